@@ -0,0 +1,201 @@
+/**
+ * @file	bench_actor.c
+ * @brief	Benchmark do runtime de atores com roubo de trabalho
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma população de atores troca mensagens: cada ping recebido é repassado a
+ * um ator aleatório até que o total de pings seja processado, com um número
+ * fixo de pings em trânsito. Um ator adicional permanece ocupado o tempo
+ * todo, realimentando o próprio evento, para mostrar que o orçamento por
+ * execução impede que ele atrase os demais. Reporta pings por segundo, roubos
+ * e eventos do ator ocupado para 1, 2, 4... até o número de workers.
+ *
+ * @code
+ * make -C benchmark actor
+ * ./build/bench_actor [-w max_workers] [-a atores] [-p pings] [-b orcamento]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fsm_actor.h"
+
+/**
+ * @defgroup bench_actor_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define ACTOR_MAILBOX		64
+#define ACTOR_DEQUE			4096
+#define ACTOR_INFLIGHT		256
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_PING, EV_DONE, EV_SPIN, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_actor_t* actor_population;
+static uint32_t actor_count = 4096;
+static int64_t actor_remaining;
+static uint32_t actor_stop;
+static __thread uint32_t actor_seed;
+
+/**
+ * @}
+ */
+
+static uint16_t actor_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+// Repassa o ping a um ator aleatório enquanto houver pings a processar
+static uint16_t actor_ping(fsm_handler_t* this)
+{
+	(void)this;
+	if( __atomic_sub_fetch(&actor_remaining, 1, __ATOMIC_RELAXED) > 0 )
+	{
+		do
+		{
+			actor_seed = actor_seed * 1664525u + 1013904223u + (uint32_t)(uintptr_t)&actor_seed;
+		} while( fsm_actor_send(&actor_population[(actor_seed >> 8) % actor_count], EV_PING) != FSM_OK );
+	}
+	return(EV_DONE);
+}
+
+static uint16_t actor_spin(fsm_handler_t* this)
+{
+	(void)this;
+	return( __atomic_load_n(&actor_stop, __ATOMIC_RELAXED) ? EV_LIMIT : EV_SPIN );
+}
+
+static fsm_state_t stateTable[] = {
+	/* callback state		event		next state */
+	{ (void*)actor_idle,	EV_PING,	(void*)actor_ping	},
+	{ (void*)actor_ping,	EV_DONE,	(void*)actor_idle	},
+	{ (void*)actor_spin,	EV_SPIN,	(void*)actor_spin	},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((double)ts.tv_sec + (double)ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_actor_runtime_t runtime;
+	fsm_actor_worker_t *workers;
+	fsm_actor_cell_t *cells;
+	fsm_actor_t **slots, busy;
+	fsm_actor_cell_t busy_cells[ACTOR_MAILBOX];
+	uint64_t pings = 2000000ull, steals, events;
+	uint32_t max_workers = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN), budget = 64, number, i;
+	const char *sep = "";
+	double start, elapsed;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-w") == 0 )
+		{
+			max_workers = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-a") == 0 )
+		{
+			actor_count = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-p") == 0 )
+		{
+			pings = strtoull(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-b") == 0 )
+		{
+			budget = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+	if( (max_workers == 0) || (max_workers > 256) || (actor_count < ACTOR_INFLIGHT) )
+	{
+		fprintf(stderr, "invalid arguments\n");
+		return(1);
+	}
+
+	actor_population	= (fsm_actor_t*)calloc(actor_count, sizeof(fsm_actor_t));
+	cells				= (fsm_actor_cell_t*)calloc((size_t)actor_count * ACTOR_MAILBOX, sizeof(fsm_actor_cell_t));
+	workers				= (fsm_actor_worker_t*)calloc(max_workers, sizeof(fsm_actor_worker_t));
+	slots				= (fsm_actor_t**)calloc((size_t)max_workers * ACTOR_DEQUE, sizeof(fsm_actor_t*));
+	if( (actor_population == NULL) || (cells == NULL) || (workers == NULL) || (slots == NULL) )
+	{
+		fprintf(stderr, "without resources\n");
+		return(1);
+	}
+
+	printf("{\n  \"benchmark\": \"fsm_actor\",\n  \"actors\": %u,\n  \"pings\": %llu,\n  \"inflight\": %u,\n  \"budget\": %u,\n  \"runs\": [",
+		   actor_count, (unsigned long long)pings, ACTOR_INFLIGHT, budget);
+
+	for( number=1; number<=max_workers; number=((number*2 > max_workers) && (number != max_workers)) ? max_workers : number*2 )
+	{
+		if( fsm_actor_init(&runtime, workers, (uint16_t)number, slots, ACTOR_DEQUE, budget) != FSM_OK )
+		{
+			fprintf(stderr, "invalid runtime\n");
+			return(1);
+		}
+		for( i=0; i<actor_count; i++ )
+		{
+			fsm_actor_create(&actor_population[i], &runtime, &cells[(size_t)i * ACTOR_MAILBOX], ACTOR_MAILBOX,
+							 stateTable, (void*)actor_idle, "actor", EV_LIMIT);
+		}
+		fsm_actor_create(&busy, &runtime, busy_cells, ACTOR_MAILBOX, stateTable, (void*)actor_spin, "busy", EV_LIMIT);
+		__atomic_store_n(&actor_stop, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&actor_remaining, (int64_t)pings, __ATOMIC_RELAXED);
+
+		fsm_actor_start(&runtime);
+		fsm_actor_send(&busy, EV_SPIN);
+		start = bench_now();
+		for( i=0; i<ACTOR_INFLIGHT; i++ )
+		{
+			fsm_actor_send(&actor_population[(i * 2654435761u) % actor_count], EV_PING);
+		}
+		while( __atomic_load_n(&actor_remaining, __ATOMIC_RELAXED) > 0 )
+		{
+			usleep(100);
+		}
+		elapsed = bench_now() - start;
+		__atomic_store_n(&actor_stop, 1, __ATOMIC_RELAXED);
+		fsm_actor_stop(&runtime);
+
+		steals = 0;
+		events = 0;
+		for( i=0; i<number; i++ )
+		{
+			steals += workers[i].steals;
+			events += workers[i].events;
+		}
+		printf("%s\n    { \"workers\": %u, \"seconds\": %.3f, \"pings_per_second\": %.0f, \"events\": %llu, \"steals\": %llu }",
+			   sep, number, elapsed, (double)pings / elapsed, (unsigned long long)events, (unsigned long long)steals);
+		sep = ",";
+
+		if( number == max_workers )
+		{
+			break;
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	return(0);
+}
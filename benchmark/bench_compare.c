@@ -0,0 +1,187 @@
+/**
+ * @file	bench_compare.c
+ * @brief	Comparação do fsm_engine com outras implementações de FSM
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Executa a máquina do menu de examples/FSM_STM32F7 e uma máquina sintética
+ * em anel com o fsm_engine, com um switch escrito à mão, com tinyfsm e com
+ * Boost.SML (os dois últimos apenas quando os headers estão disponíveis).
+ * Todos os estilos recebem a mesma sequência de eventos e precisam terminar
+ * no mesmo estado. São reportados latência por passo, vazão, tamanho de
+ * código (text+data do objeto, recebido do Makefile como nome=bytes) e RAM
+ * por instância, em JSON.
+ *
+ * @code
+ * make -C benchmark compare [TINYFSM_INC=...] [SML_INC=...]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "compare.h"
+
+/**
+ * Macros Privadas
+ */
+#define COMPARE_STREAM_SIZE		4096
+#define COMPARE_VALIDATE_STEPS	100000
+#define COMPARE_REPEAT			5
+
+/**
+ * Variáveis privadas
+ */
+static const struct
+{
+	const compare_style_t*	style;
+	const char*				object;
+	int						engine;		/**< soma o tamanho de src/fsm.c ao tamanho de código */
+} compare_list[] = {
+	{ &compare_fsm_menu,		"compare_fsm_menu",		1 },
+	{ &compare_switch_menu,		"compare_switch_menu",	0 },
+	{ &compare_tinyfsm_menu,	"compare_tinyfsm_menu",	0 },
+	{ &compare_sml_menu,		"compare_sml_menu",		0 },
+	{ &compare_fsm_ring,		"compare_fsm_ring",		1 },
+	{ &compare_switch_ring,		"compare_switch_ring",	0 },
+	{ &compare_tinyfsm_ring,	"compare_tinyfsm_ring",	0 },
+	{ &compare_sml_ring,		"compare_sml_ring",		0 },
+};
+
+static uint16_t compare_menu_stream[COMPARE_STREAM_SIZE];
+static uint16_t compare_ring_stream[COMPARE_STREAM_SIZE];
+
+static uint64_t compare_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return((x > y) - (x < y));
+}
+
+/**
+ * @brief compare_size
+ *
+ * Procura o tamanho de um objeto nos argumentos nome=bytes (0 caso não informado)
+ */
+static long compare_size(int argc, char *argv[], const char *name)
+{
+	size_t len = strlen(name);
+	int i;
+
+	for( i=1; i<argc; i++ )
+	{
+		if( (strncmp(argv[i], name, len) == 0) && (argv[i][len] == '=') )
+		{
+			return(strtol(&argv[i][len+1], NULL, 10));
+		}
+	}
+	return(0);
+}
+
+int main(int argc, char *argv[])
+{
+	const compare_style_t *style;
+	const uint16_t *stream;
+	double samples[COMPARE_REPEAT];
+	uint64_t start, elapsed, steps;
+	uint32_t seed = 0x2545F491;
+	uint32_t expected_menu = 0xFFFFFFFF, expected_ring = 0xFFFFFFFF;
+	uint32_t *expected, final_state;
+	uint32_t i, r;
+	long code;
+	const char *sep = "";
+	int ret = 0;
+
+	for( i=0; i<COMPARE_STREAM_SIZE; i++ )
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		compare_menu_stream[i] = (uint16_t)(seed % COMPARE_MENU_EVENTS);
+		compare_ring_stream[i] = (uint16_t)((seed >> 8) % COMPARE_RING_EVENTS);
+	}
+
+	printf("{\n  \"benchmark\": \"fsm_compare\",\n  \"results\": [");
+	for( i=0; i<sizeof(compare_list)/sizeof(compare_list[0]); i++ )
+	{
+		style = compare_list[i].style;
+		if( strcmp(style->machine, "menu") == 0 )
+		{
+			stream = compare_menu_stream;
+			expected = &expected_menu;
+		}
+		else
+		{
+			stream = compare_ring_stream;
+			expected = &expected_ring;
+		}
+
+		if( style->run == NULL )
+		{
+			printf("%s\n    { \"style\": \"%s\", \"machine\": \"%s\", \"skipped\": \"%s\" }",
+				   sep, style->style, style->machine, style->note);
+			sep = ",";
+			continue;
+		}
+
+		// Todos os estilos devem chegar ao mesmo estado
+		style->reset();
+		final_state = style->run(stream, COMPARE_STREAM_SIZE-1, COMPARE_VALIDATE_STEPS);
+		if( *expected == 0xFFFFFFFF )
+		{
+			*expected = final_state;
+		}
+		else if( *expected != final_state )
+		{
+			fprintf(stderr, "%s/%s: final state %u, expected %u\n",
+					style->style, style->machine, (unsigned)final_state, (unsigned)*expected);
+			ret = 1;
+		}
+
+		for( r=0; r<COMPARE_REPEAT; r++ )
+		{
+			style->reset();
+			steps = 0;
+			start = compare_now();
+			do
+			{
+				style->run(stream, COMPARE_STREAM_SIZE-1, 65536);
+				steps += 65536;
+				elapsed = compare_now() - start;
+			} while( elapsed < 50000000ull );
+			samples[r] = (double)elapsed / (double)steps;
+		}
+		qsort(samples, COMPARE_REPEAT, sizeof(double), compare_double);
+
+		code = compare_size(argc, argv, compare_list[i].object);
+		if( compare_list[i].engine )
+		{
+			code += compare_size(argc, argv, "fsm");
+		}
+
+		printf("%s\n    { \"style\": \"%s\", \"machine\": \"%s\", \"ns_per_step\": %.2f, "
+			   "\"steps_per_sec\": %.0f, \"code_bytes\": %ld, \"ram_bytes_per_instance\": %u, "
+			   "\"ram_note\": \"%s\" }",
+			   sep, style->style, style->machine, samples[COMPARE_REPEAT/2],
+			   1e9 / samples[COMPARE_REPEAT/2], code, (unsigned)style->ram, style->note);
+		sep = ",";
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	return(ret);
+}
@@ -0,0 +1,316 @@
+/**
+ * @file	bench_engine.c
+ * @brief	Microbenchmark do custo de busca do fsm_engine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Mede passos por segundo e ns por passo do fsm_engine, e o tempo do
+ * fsm_create, para tabelas de 8 a 10.000 linhas. Cada caso varia a posição
+ * da transição ativa na tabela e a fração de passos em que nenhuma transição
+ * é disparada (evento válido sem regra para o estado atual, o que obriga a
+ * varredura completa da tabela). O resultado é emitido em JSON na saída
+ * padrão.
+ *
+ * @code
+ * make -C benchmark run
+ * ./build/bench_engine [-t ms_por_caso] > bench_engine.json
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "fsm.h"
+
+/**
+ * @defgroup bench_engine_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define BENCH_EVENTS_MAX	64
+#define BENCH_STATES_MAX	256
+#define BENCH_HOT_A			(BENCH_STATES_MAX-2)
+#define BENCH_HOT_B			(BENCH_STATES_MAX-1)
+#define BENCH_EV_HIT		0
+#define BENCH_EV_MISS		1
+#define BENCH_STREAM_SIZE	4096
+#define BENCH_REPEAT		5
+
+// Gera 256 callbacks distintos, um por estado
+#define BENCH_HEX(m, p)	m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7) \
+						m(p##8) m(p##9) m(p##a) m(p##b) m(p##c) m(p##d) m(p##e) m(p##f)
+#define BENCH_ALL(m)	BENCH_HEX(m,0) BENCH_HEX(m,1) BENCH_HEX(m,2) BENCH_HEX(m,3) \
+						BENCH_HEX(m,4) BENCH_HEX(m,5) BENCH_HEX(m,6) BENCH_HEX(m,7) \
+						BENCH_HEX(m,8) BENCH_HEX(m,9) BENCH_HEX(m,a) BENCH_HEX(m,b) \
+						BENCH_HEX(m,c) BENCH_HEX(m,d) BENCH_HEX(m,e) BENCH_HEX(m,f)
+
+/**
+ * Variáveis privadas
+ */
+static uint16_t bench_stream[BENCH_STREAM_SIZE];
+static uint32_t bench_pos;
+static uint32_t bench_seed = 0x12345678;
+
+static const uint32_t bench_rows[]			= { 8, 16, 64, 256, 1024, 4096, 10000 };
+static const double	  bench_positions[]		= { 0.0, 0.5, 1.0 };
+static const double	  bench_miss_ratios[]	= { 0.0, 0.25, 0.5, 1.0 };
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint32_t bench_random(void);
+static uint64_t bench_now(void);
+
+#define BENCH_STATE(n)	static uint16_t bench_state_##n(fsm_handler_t *this) \
+						{ (void)this; return(bench_stream[bench_pos++ & (BENCH_STREAM_SIZE-1)]); }
+BENCH_ALL(BENCH_STATE)
+
+#define BENCH_PTR(n)	(void*)bench_state_##n,
+static void* const bench_states[BENCH_STATES_MAX] = { BENCH_ALL(BENCH_PTR) };
+
+/**
+ * @}
+ */
+
+/**
+ * @brief bench_random
+ *
+ * Gerador xorshift32 determinístico, para que as execuções sejam comparáveis
+ */
+static uint32_t bench_random(void)
+{
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 17;
+	bench_seed ^= bench_seed << 5;
+	return(bench_seed);
+}
+
+/**
+ * @brief bench_now
+ *
+ * Retorna o tempo monotônico em ns
+ */
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief		Monta uma tabela sintética
+ * @details		A tabela tem exatamente rows linhas (mais o terminador). Os estados frios
+ *				combinam todos os eventos com próximos estados distintos, para respeitar as
+ *				regras do fsm_checkStateTable. Os dois estados quentes alternam entre si com
+ *				BENCH_EV_HIT e não possuem regra para BENCH_EV_MISS; suas linhas são
+ *				posicionadas na fração position da tabela.
+ * @param		table tabela de saída com pelo menos rows+1 posições
+ * @param		rows quantidade de linhas da tabela (>= 2)
+ * @param		position posição relativa (0 a 1) das linhas quentes
+ * @return		Quantidade de eventos utilizada pela tabela
+ */
+static uint16_t bench_build_table(fsm_state_t *table, uint32_t rows, double position)
+{
+	uint32_t events, states, cold, row, hot, s, e;
+
+	events = 2;
+	while( ((events*2) <= BENCH_EVENTS_MAX) && ((events*2)*(events*2) <= rows) )
+	{
+		events *= 2;
+	}
+	states = (rows + events - 1) / events;
+
+	cold = rows - 2;
+	hot = (uint32_t)(position * (double)cold);
+
+	row = 0;
+	for( s=0; (s<states) && (row<rows); s++ )
+	{
+		for( e=0; (e<events) && (row<rows); e++ )
+		{
+			if( row == hot )
+			{
+				table[row].cb_state	= bench_states[BENCH_HOT_A];
+				table[row].eventID	= BENCH_EV_HIT;
+				table[row].cb_next	= bench_states[BENCH_HOT_B];
+				row++;
+				table[row].cb_state	= bench_states[BENCH_HOT_B];
+				table[row].eventID	= BENCH_EV_HIT;
+				table[row].cb_next	= bench_states[BENCH_HOT_A];
+				row++;
+				if( row >= rows )
+				{
+					break;
+				}
+			}
+			table[row].cb_state	= bench_states[s];
+			table[row].eventID	= (uint16_t)e;
+			table[row].cb_next	= bench_states[(s + e + 1) % states];
+			row++;
+		}
+	}
+
+	table[rows].cb_state	= NULL;
+	table[rows].eventID		= (uint16_t)events;
+	table[rows].cb_next		= NULL;
+
+	return((uint16_t)events);
+}
+
+/**
+ * @brief bench_build_stream
+ *
+ * Preenche a sequência de eventos retornada pelos callbacks com a fração miss de eventos sem transição
+ */
+static void bench_build_stream(double miss)
+{
+	uint32_t i;
+	uint32_t limit = (uint32_t)(miss * 4294967295.0);
+
+	for( i=0; i<BENCH_STREAM_SIZE; i++ )
+	{
+		bench_stream[i] = ((miss >= 1.0) || (bench_random() < limit)) ? BENCH_EV_MISS : BENCH_EV_HIT;
+	}
+	bench_pos = 0;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return((x > y) - (x < y));
+}
+
+/**
+ * @brief		Mede o custo por passo do fsm_engine
+ * @return		Mediana de ns por passo entre BENCH_REPEAT repetições
+ */
+static double bench_engine(fsm_state_t *table, uint16_t events, uint64_t budget_ns)
+{
+	fsm_handler_t fsm;
+	double samples[BENCH_REPEAT];
+	uint64_t start, elapsed, steps, i;
+	uint32_t r;
+
+	for( r=0; r<BENCH_REPEAT; r++ )
+	{
+		if( fsm_create(&fsm, table, bench_states[BENCH_HOT_A], "bench", events) != FSM_OK )
+		{
+			fprintf(stderr, "invalid state table\n");
+			exit(1);
+		}
+		fsm.eventID = BENCH_EV_HIT;
+
+		steps = 0;
+		start = bench_now();
+		do
+		{
+			for( i=0; i<1024; i++ )
+			{
+				fsm_engine(&fsm);
+			}
+			steps += 1024;
+			elapsed = bench_now() - start;
+		} while( elapsed < budget_ns );
+
+		samples[r] = (double)elapsed / (double)steps;
+	}
+
+	qsort(samples, BENCH_REPEAT, sizeof(double), bench_compare);
+	return(samples[BENCH_REPEAT/2]);
+}
+
+/**
+ * @brief		Mede o tempo do fsm_create (dominado pelo fsm_checkStateTable)
+ * @return		Mediana de ns por chamada
+ */
+static double bench_create(fsm_state_t *table, uint16_t events, uint64_t budget_ns)
+{
+	fsm_handler_t fsm;
+	double samples[BENCH_REPEAT];
+	uint64_t start, elapsed, calls;
+	uint32_t r;
+
+	for( r=0; r<BENCH_REPEAT; r++ )
+	{
+		calls = 0;
+		start = bench_now();
+		do
+		{
+			fsm_create(&fsm, table, bench_states[BENCH_HOT_A], "bench", events);
+			calls++;
+			elapsed = bench_now() - start;
+		} while( elapsed < (budget_ns / BENCH_REPEAT) );
+
+		samples[r] = (double)elapsed / (double)calls;
+	}
+
+	qsort(samples, BENCH_REPEAT, sizeof(double), bench_compare);
+	return(samples[BENCH_REPEAT/2]);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_state_t *table;
+	uint64_t budget_ns = 20000000ull;
+	uint32_t r, p, m;
+	uint16_t events;
+	double ns;
+	const char *sep = "";
+
+	if( (argc > 2) && (strcmp(argv[1], "-t") == 0) )
+	{
+		budget_ns = (uint64_t)strtoul(argv[2], NULL, 10) * 1000000ull;
+	}
+
+	table = (fsm_state_t*)malloc((bench_rows[sizeof(bench_rows)/sizeof(bench_rows[0])-1] + 1) * sizeof(fsm_state_t));
+	if( table == NULL )
+	{
+		return(1);
+	}
+
+	printf("{\n  \"benchmark\": \"fsm_engine\",\n  \"sizeof_fsm_handler_t\": %u,\n  \"engine\": [",
+		   (unsigned)sizeof(fsm_handler_t));
+	for( r=0; r<sizeof(bench_rows)/sizeof(bench_rows[0]); r++ )
+	{
+		for( p=0; p<sizeof(bench_positions)/sizeof(bench_positions[0]); p++ )
+		{
+			events = bench_build_table(table, bench_rows[r], bench_positions[p]);
+			for( m=0; m<sizeof(bench_miss_ratios)/sizeof(bench_miss_ratios[0]); m++ )
+			{
+				bench_build_stream(bench_miss_ratios[m]);
+				ns = bench_engine(table, events, budget_ns);
+				printf("%s\n    { \"rows\": %u, \"hit_position\": %.2f, \"miss_ratio\": %.2f, "
+					   "\"ns_per_step\": %.2f, \"steps_per_sec\": %.0f }",
+					   sep, bench_rows[r], bench_positions[p], bench_miss_ratios[m], ns, 1e9 / ns);
+				sep = ",";
+				fflush(stdout);
+			}
+		}
+	}
+
+	printf("\n  ],\n  \"create\": [");
+	sep = "";
+	for( r=0; r<sizeof(bench_rows)/sizeof(bench_rows[0]); r++ )
+	{
+		events = bench_build_table(table, bench_rows[r], 0.5);
+		ns = bench_create(table, events, budget_ns);
+		printf("%s\n    { \"rows\": %u, \"ns_per_create\": %.0f }", sep, bench_rows[r], ns);
+		sep = ",";
+		fflush(stdout);
+	}
+	printf("\n  ]\n}\n");
+
+	free(table);
+	return(0);
+}
@@ -0,0 +1,305 @@
+/**
+ * @file	bench_scale.c
+ * @brief	Benchmark de escala: milhões de instâncias compartilhando uma tabela
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cria de 10^4 a 10^7 instâncias de fsm_handler_t com a tabela do menu de
+ * examples/FSM_STM32F7 e as conduz com uma mistura aleatória de eventos,
+ * em ordem aleatória e sequencial de instâncias. Reporta passos por segundo,
+ * bytes por instância, o tempo do fsm_create para toda a população e, quando
+ * os contadores de desempenho estão disponíveis (perf_event_open), as falhas
+ * de cache L1D e LLC por passo. O Makefile compila o benchmark também com
+ * FSM_NAME_MAX_LENGTH=1 para medir o custo do nome de 16 bytes por instância.
+ * Com -H a população é alocada com fsm_numa_alloc em páginas de 2 MB, e com
+ * -N ligada a um nó NUMA, para comparar o custo das varreduras.
+ *
+ * @code
+ * make -C benchmark scale
+ * ./build/bench_scale [-n max_instancias] [-s passos] [-H] [-N no]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#	include <sys/ioctl.h>
+#	include <sys/syscall.h>
+#	include <linux/perf_event.h>
+#endif
+#include "fsm.h"
+#include "fsm_numa.h"
+
+/**
+ * @defgroup bench_scale_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define SCALE_COUNTERS	2
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_NONE, EV_SELECT, EV_UP, EV_DOWN, EV_LEFT, EV_RIGHT, EV_LIMIT };
+
+typedef struct scale_counters
+{
+	int			fd[SCALE_COUNTERS];
+	uint64_t	value[SCALE_COUNTERS];
+} scale_counters_t;
+
+/**
+ * Variáveis privadas
+ */
+static const char* const scale_counter_names[SCALE_COUNTERS] = { "l1d_read_misses", "llc_read_misses" };
+static uint64_t scale_seed = 0x9E3779B97F4A7C15ull;
+
+/**
+ * @}
+ */
+
+// Os estados não produzem eventos: os eventos vêm apenas da mistura aleatória
+static uint16_t menu_off	(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t menu_on		(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t menu_play	(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t menu_treble	(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t menu_mid	(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t menu_bass	(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)menu_off,		EV_SELECT,	(void*)menu_on		},
+	{ (void*)menu_on,		EV_SELECT,	(void*)menu_play	},
+	{ (void*)menu_on,		EV_DOWN,	(void*)menu_treble	},
+	{ (void*)menu_on,		EV_UP,		(void*)menu_bass	},
+	{ (void*)menu_on,		EV_NONE,	(void*)menu_off		},
+	{ (void*)menu_play, 	EV_SELECT,	(void*)menu_on		},
+	{ (void*)menu_treble,	EV_DOWN,	(void*)menu_mid		},
+	{ (void*)menu_treble,	EV_UP,		(void*)menu_on		},
+	{ (void*)menu_mid,		EV_DOWN,	(void*)menu_bass	},
+	{ (void*)menu_mid,		EV_UP,		(void*)menu_treble	},
+	{ (void*)menu_bass,		EV_DOWN,	(void*)menu_on		},
+	{ (void*)menu_bass,		EV_UP,		(void*)menu_mid		},
+	{ NULL,					EV_LIMIT,	NULL,				}
+};
+
+static uint64_t scale_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief scale_random
+ *
+ * Gerador xorshift64 determinístico
+ */
+static uint64_t scale_random(void)
+{
+	scale_seed ^= scale_seed << 13;
+	scale_seed ^= scale_seed >> 7;
+	scale_seed ^= scale_seed << 17;
+	return(scale_seed);
+}
+
+/**
+ * @brief		Abre os contadores de falhas de cache
+ * @details		Em sistemas sem suporte (containers, VMs sem PMU) os descritores ficam
+ *				em -1 e os valores são reportados como null
+ */
+static void scale_counters_open(scale_counters_t *counters)
+{
+	int i;
+
+	for( i=0; i<SCALE_COUNTERS; i++ )
+	{
+		counters->fd[i] = -1;
+	}
+
+#ifdef __linux__
+	for( i=0; i<SCALE_COUNTERS; i++ )
+	{
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size			= sizeof(attr);
+		attr.type			= PERF_TYPE_HW_CACHE;
+		attr.config			= ((i == 0) ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL) |
+							  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+							  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled		= 1;
+		attr.exclude_kernel	= 1;
+		attr.exclude_hv		= 1;
+		counters->fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#endif
+}
+
+static void scale_counters_start(scale_counters_t *counters)
+{
+#ifdef __linux__
+	int i;
+
+	for( i=0; i<SCALE_COUNTERS; i++ )
+	{
+		if( counters->fd[i] >= 0 )
+		{
+			ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#else
+	(void)counters;
+#endif
+}
+
+static void scale_counters_stop(scale_counters_t *counters)
+{
+	int i;
+
+	for( i=0; i<SCALE_COUNTERS; i++ )
+	{
+		counters->value[i] = 0;
+#ifdef __linux__
+		if( counters->fd[i] >= 0 )
+		{
+			ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			if( read(counters->fd[i], &counters->value[i], sizeof(uint64_t)) != sizeof(uint64_t) )
+			{
+				counters->value[i] = 0;
+			}
+		}
+#endif
+	}
+}
+
+static void scale_counters_print(const scale_counters_t *counters, uint64_t steps)
+{
+	int i;
+
+	for( i=0; i<SCALE_COUNTERS; i++ )
+	{
+		if( counters->fd[i] >= 0 )
+		{
+			printf(", \"%s_per_step\": %.4f", scale_counter_names[i], (double)counters->value[i] / (double)steps);
+		}
+		else
+		{
+			printf(", \"%s_per_step\": null", scale_counter_names[i]);
+		}
+	}
+	printf(", \"l2_misses_per_step\": null");
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_handler_t *population;
+	scale_counters_t counters;
+	fsm_numa_t numa;
+	fsm_alloc_t allocator;
+	uint8_t flags = 0;
+	int node = FSM_NUMA_ANY;
+	uint64_t max_instances = 10000000ull;
+	uint64_t steps = 20000000ull;
+	uint64_t count, i, step, start, create_ns, elapsed, transitions;
+	uint64_t r;
+	int a, access;
+	const char *sep = "";
+
+	for( a=1; a<argc; a++ )
+	{
+		if( (strcmp(argv[a], "-n") == 0) && (a+1 < argc) )
+		{
+			max_instances = strtoull(argv[++a], NULL, 10);
+		}
+		else if( (strcmp(argv[a], "-s") == 0) && (a+1 < argc) )
+		{
+			steps = strtoull(argv[++a], NULL, 10);
+		}
+		else if( (strcmp(argv[a], "-N") == 0) && (a+1 < argc) )
+		{
+			node = atoi(argv[++a]);
+		}
+		else if( strcmp(argv[a], "-H") == 0 )
+		{
+			flags |= FSM_NUMA_HUGE;
+		}
+	}
+	fsm_numa_allocator(&allocator, &numa, node, flags);
+
+	scale_counters_open(&counters);
+
+	printf("{\n  \"benchmark\": \"fsm_scale\",\n  \"sizeof_fsm_handler_t\": %u,\n  \"fsm_name_max_length\": %u,\n"
+		   "  \"table_rows\": %u,\n  \"results\": [",
+		   (unsigned)sizeof(fsm_handler_t), (unsigned)FSM_NAME_MAX_LENGTH,
+		   (unsigned)(sizeof(stateTable)/sizeof(stateTable[0]) - 1));
+
+	for( count=10000; count<=max_instances; count*=10 )
+	{
+		population = (fsm_handler_t*)allocator.alloc(count * sizeof(fsm_handler_t), allocator.context);
+		if( population == NULL )
+		{
+			fprintf(stderr, "without resources for %llu instances\n", (unsigned long long)count);
+			break;
+		}
+
+		start = scale_now();
+		for( i=0; i<count; i++ )
+		{
+			fsm_create(&population[i], stateTable, (void*)menu_off, "scale", EV_LIMIT);
+		}
+		create_ns = scale_now() - start;
+
+		for( access=0; access<2; access++ )
+		{
+			transitions = 0;
+			i = 0;
+			scale_counters_start(&counters);
+			start = scale_now();
+			for( step=0; step<steps; step++ )
+			{
+				r = scale_random();
+				// 0 = aleatório, 1 = sequencial
+				i = (access == 0) ? ((r >> 8) % count) : ((i + 1 < count) ? i + 1 : 0);
+				population[i].eventID = (uint16_t)(r % EV_LIMIT);
+				transitions += (fsm_engine(&population[i]) == FSM_OK);
+			}
+			elapsed = scale_now() - start;
+			scale_counters_stop(&counters);
+
+			printf("%s\n    { \"instances\": %llu, \"access\": \"%s\", \"bytes_per_instance\": %u, "
+				   "\"population_bytes\": %llu, \"create_total_ms\": %.3f, \"ns_per_create\": %.2f, "
+				   "\"pages\": \"%s\", \"numa_bound\": %s, "
+				   "\"steps_per_sec\": %.0f, \"ns_per_step\": %.2f, \"transition_ratio\": %.3f",
+				   sep, (unsigned long long)count, (access == 0) ? "random" : "sequential",
+				   (unsigned)sizeof(fsm_handler_t), (unsigned long long)(count * sizeof(fsm_handler_t)),
+				   (double)create_ns / 1e6, (double)create_ns / (double)count,
+				   (numa.huge == FSM_NUMA_PAGES_EXPLICIT) ? "hugetlb" : ((numa.huge == FSM_NUMA_PAGES_TRANSPARENT) ? "thp" : "4k"),
+				   numa.bound ? "true" : "false",
+				   (double)steps * 1e9 / (double)elapsed, (double)elapsed / (double)steps,
+				   (double)transitions / (double)steps);
+			scale_counters_print(&counters, steps);
+			printf(" }");
+			sep = ",";
+			fflush(stdout);
+		}
+
+		allocator.release(population, count * sizeof(fsm_handler_t), allocator.context);
+	}
+	printf("\n  ]\n}\n");
+
+	return(0);
+}
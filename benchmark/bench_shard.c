@@ -0,0 +1,170 @@
+/**
+ * @file	bench_shard.c
+ * @brief	Benchmark do runtime particionado por núcleo
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Entidades identificadas por chave trocam pings: cada ping recebido é
+ * repassado a uma chave aleatória, no mesmo shard ou em outro, pelas filas
+ * SPSC entre shards. A thread principal injeta os pings iniciais pela origem
+ * FSM_SHARD_INGRESS e mede, por um intervalo fixo, os eventos entregues em
+ * cada shard. Reporta eventos por segundo no total e por shard para 1, 2,
+ * 4... até o número de shards.
+ *
+ * @code
+ * make -C benchmark shard
+ * ./build/bench_shard [-s max_shards] [-k chaves] [-t milissegundos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fsm_shard.h"
+
+/**
+ * @defgroup bench_shard_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define SHARD_RING			1024
+#define SHARD_MAP			1024
+#define SHARD_INFLIGHT		128		/**< Pings em trânsito por shard */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_PING, EV_DONE, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static uint64_t shard_keys = 1000000ull;
+static __thread uint64_t shard_seed;
+static uint64_t shard_lost;
+
+/**
+ * @}
+ */
+
+static uint16_t shard_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+// Repassa o ping para uma chave aleatória
+static uint16_t shard_ping(fsm_handler_t* this)
+{
+	fsm_shard_t *shard = fsm_shard_of(this);
+
+	shard_seed = shard_seed * 6364136223846793005ull + fsm_map_key(this) + 1442695040888963407ull;
+	if( fsm_shard_send(shard->runtime, shard->index, (shard_seed >> 16) % shard_keys, EV_PING) != FSM_OK )
+	{
+		__atomic_add_fetch(&shard_lost, 1, __ATOMIC_RELAXED);
+	}
+	return(EV_DONE);
+}
+
+static fsm_state_t stateTable[] = {
+	/* callback state		event		next state */
+	{ (void*)shard_idle,	EV_PING,	(void*)shard_ping	},
+	{ (void*)shard_ping,	EV_DONE,	(void*)shard_idle	},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+int main(int argc, char *argv[])
+{
+	fsm_shard_runtime_t runtime;
+	fsm_shard_t *shards;
+	fsm_shard_ring_t *rings;
+	fsm_shard_msg_t *cells;
+	fsm_map_entry_t *entries;
+	struct timespec delay;
+	uint64_t events, dropped;
+	uint32_t max_shards = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN), millis = 500, number, i;
+	const char *sep = "";
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-s") == 0 )
+		{
+			max_shards = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-k") == 0 )
+		{
+			shard_keys = strtoull(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-t") == 0 )
+		{
+			millis = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+	if( (max_shards == 0) || (max_shards > 256) || (shard_keys == 0) || (millis == 0) )
+	{
+		fprintf(stderr, "invalid arguments\n");
+		return(1);
+	}
+
+	shards	= (fsm_shard_t*)aligned_alloc(FSM_SHARD_LINE, max_shards * sizeof(fsm_shard_t));
+	rings	= (fsm_shard_ring_t*)aligned_alloc(FSM_SHARD_LINE, FSM_SHARD_RINGS(max_shards) * sizeof(fsm_shard_ring_t));
+	cells	= (fsm_shard_msg_t*)calloc((size_t)FSM_SHARD_RINGS(max_shards) * SHARD_RING, sizeof(fsm_shard_msg_t));
+	entries	= (fsm_map_entry_t*)calloc((size_t)max_shards * SHARD_MAP, sizeof(fsm_map_entry_t));
+	if( (shards == NULL) || (rings == NULL) || (cells == NULL) || (entries == NULL) )
+	{
+		fprintf(stderr, "without resources\n");
+		return(1);
+	}
+
+	printf("{\n  \"benchmark\": \"fsm_shard\",\n  \"keys\": %llu,\n  \"milliseconds\": %u,\n  \"inflight_per_shard\": %u,\n  \"runs\": [",
+		   (unsigned long long)shard_keys, millis, SHARD_INFLIGHT);
+
+	for( number=1; number<=max_shards; number=((number*2 > max_shards) && (number != max_shards)) ? max_shards : number*2 )
+	{
+		if( fsm_shard_init(&runtime, shards, (uint16_t)number, rings, cells, SHARD_RING, entries, SHARD_MAP,
+						   stateTable, (void*)shard_idle, "shard", EV_LIMIT) != FSM_OK )
+		{
+			fprintf(stderr, "invalid runtime\n");
+			return(1);
+		}
+		__atomic_store_n(&shard_lost, 0, __ATOMIC_RELAXED);
+
+		for( i=0; i<SHARD_INFLIGHT * number; i++ )
+		{
+			fsm_shard_send(&runtime, FSM_SHARD_INGRESS, ((uint64_t)i * 2654435761u) % shard_keys, EV_PING);
+		}
+		fsm_shard_start(&runtime, NULL);
+		delay.tv_sec	= millis / 1000;
+		delay.tv_nsec	= (long)(millis % 1000) * 1000000L;
+		nanosleep(&delay, NULL);
+		fsm_shard_stop(&runtime);
+
+		events = 0;
+		dropped = 0;
+		for( i=0; i<number; i++ )
+		{
+			events	+= shards[i].events;
+			dropped	+= shards[i].dropped;
+		}
+		printf("%s\n    { \"shards\": %u, \"events_per_second\": %.0f, \"events_per_second_per_shard\": %.0f, \"dropped\": %llu, \"lost\": %llu }",
+			   sep, number, (double)events * 1000.0 / millis, (double)events * 1000.0 / millis / number,
+			   (unsigned long long)dropped, (unsigned long long)shard_lost);
+		sep = ",";
+
+		if( number == max_shards )
+		{
+			break;
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	return(0);
+}
@@ -0,0 +1,269 @@
+/**
+ * @file	bench_sim.c
+ * @brief	Benchmark da simulação por eventos discretos de uma frota de dispositivos
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada dispositivo acorda a cada 15 min (com 10% de variação), envia uma
+ * leitura e aguarda a confirmação com timeout de 5 s, repetindo até 3
+ * vezes; 1% das mensagens se perde. O tempo é em ms. fsm_sim_run entrega
+ * apenas os eventos de cada dispositivo, e o resultado é comparado com o
+ * custo estimado de executar fsm_engine em todas as instâncias a cada tick
+ * de 1 ms, medido em uma amostra curta.
+ *
+ * @code
+ * make -C benchmark sim
+ * ./build/bench_sim [-n dispositivos] [-d dias]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "fsm.h"
+#include "fsm_sim.h"
+
+/**
+ * @defgroup bench_sim_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define SIM_DAY_MS		86400000ull
+#define SIM_REPORT_MS	900000u		/**< Intervalo entre leituras */
+#define SIM_JITTER_MS	90000u		/**< Variação do intervalo, para cada lado */
+#define SIM_TIMEOUT_MS	5000u
+#define SIM_LATENCY_MS	50u			/**< Latência mínima da confirmação */
+#define SIM_SPREAD_MS	450u		/**< Variação da latência */
+#define SIM_LOSS		100u		/**< Uma em SIM_LOSS mensagens se perde */
+#define SIM_RETRIES		3u
+#define SIM_TICKS		20u			/**< Ticks da amostra de execução por tick */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_WAKE, EV_ACK, EV_TIMEOUT, EV_GIVEUP, EV_LIMIT };
+
+typedef struct sim_device
+{
+	fsm_handler_t	fsm;		/**< Deve ser o primeiro campo */
+	fsm_sim_timer_t	timeout;	/**< Timeout da confirmação */
+	uint8_t			attempts;	/**< Envios da leitura atual */
+} sim_device_t;
+
+typedef struct sim_counters
+{
+	uint64_t	wakes;
+	uint64_t	sends;
+	uint64_t	acks;
+	uint64_t	timeouts;
+	uint64_t	giveups;
+} sim_counters_t;
+
+/**
+ * Variáveis privadas
+ */
+static fsm_sim_t		sim;
+static sim_counters_t	counters;
+static uint64_t			sim_seed = 0x9E3779B97F4A7C15ull;
+
+/**
+ * @}
+ */
+
+static uint16_t dev_sleep(fsm_handler_t* this);
+static uint16_t dev_send(fsm_handler_t* this);
+static uint16_t dev_backoff(fsm_handler_t* this);
+static uint16_t dev_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static fsm_state_t deviceTable[] = {
+	/* callback state	event			next state */
+	{ (void*)dev_sleep,		EV_WAKE,	(void*)dev_send		},
+	{ (void*)dev_send,		EV_ACK,		(void*)dev_sleep	},
+	{ (void*)dev_send,		EV_TIMEOUT,	(void*)dev_send		},
+	{ (void*)dev_send,		EV_GIVEUP,	(void*)dev_backoff	},
+	{ (void*)dev_backoff,	EV_WAKE,	(void*)dev_send		},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+static fsm_state_t idleTable[] = {
+	/* callback state	event			next state */
+	{ (void*)dev_idle,		EV_WAKE,	(void*)dev_idle		},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+/**
+ * @brief sim_random
+ *
+ * xorshift64*, determinístico entre execuções
+ */
+static uint32_t sim_random(uint32_t range)
+{
+	sim_seed ^= sim_seed >> 12;
+	sim_seed ^= sim_seed << 25;
+	sim_seed ^= sim_seed >> 27;
+	return((uint32_t)(((sim_seed * 0x2545F4914F6CDD1Dull) >> 32) % range));
+}
+
+/**
+ * @brief dev_sleep
+ *
+ * Dorme até a próxima leitura; a confirmação cancela o timeout pendente
+ */
+static uint16_t dev_sleep(fsm_handler_t* this)
+{
+	sim_device_t *device = (sim_device_t*)this;
+
+	fsm_sim_cancel(&sim, &device->timeout);
+	device->attempts = 0;
+	fsm_sim_schedule(&sim, this, EV_WAKE, SIM_REPORT_MS - SIM_JITTER_MS + sim_random(2 * SIM_JITTER_MS), NULL);
+	return(EV_LIMIT);
+}
+
+/**
+ * @brief dev_backoff
+ *
+ * Desiste da leitura atual e dorme até a próxima
+ */
+static uint16_t dev_backoff(fsm_handler_t* this)
+{
+	counters.giveups++;
+	return(dev_sleep(this));
+}
+
+/**
+ * @brief dev_send
+ *
+ * Envia a leitura e aguarda a confirmação
+ */
+static uint16_t dev_send(fsm_handler_t* this)
+{
+	sim_device_t *device = (sim_device_t*)this;
+
+	if( device->attempts == 0 )
+	{
+		counters.wakes++;
+	}
+	else
+	{
+		counters.timeouts++;
+	}
+	if( device->attempts >= SIM_RETRIES )
+	{
+		return(EV_GIVEUP);
+	}
+
+	device->attempts++;
+	counters.sends++;
+	if( sim_random(SIM_LOSS) != 0 )
+	{
+		counters.acks++;
+		fsm_sim_schedule(&sim, this, EV_ACK, SIM_LATENCY_MS + sim_random(SIM_SPREAD_MS), NULL);
+	}
+	fsm_sim_schedule(&sim, this, EV_TIMEOUT, SIM_TIMEOUT_MS, &device->timeout);
+	return(EV_LIMIT);
+}
+
+/**
+ * @brief sim_ns
+ *
+ * Relógio monotônico em nanossegundos
+ */
+static uint64_t sim_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	sim_device_t *devices;
+	fsm_handler_t *idle;
+	fsm_sim_event_t *events;
+	uint32_t number = 100000, days = 1, i, tick;
+	uint64_t start, elapsed, tick_ns, ticks;
+	fsm_result_t ret;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-n") == 0 )
+		{
+			number = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-d") == 0 )
+		{
+			days = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	devices	= (sim_device_t*)calloc(number, sizeof(sim_device_t));
+	events	= (fsm_sim_event_t*)malloc(2u * number * sizeof(fsm_sim_event_t));
+	idle	= (fsm_handler_t*)calloc(number, sizeof(fsm_handler_t));
+	if( (devices == NULL) || (events == NULL) || (idle == NULL) )
+	{
+		fprintf(stderr, "sem memória\n");
+		return(1);
+	}
+
+	// No máximo dois eventos pendentes por dispositivo: confirmação e timeout
+	fsm_sim_init(&sim, events, 2u * number);
+	for( i=0; i<number; i++ )
+	{
+		if( fsm_create(&devices[i].fsm, deviceTable, (void*)dev_sleep, "device", EV_LIMIT) != FSM_OK )
+		{
+			fprintf(stderr, "tabela inválida\n");
+			return(1);
+		}
+		// Primeira leitura espalhada pelo primeiro intervalo
+		fsm_sim_schedule(&sim, &devices[i].fsm, EV_WAKE, sim_random(SIM_REPORT_MS), NULL);
+	}
+
+	start	= sim_ns();
+	ret		= fsm_sim_run(&sim, (fsm_sim_time_t)days * SIM_DAY_MS, 0);
+	elapsed	= sim_ns() - start;
+
+	// Amostra do custo de executar todas as instâncias a cada tick
+	for( i=0; i<number; i++ )
+	{
+		fsm_create(&idle[i], idleTable, (void*)dev_idle, "device", EV_LIMIT);
+	}
+	start = sim_ns();
+	for( tick=0; tick<SIM_TICKS; tick++ )
+	{
+		for( i=0; i<number; i++ )
+		{
+			fsm_engine(&idle[i]);
+		}
+	}
+	tick_ns	= (sim_ns() - start) / SIM_TICKS;
+	ticks	= (uint64_t)days * SIM_DAY_MS;
+
+	printf("{ \"benchmark\": \"fsm_sim_fleet\", \"devices\": %u, \"days\": %u, \"result\": %d, \"events\": %llu, \"engine_steps\": %llu, "
+		   "\"wakes\": %llu, \"sends\": %llu, \"acks\": %llu, \"timeouts\": %llu, \"giveups\": %llu, \"pending\": %u, "
+		   "\"seconds\": %.3f, \"ns_per_event\": %.1f, \"sim_days_per_s\": %.3f, "
+		   "\"tick_engine_calls\": %.3e, \"tick_seconds_estimated\": %.0f, \"useful_fraction\": %.2e }\n",
+		   number, days, (int)ret, (unsigned long long)sim.dispatched, (unsigned long long)sim.steps,
+		   (unsigned long long)counters.wakes, (unsigned long long)counters.sends, (unsigned long long)counters.acks,
+		   (unsigned long long)counters.timeouts, (unsigned long long)counters.giveups, sim.pending,
+		   (double)elapsed / 1e9, (double)elapsed / (double)(sim.dispatched ? sim.dispatched : 1),
+		   (double)days / ((double)elapsed / 1e9),
+		   (double)ticks * number, (double)ticks * (double)tick_ns / 1e9,
+		   (double)sim.steps / ((double)ticks * number));
+
+	free(idle);
+	free(events);
+	free(devices);
+	return((ret == FSM_OK) ? 0 : 1);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file	bench_synth.c
+ * @brief	Benchmark do fsm_engine com FSMs sintéticas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Executa uma FSM gerada por generator/synth.py, conduzida pela sequência de
+ * eventos gerada junto com a tabela, e emite o resultado em JSON.
+ *
+ * @code
+ * make -C benchmark synth SYNTH_ARGS="--states 500 --events 32 --density 0.1 --degree zipf"
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "synth_synth.h"
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_handler_t fsm;
+	uint64_t budget_ns = 200000000ull;
+	uint64_t start, elapsed, steps, transitions, i;
+	uint64_t create_ns;
+
+	if( (argc > 2) && (strcmp(argv[1], "-t") == 0) )
+	{
+		budget_ns = (uint64_t)strtoul(argv[2], NULL, 10) * 1000000ull;
+	}
+
+	start = bench_now();
+	if( synth_Create(&fsm) != FSM_OK )
+	{
+		fprintf(stderr, "invalid state table\n");
+		return(1);
+	}
+	create_ns = bench_now() - start;
+
+	steps = 0;
+	transitions = 0;
+	start = bench_now();
+	do
+	{
+		for( i=0; i<1024; i++ )
+		{
+			transitions += (fsm_engine(&fsm) == FSM_OK);
+		}
+		steps += 1024;
+		elapsed = bench_now() - start;
+	} while( elapsed < budget_ns );
+
+	printf("{ \"benchmark\": \"fsm_synth\", \"states\": %u, \"events\": %u, \"rows\": %u, "
+		   "\"transition_ratio\": %.3f, \"ns_per_step\": %.2f, \"steps_per_sec\": %.0f, "
+		   "\"ns_per_create\": %llu }\n",
+		   (unsigned)SYNTH_STATES, (unsigned)SYNTH_EV_LIMIT, (unsigned)SYNTH_ROWS,
+		   (double)transitions / (double)steps, (double)elapsed / (double)steps,
+		   (double)steps * 1e9 / (double)elapsed, (unsigned long long)create_ns);
+
+	return(0);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file	compare.h
+ * @brief	Interface comum dos estilos de FSM comparados em bench_compare
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada estilo (fsm_engine, switch, tinyfsm, Boost.SML) implementa as mesmas
+ * máquinas em um arquivo próprio, compilado uma vez por máquina com
+ * COMPARE_MACHINE, para que o tamanho de código de cada combinação possa ser
+ * medido no objeto correspondente.
+ *
+ * Numeração comum dos estados, usada para validar que todos os estilos
+ * chegam ao mesmo estado com a mesma sequência de eventos:
+ * - menu: off=0, on=1, play=2, treble=3, mid=4, bass=5
+ * - ring: índice do estado no anel (COMPARE_RING_STATES estados)
+ *
+ */
+#ifndef __COMPARE_H__
+#define __COMPARE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Macros Públicas
+ */
+#define COMPARE_MENU			1
+#define COMPARE_RING			2
+
+#define COMPARE_MENU_EVENTS		6	/**< EV_NONE, EV_SELECT, EV_UP, EV_DOWN, EV_LEFT, EV_RIGHT */
+#define COMPARE_RING_STATES		64
+#define COMPARE_RING_EVENTS		4	/**< próximo, anterior, oposto, reset (apenas estados s%4==2) */
+
+#if COMPARE_MACHINE == COMPARE_MENU
+#	define COMPARE_MACHINE_NAME	menu
+#	define COMPARE_MACHINE_STR	"menu"
+#elif COMPARE_MACHINE == COMPARE_RING
+#	define COMPARE_MACHINE_NAME	ring
+#	define COMPARE_MACHINE_STR	"ring"
+#endif
+
+#define COMPARE_CAT_(a, b)		a##b
+#define COMPARE_CAT(a, b)		COMPARE_CAT_(a, b)
+#define COMPARE_STYLE(style)	COMPARE_CAT(compare_##style##_, COMPARE_MACHINE_NAME)
+
+/**
+ * Tipos de Dados Públicos
+ */
+typedef struct compare_style
+{
+	const char*	style;		/**< Nome do estilo de implementação */
+	const char*	machine;	/**< Nome da máquina */
+	const char*	note;		/**< Observação sobre a medição de RAM */
+	size_t		ram;		/**< Bytes de RAM por instância */
+	void		(*reset)(void);
+	uint32_t	(*run)(const uint16_t *events, uint32_t mask, uint32_t count);	/**< Retorna o estado final */
+} compare_style_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const compare_style_t compare_fsm_menu;
+extern const compare_style_t compare_fsm_ring;
+extern const compare_style_t compare_switch_menu;
+extern const compare_style_t compare_switch_ring;
+extern const compare_style_t compare_tinyfsm_menu;
+extern const compare_style_t compare_tinyfsm_ring;
+extern const compare_style_t compare_sml_menu;
+extern const compare_style_t compare_sml_ring;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file	compare_fsm.c
+ * @brief	Máquinas do bench_compare implementadas com o fsm_engine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "compare.h"
+#include "fsm.h"
+
+/**
+ * Variáveis privadas
+ */
+static fsm_handler_t compare_fsm;
+static const uint16_t *compare_events;
+static uint32_t compare_mask;
+static uint32_t compare_pos;
+
+static uint16_t compare_next(void)
+{
+	return(compare_events[compare_pos++ & compare_mask]);
+}
+
+#if COMPARE_MACHINE == COMPARE_MENU
+
+enum { EV_NONE, EV_SELECT, EV_UP, EV_DOWN, EV_LEFT, EV_RIGHT, EV_LIMIT };
+
+static uint16_t menu_off	(fsm_handler_t* this) { (void)this; return(compare_next()); }
+static uint16_t menu_on		(fsm_handler_t* this) { (void)this; return(compare_next()); }
+static uint16_t menu_play	(fsm_handler_t* this) { (void)this; return(compare_next()); }
+static uint16_t menu_treble	(fsm_handler_t* this) { (void)this; return(compare_next()); }
+static uint16_t menu_mid	(fsm_handler_t* this) { (void)this; return(compare_next()); }
+static uint16_t menu_bass	(fsm_handler_t* this) { (void)this; return(compare_next()); }
+
+static void* const compare_states[] = { (void*)menu_off, (void*)menu_on, (void*)menu_play,
+										(void*)menu_treble, (void*)menu_mid, (void*)menu_bass };
+
+// Mesma tabela de examples/FSM_STM32F7/Src/menu_tsk.c
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)menu_off,		EV_SELECT,	(void*)menu_on		},
+	{ (void*)menu_on,		EV_SELECT,	(void*)menu_play	},
+	{ (void*)menu_on,		EV_DOWN,	(void*)menu_treble	},
+	{ (void*)menu_on,		EV_UP,		(void*)menu_bass	},
+	{ (void*)menu_on,		EV_NONE,	(void*)menu_off		},
+	{ (void*)menu_play, 	EV_SELECT,	(void*)menu_on		},
+	{ (void*)menu_treble,	EV_DOWN,	(void*)menu_mid		},
+	{ (void*)menu_treble,	EV_UP,		(void*)menu_on		},
+	{ (void*)menu_mid,		EV_DOWN,	(void*)menu_bass	},
+	{ (void*)menu_mid,		EV_UP,		(void*)menu_treble	},
+	{ (void*)menu_bass,		EV_DOWN,	(void*)menu_on		},
+	{ (void*)menu_bass,		EV_UP,		(void*)menu_mid		},
+	{ NULL,					EV_LIMIT,	NULL,				}
+};
+
+#define COMPARE_STATES	6
+#define COMPARE_EVENTS	EV_LIMIT
+
+static void compare_table(void)
+{
+}
+
+#else
+
+#define COMPARE_STATES	COMPARE_RING_STATES
+#define COMPARE_EVENTS	COMPARE_RING_EVENTS
+
+#define RING_X16(m, p)	m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7) \
+						m(p##8) m(p##9) m(p##a) m(p##b) m(p##c) m(p##d) m(p##e) m(p##f)
+#define RING_ALL(m)		RING_X16(m,0) RING_X16(m,1) RING_X16(m,2) RING_X16(m,3)
+
+#define RING_STATE(n)	static uint16_t ring_##n(fsm_handler_t* this) { (void)this; return(compare_next()); }
+RING_ALL(RING_STATE)
+
+#define RING_PTR(n)		(void*)ring_##n,
+static void* const compare_states[COMPARE_RING_STATES] = { RING_ALL(RING_PTR) };
+
+static fsm_state_t stateTable[COMPARE_RING_STATES*COMPARE_RING_EVENTS + 1];
+
+static void compare_table(void)
+{
+	uint32_t s, row = 0;
+
+	for( s=0; s<COMPARE_RING_STATES; s++ )
+	{
+		stateTable[row].cb_state	= compare_states[s];
+		stateTable[row].eventID		= 0;
+		stateTable[row].cb_next		= compare_states[(s + 1) % COMPARE_RING_STATES];
+		row++;
+		stateTable[row].cb_state	= compare_states[s];
+		stateTable[row].eventID		= 1;
+		stateTable[row].cb_next		= compare_states[(s + COMPARE_RING_STATES - 1) % COMPARE_RING_STATES];
+		row++;
+		stateTable[row].cb_state	= compare_states[s];
+		stateTable[row].eventID		= 2;
+		stateTable[row].cb_next		= compare_states[(s + COMPARE_RING_STATES/2) % COMPARE_RING_STATES];
+		row++;
+		if( (s % 4) == 2 )
+		{
+			stateTable[row].cb_state	= compare_states[s];
+			stateTable[row].eventID		= 3;
+			stateTable[row].cb_next		= compare_states[0];
+			row++;
+		}
+	}
+	stateTable[row].cb_state	= NULL;
+	stateTable[row].eventID		= COMPARE_RING_EVENTS;
+	stateTable[row].cb_next		= NULL;
+}
+
+#endif
+
+static void compare_reset(void)
+{
+	compare_table();
+	fsm_create(&compare_fsm, stateTable, compare_states[0], "compare", COMPARE_EVENTS);
+}
+
+static uint32_t compare_run(const uint16_t *events, uint32_t mask, uint32_t count)
+{
+	uint32_t i;
+
+	compare_events = events;
+	compare_mask = mask;
+	compare_pos = 0;
+
+	// O primeiro evento é entregue diretamente; os seguintes vêm dos callbacks
+	compare_fsm.eventID = compare_next();
+	for( i=0; i<count; i++ )
+	{
+		fsm_engine(&compare_fsm);
+	}
+
+	for( i=0; i<COMPARE_STATES; i++ )
+	{
+		if( compare_states[i] == compare_fsm.cb_state )
+		{
+			break;
+		}
+	}
+	return(i);
+}
+
+const compare_style_t COMPARE_STYLE(fsm) = {
+	"fsm_engine", COMPARE_MACHINE_STR, "sizeof(fsm_handler_t)",
+	sizeof(fsm_handler_t), compare_reset, compare_run
+};
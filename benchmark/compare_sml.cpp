@@ -0,0 +1,198 @@
+/**
+ * @file	compare_sml.cpp
+ * @brief	Máquinas do bench_compare implementadas com Boost.SML
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Compilado apenas quando <boost/sml.hpp> está no include path
+ * (make compare SML_INC=/caminho/para/sml/include). O SML exige um tipo por
+ * estado declarado na tabela de transição: na máquina em anel os
+ * COMPARE_RING_STATES estados são instâncias de Ring<N> e as linhas da
+ * tabela são geradas por expansão de std::index_sequence.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <new>
+#include <utility>
+#include "compare.h"
+
+#if defined(__has_include)
+#	if __has_include(<boost/sml.hpp>)
+#		define COMPARE_HAS_SML 1
+#	endif
+#endif
+
+#if COMPARE_HAS_SML
+
+#include <boost/sml.hpp>
+
+namespace sml = boost::sml;
+
+#if COMPARE_MACHINE == COMPARE_MENU
+
+struct EvNone {};
+struct EvSelect {};
+struct EvUp {};
+struct EvDown {};
+
+struct Off {};
+struct On {};
+struct Play {};
+struct Treble {};
+struct Mid {};
+struct Bass {};
+
+struct Menu
+{
+	auto operator()() const
+	{
+		using namespace sml;
+		return make_transition_table(
+			*state<Off>		+ event<EvSelect>	= state<On>,
+			state<On>		+ event<EvSelect>	= state<Play>,
+			state<On>		+ event<EvDown>		= state<Treble>,
+			state<On>		+ event<EvUp>		= state<Bass>,
+			state<On>		+ event<EvNone>		= state<Off>,
+			state<Play>		+ event<EvSelect>	= state<On>,
+			state<Treble>	+ event<EvDown>		= state<Mid>,
+			state<Treble>	+ event<EvUp>		= state<On>,
+			state<Mid>		+ event<EvDown>		= state<Bass>,
+			state<Mid>		+ event<EvUp>		= state<Treble>,
+			state<Bass>		+ event<EvDown>		= state<On>,
+			state<Bass>		+ event<EvUp>		= state<Mid>
+		);
+	}
+};
+
+typedef sml::sm<Menu> compare_sm_t;
+#define COMPARE_SM_STR	"sizeof(sml::sm<Menu>)"
+
+static void compare_dispatch(compare_sm_t &sm, uint16_t event)
+{
+	// EV_NONE=0, EV_SELECT=1, EV_UP=2, EV_DOWN=3; EV_LEFT e EV_RIGHT não geram transições
+	switch(event)
+	{
+	case 0: sm.process_event(EvNone{}); break;
+	case 1: sm.process_event(EvSelect{}); break;
+	case 2: sm.process_event(EvUp{}); break;
+	case 3: sm.process_event(EvDown{}); break;
+	default: break;
+	}
+}
+
+static uint32_t compare_current(compare_sm_t &sm)
+{
+	using namespace sml;
+	if( sm.is(state<Off>) )		return(0);
+	if( sm.is(state<On>) )		return(1);
+	if( sm.is(state<Play>) )	return(2);
+	if( sm.is(state<Treble>) )	return(3);
+	if( sm.is(state<Mid>) )		return(4);
+	return(5);
+}
+
+#else
+
+struct Ev0 {};
+struct Ev1 {};
+struct Ev2 {};
+struct Ev3 {};
+
+template<std::size_t N> struct Ring {};
+
+// Ev0 próximo, Ev1 anterior, Ev2 oposto e Ev3 reset, apenas nos estados s%4==2. A primeira
+// linha marca o estado inicial; as demais saídas por Ev0 começam em Ring<1>
+template<std::size_t... Next, std::size_t... S, std::size_t... Reset>
+static auto compare_ring_table(std::index_sequence<Next...>, std::index_sequence<S...>, std::index_sequence<Reset...>)
+{
+	using namespace sml;
+	return make_transition_table(
+		*state<Ring<0>>	+ event<Ev0> = state<Ring<1>>,
+		(state<Ring<Next + 1>>	+ event<Ev0> = state<Ring<(Next + 2) % COMPARE_RING_STATES>>)...,
+		(state<Ring<S>>			+ event<Ev1> = state<Ring<(S + COMPARE_RING_STATES - 1) % COMPARE_RING_STATES>>)...,
+		(state<Ring<S>>			+ event<Ev2> = state<Ring<(S + COMPARE_RING_STATES/2) % COMPARE_RING_STATES>>)...,
+		(state<Ring<4*Reset + 2>>	+ event<Ev3> = state<Ring<0>>)...
+	);
+}
+
+struct RingMachine
+{
+	auto operator()() const
+	{
+		return compare_ring_table(std::make_index_sequence<COMPARE_RING_STATES - 1>{},
+								  std::make_index_sequence<COMPARE_RING_STATES>{},
+								  std::make_index_sequence<COMPARE_RING_STATES / 4>{});
+	}
+};
+
+typedef sml::sm<RingMachine> compare_sm_t;
+#define COMPARE_SM_STR	"sizeof(sml::sm<RingMachine>)"
+
+static void compare_dispatch(compare_sm_t &sm, uint16_t event)
+{
+	switch(event)
+	{
+	case 0: sm.process_event(Ev0{}); break;
+	case 1: sm.process_event(Ev1{}); break;
+	case 2: sm.process_event(Ev2{}); break;
+	case 3: sm.process_event(Ev3{}); break;
+	default: break;
+	}
+}
+
+template<std::size_t... S>
+static uint32_t compare_ring_current(compare_sm_t &sm, std::index_sequence<S...>)
+{
+	uint32_t current = 0;
+	using expand = int[];
+
+	(void)expand{ 0, (sm.is(sml::state<Ring<S>>) ? (current = (uint32_t)S, 0) : 0)... };
+	return(current);
+}
+
+static uint32_t compare_current(compare_sm_t &sm)
+{
+	return(compare_ring_current(sm, std::make_index_sequence<COMPARE_RING_STATES>{}));
+}
+
+#endif
+
+alignas(compare_sm_t) static unsigned char compare_storage[sizeof(compare_sm_t)];
+static compare_sm_t *compare_sm;
+
+static void compare_reset(void)
+{
+	if( compare_sm != nullptr )
+	{
+		compare_sm->~compare_sm_t();
+	}
+	compare_sm = new (compare_storage) compare_sm_t{};
+}
+
+static uint32_t compare_run(const uint16_t *events, uint32_t mask, uint32_t count)
+{
+	compare_sm_t &sm = *compare_sm;
+
+	for( uint32_t i=0; i<count; i++ )
+	{
+		compare_dispatch(sm, events[i & mask]);
+	}
+	return(compare_current(sm));
+}
+
+extern "C" const compare_style_t COMPARE_STYLE(sml) = {
+	"boost_sml", COMPARE_MACHINE_STR, COMPARE_SM_STR,
+	sizeof(compare_sm_t), compare_reset, compare_run
+};
+
+#else
+
+extern "C" const compare_style_t COMPARE_STYLE(sml) = {
+	"boost_sml", COMPARE_MACHINE_STR, "boost/sml.hpp not found", 0, NULL, NULL
+};
+
+#endif
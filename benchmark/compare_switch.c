@@ -0,0 +1,110 @@
+/**
+ * @file	compare_switch.c
+ * @brief	Máquinas do bench_compare implementadas com switch escrito à mão
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "compare.h"
+
+/**
+ * Variáveis privadas
+ */
+static uint8_t compare_state;
+
+#if COMPARE_MACHINE == COMPARE_MENU
+
+enum { EV_NONE, EV_SELECT, EV_UP, EV_DOWN, EV_LEFT, EV_RIGHT };
+enum { MENU_OFF, MENU_ON, MENU_PLAY, MENU_TREBLE, MENU_MID, MENU_BASS };
+
+static uint8_t compare_step(uint8_t state, uint16_t event)
+{
+	switch(state)
+	{
+	case MENU_OFF:
+		if( event == EV_SELECT ) return(MENU_ON);
+		break;
+
+	case MENU_ON:
+		switch(event)
+		{
+		case EV_SELECT:	return(MENU_PLAY);
+		case EV_DOWN:	return(MENU_TREBLE);
+		case EV_UP:		return(MENU_BASS);
+		case EV_NONE:	return(MENU_OFF);
+		default:		break;
+		}
+		break;
+
+	case MENU_PLAY:
+		if( event == EV_SELECT ) return(MENU_ON);
+		break;
+
+	case MENU_TREBLE:
+		if( event == EV_DOWN ) return(MENU_MID);
+		if( event == EV_UP ) return(MENU_ON);
+		break;
+
+	case MENU_MID:
+		if( event == EV_DOWN ) return(MENU_BASS);
+		if( event == EV_UP ) return(MENU_TREBLE);
+		break;
+
+	case MENU_BASS:
+		if( event == EV_DOWN ) return(MENU_ON);
+		if( event == EV_UP ) return(MENU_MID);
+		break;
+
+	default:
+		break;
+	}
+
+	return(state);
+}
+
+#else
+
+static uint8_t compare_step(uint8_t state, uint16_t event)
+{
+	switch(event)
+	{
+	case 0:	return((uint8_t)((state + 1) % COMPARE_RING_STATES));
+	case 1:	return((uint8_t)((state + COMPARE_RING_STATES - 1) % COMPARE_RING_STATES));
+	case 2:	return((uint8_t)((state + COMPARE_RING_STATES/2) % COMPARE_RING_STATES));
+	case 3:	return(((state % 4) == 2) ? 0 : state);
+	default: break;
+	}
+
+	return(state);
+}
+
+#endif
+
+static void compare_reset(void)
+{
+	compare_state = 0;
+}
+
+static uint32_t compare_run(const uint16_t *events, uint32_t mask, uint32_t count)
+{
+	uint32_t i;
+	uint8_t state = compare_state;
+
+	for( i=0; i<count; i++ )
+	{
+		state = compare_step(state, events[i & mask]);
+	}
+	compare_state = state;
+
+	return(state);
+}
+
+const compare_style_t COMPARE_STYLE(switch) = {
+	"switch", COMPARE_MACHINE_STR, "uint8_t state",
+	sizeof(compare_state), compare_reset, compare_run
+};
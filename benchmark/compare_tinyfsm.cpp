@@ -0,0 +1,153 @@
+/**
+ * @file	compare_tinyfsm.cpp
+ * @brief	Máquinas do bench_compare implementadas com tinyfsm
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Compilado apenas quando <tinyfsm.hpp> está no include path
+ * (make compare TINYFSM_INC=/caminho/para/tinyfsm/include). Caso contrário o
+ * estilo é registrado sem função de execução e ignorado pelo bench_compare.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "compare.h"
+
+#if defined(__has_include)
+#	if __has_include(<tinyfsm.hpp>)
+#		define COMPARE_HAS_TINYFSM 1
+#	endif
+#endif
+
+#if COMPARE_HAS_TINYFSM
+
+#include <tinyfsm.hpp>
+
+// Cada máquina é compilada em um objeto próprio; o namespace evita símbolos duplicados
+#define COMPARE_NS	COMPARE_CAT(tinyfsm_, COMPARE_MACHINE_NAME)
+
+struct Ev0 : tinyfsm::Event {};
+struct Ev1 : tinyfsm::Event {};
+struct Ev2 : tinyfsm::Event {};
+struct Ev3 : tinyfsm::Event {};
+
+#if COMPARE_MACHINE == COMPARE_MENU
+
+namespace COMPARE_NS {
+
+// EV_NONE=Ev0, EV_SELECT=Ev1, EV_UP=Ev2, EV_DOWN=Ev3; EV_LEFT e EV_RIGHT não geram transições
+struct Machine : tinyfsm::Fsm<Machine>
+{
+	virtual void react(Ev0 const &) {}
+	virtual void react(Ev1 const &) {}
+	virtual void react(Ev2 const &) {}
+	virtual void react(Ev3 const &) {}
+	void entry(void) {}
+	void exit(void) {}
+	virtual uint32_t id(void) const = 0;
+	static uint32_t current(void) { return(current_state_ptr->id()); }
+};
+
+struct Off		: Machine { void react(Ev1 const &) override; uint32_t id(void) const override { return(0); } };
+struct On		: Machine { void react(Ev0 const &) override; void react(Ev1 const &) override;
+							void react(Ev2 const &) override; void react(Ev3 const &) override;
+							uint32_t id(void) const override { return(1); } };
+struct Play		: Machine { void react(Ev1 const &) override; uint32_t id(void) const override { return(2); } };
+struct Treble	: Machine { void react(Ev2 const &) override; void react(Ev3 const &) override;
+							uint32_t id(void) const override { return(3); } };
+struct Mid		: Machine { void react(Ev2 const &) override; void react(Ev3 const &) override;
+							uint32_t id(void) const override { return(4); } };
+struct Bass		: Machine { void react(Ev2 const &) override; void react(Ev3 const &) override;
+							uint32_t id(void) const override { return(5); } };
+
+void Off::react(Ev1 const &)	{ transit<On>(); }
+void On::react(Ev0 const &)		{ transit<Off>(); }
+void On::react(Ev1 const &)		{ transit<Play>(); }
+void On::react(Ev2 const &)		{ transit<Bass>(); }
+void On::react(Ev3 const &)		{ transit<Treble>(); }
+void Play::react(Ev1 const &)	{ transit<On>(); }
+void Treble::react(Ev2 const &)	{ transit<On>(); }
+void Treble::react(Ev3 const &)	{ transit<Mid>(); }
+void Mid::react(Ev2 const &)	{ transit<Treble>(); }
+void Mid::react(Ev3 const &)	{ transit<Bass>(); }
+void Bass::react(Ev2 const &)	{ transit<Mid>(); }
+void Bass::react(Ev3 const &)	{ transit<On>(); }
+
+}
+
+FSM_INITIAL_STATE(COMPARE_NS::Machine, COMPARE_NS::Off)
+
+#else
+
+namespace COMPARE_NS {
+
+struct Machine : tinyfsm::Fsm<Machine>
+{
+	virtual void react(Ev0 const &) {}
+	virtual void react(Ev1 const &) {}
+	virtual void react(Ev2 const &) {}
+	virtual void react(Ev3 const &) {}
+	void entry(void) {}
+	void exit(void) {}
+	virtual uint32_t id(void) const = 0;
+	static uint32_t current(void) { return(current_state_ptr->id()); }
+};
+
+template<int N> struct Ring : Machine
+{
+	void react(Ev0 const &) override { transit< Ring<(N + 1) % COMPARE_RING_STATES> >(); }
+	void react(Ev1 const &) override { transit< Ring<(N + COMPARE_RING_STATES - 1) % COMPARE_RING_STATES> >(); }
+	void react(Ev2 const &) override { transit< Ring<(N + COMPARE_RING_STATES/2) % COMPARE_RING_STATES> >(); }
+	void react(Ev3 const &) override { if( (N % 4) == 2 ) { transit< Ring<0> >(); } }
+	uint32_t id(void) const override { return(N); }
+};
+
+}
+
+FSM_INITIAL_STATE(COMPARE_NS::Machine, COMPARE_NS::Ring<0>)
+
+#endif
+
+using namespace COMPARE_NS;
+
+static void compare_dispatch(uint16_t event)
+{
+	switch(event)
+	{
+	case 0: Machine::dispatch(Ev0()); break;
+	case 1: Machine::dispatch(Ev1()); break;
+	case 2: Machine::dispatch(Ev2()); break;
+	case 3: Machine::dispatch(Ev3()); break;
+	default: break;
+	}
+}
+
+static void compare_reset(void)
+{
+	Machine::start();
+}
+
+static uint32_t compare_run(const uint16_t *events, uint32_t mask, uint32_t count)
+{
+	for( uint32_t i=0; i<count; i++ )
+	{
+		compare_dispatch(events[i & mask]);
+	}
+	return(Machine::current());
+}
+
+extern "C" const compare_style_t COMPARE_STYLE(tinyfsm) = {
+	"tinyfsm", COMPARE_MACHINE_STR, "singleton: one current_state_ptr per machine type",
+	sizeof(void*), compare_reset, compare_run
+};
+
+#else
+
+extern "C" const compare_style_t COMPARE_STYLE(tinyfsm) = {
+	"tinyfsm", COMPARE_MACHINE_STR, "tinyfsm.hpp not found", 0, NULL, NULL
+};
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file	stress_seqlock.c
+ * @brief	Teste de estresse da leitura concorrente do estado (FSM_SEQLOCK_ENABLE)
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma thread dona conduz instâncias de um anel de FSM_RING estados com
+ * fsm_post e fsm_engine enquanto threads monitoras leem as mesmas instâncias
+ * com fsm_read_state. Cada leitura deve ser consistente: o estado é sempre
+ * o de índice transitions % FSM_RING e o contador nunca volta atrás. O
+ * Makefile compila o teste com ThreadSanitizer, que também acusa qualquer
+ * acesso não protegido.
+ *
+ * @code
+ * make -C benchmark stress
+ * ./build/stress_seqlock [-r monitores] [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "fsm.h"
+
+#if !FSM_SEQLOCK_ENABLE
+#	error "stress_seqlock requer FSM_SEQLOCK_ENABLE=1"
+#endif
+
+/**
+ * @defgroup stress_seqlock_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_RING		4
+#define STRESS_FSMS		16
+#define STRESS_READERS	8
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_ADVANCE, EV_LIMIT };
+
+typedef struct stress_reader
+{
+	pthread_t	thread;
+	uint64_t	reads;
+	uint64_t	errors;
+} stress_reader_t;
+
+/**
+ * Variáveis privadas
+ */
+static fsm_handler_t stress_fsm[STRESS_FSMS];
+static int stress_done;
+
+/**
+ * @}
+ */
+
+static uint16_t ring_0(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t ring_1(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t ring_2(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t ring_3(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static void* const ring_states[FSM_RING] = { (void*)ring_0, (void*)ring_1, (void*)ring_2, (void*)ring_3 };
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)ring_0,	EV_ADVANCE,		(void*)ring_1	},
+	{ (void*)ring_1,	EV_ADVANCE,		(void*)ring_2	},
+	{ (void*)ring_2,	EV_ADVANCE,		(void*)ring_3	},
+	{ (void*)ring_3,	EV_ADVANCE,		(void*)ring_0	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+/**
+ * @brief stress_monitor
+ *
+ * Thread monitora: lê as instâncias em sequência e verifica cada leitura
+ */
+static void* stress_monitor(void *arg)
+{
+	stress_reader_t *reader = (stress_reader_t*)arg;
+	uint32_t last[STRESS_FSMS];
+	fsm_status_t status;
+	uint32_t i = 0;
+
+	memset(last, 0, sizeof(last));
+	while( !__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE) )
+	{
+		fsm_read_state(&stress_fsm[i], &status);
+		if( (status.cb_state != ring_states[status.transitions % FSM_RING]) ||
+			(status.transitions < last[i]) ||
+			((status.eventID != EV_ADVANCE) && (status.eventID != EV_LIMIT)) )
+		{
+			reader->errors++;
+		}
+		last[i] = status.transitions;
+		reader->reads++;
+		i = (i + 1) % STRESS_FSMS;
+	}
+
+	return(NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	stress_reader_t readers[STRESS_READERS];
+	uint64_t steps = 2000000ull, step, reads = 0, errors = 0;
+	uint32_t number_readers = 3, i, expected;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-r") == 0 )
+		{
+			number_readers = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = strtoull(argv[a+1], NULL, 10);
+		}
+	}
+	if( number_readers > STRESS_READERS )
+	{
+		number_readers = STRESS_READERS;
+	}
+
+	for( i=0; i<STRESS_FSMS; i++ )
+	{
+		fsm_create(&stress_fsm[i], stateTable, (void*)ring_0, "stress", EV_LIMIT);
+	}
+
+	memset(readers, 0, sizeof(readers));
+	for( i=0; i<number_readers; i++ )
+	{
+		pthread_create(&readers[i].thread, NULL, stress_monitor, &readers[i]);
+	}
+
+	for( step=0; step<steps; step++ )
+	{
+		fsm_post(&stress_fsm[step % STRESS_FSMS], EV_ADVANCE);
+		fsm_engine(&stress_fsm[step % STRESS_FSMS]);
+	}
+
+	__atomic_store_n(&stress_done, 1, __ATOMIC_RELEASE);
+	for( i=0; i<number_readers; i++ )
+	{
+		pthread_join(readers[i].thread, NULL);
+		reads	+= readers[i].reads;
+		errors	+= readers[i].errors;
+	}
+
+	// Confere o resultado final da thread dona
+	for( i=0; i<STRESS_FSMS; i++ )
+	{
+		expected = (uint32_t)(steps / STRESS_FSMS + ((i < (steps % STRESS_FSMS)) ? 1 : 0));
+		if( stress_fsm[i].transitions != expected )
+		{
+			errors++;
+		}
+	}
+
+	printf("{ \"benchmark\": \"fsm_seqlock_stress\", \"steps\": %llu, \"readers\": %u, \"reads\": %llu, \"errors\": %llu }\n",
+		   (unsigned long long)steps, number_readers, (unsigned long long)reads, (unsigned long long)errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,303 @@
+/**
+ * @file	stress_swap.c
+ * @brief	Teste de estresse da troca de tabelas em execução (FSM_SWAP_ENABLE)
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Threads de trabalho conduzem instâncias de um anel de FSM_RING estados
+ * sobre uma tabela compartilhada enquanto a thread principal publica, sem
+ * parar, versões que alternam entre o anel puro (um evento) e o anel com
+ * EV_RESET (dois eventos). Cada EV_ADVANCE deve avançar o anel em qualquer
+ * versão; EV_RESET volta ao início de ring_1 e ring_2 apenas quando a
+ * instância está na versão que o conhece e, nas demais, não gera transição. Os callbacks retornam
+ * um valor qualquer acima do enum, que nunca é tratado como evento. O
+ * Makefile compila o teste com ThreadSanitizer, que também acusa qualquer
+ * acesso não protegido à versão publicada ou às versões liberadas.
+ *
+ * @code
+ * make -C benchmark stress_swap
+ * ./build/stress_swap [-w threads] [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "fsm.h"
+#include "fsm_swap.h"
+
+#if !FSM_SWAP_ENABLE
+#	error "stress_swap requer FSM_SWAP_ENABLE=1"
+#endif
+
+/**
+ * @defgroup stress_swap_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_RING		4
+#define STRESS_FSMS		8							/**< Instâncias por thread de trabalho */
+#define STRESS_WORKERS	8
+#define STRESS_VERSIONS	(FSM_SWAP_RETIRED + 2)		/**< Versões publicadas, retiradas ou livres */
+#define STRESS_NO_EVENT	0xFFFF						/**< Retorno dos callbacks: nenhum evento */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_ADVANCE, EV_RESET, EV_LIMIT };
+
+typedef struct stress_version
+{
+	fsm_swap_version_t	version;					/**< Deve ser o primeiro campo */
+	void*				callbacks[FSM_RING];
+	uint16_t			next[FSM_RING * EV_LIMIT];
+	uint8_t				busy;						/**< Publicada ou aguardando liberação */
+} stress_version_t;
+
+typedef struct stress_worker
+{
+	pthread_t			thread;
+	fsm_swap_reader_t	reader;
+	fsm_handler_t		fsm[STRESS_FSMS];
+	uint64_t			steps;
+	uint64_t			resets;
+	uint64_t			errors;
+} stress_worker_t;
+
+/**
+ * Variáveis privadas
+ */
+static fsm_swap_t		stress_swap;
+static stress_version_t	stress_versions[STRESS_VERSIONS];
+static stress_worker_t	stress_workers[STRESS_WORKERS];
+static uint32_t			stress_finished;
+
+/**
+ * @}
+ */
+
+static uint16_t ring_0(fsm_handler_t* this) { (void)this; return(STRESS_NO_EVENT); }
+static uint16_t ring_1(fsm_handler_t* this) { (void)this; return(STRESS_NO_EVENT); }
+static uint16_t ring_2(fsm_handler_t* this) { (void)this; return(STRESS_NO_EVENT); }
+static uint16_t ring_3(fsm_handler_t* this) { (void)this; return(STRESS_NO_EVENT); }
+
+static void* const ring_states[FSM_RING] = { (void*)ring_0, (void*)ring_1, (void*)ring_2, (void*)ring_3 };
+
+static fsm_state_t ringTable[] = {
+	/* callback state	event			next state */
+	{ (void*)ring_0,	EV_ADVANCE,		(void*)ring_1	},
+	{ (void*)ring_1,	EV_ADVANCE,		(void*)ring_2	},
+	{ (void*)ring_2,	EV_ADVANCE,		(void*)ring_3	},
+	{ (void*)ring_3,	EV_ADVANCE,		(void*)ring_0	},
+	{ NULL,				EV_RESET,		NULL			}
+};
+
+static fsm_state_t resetTable[] = {
+	/* callback state	event			next state */
+	{ (void*)ring_0,	EV_ADVANCE,		(void*)ring_1	},
+	{ (void*)ring_1,	EV_ADVANCE,		(void*)ring_2	},
+	{ (void*)ring_2,	EV_ADVANCE,		(void*)ring_3	},
+	{ (void*)ring_3,	EV_ADVANCE,		(void*)ring_0	},
+	{ (void*)ring_1,	EV_RESET,		(void*)ring_0	},
+	{ (void*)ring_2,	EV_RESET,		(void*)ring_0	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+/**
+ * @brief stress_release
+ *
+ * Devolve uma versão que nenhum leitor pode mais ver; chamada pela thread que publica
+ */
+static void stress_release(fsm_swap_version_t *version, void *context)
+{
+	(void)context;
+	((stress_version_t*)version)->busy = 0;
+}
+
+/**
+ * @brief stress_compile
+ *
+ * Gera uma versão livre com o anel puro ou com EV_RESET; retorna NULL sem versão livre
+ */
+static stress_version_t* stress_compile(uint8_t reset)
+{
+	stress_version_t *slot;
+	uint32_t i;
+
+	for( i=0; i<STRESS_VERSIONS; i++ )
+	{
+		slot = &stress_versions[i];
+		if( !slot->busy )
+		{
+			if( fsm_table_compile(&slot->version.table, reset ? resetTable : ringTable, (void*)ring_0,
+								  reset ? EV_LIMIT : EV_RESET, slot->callbacks, FSM_RING, slot->next, FSM_RING * EV_LIMIT) != FSM_OK )
+			{
+				return(NULL);
+			}
+			slot->busy = 1;
+			return(slot);
+		}
+	}
+
+	return(NULL);
+}
+
+/**
+ * @brief stress_index
+ *
+ * Índice do estado no anel
+ */
+static uint32_t stress_index(fsm_handler_t *fsm)
+{
+	uint32_t i;
+
+	for( i=0; (i<FSM_RING) && (ring_states[i] != fsm->cb_state); i++ );
+	return(i);
+}
+
+/**
+ * @brief stress_run
+ *
+ * Thread de trabalho: conduz as próprias instâncias e verifica cada passo
+ */
+static void* stress_run(void *arg)
+{
+	stress_worker_t *worker = (stress_worker_t*)arg;
+	fsm_handler_t *fsm;
+	fsm_result_t ret;
+	uint64_t step;
+	uint32_t index;
+
+	fsm_swap_register(&stress_swap, &worker->reader);
+	for( index=0; index<STRESS_FSMS; index++ )
+	{
+		if( fsm_swap_create(&worker->fsm[index], &worker->reader, "stress") != FSM_OK )
+		{
+			worker->errors++;
+		}
+	}
+
+	for( step=0; step<worker->steps; step++ )
+	{
+		fsm		= &worker->fsm[step % STRESS_FSMS];
+		index	= stress_index(fsm);
+
+		// EV_ADVANCE existe em todas as versões
+		fsm_post(fsm, EV_ADVANCE);
+		if( (fsm_engine(fsm) != FSM_OK) || (stress_index(fsm) != (index + 1) % FSM_RING) )
+		{
+			worker->errors++;
+		}
+
+		// O retorno do callback está acima do enum de qualquer versão: não é evento
+		if( fsm_engine(fsm) != FSM_NO_TRANSITION )
+		{
+			worker->errors++;
+		}
+
+		// EV_RESET só é evento na versão em que a instância acabou de migrar
+		if( (step % 8) == 0 )
+		{
+			index = stress_index(fsm);
+			fsm_post(fsm, EV_RESET);
+			ret = fsm_engine(fsm);
+			if( ret == FSM_OK )
+			{
+				worker->resets++;
+				if( (fsm->cb_state != (void*)ring_0) || (fsm->number_events != EV_LIMIT) )
+				{
+					worker->errors++;
+				}
+			}
+			else if( (stress_index(fsm) != index) ||
+					 !(((ret == FSM_NO_TRANSITION) && (fsm->number_events == EV_RESET)) ||
+					   ((ret == FSM_EVENT_ERROR) && ((fsm->number_events == EV_RESET) || (index == 0) || (index == FSM_RING - 1)))) )
+			{
+				worker->errors++;
+			}
+		}
+	}
+	__atomic_add_fetch(&stress_finished, 1, __ATOMIC_RELEASE);
+
+	return(NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	stress_version_t *slot;
+	uint64_t steps = 200000ull, resets = 0, errors = 0, published = 0;
+	uint32_t number_workers = 4, i;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-w") == 0 )
+		{
+			number_workers = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+		else if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = strtoull(argv[a+1], NULL, 10);
+		}
+	}
+	if( (number_workers == 0) || (number_workers > STRESS_WORKERS) )
+	{
+		number_workers = STRESS_WORKERS;
+	}
+
+	slot = stress_compile(1);
+	if( (slot == NULL) || (fsm_swap_init(&stress_swap, &slot->version, NULL, stress_release, NULL) != FSM_OK) )
+	{
+		return(1);
+	}
+
+	memset(stress_workers, 0, sizeof(stress_workers));
+	for( i=0; i<number_workers; i++ )
+	{
+		stress_workers[i].steps = steps;
+		pthread_create(&stress_workers[i].thread, NULL, stress_run, &stress_workers[i]);
+	}
+
+	// Publica versões alternadas até as threads de trabalho terminarem
+	do
+	{
+		slot = stress_compile((uint8_t)(published & 1));
+		if( slot == NULL )
+		{
+			fsm_swap_reclaim(&stress_swap);
+		}
+		else if( fsm_swap_table(&stress_swap, &slot->version) == FSM_OK )
+		{
+			published++;
+		}
+		else
+		{
+			slot->busy = 0;
+			fsm_swap_reclaim(&stress_swap);
+		}
+
+	} while( __atomic_load_n(&stress_finished, __ATOMIC_ACQUIRE) < number_workers );
+
+	for( i=0; i<number_workers; i++ )
+	{
+		pthread_join(stress_workers[i].thread, NULL);
+		resets += stress_workers[i].resets;
+		errors += stress_workers[i].errors;
+	}
+	fsm_swap_synchronize(&stress_swap);
+
+	printf("{ \"benchmark\": \"fsm_swap_stress\", \"steps\": %llu, \"workers\": %u, \"published\": %llu, \"resets\": %llu, \"errors\": %llu }\n",
+		   (unsigned long long)steps, number_workers, (unsigned long long)published, (unsigned long long)resets, (unsigned long long)errors);
+
+	return((errors == 0) ? 0 : 1);
+}
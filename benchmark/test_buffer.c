@@ -0,0 +1,242 @@
+/**
+ * @file	test_buffer.c
+ * @brief	Teste dos buffers com contagem de referências e dos payloads de eventos
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Confere o pool de buffers (esgotamento, reuso pela lista livre, retain e
+ * release, liberação dupla) e o ciclo de vida de um payload entregue com
+ * fsm_post_envelope: o callback do estado alcançado o lê com fsm_payload e
+ * o buffer volta ao pool ao final do despacho, salvo quando o callback o
+ * retém; um evento sem transição (FSM_EVENT_ERROR) e um evento pendente
+ * substituído por fsm_post devolvem o payload sem entregá-lo; um buffer
+ * entregue a duas FSMs só volta ao pool depois dos dois despachos.
+ *
+ * @code
+ * make -C benchmark buffer
+ * ./build/test_buffer
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_buffer.h"
+
+#if !FSM_PAYLOAD_ENABLE
+#	error "test_buffer requer FSM_PAYLOAD_ENABLE=1"
+#endif
+
+/**
+ * @defgroup test_buffer_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define BUFFER_COUNT	4
+#define BUFFER_SIZE		32
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_PACKET, EV_DONE, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static uint8_t				buffer_arena[FSM_BUFFER_ARENA_SIZE(BUFFER_COUNT, BUFFER_SIZE)];
+static fsm_buffer_pool_t	buffer_pool;
+static fsm_buffer_t*		buffer_seen;		/**< Payload visto pelo último callback */
+static uint8_t				buffer_keep;		/**< O callback retém o payload */
+
+/**
+ * @}
+ */
+
+static uint16_t st_idle(fsm_handler_t* this)
+{
+	buffer_seen = fsm_payload(this);
+	return(EV_LIMIT);
+}
+
+static uint16_t st_rx(fsm_handler_t* this)
+{
+	buffer_seen = fsm_payload(this);
+	if( (buffer_seen != NULL) && buffer_keep )
+	{
+		fsm_buffer_retain(buffer_seen);
+	}
+	return(EV_LIMIT);
+}
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_idle,	EV_PACKET,		(void*)st_rx	},
+	{ (void*)st_rx,		EV_PACKET,		(void*)st_rx	},
+	{ (void*)st_rx,		EV_DONE,		(void*)st_idle	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+/**
+ * @brief buffer_packet
+ *
+ * Obtém um buffer e escreve length bytes com o valor value
+ */
+static fsm_buffer_t* buffer_packet(uint8_t value, uint16_t length)
+{
+	fsm_buffer_t *buffer = fsm_buffer_alloc(&buffer_pool);
+
+	if( buffer != NULL )
+	{
+		memset(FSM_BUFFER_DATA(buffer), value, length);
+		buffer->length = length;
+	}
+	return(buffer);
+}
+
+/**
+ * @brief buffer_test_pool
+ *
+ * Esgotamento, reuso e contagem de referências; retorna a quantidade de erros
+ */
+static uint32_t buffer_test_pool(void)
+{
+	fsm_buffer_t *buffers[BUFFER_COUNT];
+	fsm_buffer_pool_t small;
+	uint32_t errors = 0, i;
+
+	if( fsm_buffer_pool_init(&small, buffer_arena, FSM_BUFFER_STRIDE(BUFFER_SIZE) - 1, BUFFER_SIZE) != FSM_NO_RESOURCES )
+	{
+		errors++;
+	}
+	if( (fsm_buffer_pool_init(&buffer_pool, buffer_arena, sizeof(buffer_arena), BUFFER_SIZE) != FSM_OK) ||
+		(buffer_pool.capacity != BUFFER_COUNT) || ((((uintptr_t)buffer_pool.base) & 7u) != 0) )
+	{
+		errors++;
+	}
+
+	for( i=0; i<BUFFER_COUNT; i++ )
+	{
+		buffers[i] = fsm_buffer_alloc(&buffer_pool);
+		if( (buffers[i] == NULL) || (buffers[i]->refs != 1) || (buffers[i]->length != 0) )
+		{
+			errors++;
+		}
+	}
+	if( (fsm_buffer_alloc(&buffer_pool) != NULL) || (buffer_pool.failures != 1) || (buffer_pool.used != BUFFER_COUNT) )
+	{
+		errors++;
+	}
+
+	// Uma referência extra mantém o buffer fora do pool
+	if( (fsm_buffer_retain(buffers[1]) != FSM_OK) || (fsm_buffer_release(buffers[1]) != FSM_OK) ||
+		(buffers[1]->refs != 1) || (buffer_pool.used != BUFFER_COUNT) )
+	{
+		errors++;
+	}
+
+	// O último buffer devolvido é o próximo entregue
+	if( (fsm_buffer_release(buffers[1]) != FSM_OK) || (buffer_pool.used != BUFFER_COUNT - 1) ||
+		(fsm_buffer_release(buffers[1]) != FSM_STATE_ERROR) || (fsm_buffer_alloc(&buffer_pool) != buffers[1]) )
+	{
+		errors++;
+	}
+
+	for( i=0; i<BUFFER_COUNT; i++ )
+	{
+		fsm_buffer_release(buffers[i]);
+	}
+	if( buffer_pool.used != 0 )
+	{
+		errors++;
+	}
+
+	return(errors);
+}
+
+int main(void)
+{
+	fsm_handler_t fsm, other;
+	fsm_envelope_t envelope;
+	fsm_buffer_t *first;
+	uint32_t errors = 0;
+
+	errors += buffer_test_pool();
+	fsm_create(&fsm, stateTable, (void*)st_idle, "buffer", EV_LIMIT);
+	fsm_create(&other, stateTable, (void*)st_idle, "other", EV_LIMIT);
+
+	// Entrega: o callback vê o payload e o buffer volta ao pool depois do despacho
+	envelope.eventID = EV_PACKET;
+	envelope.payload = buffer_packet(0x5A, 16);
+	if( (fsm_post_envelope(&fsm, &envelope) != FSM_OK) || (fsm_engine(&fsm) != FSM_OK) ||
+		(buffer_seen != envelope.payload) || (buffer_seen->length != 16) || (FSM_BUFFER_DATA(buffer_seen)[15] != 0x5A) ||
+		(fsm_payload(&fsm) != NULL) || (buffer_pool.used != 0) )
+	{
+		errors++;
+	}
+
+	// O callback que retém o buffer passa a ser responsável por devolvê-lo
+	buffer_keep = 1;
+	envelope.payload = buffer_packet(0x11, 4);
+	fsm_post_envelope(&fsm, &envelope);
+	if( (fsm_engine(&fsm) != FSM_OK) || (buffer_seen != envelope.payload) || (buffer_pool.used != 1) ||
+		(fsm_buffer_release(buffer_seen) != FSM_OK) || (buffer_pool.used != 0) )
+	{
+		errors++;
+	}
+	buffer_keep = 0;
+
+	// Evento sem transição: o payload é devolvido e o callback não o vê
+	fsm_post(&fsm, EV_DONE);
+	fsm_engine(&fsm);
+	envelope.eventID = EV_DONE;
+	envelope.payload = buffer_packet(0x22, 8);
+	fsm_post_envelope(&fsm, &envelope);
+	if( (fsm_engine(&fsm) != FSM_EVENT_ERROR) || (buffer_seen != NULL) || (buffer_pool.used != 0) )
+	{
+		errors++;
+	}
+
+	// Evento pendente substituído: o payload anterior é devolvido na hora
+	envelope.eventID = EV_PACKET;
+	envelope.payload = first = buffer_packet(0x33, 8);
+	fsm_post_envelope(&fsm, &envelope);
+	envelope.payload = buffer_packet(0x44, 8);
+	fsm_post_envelope(&fsm, &envelope);
+	if( (buffer_pool.used != 1) || (first->refs != 0) )
+	{
+		errors++;
+	}
+	fsm_post(&fsm, EV_PACKET);
+	if( (buffer_pool.used != 0) || (fsm_engine(&fsm) != FSM_OK) || (buffer_seen != NULL) )
+	{
+		errors++;
+	}
+
+	// Um buffer para duas FSMs: uma referência por entrega
+	fsm_post(&fsm, EV_DONE);
+	fsm_engine(&fsm);
+	envelope.payload = buffer_packet(0x55, 8);
+	fsm_buffer_retain(envelope.payload);
+	fsm_post_envelope(&fsm, &envelope);
+	fsm_post_envelope(&other, &envelope);
+	if( (fsm_engine(&fsm) != FSM_OK) || (buffer_seen != envelope.payload) || (buffer_pool.used != 1) ||
+		(fsm_engine(&other) != FSM_OK) || (buffer_seen != envelope.payload) || (buffer_pool.used != 0) )
+	{
+		errors++;
+	}
+
+	printf("{ \"benchmark\": \"fsm_buffer\", \"buffers\": %u, \"failures\": %u, \"errors\": %u }\n",
+		   BUFFER_COUNT, buffer_pool.failures, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file	test_bundle.c
+ * @brief	Teste da carga de tabelas a partir de um bundle gerado
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * A descrição menu.csv é gerada duas vezes por generator/script.py: no modo
+ * normal (menu_api.h e menu_tsk.c, com a tabela fsm_state_t) e com --bundle
+ * (menu.fsmb e menu_bundle.h). Os dois cabeçalhos são incluídos juntos, como
+ * na aplicação. O teste confere que os índices de eventos do bundle são os
+ * do enum menu_evHandler, o estado inicial e a identidade da tabela
+ * (fsm_snapshot_hash), e conduz com os mesmos eventos ao acaso uma instância
+ * criada do bundle (fsm_create_table) e a instância da tabela gerada.
+ *
+ * @code
+ * make -C benchmark bundle
+ * ./build/test_bundle [-p bundle] [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_bundle.h"
+#include "fsm_snapshot.h"
+#include "menu_tsk.h"
+#include "menu_bundle.h"
+
+#if !FSM_TABLE_ENABLE || !FSM_BUNDLE_MMAP
+#	error "test_bundle requer FSM_TABLE_ENABLE e FSM_BUNDLE_MMAP"
+#endif
+
+/**
+ * @defgroup test_bundle_c doxygengroup
+ * @{
+ */
+
+/**
+ * Variáveis externas
+ */
+extern fsm_handler_t menu_obj;		/**< Instância criada por menu_TaskInit (menu_tsk.c) */
+
+/**
+ * Variáveis privadas
+ */
+static void* const	bundle_callbacks[menu_BUNDLE_STATES] = { menu_CALLBACKS };
+static fsm_bundle_t	bundle;
+static fsm_table_t	bundle_table;
+static fsm_handler_t bundle_fsm;
+
+/**
+ * @}
+ */
+
+// Callbacks da FSM gerada; menu_play deixa menu_EV_DONE pendente de vez em quando
+menu_evHandler menu_idle(fsm_handler_t* this) { (void)this; return(menu_EV_LIMIT); }
+menu_evHandler menu_browse(fsm_handler_t* this) { (void)this; return(menu_EV_LIMIT); }
+menu_evHandler menu_play(fsm_handler_t* this) { (void)this; return(((rand() % 4) == 0) ? menu_EV_DONE : menu_EV_LIMIT); }
+menu_evHandler menu_paused(fsm_handler_t* this) { (void)this; return(menu_EV_LIMIT); }
+
+int main(int argc, char *argv[])
+{
+	const char *path = "menu.fsmb";
+	void *states[menu_BUNDLE_STATES];
+	uint32_t steps = 100000, step, seed, errors = 0;
+	uint16_t eventID, number_states;
+	fsm_result_t ret;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-p") == 0 )
+		{
+			path = argv[a+1];
+		}
+		else if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	// Os índices do bundle são os do enum de menu_api.h
+	if( ((int)menu_BUNDLE_EVENTS != (int)menu_EV_LIMIT) ||
+		((int)menu_BUNDLE_EV_SELECT != (int)menu_EV_SELECT) || ((int)menu_BUNDLE_EV_BACK != (int)menu_EV_BACK) ||
+		((int)menu_BUNDLE_EV_PAUSE != (int)menu_EV_PAUSE) || ((int)menu_BUNDLE_EV_DONE != (int)menu_EV_DONE) )
+	{
+		errors++;
+	}
+
+	if( (fsm_bundle_map(&bundle, path) != FSM_OK) ||
+		(fsm_bundle_table(&bundle, menu_BUNDLE_NAME, bundle_callbacks, menu_BUNDLE_STATES, &bundle_table) != FSM_OK) ||
+		(fsm_create_table(&bundle_fsm, &bundle_table, menu_BUNDLE_NAME) != FSM_OK) )
+	{
+		printf("{ \"benchmark\": \"fsm_bundle\", \"errors\": %u }\n", errors + 1);
+		return(1);
+	}
+	if( (bundle_table.number_events != menu_EV_LIMIT) || (bundle_table.number_states != menu_BUNDLE_STATES) ||
+		(bundle_table.initial != menu_BUNDLE_INITIAL) || (bundle_fsm.cb_state != (void*)menu_idle) )
+	{
+		errors++;
+	}
+	if( fsm_bundle_table(&bundle, menu_BUNDLE_NAME, bundle_callbacks, menu_BUNDLE_STATES - 1, &bundle_table) != FSM_FUNCTION_NULL )
+	{
+		errors++;
+	}
+
+	// A tabela gerada pelo modo normal cria menu_obj a partir do mesmo estado inicial
+	if( (menu_TaskInit() != 0) || (menu_obj.cb_state != bundle_fsm.cb_state) )
+	{
+		errors++;
+	}
+
+	// Mesma identidade que um snapshot da tabela gerada registraria
+	number_states = fsm_state_list(menu_obj.stateTable, states, menu_BUNDLE_STATES);
+	if( (number_states != menu_BUNDLE_STATES) ||
+		(fsm_snapshot_hash(menu_obj.stateTable, states, number_states, menu_EV_LIMIT) != bundle.entries[0].table_hash) )
+	{
+		errors++;
+	}
+
+	srand(1);
+	for( step=0; step<steps; step++ )
+	{
+		eventID	= (uint16_t)((uint32_t)rand() % menu_EV_LIMIT);
+		seed	= (uint32_t)rand();
+
+		// Os callbacks sorteiam o evento de retorno: as duas instâncias usam a mesma semente
+		fsm_post(&bundle_fsm, eventID);
+		srand(seed);
+		ret = fsm_engine(&bundle_fsm);
+		fsm_post(&menu_obj, eventID);
+		srand(seed);
+		if( (fsm_engine(&menu_obj) != ret) || (menu_obj.cb_state != bundle_fsm.cb_state) ||
+			(menu_obj.eventID != bundle_fsm.eventID) )
+		{
+			errors++;
+		}
+	}
+
+	menu_TaskDestroy();
+	fsm_destroy(&bundle_fsm);
+	fsm_bundle_unmap(&bundle);
+
+	printf("{ \"benchmark\": \"fsm_bundle\", \"steps\": %u, \"states\": %u, \"events\": %u, \"errors\": %u }\n",
+		   steps, (unsigned)menu_BUNDLE_STATES, (unsigned)menu_EV_LIMIT, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file	test_cold.c
+ * @brief	Teste da hibernação de instâncias ociosas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma população muito maior que o vetor quente recebe eventos ao acaso
+ * através de fsm_cold_post, com hibernações periódicas e despejos por falta
+ * de posições quentes, e um modelo direto é conduzido em paralelo. Um dos
+ * estados deixa um evento pendente, que deve sobreviver à ida e volta pela
+ * camada fria. A cada passo o estado da instância tocada e o resultado do
+ * envio devem coincidir com o modelo.
+ *
+ * @code
+ * make -C benchmark cold
+ * ./build/test_cold [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_cold.h"
+
+/**
+ * @defgroup test_cold_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define COLD_POPULATION		4096
+#define COLD_HOT			64
+#define COLD_STATES			4
+#define COLD_IDLE_TICKS		40
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_REQ, EV_CANCEL, EV_DONE, EV_LIMIT };
+enum { ST_IDLE, ST_WORK, ST_ACK };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_hot_t	cold_hot[COLD_HOT];
+static fsm_cold_t	cold_records[COLD_POPULATION];
+static void*		cold_states[COLD_STATES];
+static uint8_t		cold_model[COLD_POPULATION];
+
+/**
+ * @}
+ */
+
+static uint16_t st_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_work(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_ack(fsm_handler_t* this) { (void)this; return(EV_DONE); }
+
+static void* const cold_callbacks[3] = { (void*)st_idle, (void*)st_work, (void*)st_ack };
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_idle,	EV_REQ,			(void*)st_work	},
+	{ (void*)st_work,	EV_REQ,			(void*)st_ack	},
+	{ (void*)st_work,	EV_CANCEL,		(void*)st_idle	},
+	{ (void*)st_ack,	EV_DONE,		(void*)st_idle	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+/**
+ * @brief cold_model_step
+ *
+ * Aplica um evento ao modelo; retorna o resultado esperado do fsm_engine
+ */
+static fsm_result_t cold_model_step(uint32_t id, uint16_t eventID)
+{
+	uint32_t row;
+
+	for( row=0; stateTable[row].cb_state != NULL; row++ )
+	{
+		if( (stateTable[row].cb_state == cold_callbacks[cold_model[id]]) && (stateTable[row].eventID == eventID) )
+		{
+			cold_model[id] = (stateTable[row].cb_next == (void*)st_idle) ? ST_IDLE : ((stateTable[row].cb_next == (void*)st_work) ? ST_WORK : ST_ACK);
+			return(FSM_OK);
+		}
+	}
+	return(FSM_EVENT_ERROR);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_cold_store_t store;
+	uint32_t steps = 1000000, step, id, errors = 0, hibernated = 0;
+	uint16_t eventID;
+	fsm_result_t expected;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	if( fsm_cold_init(&store, cold_hot, COLD_HOT, cold_records, COLD_POPULATION, cold_states, COLD_STATES,
+					  stateTable, (void*)st_idle, "cold", EV_LIMIT) != FSM_OK )
+	{
+		errors++;
+	}
+
+	srand(1);
+	for( step=0; step<steps; step++ )
+	{
+		id		= (uint32_t)rand() % COLD_POPULATION;
+		eventID	= (uint16_t)((uint32_t)rand() % EV_DONE);
+
+		// O callback de ST_ACK deixa EV_DONE pendente, processado antes do evento enviado
+		if( cold_model[id] == ST_ACK )
+		{
+			cold_model_step(id, EV_DONE);
+		}
+		expected = cold_model_step(id, eventID);
+		if( fsm_cold_post(&store, id, eventID, step) != expected )
+		{
+			errors++;
+		}
+		if( (fsm_cold_state(&store, id) != cold_callbacks[cold_model[id]]) || (store.hot_count > COLD_HOT) )
+		{
+			errors++;
+		}
+
+		if( (step % 256) == 0 )
+		{
+			hibernated += fsm_cold_hibernate(&store, step, COLD_IDLE_TICKS);
+		}
+	}
+
+	// Tudo volta para a camada fria e cada registro deve coincidir com o modelo
+	hibernated += fsm_cold_hibernate(&store, step, 0);
+	if( store.hot_count != 0 )
+	{
+		errors++;
+	}
+	for( id=0; id<COLD_POPULATION; id++ )
+	{
+		if( (cold_records[id].state == FSM_COLD_HOT) ||
+			(store.states[cold_records[id].state] != cold_callbacks[cold_model[id]]) ||
+			(cold_records[id].eventID != ((cold_model[id] == ST_ACK) ? EV_DONE : EV_LIMIT)) )
+		{
+			errors++;
+		}
+	}
+
+	printf("{ \"benchmark\": \"fsm_cold\", \"steps\": %u, \"population\": %u, \"hot\": %u, \"hibernated\": %u, \"errors\": %u }\n",
+		   steps, COLD_POPULATION, COLD_HOT, hibernated, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file	test_cyclic.c
+ * @brief	Teste da tabela e das sobrecargas do executivo cíclico
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Três FSMs de períodos 20, 40 e 100 ticks são escalonadas com
+ * fsm_cyclic_build. O teste confere o quadro maior e o quadro menor
+ * escolhidos, que cada execução cai em um quadro inteiramente contido entre
+ * a sua liberação e o seu prazo sem exceder a duração do quadro, e que dois
+ * quadros maiores executam cada FSM na quantidade esperada. Com um relógio
+ * falso, avançado pelos próprios callbacks, confere as sobrecargas: o
+ * quadro que excede a duração e o quadro chamado durante o anterior são
+ * contados em overruns, o tempo medido entra na próxima montagem e tabelas
+ * inviáveis são recusadas com FSM_NO_RESOURCES. Por fim alguns quadros são
+ * conduzidos por fsm_cyclic_timerfd.
+ *
+ * @code
+ * make -C benchmark cyclic
+ * ./build/test_cyclic
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_cyclic.h"
+
+/**
+ * @defgroup test_cyclic_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define CYCLIC_TASKS		3
+#define CYCLIC_MAX_FRAMES	64
+#define CYCLIC_MAX_SLOTS	64
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_TICK, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_cyclic_t			cyclic;
+static fsm_cyclic_task_t	cyclic_tasks[CYCLIC_TASKS];
+static fsm_handler_t		cyclic_fsm[CYCLIC_TASKS];
+static uint32_t				cyclic_frames[CYCLIC_MAX_FRAMES + 1];
+static fsm_cyclic_slot_t	cyclic_slots[CYCLIC_MAX_SLOTS];
+static uint32_t				cyclic_runs[CYCLIC_TASKS];
+static uint32_t				cyclic_cost[CYCLIC_TASKS];
+static uint32_t				cyclic_clock;
+
+/**
+ * @}
+ */
+
+/**
+ * @brief cyclic_run
+ *
+ * Conta a execução e consome o custo da FSM no relógio falso
+ */
+static uint16_t cyclic_run(uint32_t task)
+{
+	cyclic_runs[task]++;
+	cyclic_clock += cyclic_cost[task];
+	return(EV_LIMIT);
+}
+
+static uint16_t st_fast(fsm_handler_t* this) { (void)this; return(cyclic_run(0)); }
+static uint16_t st_mid(fsm_handler_t* this)  { (void)this; return(cyclic_run(1)); }
+static uint16_t st_slow(fsm_handler_t* this) { (void)this; return(cyclic_run(2)); }
+
+static fsm_state_t fastTable[] = { { (void*)st_fast, EV_TICK, (void*)st_fast }, { NULL, EV_LIMIT, NULL } };
+static fsm_state_t midTable[]  = { { (void*)st_mid,  EV_TICK, (void*)st_mid  }, { NULL, EV_LIMIT, NULL } };
+static fsm_state_t slowTable[] = { { (void*)st_slow, EV_TICK, (void*)st_slow }, { NULL, EV_LIMIT, NULL } };
+
+static uint32_t cyclic_now(void)
+{
+	return(cyclic_clock);
+}
+
+/**
+ * @brief cyclic_setup
+ *
+ * Declara as três FSMs com os tempos de execução informados
+ */
+static void cyclic_setup(uint32_t fast, uint32_t mid, uint32_t slow)
+{
+	const uint32_t period[CYCLIC_TASKS] = { 20, 40, 100 };
+	const uint32_t wcet[CYCLIC_TASKS] = { fast, mid, slow };
+	uint32_t task;
+
+	for( task=0; task<CYCLIC_TASKS; task++ )
+	{
+		cyclic_tasks[task].fsm		= &cyclic_fsm[task];
+		cyclic_tasks[task].period	= period[task];
+		cyclic_tasks[task].wcet		= wcet[task];
+		cyclic_tasks[task].measured	= 0;
+		cyclic_cost[task]			= wcet[task];
+	}
+}
+
+/**
+ * @brief cyclic_check_table
+ *
+ * Confere janelas, cargas e quantidade de execuções da tabela montada
+ */
+static uint32_t cyclic_check_table(void)
+{
+	uint32_t load[CYCLIC_MAX_FRAMES], count[CYCLIC_TASKS], errors = 0, slot, frame, start, period;
+	fsm_cyclic_slot_t *entry;
+
+	memset(load, 0, sizeof(load));
+	memset(count, 0, sizeof(count));
+	for( frame=0; frame<cyclic.number_frames; frame++ )
+	{
+		for( slot=cyclic.frames[frame]; slot<cyclic.frames[frame + 1]; slot++ )
+		{
+			entry = &cyclic.slots[slot];
+			if( (entry->frame != frame) || (entry->task >= CYCLIC_TASKS) )
+			{
+				errors++;
+				continue;
+			}
+			// O quadro fica inteiro na janela da count-ésima liberação da FSM
+			period	= cyclic_tasks[entry->task].period;
+			start	= count[entry->task] * period;
+			if( (frame * cyclic.minor < start) || ((frame + 1) * cyclic.minor > start + period) )
+			{
+				errors++;
+			}
+			load[frame] += cyclic_tasks[entry->task].wcet;
+			count[entry->task]++;
+		}
+		if( load[frame] > cyclic.minor )
+		{
+			errors++;
+		}
+	}
+	for( slot=0; slot<CYCLIC_TASKS; slot++ )
+	{
+		if( count[slot] != cyclic.major / cyclic_tasks[slot].period )
+		{
+			errors++;
+		}
+	}
+	if( cyclic.frames[cyclic.number_frames] != cyclic.number_slots )
+	{
+		errors++;
+	}
+
+	return(errors);
+}
+
+int main(void)
+{
+	uint32_t task, frame, errors = 0, overruns;
+
+	fsm_create(&cyclic_fsm[0], fastTable, (void*)st_fast, "fast", EV_LIMIT);
+	fsm_create(&cyclic_fsm[1], midTable, (void*)st_mid, "mid", EV_LIMIT);
+	fsm_create(&cyclic_fsm[2], slowTable, (void*)st_slow, "slow", EV_LIMIT);
+
+	// Quadro maior mmc(20, 40, 100) = 200; o maior quadro menor viável é 20
+	cyclic_setup(5, 8, 6);
+	if( (fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, CYCLIC_MAX_FRAMES, cyclic_slots, CYCLIC_MAX_SLOTS, cyclic_now) != FSM_OK) ||
+		(cyclic.major != 200) || (cyclic.minor != 20) || (cyclic.number_frames != 10) || (cyclic.number_slots != 10 + 5 + 2) )
+	{
+		errors++;
+	}
+	errors += cyclic_check_table();
+
+	// Dois quadros maiores dentro do orçamento: nenhuma sobrecarga
+	for( frame=0; frame<2 * cyclic.number_frames; frame++ )
+	{
+		if( fsm_cyclic_tick(&cyclic) != FSM_OK )
+		{
+			errors++;
+		}
+	}
+	for( task=0; task<CYCLIC_TASKS; task++ )
+	{
+		if( (cyclic_runs[task] != 2 * cyclic.major / cyclic_tasks[task].period) || (cyclic_tasks[task].measured != cyclic_cost[task]) )
+		{
+			errors++;
+		}
+	}
+	if( (cyclic.overruns != 0) || (cyclic.frame != 0) )
+	{
+		errors++;
+	}
+
+	// Quadro chamado durante o anterior: recusado e contado, sem avançar a tabela
+	cyclic.busy = 1;
+	if( (fsm_cyclic_tick(&cyclic) != FSM_NO_RESOURCES) || (cyclic.overruns != 1) || (cyclic.frame != 0) )
+	{
+		errors++;
+	}
+	cyclic.busy = 0;
+
+	// A FSM lenta passa a consumir mais que um quadro: o quadro é contado como excedido
+	cyclic_cost[2] = 25;
+	overruns = cyclic.overruns;
+	for( frame=0; frame<cyclic.number_frames; frame++ )
+	{
+		fsm_cyclic_tick(&cyclic);
+	}
+	if( (cyclic.overruns != overruns + 2) || (cyclic_tasks[2].measured != 25) )
+	{
+		errors++;
+	}
+
+	// A próxima montagem usa o tempo medido, maior que o período mais curto
+	if( fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, CYCLIC_MAX_FRAMES, cyclic_slots, CYCLIC_MAX_SLOTS, cyclic_now) != FSM_NO_RESOURCES )
+	{
+		errors++;
+	}
+
+	// Existe quadro menor, mas a FSM média não cabe antes do prazo
+	cyclic_setup(15, 15, 1);
+	if( fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, CYCLIC_MAX_FRAMES, cyclic_slots, CYCLIC_MAX_SLOTS, cyclic_now) != FSM_NO_RESOURCES )
+	{
+		errors++;
+	}
+
+	// Vetores menores que a tabela
+	cyclic_setup(5, 8, 6);
+	if( (fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, 9, cyclic_slots, CYCLIC_MAX_SLOTS, cyclic_now) != FSM_NO_RESOURCES) ||
+		(fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, CYCLIC_MAX_FRAMES, cyclic_slots, 16, cyclic_now) != FSM_NO_RESOURCES) )
+	{
+		errors++;
+	}
+
+#if FSM_CYCLIC_TIMERFD
+	// Quadros de 20 ticks de 50 us conduzidos pelo timerfd
+	if( fsm_cyclic_build(&cyclic, cyclic_tasks, CYCLIC_TASKS, cyclic_frames, CYCLIC_MAX_FRAMES, cyclic_slots, CYCLIC_MAX_SLOTS, NULL) != FSM_OK )
+	{
+		errors++;
+	}
+	memset(cyclic_runs, 0, sizeof(cyclic_runs));
+	if( (fsm_cyclic_timerfd(&cyclic, 50000, 2 * cyclic.number_frames) != FSM_OK) || (cyclic_runs[0] == 0) )
+	{
+		errors++;
+	}
+#endif
+
+	printf("{ \"benchmark\": \"fsm_cyclic\", \"major\": %u, \"minor\": %u, \"slots\": %u, \"overruns\": %u, \"errors\": %u }\n",
+		   cyclic.major, cyclic.minor, cyclic.number_slots, cyclic.overruns, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
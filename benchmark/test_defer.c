@@ -0,0 +1,205 @@
+/**
+ * @file	test_defer.c
+ * @brief	Teste dos eventos adiados por estado
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma FSM de requisições adia REQ e GO enquanto está ocupada. O teste confere
+ * que os eventos adiados são guardados em ordem, que a fila cheia descarta o
+ * evento com FSM_NO_RESOURCES, que o primeiro evento aceito pelo novo estado
+ * volta a ser o pendente depois da mudança de estado (inclusive em um estado
+ * ausente da tabela de adiamento), que fsm_post devolve à fila um evento
+ * retirado dela e ainda não despachado, e que essa devolução com a fila
+ * cheia é informada com FSM_NO_RESOURCES. O roteiro roda sobre uma instância
+ * com stateTable e, com FSM_TABLE_ENABLE, sobre uma tabela indexada.
+ *
+ * @code
+ * make -C benchmark defer
+ * ./build/test_defer
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+
+#if FSM_DEFER_QUEUE != 4
+#	error "test_defer requer FSM_DEFER_QUEUE=4"
+#endif
+
+/**
+ * @defgroup test_defer_c doxygengroup
+ * @{
+ */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_REQ, EV_DONE, EV_GO, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+#if FSM_TABLE_ENABLE
+static void*		defer_callbacks[4];
+static uint16_t		defer_next[4 * EV_LIMIT];
+#endif
+
+/**
+ * @}
+ */
+
+static uint16_t st_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_busy(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_wait(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_idle,	EV_REQ,			(void*)st_busy	},
+	{ (void*)st_busy,	EV_DONE,		(void*)st_wait	},
+	{ (void*)st_wait,	EV_REQ,			(void*)st_busy	},
+	{ (void*)st_wait,	EV_GO,			(void*)st_idle	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+// st_wait fica fora da tabela: a máscara aceita é obtida das transições do estado
+static fsm_defer_t deferTable[] = {
+	{ (void*)st_busy,	FSM_EVENT_BIT(EV_REQ) | FSM_EVENT_BIT(EV_GO),	0 },
+	{ (void*)st_idle,	0,												0 },
+	{ NULL,				0,												0 }
+};
+
+/**
+ * @brief defer_queued
+ *
+ * Confere o conteúdo de defer_queue
+ */
+static uint8_t defer_queued(fsm_handler_t *fsm, const uint16_t *events, uint8_t count)
+{
+	return( (fsm->defer_count == count) && (memcmp(fsm->defer_queue, events, count * sizeof(uint16_t)) == 0) );
+}
+
+/**
+ * @brief defer_script
+ *
+ * Roteiro comum às duas instâncias; retorna a quantidade de erros
+ */
+static uint32_t defer_script(fsm_handler_t *fsm)
+{
+	static const uint16_t parked[4]		= { EV_REQ, EV_GO, EV_REQ, EV_GO };
+	static const uint16_t recalled[3]	= { EV_GO, EV_REQ, EV_GO };
+	static const uint16_t unparked[4]	= { EV_REQ, EV_GO, EV_REQ, EV_GO };
+	static const uint16_t busy[3]		= { EV_GO, EV_REQ, EV_GO };
+	uint32_t errors = 0;
+	uint8_t index;
+
+	if( fsm_defer_attach(fsm, deferTable) != FSM_OK )
+	{
+		return(1);
+	}
+
+	fsm_post(fsm, EV_REQ);
+	if( (fsm_engine(fsm) != FSM_OK) || (fsm->cb_state != (void*)st_busy) )
+	{
+		errors++;
+	}
+
+	// Adiamento: sem transição e sem FSM_EVENT_ERROR, na ordem de chegada
+	for( index=0; index<4; index++ )
+	{
+		fsm_post(fsm, parked[index]);
+		if( (fsm_engine(fsm) != FSM_OK) || (fsm->cb_state != (void*)st_busy) || (fsm->eventID != EV_LIMIT) )
+		{
+			errors++;
+		}
+	}
+	if( !defer_queued(fsm, parked, 4) )
+	{
+		errors++;
+	}
+
+	// Fila cheia: o evento é descartado
+	fsm_post(fsm, EV_REQ);
+	if( (fsm_engine(fsm) != FSM_NO_RESOURCES) || !defer_queued(fsm, parked, 4) )
+	{
+		errors++;
+	}
+
+	// Mudança para st_wait, ausente da tabela: o primeiro evento aceito volta a ser o pendente
+	fsm_post(fsm, EV_DONE);
+	if( (fsm_engine(fsm) != FSM_OK) || (fsm->cb_state != (void*)st_wait) ||
+		(fsm->eventID != EV_REQ) || !defer_queued(fsm, recalled, 3) )
+	{
+		errors++;
+	}
+
+	// fsm_post antes do despacho: o evento retirado volta ao início da fila
+	if( (fsm_post(fsm, EV_GO) != FSM_OK) || (fsm->eventID != EV_GO) || !defer_queued(fsm, unparked, 4) )
+	{
+		errors++;
+	}
+
+	// GO leva a st_idle, que só aceita REQ; em st_busy os demais continuam guardados
+	if( (fsm_engine(fsm) != FSM_OK) || (fsm->cb_state != (void*)st_idle) || (fsm->eventID != EV_REQ) ||
+		(fsm_engine(fsm) != FSM_OK) || (fsm->cb_state != (void*)st_busy) || (fsm->eventID != EV_LIMIT) ||
+		!defer_queued(fsm, busy, 3) )
+	{
+		errors++;
+	}
+
+	// Devolução com a fila cheia: um evento retirado não encontra posição e é informado
+	fsm_post(fsm, EV_DONE);
+	fsm_engine(fsm);
+	if( (fsm->cb_state != (void*)st_wait) || (fsm->eventID != EV_GO) || (fsm->defer_count != 2) )
+	{
+		errors++;
+	}
+	fsm->defer_queue[2]	= EV_REQ;
+	fsm->defer_queue[3]	= EV_REQ;
+	fsm->defer_count	= 4;	// Simula a fila preenchida entre a retirada e o fsm_post
+	if( (fsm_post(fsm, EV_REQ) != FSM_NO_RESOURCES) || (fsm->eventID != EV_REQ) || (fsm->defer_count != 4) )
+	{
+		errors++;
+	}
+
+	return(errors);
+}
+
+int main(void)
+{
+	fsm_handler_t fsm;
+	uint32_t errors = 0;
+	uint8_t instances = 0;
+
+	if( fsm_create(&fsm, stateTable, (void*)st_idle, "defer", EV_LIMIT) != FSM_OK )
+	{
+		errors++;
+	}
+	errors += defer_script(&fsm);
+	instances++;
+
+#if FSM_TABLE_ENABLE
+	{
+		fsm_table_t table;
+
+		if( (fsm_table_compile(&table, stateTable, (void*)st_idle, EV_LIMIT, defer_callbacks, 4, defer_next, 4 * EV_LIMIT) != FSM_OK) ||
+			(fsm_create_table(&fsm, &table, "defer") != FSM_OK) )
+		{
+			errors++;
+		}
+		errors += defer_script(&fsm);
+		instances++;
+	}
+#endif
+
+	printf("{ \"benchmark\": \"fsm_defer\", \"queue\": %u, \"instances\": %u, \"errors\": %u }\n", FSM_DEFER_QUEUE, instances, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file	test_emit.c
+ * @brief	Teste da fila de eventos emitidos pelos callbacks
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada evento leva a um estado próprio, cujo callback registra o evento
+ * despachado. O teste confere a ordem (emitidos antes do evento retornado),
+ * o limite de FSM_EMIT_QUEUE despachos por chamada do fsm_engine com um
+ * callback que emite a cada passo, sem perder nem reordenar os eventos que
+ * ficam para a próxima chamada, e a recusa de fsm_emit sem enfileirar
+ * nenhum evento quando a fila não comporta todos ou um evento é inválido.
+ *
+ * @code
+ * make -C benchmark emit
+ * ./build/test_emit
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+
+#if FSM_EMIT_QUEUE < 4
+#	error "test_emit requer FSM_EMIT_QUEUE >= 4"
+#endif
+
+/**
+ * @defgroup test_emit_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define EMIT_LOG		64
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_A, EV_B, EV_C, EV_LIMIT };
+enum { EMIT_NONE, EMIT_ONCE, EMIT_ALWAYS };
+
+/**
+ * Variáveis privadas
+ */
+static uint16_t	emit_log[EMIT_LOG];
+static uint32_t	emit_logged;
+static uint8_t	emit_mode;
+
+/**
+ * @}
+ */
+
+/**
+ * @brief emit_step
+ *
+ * Callback comum: registra o evento que levou ao estado e emite conforme emit_mode
+ */
+static uint16_t emit_step(fsm_handler_t* this, uint16_t eventID)
+{
+	static const uint16_t both[2] = { EV_B, EV_C };
+	uint16_t next;
+
+	if( emit_logged < EMIT_LOG )
+	{
+		emit_log[emit_logged] = eventID;
+	}
+	emit_logged++;
+
+	if( emit_mode == EMIT_ONCE )
+	{
+		// B e C emitidos, A retornado: despacho esperado B, C, A
+		emit_mode = EMIT_NONE;
+		fsm_emit(this, both, 2);
+		return(EV_A);
+	}
+	if( emit_mode == EMIT_ALWAYS )
+	{
+		next = (uint16_t)((eventID + 1) % EV_LIMIT);
+		fsm_emit(this, &next, 1);
+	}
+	return(EV_LIMIT);
+}
+
+static uint16_t st_idle(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_a(fsm_handler_t* this) { return(emit_step(this, EV_A)); }
+static uint16_t st_b(fsm_handler_t* this) { return(emit_step(this, EV_B)); }
+static uint16_t st_c(fsm_handler_t* this) { return(emit_step(this, EV_C)); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_idle,	EV_A,			(void*)st_a	},
+	{ (void*)st_idle,	EV_B,			(void*)st_b	},
+	{ (void*)st_idle,	EV_C,			(void*)st_c	},
+	{ (void*)st_a,		EV_A,			(void*)st_a	},
+	{ (void*)st_a,		EV_B,			(void*)st_b	},
+	{ (void*)st_a,		EV_C,			(void*)st_c	},
+	{ (void*)st_b,		EV_A,			(void*)st_a	},
+	{ (void*)st_b,		EV_B,			(void*)st_b	},
+	{ (void*)st_b,		EV_C,			(void*)st_c	},
+	{ (void*)st_c,		EV_A,			(void*)st_a	},
+	{ (void*)st_c,		EV_B,			(void*)st_b	},
+	{ (void*)st_c,		EV_C,			(void*)st_c	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+int main(void)
+{
+	static const uint16_t order[4] = { EV_A, EV_B, EV_C, EV_A };
+	static const uint16_t three[3] = { EV_A, EV_B, EV_C };
+	static const uint16_t invalid[2] = { EV_A, EV_LIMIT };
+	fsm_handler_t fsm;
+	uint32_t calls, errors = 0, i;
+
+	// Ordem: o evento retornado segue os emitidos, na mesma chamada
+	fsm_create(&fsm, stateTable, (void*)st_idle, "emit", EV_LIMIT);
+	emit_mode = EMIT_ONCE;
+	fsm_post(&fsm, EV_A);
+	if( (fsm_engine(&fsm) != FSM_OK) || (emit_logged != 4) || (memcmp(emit_log, order, sizeof(order)) != 0) ||
+		(fsm.emit_count != 0) || (fsm.eventID != EV_LIMIT) )
+	{
+		errors++;
+	}
+
+	// Limite: um callback que emite a cada passo não prende o fsm_engine
+	fsm_create(&fsm, stateTable, (void*)st_idle, "emit", EV_LIMIT);
+	emit_mode		= EMIT_ALWAYS;
+	emit_logged		= 0;
+	fsm_post(&fsm, EV_A);
+	for( calls=0; calls<8; calls++ )
+	{
+		fsm_engine(&fsm);
+		if( (emit_logged != (calls + 1) * (FSM_EMIT_QUEUE + 1)) || (fsm.eventID >= EV_LIMIT) )
+		{
+			errors++;
+		}
+	}
+	// Nenhum evento foi perdido ou reordenado entre as chamadas: A, B, C, A, ...
+	for( i=0; (i<emit_logged) && (i<EMIT_LOG); i++ )
+	{
+		if( emit_log[i] != (i % EV_LIMIT) )
+		{
+			errors++;
+		}
+	}
+
+	// Tudo ou nada: nenhum evento entra na fila quando algum é recusado
+	fsm_create(&fsm, stateTable, (void*)st_idle, "emit", EV_LIMIT);
+	emit_mode = EMIT_NONE;
+	for( i=0; i<FSM_EMIT_QUEUE-2; i++ )
+	{
+		fsm_emit(&fsm, three, 1);
+	}
+	if( (fsm_emit(&fsm, three, 3) != FSM_NO_RESOURCES) || (fsm.emit_count != FSM_EMIT_QUEUE-2) ||
+		(fsm_emit(&fsm, invalid, 2) != FSM_EVENT_ERROR) || (fsm.emit_count != FSM_EMIT_QUEUE-2) ||
+		(fsm_emit(&fsm, three, 2) != FSM_OK) || (fsm.emit_count != FSM_EMIT_QUEUE) )
+	{
+		errors++;
+	}
+
+	printf("{ \"benchmark\": \"fsm_emit\", \"queue\": %u, \"dispatched\": %u, \"errors\": %u }\n", FSM_EMIT_QUEUE, emit_logged, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,184 @@
+/**
+ * @file	test_map.c
+ * @brief	Teste do mapa de instâncias materializadas sob demanda
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Entidades de uma FSM de sessão recebem eventos ao acaso através de
+ * fsm_map_post, e um modelo direto (um estado por chave) é conduzido em
+ * paralelo. A cada passo o estado de cada chave tocada e a quantidade de
+ * registros devem coincidir com o modelo: só as entidades fora do estado
+ * inicial ocupam registro, inclusive depois de muitas remoções. Também
+ * confere o limite de ocupação do menor mapa aceito, a recusa dos menores e
+ * o fsm_map_engine de chaves sem registro com o mapa cheio.
+ *
+ * @code
+ * make -C benchmark map
+ * ./build/test_map [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_map.h"
+
+/**
+ * @defgroup test_map_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define MAP_CAPACITY	1024
+#define MAP_KEYS		700		/**< Menor que 7/8 de MAP_CAPACITY: o mapa nunca enche */
+#define MAP_AUTO_OPEN	0x1000000000000ull	/**< Chaves com esse bit retornam EV_OPEN em st_closed */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_OPEN, EV_DATA, EV_CLOSE, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_map_entry_t	map_entries[MAP_CAPACITY];
+static uint8_t			map_model[MAP_KEYS];		/**< 0 fechada, 1 aberta, 2 recebendo */
+
+/**
+ * @}
+ */
+
+static uint16_t st_closed(fsm_handler_t* this) { return((fsm_map_key(this) & MAP_AUTO_OPEN) ? EV_OPEN : EV_LIMIT); }
+static uint16_t st_open(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_data(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static void* const map_states[3] = { (void*)st_closed, (void*)st_open, (void*)st_data };
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_closed,	EV_OPEN,		(void*)st_open		},
+	{ (void*)st_open,	EV_DATA,		(void*)st_data		},
+	{ (void*)st_open,	EV_CLOSE,		(void*)st_closed	},
+	{ (void*)st_data,	EV_DATA,		(void*)st_data		},
+	{ (void*)st_data,	EV_OPEN,		(void*)st_open		},
+	{ NULL,				EV_LIMIT,		NULL				}
+};
+
+/**
+ * @brief map_model_post
+ *
+ * Aplica o evento ao modelo; retorna o resultado esperado de fsm_map_post
+ */
+static fsm_result_t map_model_post(uint32_t key, uint16_t eventID)
+{
+	uint32_t row;
+
+	for( row=0; stateTable[row].cb_state != NULL; row++ )
+	{
+		if( (stateTable[row].cb_state == map_states[map_model[key]]) && (stateTable[row].eventID == eventID) )
+		{
+			map_model[key] = (stateTable[row].cb_next == (void*)st_closed) ? 0 : ((stateTable[row].cb_next == (void*)st_open) ? 1 : 2);
+			return(FSM_OK);
+		}
+	}
+	return(FSM_EVENT_ERROR);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_map_t map;
+	uint32_t steps = 1000000, step, key, active, errors = 0, peak = 0;
+	uint16_t eventID;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	if( fsm_map_init(&map, map_entries, MAP_CAPACITY, stateTable, (void*)st_closed, "map", EV_LIMIT) != FSM_OK )
+	{
+		errors++;
+	}
+
+	srand(1);
+	active = 0;
+	for( step=0; step<steps; step++ )
+	{
+		key		= (uint32_t)rand() % MAP_KEYS;
+		eventID	= (uint16_t)((uint32_t)rand() % EV_LIMIT);
+
+		active -= (map_model[key] != 0);
+		if( fsm_map_post(&map, 0x5000000000ull + key, eventID) != map_model_post(key, eventID) )
+		{
+			errors++;
+		}
+		active += (map_model[key] != 0);
+
+		if( (fsm_map_state(&map, 0x5000000000ull + key) != map_states[map_model[key]]) || (map.count != active) )
+		{
+			errors++;
+		}
+		if( active > peak )
+		{
+			peak = active;
+		}
+	}
+	for( key=0; key<MAP_KEYS; key++ )
+	{
+		if( fsm_map_state(&map, 0x5000000000ull + key) != map_states[map_model[key]] )
+		{
+			errors++;
+		}
+	}
+
+	// O menor mapa aceito ocupa 7 das 8 posições; mapas menores são recusados
+	if( (fsm_map_init(&map, map_entries, 4, stateTable, (void*)st_closed, "map", EV_LIMIT) != FSM_NO_RESOURCES) ||
+		(fsm_map_init(&map, map_entries, 12, stateTable, (void*)st_closed, "map", EV_LIMIT) != FSM_NO_RESOURCES) ||
+		(fsm_map_init(&map, map_entries, FSM_MAP_LOAD_DEN, stateTable, (void*)st_closed, "map", EV_LIMIT) != FSM_OK) )
+	{
+		errors++;
+	}
+	for( key=0; key<FSM_MAP_LOAD_DEN; key++ )
+	{
+		if( fsm_map_post(&map, key, EV_OPEN) != ((key < FSM_MAP_LOAD_NUM) ? FSM_OK : FSM_NO_RESOURCES) )
+		{
+			errors++;
+		}
+	}
+	if( (fsm_map_post(&map, 0, EV_CLOSE) != FSM_OK) || (fsm_map_post(&map, FSM_MAP_LOAD_NUM, EV_OPEN) != FSM_OK) )
+	{
+		errors++;
+	}
+
+	// Com o mapa cheio, uma chave sem registro executa o estado inicial sem ocupar posição;
+	// só o evento pendente retornado pelo callback precisa de registro
+	if( (fsm_map_engine(&map, 100) != FSM_NO_TRANSITION) || (map.count != FSM_MAP_LOAD_NUM) ||
+		(fsm_map_engine(&map, MAP_AUTO_OPEN | 100) != FSM_NO_RESOURCES) || (map.count != FSM_MAP_LOAD_NUM) )
+	{
+		errors++;
+	}
+	if( (fsm_map_post(&map, 1, EV_CLOSE) != FSM_OK) ||
+		(fsm_map_engine(&map, MAP_AUTO_OPEN | 100) != FSM_NO_TRANSITION) || (map.count != FSM_MAP_LOAD_NUM) ||
+		(fsm_map_pending(&map, MAP_AUTO_OPEN | 100) != EV_OPEN) || (fsm_map_state(&map, MAP_AUTO_OPEN | 100) != (void*)st_closed) ||
+		(fsm_map_engine(&map, MAP_AUTO_OPEN | 100) != FSM_OK) || (fsm_map_state(&map, MAP_AUTO_OPEN | 100) != (void*)st_open) )
+	{
+		errors++;
+	}
+
+	printf("{ \"benchmark\": \"fsm_map\", \"steps\": %u, \"keys\": %u, \"peak_active\": %u, \"errors\": %u }\n", steps, MAP_KEYS, peak, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file	test_pool.c
+ * @brief	Teste do pool de instâncias dinâmicas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cria e destrói instâncias ao acaso em um pool pequeno e confere, a cada
+ * passo, que nenhuma posição é entregue a duas instâncias vivas e que o
+ * contador de uso acompanha as instâncias vivas. Também confere a recusa de
+ * destruição dupla, de ponteiros fora do pool e de criação com o pool cheio.
+ *
+ * @code
+ * make -C benchmark pool
+ * ./build/test_pool [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_pool.h"
+
+#if FSM_STATIC_ONLY
+#	error "test_pool requer FSM_STATIC_ONLY=0"
+#endif
+
+/**
+ * @defgroup test_pool_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define POOL_SLOTS		32
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_TOGGLE, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static uint8_t			pool_arena[FSM_POOL_ARENA_SIZE(POOL_SLOTS)];
+static fsm_handler_t*	pool_live[POOL_SLOTS];
+
+/**
+ * @}
+ */
+
+static uint16_t st_off(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_on(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_off,	EV_TOGGLE,		(void*)st_on	},
+	{ (void*)st_on,		EV_TOGGLE,		(void*)st_off	},
+	{ NULL,				EV_LIMIT,		NULL			}
+};
+
+int main(int argc, char *argv[])
+{
+	fsm_pool_t pool;
+	fsm_handler_t *fsm, outside;
+	uint32_t steps = 200000, step, i, j, live = 0, errors = 0;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	if( (fsm_pool_init(&pool, pool_arena, sizeof(pool_arena)) != FSM_OK) || (pool.capacity != POOL_SLOTS) )
+	{
+		errors++;
+	}
+
+	srand(1);
+	for( step=0; step<steps; step++ )
+	{
+		i = (uint32_t)rand() % POOL_SLOTS;
+		if( pool_live[i] == NULL )
+		{
+			if( fsm_pool_create(&pool, &pool_live[i], stateTable, (void*)st_off, "pool", EV_LIMIT) != FSM_OK )
+			{
+				errors++;
+				continue;
+			}
+			live++;
+			for( j=0; j<POOL_SLOTS; j++ )
+			{
+				if( (j != i) && (pool_live[j] == pool_live[i]) )
+				{
+					errors++;
+				}
+			}
+		}
+		else
+		{
+			fsm = pool_live[i];
+			fsm_post(fsm, EV_TOGGLE);
+			fsm_engine(fsm);
+			if( (fsm_pool_destroy(&pool, fsm) != FSM_OK) || (fsm_pool_destroy(&pool, fsm) != FSM_STATE_NULL) )
+			{
+				errors++;
+			}
+			pool_live[i] = NULL;
+			live--;
+		}
+		if( pool.used != live )
+		{
+			errors++;
+		}
+	}
+
+	// Pool cheio e ponteiros que não pertencem ao pool
+	for( i=0; i<POOL_SLOTS; i++ )
+	{
+		if( (pool_live[i] == NULL) && (fsm_pool_create(&pool, &pool_live[i], stateTable, (void*)st_off, "pool", EV_LIMIT) != FSM_OK) )
+		{
+			errors++;
+		}
+	}
+	if( fsm_pool_create(&pool, &fsm, stateTable, (void*)st_off, "pool", EV_LIMIT) != FSM_NO_RESOURCES )
+	{
+		errors++;
+	}
+	if( (fsm_pool_destroy(&pool, &outside) != FSM_STATE_ERROR) ||
+		(fsm_pool_destroy(&pool, (fsm_handler_t*)((uint8_t*)pool_live[0] + 1)) != FSM_STATE_ERROR) )
+	{
+		errors++;
+	}
+
+	// Criação recusada pela tabela não deixa a posição marcada como em uso
+	fsm_pool_destroy(&pool, pool_live[0]);
+	if( (fsm_pool_create(&pool, &fsm, stateTable, NULL, "pool", EV_LIMIT) == FSM_OK) ||
+		(fsm_pool_create(&pool, &pool_live[0], stateTable, (void*)st_off, "pool", EV_LIMIT) != FSM_OK) ||
+		(pool.used != POOL_SLOTS) )
+	{
+		errors++;
+	}
+
+	fsm_pool_deinit(&pool);
+
+	printf("{ \"benchmark\": \"fsm_pool\", \"steps\": %u, \"slots\": %u, \"errors\": %u }\n", steps, POOL_SLOTS, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,173 @@
+/**
+ * @file	test_run.c
+ * @brief	Teste dos orçamentos de passos e de ticks do fsm_run
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma cadeia de RUN_CHAIN estados é percorrida por um único evento: cada
+ * callback retorna o próximo evento e avança um relógio falso em RUN_COST
+ * ticks. O teste confere que fsm_run percorre a cadeia sem orçamento, que os
+ * limites de passos e de ticks interrompem a cadeia com
+ * FSM_BUDGET_EXHAUSTED e evento pendente, que a chamada seguinte continua
+ * de onde parou e que executed e elapsed informam o consumo de cada chamada.
+ *
+ * @code
+ * make -C benchmark run_budget
+ * ./build/test_run
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+
+/**
+ * @defgroup test_run_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define RUN_CHAIN		8
+#define RUN_COST		10		/**< Ticks consumidos por callback */
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_NEXT, EV_RESET, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static uint32_t run_clock;
+
+/**
+ * @}
+ */
+
+static uint16_t st_0(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_LIMIT); }
+static uint16_t st_1(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_2(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_3(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_4(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_5(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_6(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_NEXT); }
+static uint16_t st_7(fsm_handler_t* this) { (void)this; run_clock += RUN_COST; return(EV_LIMIT); }
+
+static void* const chain[RUN_CHAIN] = { (void*)st_0, (void*)st_1, (void*)st_2, (void*)st_3,
+										(void*)st_4, (void*)st_5, (void*)st_6, (void*)st_7 };
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_0,		EV_NEXT,		(void*)st_1	},
+	{ (void*)st_1,		EV_NEXT,		(void*)st_2	},
+	{ (void*)st_2,		EV_NEXT,		(void*)st_3	},
+	{ (void*)st_3,		EV_NEXT,		(void*)st_4	},
+	{ (void*)st_4,		EV_NEXT,		(void*)st_5	},
+	{ (void*)st_5,		EV_NEXT,		(void*)st_6	},
+	{ (void*)st_6,		EV_NEXT,		(void*)st_7	},
+	{ (void*)st_7,		EV_RESET,		(void*)st_0	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+static uint32_t run_now(void)
+{
+	return(run_clock);
+}
+
+/**
+ * @brief run_check
+ *
+ * Executa fsm_run e confere o resultado, o consumo e o estado alcançado
+ */
+static uint32_t run_check(fsm_handler_t *fsm, fsm_budget_t *budget, fsm_result_t expected, uint32_t executed, uint32_t elapsed, uint32_t state)
+{
+	if( (fsm_run(fsm, budget) != expected) || (budget->executed != executed) ||
+		(budget->elapsed != elapsed) || (fsm->cb_state != chain[state]) )
+	{
+		return(1);
+	}
+	// O evento continua pendente apenas quando o orçamento acaba
+	if( (expected == FSM_BUDGET_EXHAUSTED) != (fsm->eventID < EV_LIMIT) )
+	{
+		return(1);
+	}
+
+	return(0);
+}
+
+/**
+ * @brief run_restart
+ *
+ * Volta ao início da cadeia e envia o evento que a percorre
+ */
+static void run_restart(fsm_handler_t *fsm)
+{
+	fsm_post(fsm, EV_RESET);
+	fsm_engine(fsm);
+	fsm_post(fsm, EV_NEXT);
+}
+
+int main(void)
+{
+	fsm_handler_t fsm;
+	fsm_budget_t budget;
+	uint32_t errors = 0;
+
+	fsm_create(&fsm, stateTable, (void*)st_0, "run", EV_LIMIT);
+	memset(&budget, 0, sizeof(budget));
+
+	// Sem evento pendente: um passo, sem transição
+	errors += run_check(&fsm, &budget, FSM_OK, 1, 0, 0);
+
+	// Sem orçamento a cadeia é percorrida até o fim
+	fsm_post(&fsm, EV_NEXT);
+	errors += run_check(&fsm, &budget, FSM_OK, RUN_CHAIN - 1, 0, RUN_CHAIN - 1);
+
+	// Orçamento de passos: a cadeia é retomada na chamada seguinte
+	run_restart(&fsm);
+	budget.steps = 3;
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 3, 0, 3);
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 3, 0, 6);
+	errors += run_check(&fsm, &budget, FSM_OK, 1, 0, 7);
+
+	// Orçamento de ticks: o passo que ultrapassa o limite termina antes da verificação
+	run_restart(&fsm);
+	budget.steps	= 0;
+	budget.ticks	= 25;
+	budget.now		= run_now;
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 3, 3 * RUN_COST, 3);
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 3, 3 * RUN_COST, 6);
+	errors += run_check(&fsm, &budget, FSM_OK, 1, RUN_COST, 7);
+
+	// Sem limite de ticks o relógio apenas mede a chamada
+	run_restart(&fsm);
+	budget.ticks = 0;
+	errors += run_check(&fsm, &budget, FSM_OK, RUN_CHAIN - 1, (RUN_CHAIN - 1) * RUN_COST, RUN_CHAIN - 1);
+
+	// Com os dois limites vale o primeiro alcançado
+	run_restart(&fsm);
+	budget.steps	= 2;
+	budget.ticks	= 100;
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 2, 2 * RUN_COST, 2);
+	budget.steps	= 10;
+	budget.ticks	= 15;
+	errors += run_check(&fsm, &budget, FSM_BUDGET_EXHAUSTED, 2, 2 * RUN_COST, 4);
+
+	if( (fsm_run(&fsm, NULL) != FSM_NULL) || (fsm_run(NULL, &budget) != FSM_NULL) )
+	{
+		errors++;
+	}
+
+	printf("{ \"benchmark\": \"fsm_run_budget\", \"chain\": %u, \"errors\": %u }\n", RUN_CHAIN, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,254 @@
+/**
+ * @file	test_shm.c
+ * @brief	Teste de ponta a ponta das populações em memória compartilhada
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Publica duas FSMs com fsm_shm_create: door, com nomes de estados e
+ * eventos e uma distribuição conhecida de instâncias e eventos pendentes,
+ * e led, sem nomes, cujas instâncias são conduzidas por uma thread enquanto
+ * o inspetor amostra o segmento. O tools/fsmtop é executado sobre o
+ * segmento e a sua saída deve mostrar as duas FSMs, a ocupação de cada
+ * estado de door, os eventos pendentes pelo nome, os estados de led pelo
+ * índice e uma taxa de transições não nula para led (FSM_SEQLOCK_ENABLE).
+ *
+ * @code
+ * make -C benchmark shm
+ * ./build/test_shm ../tools/build/fsmtop
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "fsm.h"
+#include "fsm_shm.h"
+
+#if !FSM_SHM_ENABLE || !FSM_SEQLOCK_ENABLE
+#	error "test_shm requer um sistema POSIX e FSM_SEQLOCK_ENABLE=1"
+#endif
+
+/**
+ * @defgroup test_shm_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define SHM_SEGMENT		"/fsm_test_shm"
+#define SHM_DOORS		100
+#define SHM_LEDS		10
+#define SHM_OUTPUT		8192
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_OPEN, EV_CLOSE, EV_LOCK, EV_UNLOCK, EV_DOOR_LIMIT };
+enum { EV_TOGGLE, EV_LED_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_shm_t		shm;
+static fsm_handler_t*	shm_leds;
+static int				shm_done;
+
+/**
+ * @}
+ */
+
+static uint16_t st_closed(fsm_handler_t* this) { (void)this; return(EV_DOOR_LIMIT); }
+static uint16_t st_open(fsm_handler_t* this)   { (void)this; return(EV_DOOR_LIMIT); }
+static uint16_t st_locked(fsm_handler_t* this) { (void)this; return(EV_DOOR_LIMIT); }
+static uint16_t st_off(fsm_handler_t* this)    { (void)this; return(EV_LED_LIMIT); }
+static uint16_t st_on(fsm_handler_t* this)     { (void)this; return(EV_LED_LIMIT); }
+
+static fsm_state_t doorTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_closed,	EV_OPEN,		(void*)st_open		},
+	{ (void*)st_closed,	EV_LOCK,		(void*)st_locked	},
+	{ (void*)st_open,	EV_CLOSE,		(void*)st_closed	},
+	{ (void*)st_locked,	EV_UNLOCK,		(void*)st_closed	},
+	{ NULL,				EV_DOOR_LIMIT,	NULL				}
+};
+
+static fsm_state_t ledTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_off,	EV_TOGGLE,		(void*)st_on	},
+	{ (void*)st_on,		EV_TOGGLE,		(void*)st_off	},
+	{ NULL,				EV_LED_LIMIT,	NULL			}
+};
+
+static const fsm_shm_name_t doorStates[] = {
+	{ (void*)st_closed,	"closed"	},
+	{ (void*)st_open,	"open"		},
+	{ (void*)st_locked,	"locked"	},
+	{ NULL,				NULL		}
+};
+
+static const char* const doorEvents[EV_DOOR_LIMIT] = { "open", "close", "lock", "unlock" };
+
+/**
+ * @brief shm_blink
+ *
+ * Thread que alterna as instâncias de led enquanto o inspetor amostra
+ */
+static void* shm_blink(void *arg)
+{
+	uint32_t i = 0;
+
+	(void)arg;
+	while( !__atomic_load_n(&shm_done, __ATOMIC_ACQUIRE) )
+	{
+		fsm_post(&shm_leds[i], EV_TOGGLE);
+		fsm_engine(&shm_leds[i]);
+		i = (i + 1) % SHM_LEDS;
+	}
+	return(NULL);
+}
+
+/**
+ * @brief shm_count
+ *
+ * Ocupação mostrada para um estado na última amostra de uma FSM, ou -1
+ */
+static long shm_count(const char *output, const char *fsm, const char *state)
+{
+	const char *section = NULL, *next = output, *line;
+	char name[FSM_SHM_NAME_LENGTH + 1];
+	unsigned long long count;
+
+	// A última amostra é a última seção da FSM
+	while( (next = strstr(next, fsm)) != NULL )
+	{
+		if( (next == output) || (next[-1] == '\n') )
+		{
+			section = next;
+		}
+		next++;
+	}
+	if( section == NULL )
+	{
+		return(-1);
+	}
+
+	for( line=strchr(section, '\n'); (line != NULL) && (strncmp(line, "\n  ", 3) == 0); line=strchr(line + 1, '\n') )
+	{
+		if( (sscanf(line, " %32s %llu", name, &count) == 2) && (strcmp(name, state) == 0) )
+		{
+			return((long)count);
+		}
+	}
+	return(-1);
+}
+
+int main(int argc, char *argv[])
+{
+	static char output[SHM_OUTPUT];
+	fsm_shm_desc_t desc[2];
+	fsm_handler_t *doors;
+	pthread_t blink;
+	char command[512];
+	const char *rate;
+	size_t length = 0, got;
+	uint32_t i, errors = 0;
+	FILE *pipe;
+
+	if( argc < 2 )
+	{
+		fprintf(stderr, "uso: %s fsmtop\n", argv[0]);
+		return(2);
+	}
+
+	memset(desc, 0, sizeof(desc));
+	desc[0].name			= "door";
+	desc[0].stateTable		= doorTable;
+	desc[0].initial_state	= (void*)st_closed;
+	desc[0].number_events	= EV_DOOR_LIMIT;
+	desc[0].population		= SHM_DOORS;
+	desc[0].state_names		= doorStates;
+	desc[0].event_names		= doorEvents;
+	desc[1].name			= "led";
+	desc[1].stateTable		= ledTable;
+	desc[1].initial_state	= (void*)st_off;
+	desc[1].number_events	= EV_LED_LIMIT;
+	desc[1].population		= SHM_LEDS;
+	if( fsm_shm_create(&shm, SHM_SEGMENT, desc, 2) != FSM_OK )
+	{
+		return(1);
+	}
+	doors		= fsm_shm_instances(&shm, 0);
+	shm_leds	= fsm_shm_instances(&shm, 1);
+	if( (doors == NULL) || (shm_leds == NULL) || (fsm_shm_instances(&shm, 2) != NULL) )
+	{
+		errors++;
+	}
+
+	// door: 60 fechadas (5 com EV_OPEN pendente), 30 abertas e 10 trancadas
+	for( i=60; i<SHM_DOORS; i++ )
+	{
+		fsm_post(&doors[i], (i < 90) ? EV_OPEN : EV_LOCK);
+		fsm_engine(&doors[i]);
+	}
+	for( i=0; i<5; i++ )
+	{
+		fsm_post(&doors[i], EV_OPEN);
+	}
+
+	pthread_create(&blink, NULL, shm_blink, NULL);
+	snprintf(command, sizeof(command), "%s -i 50 -n 2 %s", argv[1], SHM_SEGMENT);
+	pipe = popen(command, "r");
+	if( pipe != NULL )
+	{
+		while( (length < sizeof(output) - 1) && ((got = fread(&output[length], 1, sizeof(output) - 1 - length, pipe)) > 0) )
+		{
+			length += got;
+		}
+		if( pclose(pipe) != 0 )
+		{
+			errors++;
+		}
+	}
+	else
+	{
+		errors++;
+	}
+	output[length] = '\0';
+	__atomic_store_n(&shm_done, 1, __ATOMIC_RELEASE);
+	pthread_join(blink, NULL);
+
+	if( (strstr(output, "door  100 instâncias  5 pendentes") == NULL) ||
+		(shm_count(output, "door", "closed") != 60) || (shm_count(output, "door", "open") != 30) ||
+		(shm_count(output, "door", "locked") != 10) || (strstr(output, "pendentes: open=5\n") == NULL) )
+	{
+		errors++;
+	}
+
+	// led sem nomes: estados pelo índice e transições contadas entre as amostras; a thread
+	// pode estar no meio de um passo, então os eventos pendentes não são conferidos
+	rate = strstr(output, "led  10 instâncias  ");
+	if( (rate == NULL) || (shm_count(output, "led", "#0") + shm_count(output, "led", "#1") != SHM_LEDS) ||
+		(strtod(strstr(rate, "pendentes") + strlen("pendentes"), NULL) <= 0.0) )
+	{
+		errors++;
+	}
+
+	fsm_shm_destroy(&shm);
+	if( errors != 0 )
+	{
+		fputs(output, stderr);
+	}
+
+	printf("{ \"benchmark\": \"fsm_shm\", \"fsms\": 2, \"instances\": %u, \"output\": %u, \"errors\": %u }\n",
+		   SHM_DOORS + SHM_LEDS, (uint32_t)length, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
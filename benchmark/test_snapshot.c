@@ -0,0 +1,207 @@
+/**
+ * @file	test_snapshot.c
+ * @brief	Teste de ida e volta do checkpoint de populações
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma população é conduzida por eventos ao acaso, gravada com
+ * fsm_snapshot_write e restaurada instância a instância com
+ * fsm_snapshot_map e fsm_snapshot_restore; estado e evento pendente de cada
+ * instância devem coincidir com os gravados, e as instâncias restauradas
+ * devem continuar executando. O teste também corrompe registros do arquivo
+ * e confere a recusa de estados e eventos inexistentes e de outra tabela.
+ *
+ * @code
+ * make -C benchmark snapshot
+ * ./build/test_snapshot [-p caminho] [-n instâncias]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_snapshot.h"
+
+#if !FSM_SNAPSHOT_MMAP
+#	error "test_snapshot requer FSM_SNAPSHOT_MMAP"
+#endif
+
+/**
+ * @defgroup test_snapshot_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define SNAPSHOT_MAX	100000
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_NEXT, EV_BACK, EV_HOLD, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_handler_t	snapshot_population[SNAPSHOT_MAX];
+static fsm_snapshot_t	snapshot;
+
+/**
+ * @}
+ */
+
+static uint16_t st_a(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_b(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_c(fsm_handler_t* this) { (void)this; return(EV_HOLD); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_NEXT,		(void*)st_c	},
+	{ (void*)st_b,		EV_BACK,		(void*)st_a	},
+	{ (void*)st_c,		EV_BACK,		(void*)st_b	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+static fsm_state_t otherTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_NEXT,		(void*)st_c	},
+	{ (void*)st_b,		EV_BACK,		(void*)st_a	},
+	{ (void*)st_c,		EV_NEXT,		(void*)st_a	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+/**
+ * @brief snapshot_patch
+ *
+ * Grava um registro diretamente no arquivo, simulando um snapshot corrompido
+ */
+static int snapshot_patch(const char *path, uint64_t index, fsm_cold_t record)
+{
+	FILE *file = fopen(path, "r+b");
+	int ok;
+
+	if( file == NULL )
+	{
+		return(0);
+	}
+	ok = (fseek(file, (long)(FSM_SNAPSHOT_HEADER_SIZE + index * sizeof(fsm_cold_t)), SEEK_SET) == 0) &&
+		 (fwrite(&record, sizeof(record), 1, file) == 1);
+	return((fclose(file) == 0) && ok);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = "test_snapshot.fsms";
+	fsm_handler_t fsm;
+	fsm_cold_t record;
+	uint32_t count = SNAPSHOT_MAX, i, errors = 0, restored = 0;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-p") == 0 )
+		{
+			path = argv[a+1];
+		}
+		else if( strcmp(argv[a], "-n") == 0 )
+		{
+			count = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+	if( (count == 0) || (count > SNAPSHOT_MAX) )
+	{
+		count = SNAPSHOT_MAX;
+	}
+
+	// Instâncias em estados variados; as que param em st_c ficam com EV_HOLD pendente
+	srand(1);
+	for( i=0; i<count; i++ )
+	{
+		fsm_create(&snapshot_population[i], stateTable, (void*)st_a, "snapshot", EV_LIMIT);
+		for( a=rand()%6; a>0; a-- )
+		{
+			fsm_post(&snapshot_population[i], (uint16_t)(rand() % EV_HOLD));
+			fsm_engine(&snapshot_population[i]);
+		}
+		// Qualquer valor >= EV_LIMIT é "sem evento", como o retorno de um callback
+		if( (i % 7) == 3 )
+		{
+			snapshot_population[i].eventID = 0xFFFF;
+		}
+	}
+
+	if( fsm_snapshot_write(path, snapshot_population, count) != FSM_OK )
+	{
+		errors++;
+	}
+
+	if( fsm_snapshot_map(&snapshot, path, stateTable, "snapshot", EV_LIMIT) != FSM_OK )
+	{
+		errors++;
+	}
+	for( i=0; i<count; i++ )
+	{
+		if( (fsm_snapshot_restore(&snapshot, i, &fsm) != FSM_OK) ||
+			(fsm.cb_state != snapshot_population[i].cb_state) ||
+			(fsm.eventID != ((snapshot_population[i].eventID < EV_LIMIT) ? snapshot_population[i].eventID : EV_LIMIT)) )
+		{
+			errors++;
+			continue;
+		}
+		// A instância restaurada segue a mesma execução da original
+		fsm_post(&fsm, EV_BACK);
+		fsm_post(&snapshot_population[i], EV_BACK);
+		if( fsm_engine(&fsm) != fsm_engine(&snapshot_population[i]) || (fsm.cb_state != snapshot_population[i].cb_state) )
+		{
+			errors++;
+		}
+		restored++;
+	}
+	if( fsm_snapshot_restore(&snapshot, count, &fsm) != FSM_STATE_ERROR )
+	{
+		errors++;
+	}
+	fsm_snapshot_unmap(&snapshot);
+
+	// Registros corrompidos: estado inexistente e evento pendente fora do enum
+	record.state	= 3;
+	record.eventID	= EV_LIMIT;
+	if( !snapshot_patch(path, 0, record) )
+	{
+		errors++;
+	}
+	record.state	= 0;
+	record.eventID	= EV_LIMIT + 1;
+	if( !snapshot_patch(path, count - 1, record) )
+	{
+		errors++;
+	}
+	if( (fsm_snapshot_map(&snapshot, path, stateTable, "snapshot", EV_LIMIT) != FSM_OK) ||
+		(fsm_snapshot_restore(&snapshot, 0, &fsm) != FSM_FORMAT_ERROR) ||
+		(fsm_snapshot_restore(&snapshot, count - 1, &fsm) != FSM_FORMAT_ERROR) )
+	{
+		errors++;
+	}
+	fsm_snapshot_unmap(&snapshot);
+
+	// Mesmos estados e eventos, outra tabela
+	if( fsm_snapshot_map(&snapshot, path, otherTable, "snapshot", EV_LIMIT) != FSM_STT_ERROR )
+	{
+		errors++;
+	}
+	remove(path);
+
+	printf("{ \"benchmark\": \"fsm_snapshot_roundtrip\", \"instances\": %u, \"restored\": %u, \"errors\": %u }\n", count, restored, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
@@ -0,0 +1,348 @@
+/**
+ * @file	test_tickless.c
+ * @brief	Teste do ocioso sem tick periódico com relógio virtual
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Três FSMs piscam com períodos de 100, 250 e 1000 ms e uma FSM de menu
+ * volta ao repouso 5 s depois do último botão. O laço principal usa
+ * fsm_timers_idle com um gancho que apenas avança o relógio virtual até o
+ * prazo ou até o próximo botão. A quantidade de despertares deve ser a de
+ * instantes distintos com algum vencimento ou botão, em vez de um por
+ * milissegundo. Uma segunda fase arma, rearma e cancela temporizadores ao
+ * acaso e confere fsm_next_deadline com uma busca linear, e uma terceira
+ * vence dois temporizadores da mesma FSM no mesmo instante: nenhum dos dois
+ * eventos pode ser perdido.
+ *
+ * @code
+ * make -C benchmark tickless
+ * ./build/test_tickless [-t ms]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_timer.h"
+
+/**
+ * @defgroup test_tickless_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define TICKLESS_BLINKS		3
+#define TICKLESS_MENU_MS	5000
+#define TICKLESS_RANDOM		64
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_TIMEOUT, EV_PRESS, EV_LIMIT };
+
+typedef struct tickless_clock
+{
+	uint32_t	now;		/**< Relógio virtual, em ms */
+	uint32_t	press;		/**< Próximo botão */
+	uint32_t	end;		/**< Fim da simulação */
+} tickless_clock_t;
+
+/**
+ * Variáveis privadas
+ */
+static const uint32_t tickless_periods[TICKLESS_BLINKS] = { 100, 250, 1000 };
+static const uint32_t tickless_presses[] = { 1200, 3000, 9500 };
+
+static fsm_handler_t	tickless_blink[TICKLESS_BLINKS];
+static fsm_timer_t		tickless_blink_timer[TICKLESS_BLINKS];
+static uint32_t			tickless_toggles[TICKLESS_BLINKS];
+static fsm_handler_t	tickless_menu;
+static fsm_timer_t		tickless_menu_timer;
+static fsm_timer_t*		tickless_heap[TICKLESS_RANDOM];
+static fsm_timers_t		tickless_timers;
+static tickless_clock_t	tickless_clock;
+
+/**
+ * @}
+ */
+
+static uint16_t blink_on(fsm_handler_t* this);
+static uint16_t blink_off(fsm_handler_t* this);
+static uint16_t menu_idle(fsm_handler_t* this);
+static uint16_t menu_active(fsm_handler_t* this);
+
+static fsm_state_t blinkTable[] = {
+	/* callback state	event			next state */
+	{ (void*)blink_on,		EV_TIMEOUT,	(void*)blink_off	},
+	{ (void*)blink_off,		EV_TIMEOUT,	(void*)blink_on		},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+static fsm_state_t menuTable[] = {
+	/* callback state	event			next state */
+	{ (void*)menu_idle,		EV_PRESS,	(void*)menu_active	},
+	{ (void*)menu_active,	EV_PRESS,	(void*)menu_active	},
+	{ (void*)menu_active,	EV_TIMEOUT,	(void*)menu_idle	},
+	{ NULL,					EV_LIMIT,	NULL				}
+};
+
+/**
+ * @brief blink_rearm
+ *
+ * Callback comum dos estados das FSMs que piscam: arma o próximo período
+ */
+static uint16_t blink_rearm(fsm_handler_t* this)
+{
+	uint32_t i = (uint32_t)(this - tickless_blink);
+
+	tickless_toggles[i]++;
+	fsm_timer_start(&tickless_timers, &tickless_blink_timer[i], tickless_clock.now, tickless_periods[i]);
+	return(EV_LIMIT);
+}
+
+static uint16_t blink_on(fsm_handler_t* this) { return(blink_rearm(this)); }
+static uint16_t blink_off(fsm_handler_t* this) { return(blink_rearm(this)); }
+
+static uint16_t menu_idle(fsm_handler_t* this)
+{
+	(void)this;
+	fsm_timer_stop(&tickless_timers, &tickless_menu_timer);
+	return(EV_LIMIT);
+}
+
+static uint16_t menu_active(fsm_handler_t* this)
+{
+	(void)this;
+	fsm_timer_start(&tickless_timers, &tickless_menu_timer, tickless_clock.now, TICKLESS_MENU_MS);
+	return(EV_LIMIT);
+}
+
+/**
+ * @brief tickless_sleep
+ *
+ * Gancho de ocioso: avança o relógio virtual até o prazo ou o próximo botão
+ */
+static void tickless_sleep(uint32_t ticks, void *context)
+{
+	tickless_clock_t *clock = (tickless_clock_t*)context;
+	uint32_t wake = (ticks == FSM_TIMER_FOREVER) ? clock->end : clock->now + ticks;
+
+	clock->now = (clock->press < wake) ? clock->press : wake;
+}
+
+/**
+ * @brief tickless_expected
+ *
+ * Instantes em (0, end] com algum vencimento ou botão, calculados diretamente
+ */
+static uint32_t tickless_expected(uint32_t end)
+{
+	uint32_t t, i, count = 0, press = 0, menu = 0xFFFFFFFFu;
+	uint8_t wake;
+
+	for( t=1; t<=end; t++ )
+	{
+		wake = 0;
+		for( i=0; i<TICKLESS_BLINKS; i++ )
+		{
+			wake |= ((t % tickless_periods[i]) == 0);
+		}
+		if( t == menu )
+		{
+			wake = 1;
+			menu = 0xFFFFFFFFu;
+		}
+		if( (press < sizeof(tickless_presses)/sizeof(tickless_presses[0])) && (t == tickless_presses[press]) )
+		{
+			wake = 1;
+			menu = t + TICKLESS_MENU_MS;
+			press++;
+		}
+		count += wake;
+	}
+	return(count);
+}
+
+/**
+ * @brief tickless_random
+ *
+ * Arma, rearma e cancela temporizadores ao acaso e confere o prazo mais próximo
+ */
+static uint32_t tickless_random(void)
+{
+	fsm_timer_t timers[TICKLESS_RANDOM];
+	uint32_t step, i, now = 0xFFFFF000u, best, deadline, errors = 0;
+	uint8_t armed, found;
+
+	fsm_timers_init(&tickless_timers, tickless_heap, TICKLESS_RANDOM);
+	for( i=0; i<TICKLESS_RANDOM; i++ )
+	{
+		fsm_timer_init(&timers[i], &tickless_menu, EV_TIMEOUT);
+	}
+
+	srand(1);
+	for( step=0; step<200000; step++ )
+	{
+		i = (uint32_t)rand() % TICKLESS_RANDOM;
+		if( (rand() % 4) == 0 )
+		{
+			fsm_timer_stop(&tickless_timers, &timers[i]);
+		}
+		else
+		{
+			fsm_timer_start(&tickless_timers, &timers[i], now, (uint32_t)rand() % 10000);
+		}
+		now += (uint32_t)rand() % 8;	// atravessa o estouro do contador
+
+		found = 0;
+		best = 0;
+		for( i=0; i<TICKLESS_RANDOM; i++ )
+		{
+			if( (timers[i].index != FSM_TIMER_IDLE) && (!found || ((int32_t)(timers[i].deadline - best) < 0)) )
+			{
+				best = timers[i].deadline;
+				found = 1;
+			}
+		}
+		armed = fsm_next_deadline(&tickless_timers, &deadline);
+		if( (armed != found) || (armed && (deadline != best)) )
+		{
+			errors++;
+		}
+	}
+
+	return(errors);
+}
+
+/**
+ * @brief tickless_same
+ *
+ * Dois temporizadores da mesma FSM vencem juntos: o segundo espera o fsm_engine
+ * consumir o evento do primeiro
+ */
+static uint32_t tickless_same(void)
+{
+	fsm_timer_t timeout, press, other;
+	fsm_handler_t blink;
+	uint32_t errors = 0;
+
+	fsm_timers_init(&tickless_timers, tickless_heap, 3);
+	fsm_create(&tickless_menu, menuTable, (void*)menu_idle, "menu", EV_LIMIT);
+	fsm_create(&blink, blinkTable, (void*)blink_on, "blink", EV_LIMIT);
+	fsm_timer_init(&press, &tickless_menu, EV_PRESS);
+	fsm_timer_init(&timeout, &tickless_menu, EV_TIMEOUT);
+	fsm_timer_init(&other, &blink, EV_TIMEOUT);
+	fsm_timer_init(&tickless_menu_timer, &tickless_menu, EV_TIMEOUT);
+	fsm_timer_start(&tickless_timers, &press, 0, 9);
+	fsm_timer_start(&tickless_timers, &timeout, 0, 10);
+	fsm_timer_start(&tickless_timers, &other, 0, 10);
+
+	// O heap está cheio: o temporizador retido volta para uma posição livre
+	if( (fsm_timers_expire(&tickless_timers, 10) != 2) || (tickless_timers.number != 1) ||
+		(tickless_menu.eventID != EV_PRESS) || (blink.eventID != EV_TIMEOUT) ||
+		(fsm_timers_idle(&tickless_timers, 10, tickless_sleep, &tickless_clock) != 0) )
+	{
+		errors++;
+	}
+	tickless_clock.now = 10;
+	fsm_engine(&tickless_menu);
+	fsm_timer_stop(&tickless_timers, &tickless_menu_timer);
+	if( (fsm_timers_expire(&tickless_timers, 11) != 1) || (tickless_timers.number != 0) ||
+		(tickless_menu.eventID != EV_TIMEOUT) || (fsm_engine(&tickless_menu) != FSM_OK) ||
+		(tickless_menu.cb_state != (void*)menu_idle) )
+	{
+		errors++;
+	}
+
+	return(errors);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t end = 20000, i, press = 0, expected, errors = 0, transitions = 0;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-t") == 0 )
+		{
+			end = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	fsm_timers_init(&tickless_timers, tickless_heap, TICKLESS_RANDOM);
+	for( i=0; i<TICKLESS_BLINKS; i++ )
+	{
+		fsm_create(&tickless_blink[i], blinkTable, (void*)blink_on, "blink", EV_LIMIT);
+		fsm_timer_init(&tickless_blink_timer[i], &tickless_blink[i], EV_TIMEOUT);
+		fsm_engine(&tickless_blink[i]);
+	}
+	fsm_create(&tickless_menu, menuTable, (void*)menu_idle, "menu", EV_LIMIT);
+	fsm_timer_init(&tickless_menu_timer, &tickless_menu, EV_TIMEOUT);
+	fsm_engine(&tickless_menu);
+
+	memset(&tickless_clock, 0, sizeof(tickless_clock));
+	tickless_clock.end		= end;
+	tickless_clock.press	= tickless_presses[0];
+
+	for( ;; )
+	{
+		fsm_timers_expire(&tickless_timers, tickless_clock.now);
+		if( tickless_clock.now == tickless_clock.press )
+		{
+			fsm_post(&tickless_menu, EV_PRESS);
+			press++;
+			tickless_clock.press = (press < sizeof(tickless_presses)/sizeof(tickless_presses[0])) ? tickless_presses[press] : 0xFFFFFFFFu;
+		}
+
+		for( i=0; i<TICKLESS_BLINKS; i++ )
+		{
+			if( tickless_blink[i].eventID < EV_LIMIT )
+			{
+				fsm_engine(&tickless_blink[i]);
+			}
+		}
+		if( tickless_menu.eventID < EV_LIMIT )
+		{
+			fsm_engine(&tickless_menu);
+		}
+
+		if( tickless_clock.now >= end )
+		{
+			break;
+		}
+		fsm_timers_idle(&tickless_timers, tickless_clock.now, tickless_sleep, &tickless_clock);
+	}
+
+	expected = tickless_expected(end);
+	if( tickless_timers.wakeups != expected )
+	{
+		errors++;
+	}
+	for( i=0; i<TICKLESS_BLINKS; i++ )
+	{
+		// O primeiro fsm_engine executa o estado inicial sem transição
+		if( tickless_toggles[i] != (end / tickless_periods[i] + 1) )
+		{
+			errors++;
+		}
+		transitions += tickless_toggles[i] - 1;
+	}
+
+	printf("{ \"benchmark\": \"fsm_tickless\", \"ms\": %u, \"tick_wakeups\": %u, \"wakeups\": %u, \"expected\": %u, \"timers_expired\": %u, \"blink_transitions\": %u",
+		   end, end, tickless_timers.wakeups, expected, tickless_timers.expired, transitions);
+	errors += tickless_random();
+	errors += tickless_same();
+	printf(", \"errors\": %u }\n", errors);
+
+	return((errors == 0) ? 0 : 1);
+}
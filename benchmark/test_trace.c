@@ -0,0 +1,231 @@
+/**
+ * @file	test_trace.c
+ * @brief	Teste de ida e volta da gravação e reprodução de eventos
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma FSM de três estados recebe eventos ao acaso, em instantes ao acaso,
+ * enquanto fsm_trace grava o log. Um dos estados encadeia um evento
+ * conforme o relógio, de modo que a reprodução só segue o mesmo caminho se
+ * os instantes também forem reproduzidos. A gravação é reproduzida em uma
+ * instância nova com fsm_trace_replay e a sequência de estados executados,
+ * com o tick visto por cada callback, deve ser idêntica à da gravação. Com
+ * FSM_EMIT_QUEUE o primeiro estado também emite um evento conforme o relógio,
+ * que a reprodução recebe do log e não de fsm_emit. O teste também confere
+ * a rejeição de logs truncados e de outra FSM.
+ *
+ * @code
+ * make -C benchmark trace
+ * ./build/test_trace [-e eventos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "fsm.h"
+#include "fsm_trace.h"
+
+#if !FSM_TRACE_ENABLE
+#	error "test_trace requer FSM_TRACE_ENABLE=1"
+#endif
+
+/**
+ * @defgroup test_trace_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define TRACE_LOG_SIZE		(256u * 1024u)
+#define TRACE_TRAIL_MAX		(64u * 1024u)
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_NEXT, EV_BACK, EV_RESET, EV_LIMIT };
+
+typedef struct trace_step
+{
+	uint8_t		state;		/**< Estado executado */
+	uint32_t	tick;		/**< Tick visto pelo callback */
+} trace_step_t;
+
+typedef struct trace_trail
+{
+	trace_step_t	steps[TRACE_TRAIL_MAX];
+	uint32_t		count;
+} trace_trail_t;
+
+/**
+ * Variáveis privadas
+ */
+static uint8_t			trace_log[TRACE_LOG_SIZE];
+static trace_trail_t	trace_recorded;
+static trace_trail_t	trace_replayed;
+static trace_trail_t*	trace_current;
+static fsm_clock_t		trace_clock;
+static uint32_t			trace_now;
+static uint32_t			trace_emitted;
+
+/**
+ * @}
+ */
+
+static uint16_t st_a(fsm_handler_t* this);
+static uint16_t st_b(fsm_handler_t* this);
+static uint16_t st_c(fsm_handler_t* this);
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_NEXT,		(void*)st_c	},
+	{ (void*)st_b,		EV_BACK,		(void*)st_a	},
+	{ (void*)st_c,		EV_RESET,		(void*)st_a	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+static fsm_state_t otherTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_BACK,		(void*)st_a	},
+	{ NULL,				EV_BACK,		NULL		}
+};
+
+/**
+ * @brief trace_step
+ *
+ * Registra o estado executado e o tick visto pelo callback
+ */
+static void trace_step(uint8_t state)
+{
+	if( trace_current->count < TRACE_TRAIL_MAX )
+	{
+		trace_current->steps[trace_current->count].state	= state;
+		trace_current->steps[trace_current->count].tick		= trace_clock();
+		trace_current->count++;
+	}
+}
+
+static uint16_t st_a(fsm_handler_t* this)
+{
+	(void)this;
+	trace_step(0);
+#if FSM_EMIT_QUEUE > 0
+	// O evento emitido é gravado quando despachado; a reprodução não o emite de novo
+	if( (trace_clock() & 2) != 0 )
+	{
+		static const uint16_t next = EV_NEXT;
+
+		if( (fsm_emit(this, &next, 1) == FSM_OK) && (trace_current == &trace_recorded) )
+		{
+			trace_emitted++;
+		}
+	}
+#endif
+	return(EV_LIMIT);
+}
+
+static uint16_t st_b(fsm_handler_t* this) { (void)this; trace_step(1); return(EV_LIMIT); }
+
+static uint16_t st_c(fsm_handler_t* this)
+{
+	(void)this;
+	trace_step(2);
+	// O caminho depende do relógio: só é reproduzido com os mesmos instantes
+	return( ((trace_clock() & 1) != 0) ? EV_RESET : EV_LIMIT );
+}
+
+static uint32_t trace_test_clock(void)
+{
+	return(trace_now);
+}
+
+int main(int argc, char *argv[])
+{
+	fsm_handler_t fsm;
+	fsm_trace_t trace;
+	fsm_replay_t replay;
+	uint32_t events = 10000, i, errors = 0, recorded = 0;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-e") == 0 )
+		{
+			events = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+
+	// Gravação: cada evento é processado por completo antes do próximo instante
+	trace_current	= &trace_recorded;
+	trace_clock		= trace_test_clock;
+	trace_now		= 0x7FFFFF00u;
+	fsm_create(&fsm, stateTable, (void*)st_a, "trace", EV_LIMIT);
+	if( fsm_trace_start(&trace, &fsm, trace_log, sizeof(trace_log), trace_test_clock) != FSM_OK )
+	{
+		errors++;
+	}
+
+	srand(1);
+	for( i=0; i<events; i++ )
+	{
+		// Intervalos de até 2^20 ticks exercitam varints de 1 a 3 bytes
+		trace_now += ((rand() % 8) == 0) ? ((uint32_t)rand() % (1u << 20)) : ((uint32_t)rand() % 100);
+		fsm_post(&fsm, (uint16_t)((uint32_t)rand() % EV_LIMIT));
+		while( fsm.eventID < EV_LIMIT )
+		{
+			fsm_engine(&fsm);
+			recorded++;
+		}
+	}
+	fsm_trace_stop(&fsm);
+	if( trace.dropped != 0 )
+	{
+		errors++;
+	}
+
+	// Reprodução em uma instância nova, com o relógio virtual
+	trace_current	= &trace_replayed;
+	trace_clock		= fsm_trace_clock;
+	fsm_create(&fsm, stateTable, (void*)st_a, "trace", EV_LIMIT);
+	if( (fsm_trace_replay(&fsm, trace_log, trace.length, &replay) != FSM_OK) || (replay.events != recorded + trace_emitted) )
+	{
+		errors++;
+	}
+	if( (trace_recorded.count != trace_replayed.count) ||
+		(memcmp(trace_recorded.steps, trace_replayed.steps, trace_recorded.count * sizeof(trace_step_t)) != 0) )
+	{
+		errors++;
+	}
+
+	// Log truncado no meio de um registro e log de outra FSM
+	trace_replayed.count = 0;
+	fsm_create(&fsm, stateTable, (void*)st_a, "trace", EV_LIMIT);
+	i = trace.length - 1;
+	while( (i > FSM_TRACE_HEADER_SIZE) && ((trace_log[i-1] & 0x80) == 0) )
+	{
+		i--;
+	}
+	if( (i <= FSM_TRACE_HEADER_SIZE) || (fsm_trace_replay(&fsm, trace_log, i, NULL) != FSM_FORMAT_ERROR) )
+	{
+		errors++;
+	}
+	fsm_create(&fsm, otherTable, (void*)st_a, "other", EV_BACK + 1);
+	if( fsm_trace_replay(&fsm, trace_log, trace.length, NULL) != FSM_FORMAT_ERROR )
+	{
+		errors++;
+	}
+
+	printf("{ \"benchmark\": \"fsm_trace_roundtrip\", \"events\": %u, \"recorded\": %u, \"bytes\": %u, \"transitions\": %u, \"steps\": %u, \"errors\": %u }\n",
+		   events, recorded, trace.length, replay.transitions, trace_recorded.count, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
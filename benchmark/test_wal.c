@@ -0,0 +1,229 @@
+/**
+ * @file	test_wal.c
+ * @brief	Teste de recuperação com snapshot e log de transições
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Uma população é conduzida por eventos ao acaso através de fsm_wal_engine,
+ * com compactações periódicas contra um snapshot. Em seguida a execução é
+ * abandonada sem fechar o log, como em uma queda, e uma segunda população
+ * é recuperada do último snapshot mais o log: estado e evento pendente de
+ * cada instância devem coincidir com os da população abandonada. O teste
+ * também confere que o arquivo do log foi reservado em disco (não esparso),
+ * que o log cheio é recusado, que um evento pendente fora do enum invalida
+ * o replay e que outra tabela não abre o log.
+ *
+ * @code
+ * make -C benchmark wal
+ * ./build/test_wal [-p prefixo] [-s passos]
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "fsm.h"
+#include "fsm_snapshot.h"
+#include "fsm_wal.h"
+
+#if !FSM_SNAPSHOT_MMAP
+#	error "test_wal requer FSM_SNAPSHOT_MMAP"
+#endif
+
+/**
+ * @defgroup test_wal_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define WAL_POPULATION		4096
+#define WAL_CAPACITY		20000
+#define WAL_COMPACT			15000	/**< Transições registradas antes de cada compactação */
+#define WAL_PATH_MAX		512
+
+/**
+ * Tipos de Dados Privados
+ */
+enum { EV_NEXT, EV_BACK, EV_HOLD, EV_LIMIT };
+
+/**
+ * Variáveis privadas
+ */
+static fsm_handler_t	wal_live[WAL_POPULATION];
+static fsm_handler_t	wal_recovered[WAL_POPULATION];
+static fsm_snapshot_t	wal_snapshot;
+static fsm_wal_t		wal_log;
+static fsm_wal_t		wal_reopened;
+
+/**
+ * @}
+ */
+
+static uint16_t st_a(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_b(fsm_handler_t* this) { (void)this; return(EV_LIMIT); }
+static uint16_t st_c(fsm_handler_t* this) { (void)this; return(EV_HOLD); }
+
+static fsm_state_t stateTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_NEXT,		(void*)st_c	},
+	{ (void*)st_b,		EV_BACK,		(void*)st_a	},
+	{ (void*)st_c,		EV_BACK,		(void*)st_b	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+static fsm_state_t otherTable[] = {
+	/* callback state	event			next state */
+	{ (void*)st_a,		EV_NEXT,		(void*)st_b	},
+	{ (void*)st_b,		EV_NEXT,		(void*)st_c	},
+	{ (void*)st_c,		EV_NEXT,		(void*)st_a	},
+	{ NULL,				EV_LIMIT,		NULL		}
+};
+
+int main(int argc, char *argv[])
+{
+	const char *prefix = "test_wal";
+	char log_path[WAL_PATH_MAX], snapshot_path[WAL_PATH_MAX];
+	struct stat info;
+	fsm_handler_t fsm;
+	uint32_t steps = 200000, step, i, errors = 0, compactions = 0, logged = 0;
+	fsm_result_t ret;
+	int a;
+
+	for( a=1; a+1<argc; a+=2 )
+	{
+		if( strcmp(argv[a], "-p") == 0 )
+		{
+			prefix = argv[a+1];
+		}
+		else if( strcmp(argv[a], "-s") == 0 )
+		{
+			steps = (uint32_t)strtoul(argv[a+1], NULL, 10);
+		}
+	}
+	snprintf(log_path, sizeof(log_path), "%s.fsmw", prefix);
+	snprintf(snapshot_path, sizeof(snapshot_path), "%s.fsms", prefix);
+	remove(log_path);
+	remove(snapshot_path);
+
+	for( i=0; i<WAL_POPULATION; i++ )
+	{
+		fsm_create(&wal_live[i], stateTable, (void*)st_a, "wal", EV_LIMIT);
+	}
+
+	// O log novo ocupa blocos de verdade, e não apenas o tamanho
+	if( (fsm_wal_open(&wal_log, log_path, WAL_CAPACITY, stateTable, EV_LIMIT, 16) != FSM_OK) ||
+		(stat(log_path, &info) != 0) || (((uint64_t)info.st_blocks * 512) < (uint64_t)info.st_size) )
+	{
+		errors++;
+	}
+	if( fsm_snapshot_write(snapshot_path, wal_live, WAL_POPULATION) != FSM_OK )
+	{
+		errors++;
+	}
+
+	srand(1);
+	for( step=0; step<steps; step++ )
+	{
+		i = (uint32_t)rand() % WAL_POPULATION;
+		fsm_post(&wal_live[i], (uint16_t)(rand() % EV_HOLD));
+		ret = fsm_wal_engine(&wal_log, wal_live, i, step);
+		if( ret == FSM_OK )
+		{
+			logged++;
+		}
+		else if( ret != FSM_EVENT_ERROR )
+		{
+			errors++;
+		}
+
+		if( wal_log.length >= WAL_COMPACT )
+		{
+			if( (fsm_wal_compact(&wal_log, snapshot_path, wal_live, WAL_POPULATION) != FSM_OK) || (wal_log.length != 0) )
+			{
+				errors++;
+			}
+			compactions++;
+		}
+	}
+
+	// Queda: os registros pendentes chegam ao disco, mas o log não é fechado
+	fsm_wal_flush(&wal_log);
+
+	// Recuperação em outra população: último snapshot e depois o log
+	if( (fsm_snapshot_map(&wal_snapshot, snapshot_path, stateTable, "wal", EV_LIMIT) != FSM_OK) ||
+		(wal_snapshot.count != WAL_POPULATION) )
+	{
+		errors++;
+	}
+	for( i=0; i<WAL_POPULATION; i++ )
+	{
+		if( fsm_snapshot_restore(&wal_snapshot, i, &wal_recovered[i]) != FSM_OK )
+		{
+			errors++;
+		}
+	}
+	fsm_snapshot_unmap(&wal_snapshot);
+
+	if( (fsm_wal_open(&wal_reopened, log_path, 0, stateTable, EV_LIMIT, 16) != FSM_OK) ||
+		(wal_reopened.length != wal_log.length) ||
+		(fsm_wal_replay(&wal_reopened, wal_recovered, WAL_POPULATION) != FSM_OK) )
+	{
+		errors++;
+	}
+	for( i=0; i<WAL_POPULATION; i++ )
+	{
+		if( (wal_recovered[i].cb_state != wal_live[i].cb_state) || (wal_recovered[i].eventID != wal_live[i].eventID) )
+		{
+			errors++;
+		}
+	}
+
+	// Um "sem evento" qualquer é registrado como EV_LIMIT; evento fora do enum invalida o log
+	fsm = wal_live[0];
+	fsm.eventID = 0xFFFF;
+	if( (fsm_wal_append(&wal_reopened, 0, &fsm, step) != FSM_OK) ||
+		(wal_reopened.records[wal_reopened.length - 1].cold.eventID != EV_LIMIT) )
+	{
+		errors++;
+	}
+	wal_reopened.records[wal_reopened.length - 1].cold.eventID = EV_LIMIT + 1;
+	if( fsm_wal_replay(&wal_reopened, wal_recovered, WAL_POPULATION) != FSM_FORMAT_ERROR )
+	{
+		errors++;
+	}
+
+	// Log cheio: o registro é recusado
+	wal_reopened.length = wal_reopened.capacity;
+	wal_reopened.synced = wal_reopened.capacity;
+	if( fsm_wal_append(&wal_reopened, 0, &wal_live[0], step) != FSM_NO_RESOURCES )
+	{
+		errors++;
+	}
+	wal_reopened.length = wal_reopened.header->length;
+	wal_reopened.synced = wal_reopened.header->length;
+	fsm_wal_close(&wal_reopened);
+	fsm_wal_close(&wal_log);
+
+	if( fsm_wal_open(&wal_reopened, log_path, 0, otherTable, EV_LIMIT, 16) != FSM_STT_ERROR )
+	{
+		errors++;
+	}
+
+	remove(log_path);
+	remove(snapshot_path);
+
+	printf("{ \"benchmark\": \"fsm_wal_recovery\", \"steps\": %u, \"transitions\": %u, \"compactions\": %u, \"errors\": %u }\n",
+		   steps, logged, compactions, errors);
+
+	return((errors == 0) ? 0 : 1);
+}
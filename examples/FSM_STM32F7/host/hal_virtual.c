@@ -0,0 +1,268 @@
+/**
+ * @file	hal_virtual.c
+ * @brief	HAL virtual para executar o exemplo no host
+ * @author	Thiago Milioni
+ *
+ * O relógio é virtual, em nanossegundos. Sem spin_ns, HAL_Delay avança o
+ * relógio diretamente e a simulação corre milhares de vezes mais rápido que
+ * o tempo real. Com spin_ns, cada HAL_GetTick avança o relógio spin_ns,
+ * reproduzindo a espera ocupada da HAL do alvo.
+ *
+ * A linha do tempo dos botões é um arquivo texto com uma linha por
+ * pressionamento, "<ms> <botão> [duração ms]", em que o instante pode ser
+ * relativo ao pressionamento anterior com '+' e o botão é SELECT, UP, DOWN,
+ * LEFT ou RIGHT. Linhas iniciadas por '#' são comentários. A duração padrão
+ * é 200 ms: BSP_Wait_Buton só aceita um botão estável por
+ * BSP_BUTTON_RETRIES leituras espaçadas de HAL_Delay(BSP_BUTTON_DEBOUNCE),
+ * cerca de 130 ms.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @defgroup hal_virtual_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define HAL_VIRTUAL_PRESSES		4096
+#define HAL_VIRTUAL_HOLD		200
+#define HAL_VIRTUAL_NS			1000000ull
+
+/**
+ * Tipos de Dados Privados
+ */
+typedef struct hal_virtual_press
+{
+	uint32_t	start;		/**< Instante do pressionamento, em ms */
+	uint32_t	end;		/**< Instante da liberação, em ms */
+	uint16_t	pin;		/**< Pino do botão em GPIOB */
+} hal_virtual_press_t;
+
+/**
+ * Variáveis públicas
+ */
+GPIO_TypeDef hal_virtual_gpiob;
+hal_virtual_stats_t hal_virtual_stats;
+
+/**
+ * Variáveis privadas
+ */
+static hal_virtual_press_t hal_virtual_presses[HAL_VIRTUAL_PRESSES];
+static uint32_t hal_virtual_number;
+static uint32_t hal_virtual_first;
+static uint64_t hal_virtual_ns;
+static uint64_t hal_virtual_end;
+static uint32_t hal_virtual_spin;
+static void (*hal_virtual_finish)(void);
+
+static const struct
+{
+	const char*	name;
+	uint16_t	pin;
+} hal_virtual_buttons[] = {
+	{ "SELECT",	GPIO_PIN_11	},
+	{ "UP",		GPIO_PIN_12	},
+	{ "DOWN",	GPIO_PIN_13	},
+	{ "LEFT",	GPIO_PIN_14	},
+	{ "RIGHT",	GPIO_PIN_15	},
+};
+
+/**
+ * @}
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static void	hal_virtual_advance	(uint64_t ns);
+
+/**
+ * @brief	Carrega a linha do tempo dos botões
+ * @param	path caminho do arquivo
+ * @param	last recebe o instante da última liberação, em ms
+ * @return	Quantidade de pressionamentos, ou -1 em caso de erro
+ */
+int hal_virtual_load(const char *path, uint32_t *last)
+{
+	char line[128], name[16];
+	char *text;
+	unsigned long at, hold;
+	uint32_t previous = 0, i;
+	int fields, number = 0;
+	FILE *file;
+
+	file = fopen(path, "r");
+	if( file == NULL )
+	{
+		return(-1);
+	}
+
+	while( fgets(line, sizeof(line), file) != NULL )
+	{
+		text = line + strspn(line, " \t");
+		if( (*text == '#') || (*text == '\r') || (*text == '\n') || (*text == '\0') )
+		{
+			continue;
+		}
+
+		hold = HAL_VIRTUAL_HOLD;
+		fields = sscanf((*text == '+') ? text + 1 : text, "%lu %15s %lu", &at, name, &hold);
+		if( (fields < 2) || (hal_virtual_number >= HAL_VIRTUAL_PRESSES) )
+		{
+			fclose(file);
+			return(-1);
+		}
+		if( *text == '+' )
+		{
+			at += previous;
+		}
+
+		for( i=0; i<sizeof(hal_virtual_buttons)/sizeof(hal_virtual_buttons[0]); i++ )
+		{
+			if( strcmp(name, hal_virtual_buttons[i].name) == 0 )
+			{
+				break;
+			}
+		}
+		if( (i == sizeof(hal_virtual_buttons)/sizeof(hal_virtual_buttons[0])) || (at < previous) )
+		{
+			fclose(file);
+			return(-1);
+		}
+
+		hal_virtual_presses[hal_virtual_number].start	= (uint32_t)at;
+		hal_virtual_presses[hal_virtual_number].end		= (uint32_t)(at + hold);
+		hal_virtual_presses[hal_virtual_number].pin		= hal_virtual_buttons[i].pin;
+		hal_virtual_number++;
+		previous = (uint32_t)at;
+		if( hal_virtual_presses[hal_virtual_number - 1].end > *last )
+		{
+			*last = hal_virtual_presses[hal_virtual_number - 1].end;
+		}
+		number++;
+	}
+
+	fclose(file);
+	return(number);
+}
+
+/**
+ * @brief	Inicia o relógio virtual
+ * @param	end fim da simulação, em ms
+ * @param	spin_ns avanço do relógio a cada HAL_GetTick (0 para HAL_Delay instantâneo)
+ * @param	finish chamada quando o relógio alcança end; não deve retornar
+ */
+void hal_virtual_start(uint32_t end, uint32_t spin_ns, void (*finish)(void))
+{
+	memset(&hal_virtual_stats, 0, sizeof(hal_virtual_stats));
+	hal_virtual_ns		= 0;
+	hal_virtual_first	= 0;
+	hal_virtual_end		= (uint64_t)end * HAL_VIRTUAL_NS;
+	hal_virtual_spin	= spin_ns;
+	hal_virtual_finish	= finish;
+}
+
+/**
+ * @brief	Retorna o relógio virtual, em nanossegundos
+ */
+uint64_t hal_virtual_now_ns(void)
+{
+	return(hal_virtual_ns);
+}
+
+/**
+ * @brief	Retorna o tick da HAL, em ms
+ */
+uint32_t HAL_GetTick(void)
+{
+	hal_virtual_stats.get_tick++;
+	hal_virtual_advance(hal_virtual_spin);
+	return((uint32_t)(hal_virtual_ns / HAL_VIRTUAL_NS));
+}
+
+/**
+ * @brief	Aguarda Delay ms, com o mesmo tick adicional da HAL do alvo
+ */
+void HAL_Delay(uint32_t Delay)
+{
+	uint32_t tickstart = HAL_GetTick();
+	uint32_t wait = Delay;
+	uint64_t target;
+
+	hal_virtual_stats.delay++;
+	if( wait < HAL_MAX_DELAY )
+	{
+		wait++;
+	}
+	hal_virtual_stats.delay_ms += wait;
+
+	if( hal_virtual_spin != 0 )
+	{
+		while( (HAL_GetTick() - tickstart) < wait )
+		{
+		}
+		return;
+	}
+
+	target = ((uint64_t)tickstart + wait) * HAL_VIRTUAL_NS;
+	if( target > hal_virtual_ns )
+	{
+		hal_virtual_advance(target - hal_virtual_ns);
+	}
+}
+
+/**
+ * @brief	Lê um botão da linha do tempo (nível baixo enquanto pressionado)
+ */
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+	uint32_t now = (uint32_t)(hal_virtual_ns / HAL_VIRTUAL_NS);
+	uint32_t i;
+
+	hal_virtual_stats.gpio_read++;
+
+	// Os pressionamentos já liberados não são mais percorridos
+	while( (hal_virtual_first < hal_virtual_number) && (hal_virtual_presses[hal_virtual_first].end <= now) )
+	{
+		hal_virtual_first++;
+	}
+
+	GPIOx->idr = 0xFFFF;
+	for( i=hal_virtual_first; (i < hal_virtual_number) && (hal_virtual_presses[i].start <= now); i++ )
+	{
+		if( hal_virtual_presses[i].end > now )
+		{
+			GPIOx->idr &= (uint16_t)~hal_virtual_presses[i].pin;
+		}
+		if( (i + 1) > hal_virtual_stats.presses )
+		{
+			hal_virtual_stats.presses = i + 1;
+		}
+	}
+
+	return( (GPIOx->idr & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET );
+}
+
+/**
+ * @brief hal_virtual_advance
+ *
+ * Função privada que avança o relógio e encerra a simulação no fim
+ */
+static void hal_virtual_advance(uint64_t ns)
+{
+	hal_virtual_ns += ns;
+	if( (hal_virtual_ns >= hal_virtual_end) && (hal_virtual_finish != NULL) )
+	{
+		hal_virtual_finish();
+	}
+}
@@ -0,0 +1,174 @@
+/**
+ * @file	main_host.c
+ * @brief	Execução do exemplo do menu no host, em tempo virtual
+ * @author	Thiago Milioni
+ *
+ * Executa Menu_TaskProcedure, como o laço de main.c, com a HAL virtual
+ * conduzida por uma linha do tempo de botões, e ao final relata o custo de
+ * CPU do host por segundo simulado. Como BSP_Wait_Buton espera ocupada
+ * (HAL_Delay entre leituras dos botões), busy_ratio indica a fração do
+ * tempo simulado em que o alvo fica girando sem dormir.
+ *
+ * @code
+ * make -C examples/FSM_STM32F7/host run
+ * ./build/menu_host [-t ms] [-s ns] timelines/navigate.txt
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "stm32f7xx_hal.h"
+#include "menu_tsk.h"
+
+/**
+ * @defgroup main_host_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define MENU_HOST_TAIL		10000	/**< Tempo simulado após o último botão, em ms */
+
+/**
+ * Variáveis privadas
+ */
+static jmp_buf menu_host_end;
+static uint64_t menu_host_procedures;
+static uint64_t menu_host_rejected;
+
+/**
+ * @}
+ */
+
+/**
+ * @brief menu_host_finish
+ *
+ * Encerra a simulação: os estados do menu esperam pelos botões dentro do callback
+ */
+static void menu_host_finish(void)
+{
+	longjmp(menu_host_end, 1);
+}
+
+/**
+ * @brief menu_host_run
+ *
+ * Laço de main.c até o fim do tempo simulado. O primeiro passo, sem evento,
+ * e os estados que não tratam EV_NONE fazem Menu_TaskProcedure retornar
+ * diferente de zero, o que main.c ignora; são contados em rejected.
+ */
+static void menu_host_run(void)
+{
+	if( setjmp(menu_host_end) == 0 )
+	{
+		for( ;; )
+		{
+			if( Menu_TaskProcedure() )
+			{
+				menu_host_rejected++;
+			}
+			menu_host_procedures++;
+		}
+	}
+}
+
+/**
+ * @brief menu_host_ns
+ *
+ * Relógio do host, em nanossegundos
+ */
+static uint64_t menu_host_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	uint32_t end = 0, spin = 0, last = 0;
+	uint64_t cpu, wall;
+	double seconds, busy;
+	int a, presses;
+
+	for( a=1; a<argc; a++ )
+	{
+		if( (strcmp(argv[a], "-t") == 0) && (a+1 < argc) )
+		{
+			end = (uint32_t)strtoul(argv[++a], NULL, 10);
+		}
+		else if( (strcmp(argv[a], "-s") == 0) && (a+1 < argc) )
+		{
+			spin = (uint32_t)strtoul(argv[++a], NULL, 10);
+		}
+		else
+		{
+			path = argv[a];
+		}
+	}
+
+	if( path == NULL )
+	{
+		fprintf(stderr, "uso: %s [-t ms] [-s ns] linha_do_tempo\n", argv[0]);
+		return(2);
+	}
+
+	presses = hal_virtual_load(path, &last);
+	if( presses < 0 )
+	{
+		fprintf(stderr, "linha do tempo inválida: %s\n", path);
+		return(2);
+	}
+
+	if( Menu_TaskInit() )
+	{
+		fprintf(stderr, "Menu_TaskInit falhou\n");
+		return(1);
+	}
+
+	if( end == 0 )
+	{
+		end = last + MENU_HOST_TAIL;
+	}
+
+	hal_virtual_start(end, spin, menu_host_finish);
+	cpu		= menu_host_ns(CLOCK_PROCESS_CPUTIME_ID);
+	wall	= menu_host_ns(CLOCK_MONOTONIC);
+
+	menu_host_run();
+
+	cpu		= menu_host_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	wall	= menu_host_ns(CLOCK_MONOTONIC) - wall;
+	seconds	= (double)hal_virtual_now_ns() / 1e9;
+	Menu_TaskDestroy();
+
+	// O último HAL_Delay é interrompido pelo fim da simulação
+	busy = (double)hal_virtual_stats.delay_ms / (double)end;
+	if( busy > 1.0 )
+	{
+		busy = 1.0;
+	}
+
+	printf("{ \"example\": \"menu_host\", \"timeline\": \"%s\", \"sim_ms\": %u, \"spin_ns\": %u, \"presses\": %d, \"presses_seen\": %u, "
+		   "\"procedures\": %llu, \"rejected\": %llu, \"get_tick\": %llu, \"gpio_read\": %llu, \"delay\": %llu, \"busy_ratio\": %.3f, "
+		   "\"get_tick_per_sim_s\": %.0f, \"gpio_read_per_sim_s\": %.0f, \"cpu_us_per_sim_s\": %.3f, \"speedup\": %.0f }\n",
+		   path, end, spin, presses, hal_virtual_stats.presses,
+		   (unsigned long long)menu_host_procedures, (unsigned long long)menu_host_rejected, (unsigned long long)hal_virtual_stats.get_tick,
+		   (unsigned long long)hal_virtual_stats.gpio_read, (unsigned long long)hal_virtual_stats.delay,
+		   busy,
+		   (double)hal_virtual_stats.get_tick / seconds, (double)hal_virtual_stats.gpio_read / seconds,
+		   ((double)cpu / 1e3) / seconds, (seconds * 1e9) / (double)(wall ? wall : 1));
+
+	return(0);
+}
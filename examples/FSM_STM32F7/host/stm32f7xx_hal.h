@@ -0,0 +1,86 @@
+/**
+ * @file	stm32f7xx_hal.h
+ * @brief	HAL virtual para executar o exemplo no host
+ * @author	Thiago Milioni
+ *
+ * Substitui o header da HAL no build de host (host/Makefile), com apenas
+ * as funções usadas por bsp.c. O tempo é virtual e os botões seguem uma
+ * linha do tempo lida de um arquivo (ver hal_virtual.c).
+ *
+ */
+#ifndef __STM32F7xx_HAL_H
+#define __STM32F7xx_HAL_H
+
+/**
+ * @defgroup stm32f7xx_hal_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+
+/**
+ * Macros Públicas
+ */
+#define HAL_MAX_DELAY		0xFFFFFFFFU
+
+#define GPIO_PIN_11			((uint16_t)0x0800U)
+#define GPIO_PIN_12			((uint16_t)0x1000U)
+#define GPIO_PIN_13			((uint16_t)0x2000U)
+#define GPIO_PIN_14			((uint16_t)0x4000U)
+#define GPIO_PIN_15			((uint16_t)0x8000U)
+
+#define GPIOB				(&hal_virtual_gpiob)
+
+/**
+ * Tipos de Dados Públicos
+ */
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+	uint16_t	idr;		/**< Nível dos pinos, recalculado a cada leitura */
+} GPIO_TypeDef;
+
+/**
+ * @brief HAL Virtual Stats
+ *
+ * Contadores das chamadas da HAL virtual
+ */
+typedef struct hal_virtual_stats
+{
+	uint64_t	get_tick;	/**< Chamadas de HAL_GetTick */
+	uint64_t	delay;		/**< Chamadas de HAL_Delay */
+	uint64_t	delay_ms;	/**< Milissegundos virtuais dentro de HAL_Delay */
+	uint64_t	gpio_read;	/**< Chamadas de HAL_GPIO_ReadPin */
+	uint32_t	presses;	/**< Botões da linha do tempo já iniciados */
+} hal_virtual_stats_t;
+
+/**
+ * Variáveis públicas
+ */
+extern GPIO_TypeDef hal_virtual_gpiob;
+extern hal_virtual_stats_t hal_virtual_stats;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+uint32_t		HAL_GetTick			(void);
+void			HAL_Delay			(uint32_t Delay);
+GPIO_PinState	HAL_GPIO_ReadPin	(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+int				hal_virtual_load	(const char *path, uint32_t *last);
+void			hal_virtual_start	(uint32_t end, uint32_t spin_ns, void (*finish)(void));
+uint64_t		hal_virtual_now_ns	(void);
+
+/**
+ * @}
+ */
+
+#endif
@@ -1,5 +1,6 @@
 import os
 import sys
+import struct
 
 forms = ['_tsk.c','_tsk.h','_api.c','_api.h']
 
@@ -103,7 +104,7 @@ def generateSourceCodeFromGraph(fsmName, fsmStart, fsmTable, fsmEvList, function
 
 	for file in forms:
 		print('Generating ' + fsmName + file + ' file\n')
-		f = open(os.path.abspath('src/'+file),'r')
+		f = open(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'src', file),'r')
 		contents = f.read()
 		f.close()
 		
@@ -164,25 +165,133 @@ def generateSourceCodeFromGraph(fsmName, fsmStart, fsmTable, fsmEvList, function
 		f.close()
 	print('\nGenerated ' + fsmName + ' FSM machine in ' + os.path.abspath(fsmName) + '\n')
 
+def parseDescriptor(path):
+	f = open(os.path.abspath(path),'r')
+	descriptor = f.read()
+	f.close()
+
+	fsmName = os.path.basename(path)
+	if fsmName.find('.') != -1:
+		fsmName = fsmName[0:fsmName.index('.')]
+	transitions = []
+	for line in descriptor.split('\n'):
+		par = line.split(',')
+		if len(par) < 3:
+			continue
+		transitions.append([par[0].strip(), par[1].strip(), par[2].strip()])
+	return fsmName, transitions
+
+def fnvHash(hash, value):
+	for byte in struct.pack('<H', value):
+		hash = ((hash ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+	return hash
+
+def align8(buffer):
+	while len(buffer) % 8 != 0:
+		buffer.append(0)
+
+# Gera um bundle binário (ver src/fsm_bundle.h) e o cabeçalho com os índices
+def generateBundle(bundleFile, descriptors):
+	entries = []
+	for path in descriptors:
+		fsmName, transitions = parseDescriptor(path)
+		if len(transitions) == 0:
+			print('No transitions in ' + path + '\n')
+			sys.exit(1)
+		if len(fsmName) > 15:
+			print('FSM name ' + fsmName + ' longer than 15 characters\n')
+			sys.exit(1)
+		# Estados na ordem de fsm_state_list: estado atual e depois próximo estado, linha a linha.
+		# Eventos na ordem de <fsm>_evHandler em <fsm>_api.h, de modo que number_events == <fsm>_EV_LIMIT
+		states = []
+		events = []
+		for line in transitions:
+			for state in [line[0], line[2]]:
+				if not state in states:
+					states.append(state)
+			if not line[1] in events:
+				events.append(line[1])
+		rows = [[states.index(line[0]), events.index(line[1]), states.index(line[2])] for line in transitions]
+		nextIndex = [0xFFFF] * (len(states) * len(events))
+		hash = fnvHash(0xCBF29CE484222325, len(events))
+		for row in rows:
+			if nextIndex[row[0] * len(events) + row[1]] != 0xFFFF:
+				print('Duplicate transition ' + states[row[0]] + ', ' + events[row[1]] + ' in ' + path + '\n')
+				sys.exit(1)
+			nextIndex[row[0] * len(events) + row[1]] = row[2]
+			for value in row:
+				hash = fnvHash(hash, value)
+		# Estado inicial: o da primeira linha, como $FSM_START_CB$ no modo normal
+		initial = states.index(transitions[0][0])
+		entries.append([fsmName, states, events, rows, nextIndex, hash, initial])
+
+	# Cabeçalho (32 bytes) e diretório (48 bytes por FSM)
+	data = bytearray(32 + 48 * len(entries))
+	directory = []
+	for entry in entries:
+		fsmName, states, events, rows, nextIndex, hash, initial = entry
+		rowsOffset = len(data)
+		for row in rows:
+			data += struct.pack('<4H', row[0], row[1], row[2], 0)
+		nextOffset = len(data)
+		data += struct.pack('<%dH' % len(nextIndex), *nextIndex)
+		align8(data)
+		directory.append(struct.pack('<16s4H4IQ', fsmName.encode(), len(states), len(events), initial, 0,
+			len(rows), rowsOffset, nextOffset, 0, hash))
+	struct.pack_into('<4s2H2I2Q', data, 0, b'FSMB', 1, 0x0102, len(entries), 0, 32, len(data))
+	for index in range(len(directory)):
+		data[32 + 48 * index:32 + 48 * (index + 1)] = directory[index]
+
+	f = open(os.path.abspath(bundleFile),'wb')
+	f.write(data)
+	f.close()
+
+	bundleName = os.path.basename(bundleFile)
+	if bundleName.find('.') != -1:
+		bundleName = bundleName[0:bundleName.index('.')]
+	headerFile = os.path.join(os.path.dirname(os.path.abspath(bundleFile)), bundleName + '_bundle.h')
+	guard = '__' + bundleName.upper() + '_BUNDLE_H__'
+	contents = '/**\n * @file\t' + bundleName + '_bundle.h\n * @brief\tÍndices do bundle ' + os.path.basename(bundleFile) + '\n *\n'
+	contents = contents + ' * Gerado por generator/script.py --bundle. Não editar.\n *\n */\n'
+	contents = contents + '#ifndef ' + guard + '\n#define ' + guard + '\n\n'
+	for entry in entries:
+		fsmName, states, events, rows, nextIndex, hash, initial = entry
+		# Prefixo _BUNDLE_: o cabeçalho é incluído junto com <fsm>_api.h, que já declara <fsm>_<evento>
+		contents = contents + '/* ' + fsmName + ' */\n'
+		contents = contents + '#define ' + fsmName + '_BUNDLE_NAME\t"' + fsmName + '"\n'
+		contents = contents + '#define ' + fsmName + '_BUNDLE_INITIAL\t' + fsmName + '_BUNDLE_' + states[initial] + '_IDX\n'
+		contents = contents + 'enum ' + fsmName + '_bundle_state {\n'
+		for state in states:
+			contents = contents + '  ' + fsmName + '_BUNDLE_' + state + '_IDX,\n'
+		contents = contents + '  ' + fsmName + '_BUNDLE_STATES\n};\n'
+		contents = contents + 'enum ' + fsmName + '_bundle_event {\n'
+		for event in events:
+			contents = contents + '  ' + fsmName + '_BUNDLE_' + event + ',\n'
+		contents = contents + '  ' + fsmName + '_BUNDLE_EVENTS\n};\n'
+		contents = contents + '#define ' + fsmName + '_CALLBACKS\t' + ', '.join(['(void*)' + fsmName + '_' + state for state in states]) + '\n\n'
+	contents = contents + '#endif\n'
+	f = open(headerFile,'w')
+	f.write(contents)
+	f.close()
+	print('Generated bundle ' + os.path.abspath(bundleFile) + ' with ' + str(len(entries)) + ' FSM machines\n')
+
 # Recebe os argumentos enviados via linha de comando
-if len(sys.argv) > 1:
+# script.py --bundle saida.fsmb fsm1.csv [fsm2.csv ...] gera um bundle binário
+if len(sys.argv) > 2 and sys.argv[1] == '--bundle':
+	generateBundle(sys.argv[2], sys.argv[3:])
+elif len(sys.argv) > 1:
 	#try:
-		f = open(os.path.abspath(sys.argv[1]),'r')
-		descriptor = f.read()
-		f.close()
-		
-		lines = descriptor.split('\n')
-		fsmName = sys.argv[1][0:sys.argv[1].index('.')]
+		# Mesma leitura do --bundle: eventos e estados na mesma ordem dos índices do bundle
+		fsmName, transitions = parseDescriptor(sys.argv[1])
 		fsmStart = ''
 		fsmTable = ''
 		fsmEvList = []
 		functionList = []
 		fsmTransitions = []
-		for line in lines:
-			par = line.split(',')
-			state = fsmName + '_' + par[0].strip()
-			event = fsmName + '_' + par[1].strip()
-			callback = fsmName + '_' + par[2].strip()
+		for par in transitions:
+			state = fsmName + '_' + par[0]
+			event = fsmName + '_' + par[1]
+			callback = fsmName + '_' + par[2]
 			fsmTransitions.append([state,event,callback])
 			fsmTable = fsmTable + '{ (void*)' + state + ', ' + event + ', (void*)' + callback + ' },\n  '
 			if fsmStart == '':
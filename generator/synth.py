@@ -0,0 +1,259 @@
+import argparse
+import os
+import random
+import struct
+import sys
+
+# Gera máquinas de estado sintéticas, com sequências de eventos compatíveis,
+# para testes de escala e benchmarks do fsm_engine.
+#
+# Saída (em --out):
+#   <name>_synth.h     enum de eventos e API de criação
+#   <name>_synth.c     callbacks, tabela de transição e sequência de eventos
+#   <name>.fsmt        sequência de eventos no formato do fsm_trace (opcional)
+#
+# Os callbacks gerados retornam os eventos da sequência, em ordem e de forma
+# cíclica, de modo que a FSM é conduzida apenas chamando fsm_engine.
+#
+# Exemplo:
+#   python synth.py --name big --states 500 --events 32 --density 0.2 --degree zipf
+
+def parseArgs():
+	parser = argparse.ArgumentParser(description='Gerador de FSMs sintéticas')
+	parser.add_argument('--name', default='synth', help='prefixo dos símbolos e arquivos gerados')
+	parser.add_argument('--out', default='.', help='diretório de saída')
+	parser.add_argument('--states', type=int, default=64, help='quantidade de estados')
+	parser.add_argument('--events', type=int, default=16, help='quantidade de eventos')
+	parser.add_argument('--density', type=float, default=0.25, help='fração dos pares (estado, evento) com transição')
+	parser.add_argument('--degree', choices=['uniform','zipf','bimodal'], default='uniform', help='distribuição do grau de saída dos estados')
+	parser.add_argument('--alpha', type=float, default=1.2, help='expoente da distribuição zipf')
+	parser.add_argument('--order', choices=['state','shuffle'], default='state', help='ordem das linhas na tabela')
+	parser.add_argument('--trace', type=int, default=4096, help='quantidade de eventos na sequência gerada')
+	parser.add_argument('--miss', type=float, default=0.0, help='fração de eventos sem transição no estado atual')
+	parser.add_argument('--tick', type=int, default=1, help='intervalo médio entre eventos, em ticks, no arquivo .fsmt')
+	parser.add_argument('--fsmt', action='store_true', help='gera também a sequência no formato binário do fsm_trace')
+	parser.add_argument('--seed', type=int, default=1, help='semente do gerador aleatório')
+	args = parser.parse_args()
+
+	if args.states < 2 or args.events < 1:
+		parser.error('são necessários pelo menos 2 estados e 1 evento')
+	if args.events >= 0xFFFF:
+		parser.error('eventID é limitado a 16 bits')
+	if not 0.0 < args.density <= 1.0:
+		parser.error('density deve estar em (0, 1]')
+	if not 0.0 <= args.miss <= 1.0:
+		parser.error('miss deve estar em [0, 1]')
+	return args
+
+def generateDegrees(rng, args):
+	# O grau de saída de um estado é limitado pela quantidade de eventos e,
+	# pela regra do fsm_checkStateTable, pela quantidade de próximos estados distintos
+	limit = min(args.events, args.states)
+	total = max(1, int(round(args.density * args.states * args.events)))
+	total = min(total, limit * args.states)
+
+	if args.degree == 'uniform':
+		weights = [1.0] * args.states
+	elif args.degree == 'zipf':
+		weights = [1.0 / ((rank + 1) ** args.alpha) for rank in range(args.states)]
+		rng.shuffle(weights)
+	else:
+		# Poucos estados concentradores e muitos estados folha
+		weights = [10.0 if rng.random() < 0.1 else 1.0 for state in range(args.states)]
+
+	scale = sum(weights)
+	degrees = [min(limit, int(total * w / scale)) for w in weights]
+
+	# Distribui o resto respeitando o limite de cada estado
+	missing = total - sum(degrees)
+	order = sorted(range(args.states), key=lambda s: -weights[s])
+	while missing > 0:
+		for state in order:
+			if missing == 0:
+				break
+			if degrees[state] < limit:
+				degrees[state] = degrees[state] + 1
+				missing = missing - 1
+
+	# O estado inicial precisa de pelo menos uma transição
+	if degrees[0] == 0:
+		degrees[0] = 1
+	return degrees
+
+def generateTable(rng, args):
+	degrees = generateDegrees(rng, args)
+	table = []
+	for state in range(args.states):
+		events = rng.sample(range(args.events), degrees[state])
+		targets = rng.sample(range(args.states), degrees[state])
+		for event, target in zip(sorted(events), targets):
+			table.append([state, event, target])
+	if args.order == 'shuffle':
+		rng.shuffle(table)
+	return table
+
+# Retorna None quando nenhuma transição do estado 0 leva a um estado que volta a ele
+def generateTrace(rng, args, table):
+	accepted = {}
+	for state, event, target in table:
+		accepted.setdefault(state, {})[event] = target
+
+	# Estados a partir dos quais o estado inicial é alcançável: a sequência só segue
+	# transições para eles, para que sempre exista o caminho de volta ao estado 0
+	returns = set([0])
+	changed = True
+	while changed:
+		changed = False
+		for state, event, target in table:
+			if target in returns and state not in returns:
+				returns.add(state)
+				changed = True
+	if not [target for target in accepted.get(0, {}).values() if target in returns]:
+		return None
+
+	trace = []
+	state = 0
+	for index in range(args.trace):
+		rules = accepted.get(state, {})
+		safe = dict([[event, target] for event, target in rules.items() if target in returns])
+		rejected = args.events - len(rules)
+		if rng.random() >= args.miss or rejected == 0:
+			event = rng.choice(sorted(safe))
+			trace.append(event)
+			state = safe[event]
+		else:
+			event = rng.randrange(args.events)
+			while event in rules:
+				event = rng.randrange(args.events)
+			trace.append(event)
+
+	# Fecha o ciclo voltando ao estado inicial, para que a sequência possa ser
+	# repetida sem perder a sincronia com a tabela
+	parent = {state: None}
+	queue = [state]
+	while queue and 0 not in parent:
+		current = queue.pop(0)
+		for event, target in sorted(accepted.get(current, {}).items()):
+			if target not in parent:
+				parent[target] = [current, event]
+				queue.append(target)
+	if 0 not in parent:
+		sys.exit('erro: o estado ' + str(state) + ' não alcança o estado 0')
+	path = []
+	current = 0
+	while current in parent and parent[current] is not None:
+		path.insert(0, parent[current][1])
+		current = parent[current][0]
+	return trace + path
+
+def stateName(args, state):
+	return args.name + '_s' + str(state)
+
+def eventName(args, event):
+	return args.name + '_EV' + str(event)
+
+def generateHeader(args, table, trace):
+	guard = '__' + args.name.upper() + '_SYNTH_H__'
+	code = '/**\n * @file\t' + args.name + '_synth.h\n * @brief\tFSM sintética gerada por synth.py\n *\n'
+	code += ' * states=' + str(args.states) + ' events=' + str(args.events) + ' rows=' + str(len(table))
+	code += ' density=' + str(args.density) + ' degree=' + args.degree + ' seed=' + str(args.seed) + '\n */\n'
+	code += '#ifndef ' + guard + '\n#define ' + guard + '\n\n#include "fsm.h"\n\n'
+	code += '/**\n * @brief Enum dos Eventos\n */\ntypedef enum {\n'
+	for event in range(args.events):
+		code += '\t' + eventName(args, event) + ',\n'
+	code += '\n\t' + args.name.upper() + '_EV_LIMIT\n} ' + args.name + '_evHandler;\n\n'
+	code += '#define ' + args.name.upper() + '_STATES\t\t' + str(args.states) + '\n'
+	code += '#define ' + args.name.upper() + '_ROWS\t\t' + str(len(table)) + '\n'
+	code += '#define ' + args.name.upper() + '_TRACE_LENGTH\t' + str(len(trace)) + '\n\n'
+	code += 'fsm_result_t ' + args.name + '_Create(fsm_handler_t *fsm);\n'
+	code += 'fsm_state_t* ' + args.name + '_Table(void);\n'
+	code += 'uint32_t     ' + args.name + '_Steps(void);\n\n'
+	code += '#endif /* ' + guard + ' */\n'
+	return code
+
+def generateSource(args, table, trace):
+	code = '/**\n * @file\t' + args.name + '_synth.c\n * @brief\tFSM sintética gerada por synth.py\n */\n'
+	code += '#include <stddef.h>\n#include <stdint.h>\n#include "' + args.name + '_synth.h"\n\n'
+
+	# Sequência de eventos consumida pelos callbacks
+	code += 'static const uint16_t ' + args.name + '_trace[' + str(len(trace)) + '] = {'
+	for index, event in enumerate(trace):
+		if index % 16 == 0:
+			code += '\n\t'
+		code += str(event) + ', '
+	code += '\n};\n\nstatic uint32_t ' + args.name + '_step;\n\n'
+	code += 'static ' + args.name + '_evHandler ' + args.name + '_next(void)\n{\n'
+	code += '\tuint32_t step = ' + args.name + '_step++;\n'
+	code += '\treturn((' + args.name + '_evHandler)' + args.name + '_trace[step % ' + str(len(trace)) + ']);\n}\n\n'
+
+	for state in range(args.states):
+		code += 'static ' + args.name + '_evHandler ' + stateName(args, state) + '(fsm_handler_t* this)\n'
+		code += '{\n\t(void)this;\n\treturn(' + args.name + '_next());\n}\n\n'
+
+	code += 'static fsm_state_t ' + args.name + '_stateTable[] = {\n'
+	code += '\t/* callback state\tevent\tnext state */\n'
+	for state, event, target in table:
+		code += '\t{ (void*)' + stateName(args, state) + ', ' + eventName(args, event) + ', (void*)' + stateName(args, target) + ' },\n'
+	code += '\t{ NULL, ' + args.name.upper() + '_EV_LIMIT, NULL, }\n};\n\n'
+
+	code += 'fsm_result_t ' + args.name + '_Create(fsm_handler_t *fsm)\n{\n'
+	code += '\tfsm_result_t ret;\n'
+	code += '\tret = fsm_create(fsm, ' + args.name + '_stateTable, (void*)' + stateName(args, 0) + ', "' + args.name[0:15] + '", ' + args.name.upper() + '_EV_LIMIT);\n'
+	code += '\t' + args.name + '_step = 0;\n'
+	code += '\tfsm->eventID = ' + args.name + '_next();\n'
+	code += '\treturn(ret);\n}\n\n'
+	code += 'fsm_state_t* ' + args.name + '_Table(void)\n{\n\treturn(' + args.name + '_stateTable);\n}\n\n'
+	code += 'uint32_t ' + args.name + '_Steps(void)\n{\n\treturn(' + args.name + '_step);\n}\n'
+	return code
+
+def generateTraceFile(rng, args, trace):
+	# Cabeçalho e registros no formato descrito em src/fsm_trace.h
+	data = bytearray(b'FSMT')
+	data += struct.pack('<BBHI', 1, 0, args.events, 0)
+
+	def varint(value):
+		out = bytearray()
+		while value >= 0x80:
+			out.append((value & 0x7F) | 0x80)
+			value = value >> 7
+		out.append(value)
+		return out
+
+	for event in trace:
+		delta = int(rng.expovariate(1.0 / args.tick)) if args.tick > 0 else 0
+		data += varint(delta)
+		data += varint(event)
+	return data
+
+def main():
+	args = parseArgs()
+	rng = random.Random(args.seed)
+
+	# Tabelas esparsas podem não ter ciclo pelo estado 0: gera outra tabela
+	for attempt in range(100):
+		table = generateTable(rng, args)
+		trace = generateTrace(rng, args, table)
+		if trace is not None:
+			break
+	if trace is None:
+		sys.exit('erro: nenhuma tabela gerada permite voltar ao estado 0; use outra --seed ou uma --density maior')
+
+	if not os.path.exists(os.path.abspath(args.out)):
+		os.makedirs(os.path.abspath(args.out))
+
+	files = [[args.name + '_synth.h', generateHeader(args, table, trace)],
+			 [args.name + '_synth.c', generateSource(args, table, trace)]]
+	for name, contents in files:
+		f = open(os.path.join(os.path.abspath(args.out), name), 'w')
+		f.write(contents)
+		f.close()
+
+	if args.fsmt:
+		f = open(os.path.join(os.path.abspath(args.out), args.name + '.fsmt'), 'wb')
+		f.write(generateTraceFile(rng, args, trace))
+		f.close()
+
+	print('Generated ' + args.name + ' FSM: ' + str(args.states) + ' states, ' + str(args.events) + ' events, '
+		  + str(len(table)) + ' rows, ' + str(len(trace)) + ' trace events in ' + os.path.abspath(args.out) + '\n')
+
+main()
@@ -15,16 +15,55 @@
  */
 #include "fsm.h"
 #include "string.h"
+#if FSM_TRACE_ENABLE
+#	include "fsm_trace.h"
+#endif
+#if FSM_SWAP_ENABLE
+#	include "fsm_swap.h"
+#endif
+#if FSM_PAYLOAD_ENABLE
+#	include "fsm_buffer.h"
+#endif
 
 /**
  * @defgroup fsm_c doxygengroup
  * @{
  */
 
+/**
+ * Macros Privadas
+ */
+#if FSM_SEQLOCK_ENABLE
+// Os campos são gravados com release após o contador ímpar e lidos com acquire,
+// de modo que um leitor que veja um valor novo também veja o contador alterado
+#	define FSM_SEQ_BEGIN(fsm)	__atomic_store_n(&(fsm)->seq, (fsm)->seq + 1, __ATOMIC_RELAXED)
+#	define FSM_SEQ_END(fsm)		__atomic_store_n(&(fsm)->seq, (fsm)->seq + 1, __ATOMIC_RELEASE)
+#else
+#	define FSM_SEQ_BEGIN(fsm)
+#	define FSM_SEQ_END(fsm)
+#endif
+
+#if FSM_DEFER_QUEUE > 0
+#	define FSM_DEFER_EVENTS		32			/**< Eventos representáveis em fsm_mask_t */
+#	define FSM_DEFER_CHANGED	0x01		/**< Estado mudou e os eventos adiados não foram verificados */
+#	define FSM_DEFER_RECALLED	0x02		/**< O evento pendente foi retirado de defer_queue */
+#endif
+
 /**
  * Protótipos de Funções Privadas
  */
 fsm_result_t fsm_checkStateTable(fsm_state_t *stateTable, uint16_t number_events);
+static fsm_result_t fsm_step(fsm_handler_t *fsm);
+#if FSM_PAYLOAD_ENABLE
+static void	fsm_payload_drop(struct fsm_buffer **payload);
+#endif
+#if FSM_DEFER_QUEUE > 0
+static fsm_defer_t*	fsm_defer_find		(fsm_handler_t *fsm, void *cb_state);
+static fsm_mask_t	fsm_defer_accept	(fsm_handler_t *fsm, void *cb_state);
+static fsm_result_t	fsm_defer_park		(fsm_handler_t *fsm);
+static fsm_result_t	fsm_defer_unpark	(fsm_handler_t *fsm);
+static uint16_t		fsm_defer_recall	(fsm_handler_t *fsm);
+#endif
 
 /**
  * @}
@@ -32,8 +71,9 @@ fsm_result_t fsm_checkStateTable(fsm_state_t *stateTable, uint16_t number_events
 
 /**
  * @brief		Cria uma Máquina de Estado
- * @details		Função que cria uma FSM. A forma de utilizar essa função pode variar de acordo
- *				com a forma de alocação que foi configurado em fsmConfig.h
+ * @details		Função que inicializa uma FSM na estrutura fornecida pela aplicação. Para
+ *				instâncias criadas dinamicamente a estrutura deve ser obtida de um pool
+ *				com fsm_pool_create (FSM_STATIC_ONLY 0)
  * @see			FSM_STATIC_ONLY
  * @param		fsm ponteiro para estrutura FSM
  * @param		stateTable ponteiro para tabela de transição de estados
@@ -79,15 +119,6 @@ fsm_result_t fsm_create(fsm_handler_t *fsm, fsm_state_t *stateTable, void* initi
 		return(FSM_STATE_ERROR);
 	}
 
-#if !FSM_STATIC_ONLY
-	fsm = (fsm_handler_t*)malloc(sizeof(fsm_handler_t));
-	if(fsm == NULL)
-	{ 
-		FSM_ERR("ERROR: without resources\r\n");
-		return(FSM_NO_RESOURCES);
-	}
-#endif
-
 	memset(fsm, 0, sizeof(fsm_handler_t));
 	len = strlen(fsm_name);
 	if( len > (FSM_NAME_MAX_LENGTH-1) )
@@ -106,6 +137,129 @@ fsm_result_t fsm_create(fsm_handler_t *fsm, fsm_state_t *stateTable, void* initi
 	return(FSM_OK);
 }
 
+#if FSM_TABLE_ENABLE
+/**
+ * @brief		Cria uma Máquina de Estado a partir de uma tabela indexada
+ * @details		A tabela já foi validada por quem gerou o índice (gerador de bundles),
+ *				então não há verificação da tabela na criação
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		table tabela indexada, com todos os callbacks associados
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ */
+fsm_result_t fsm_create_table(fsm_handler_t *fsm, const fsm_table_t *table, char* fsm_name)
+{
+	uint16_t len;
+
+	FSM_DBG("fsm create table %s ", fsm_name);
+
+	if( (fsm==NULL) || (table==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( fsm_name==NULL )
+	{
+		FSM_ERR("ERROR: fsm name null\r\n");
+		return(FSM_NAME_NULL);
+	}
+
+	if( (table->initial >= table->number_states) || (table->callbacks[table->initial] == NULL) )
+	{
+		FSM_ERR("ERROR: initial state null\r\n");
+		return(FSM_FUNCTION_NULL);
+	}
+
+	memset(fsm, 0, sizeof(fsm_handler_t));
+	len = strlen(fsm_name);
+	if( len > (FSM_NAME_MAX_LENGTH-1) )
+	{
+		len = (FSM_NAME_MAX_LENGTH-1);
+	} 
+	memcpy(fsm->fsm_name, fsm_name, len);
+
+	fsm->table			= table;
+	fsm->stateIdx		= table->initial;
+	fsm->cb_state		= table->callbacks[table->initial];
+	fsm->eventID		= table->number_events;
+	fsm->number_events	= table->number_events;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Gera a tabela indexada de uma tabela de transição
+ * @details		A tabela é validada com fsm_checkStateTable e os estados recebem os
+ *				índices de fsm_state_list, os mesmos usados nos bundles
+ * @param		table recebe a tabela indexada
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state ponteiro para a função que será executada na primeira iteração da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @param		callbacks recebe os estados, indexados pelo índice do estado
+ * @param		max_states posições em callbacks
+ * @param		next recebe o índice denso estado x evento
+ * @param		max_next posições em next (estados x number_events)
+ * @retval		FSM_NO_RESOURCES caso callbacks ou next não comportem a tabela
+ */
+fsm_result_t fsm_table_compile(fsm_table_t *table, fsm_state_t *stateTable, void* initial_state, uint16_t number_events, void **callbacks, uint16_t max_states, uint16_t *next, uint32_t max_next)
+{
+	uint16_t number_states, row, initial;
+	uint32_t position;
+
+	FSM_DBG("fsm table compile ");
+
+	if( (table==NULL) || (stateTable==NULL) || (callbacks==NULL) || (next==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if(fsm_checkStateTable(stateTable, number_events) != FSM_OK)
+	{ 
+		FSM_ERR("ERROR: invalid state\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	number_states = fsm_state_list(stateTable, callbacks, max_states);
+	if( (number_states == FSM_STATE_INVALID) || (((uint32_t)number_states * number_events) > max_next) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	initial = fsm_state_index(callbacks, number_states, initial_state);
+	if( initial == FSM_STATE_INVALID )
+	{
+		FSM_ERR("ERROR: initial state not in table\r\n");
+		return(FSM_FUNCTION_NULL);
+	}
+
+	for( position=0; position<((uint32_t)number_states * number_events); position++ )
+	{
+		next[position] = FSM_STATE_INVALID;
+	}
+	for( row=0; stateTable[row].cb_state != NULL; row++ )
+	{
+		// eventID == number_events é aceito pela verificação, mas nunca é despachado
+		if( stateTable[row].eventID < number_events )
+		{
+			next[(uint32_t)fsm_state_index(callbacks, number_states, stateTable[row].cb_state) * number_events + stateTable[row].eventID] =
+				fsm_state_index(callbacks, number_states, stateTable[row].cb_next);
+		}
+	}
+
+	table->callbacks		= callbacks;
+	table->next				= next;
+	table->number_states	= number_states;
+	table->number_events	= number_events;
+	table->initial			= initial;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+#endif
+
 /**
  * @brief Destroy uma FSM
  * 
@@ -121,10 +275,17 @@ fsm_result_t fsm_destroy (fsm_handler_t *fsm)
 		return(FSM_NULL);
 	}
 
+#if FSM_PAYLOAD_ENABLE
+	fsm_payload_drop(&fsm->payload);
+	fsm_payload_drop(&fsm->delivered);
+#if FSM_DEFER_QUEUE > 0
+	while( fsm->defer_count > 0 )
+	{
+		fsm_payload_drop(&fsm->defer_payload[--fsm->defer_count]);
+	}
+#endif
+#endif
 	memset(fsm, 0, sizeof(fsm_handler_t));
-	#if FSM_STATIC_ONLY != 1
-	free(fsm);	
-	#endif
 
 	FSM_DBG("success\r\n");
 	return(FSM_OK);
@@ -133,14 +294,197 @@ fsm_result_t fsm_destroy (fsm_handler_t *fsm)
 /**
  * @brief Executa a máquina de estado
  * 
- * A cada chamada dessa função será executado um loop da máquina de estado
+ * A cada chamada dessa função será executado um loop da máquina de estado.
+ * Com FSM_EMIT_QUEUE, os eventos emitidos pelo callback com fsm_emit são
+ * despachados em seguida, em ordem, na mesma chamada; o evento retornado por
+ * um callback que emitiu eventos é despachado depois deles. Cada chamada
+ * despacha no máximo FSM_EMIT_QUEUE eventos emitidos: os demais continuam
+ * pendentes, na mesma ordem, para as próximas chamadas.
  * @param *fsm ponteiro para estrutura FSM
  */
 fsm_result_t fsm_engine(fsm_handler_t *fsm)
+{
+	fsm_result_t ret;
+#if FSM_EMIT_QUEUE > 0
+	fsm_result_t step;
+	uint16_t eventID;
+	uint16_t dispatched = 0;
+#endif
+
+	ret = fsm_step(fsm);
+
+#if FSM_EMIT_QUEUE > 0
+	while( (fsm != NULL) && (fsm->emit_count > 0) )
+	{
+		if( (ret == FSM_STATE_ERROR) || (ret == FSM_STATE_NULL) )
+		{
+			fsm->emit_count = 0;
+			break;
+		}
+
+		eventID			= fsm->emit_queue[fsm->emit_head];
+		fsm->emit_head	= (uint8_t)((fsm->emit_head + 1) % FSM_EMIT_QUEUE);
+		fsm->emit_count--;
+
+		// O evento retornado pelo callback segue os emitidos
+		if( fsm->eventID < fsm->number_events )
+		{
+			fsm->emit_queue[(fsm->emit_head + fsm->emit_count) % FSM_EMIT_QUEUE] = fsm->eventID;
+			fsm->emit_count++;
+		}
+		FSM_SEQ_BEGIN(fsm);
+		FSM_STORE(fsm->eventID, eventID);
+		FSM_SEQ_END(fsm);
+
+		// Callbacks que emitem a cada passo não prendem o laço principal: o próximo
+		// evento fica pendente e o restante na fila, para a próxima chamada
+		if( ++dispatched > FSM_EMIT_QUEUE )
+		{
+			break;
+		}
+
+		step = fsm_step(fsm);
+		if( (ret == FSM_NO_TRANSITION) || ((ret == FSM_OK) && (step != FSM_OK)) ||
+			(step == FSM_STATE_ERROR) || (step == FSM_STATE_NULL) )
+		{
+			ret = step;
+		}
+	}
+#endif
+
+	return(ret);
+}
+
+#if FSM_EMIT_QUEUE > 0
+/**
+ * @brief		Emite eventos para a FSM a partir do callback do estado
+ * @details		Os eventos entram na fila da instância e são despachados em ordem pelo
+ *				mesmo fsm_engine, antes do evento retornado pelo callback. Nenhum evento
+ *				é emitido caso algum seja inválido ou a fila não comporte todos. Durante
+ *				fsm_trace_replay os eventos são validados e descartados, pois o log já
+ *				os contém.
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		events eventos a emitir
+ * @param		count quantidade de eventos
+ * @retval		FSM_EVENT_ERROR caso algum evento não pertença à FSM
+ * @retval		FSM_NO_RESOURCES caso a fila não comporte os eventos (FSM_EMIT_QUEUE)
+ */
+fsm_result_t fsm_emit(fsm_handler_t *fsm, const uint16_t *events, uint8_t count)
+{
+	uint8_t index;
+
+	if( (fsm==NULL) || (events==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	for( index=0; index<count; index++ )
+	{
+		if( events[index] >= fsm->number_events )
+		{
+			FSM_ERR("ERROR: invalid event\r\n");
+			return(FSM_EVENT_ERROR);
+		}
+	}
+
+	if( fsm->emit_muted )
+	{
+		return(FSM_OK);
+	}
+
+	if( ((uint16_t)fsm->emit_count + count) > FSM_EMIT_QUEUE )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	for( index=0; index<count; index++ )
+	{
+		fsm->emit_queue[(fsm->emit_head + fsm->emit_count) % FSM_EMIT_QUEUE] = events[index];
+		fsm->emit_count++;
+	}
+
+	return(FSM_OK);
+}
+#endif
+
+#if FSM_DEFER_QUEUE > 0
+/**
+ * @brief		Associa uma tabela de eventos adiados à FSM
+ * @details		Um evento enviado a um estado que o adia é guardado na fila da instância,
+ *				sem transição e sem FSM_EVENT_ERROR. Após cada mudança de estado, o
+ *				primeiro evento guardado que o novo estado aceita volta a ser o evento
+ *				pendente, com o seu payload. Para os estados da tabela a verificação
+ *				compara apenas a máscara pré-calculada do novo estado com a dos eventos
+ *				guardados; para os ausentes, as transições do estado são percorridas a
+ *				cada mudança de estado com eventos guardados (uma linha do índice com
+ *				FSM_TABLE_ENABLE). Estados listados com defer 0 não adiam nada e evitam
+ *				essa busca. Preenche o campo accept de cada linha, então deve ser
+ *				chamada novamente se a tabela da FSM for trocada.
+ *				A tabela pode ser compartilhada por instâncias da mesma FSM. O fsm_engine
+ *				retorna FSM_OK ao guardar um evento e FSM_NO_RESOURCES caso a fila
+ *				esteja cheia (FSM_DEFER_QUEUE), e o evento é descartado.
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		deferTable eventos adiados por estado, terminada por cb_state NULL
+ *				(NULL desassocia a tabela; os eventos guardados permanecem)
+ * @retval		FSM_EVENT_ERROR caso um estado adie um evento maior que 31 ou fora do enum
+ * @retval		FSM_STT_ERROR caso a FSM use uma tabela compartilhada (fsm_swap_create)
+ */
+fsm_result_t fsm_defer_attach(fsm_handler_t *fsm, fsm_defer_t *deferTable)
+{
+	fsm_defer_t *entry;
+	fsm_mask_t events;
+
+	FSM_DBG("fsm defer attach ");
+
+	if( fsm==NULL )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+#if FSM_SWAP_ENABLE
+	// fsm_swap_enter troca a tabela sem aviso e as máscaras accept ficariam obsoletas
+	if( fsm->reader != NULL )
+	{
+		FSM_ERR("ERROR: shared table\r\n");
+		return(FSM_STT_ERROR);
+	}
+#endif
+
+	events = (fsm->number_events >= FSM_DEFER_EVENTS) ? ~(fsm_mask_t)0 : (FSM_EVENT_BIT(fsm->number_events) - 1u);
+	for( entry=deferTable; (entry != NULL) && (entry->cb_state != NULL); entry++ )
+	{
+		if( (entry->defer & ~events) != 0 )
+		{
+			FSM_ERR("ERROR: invalid deferred event\r\n");
+			return(FSM_EVENT_ERROR);
+		}
+		entry->accept = fsm_defer_accept(fsm, entry->cb_state);
+	}
+
+	fsm->defer_table = deferTable;
+	fsm->defer_state = fsm_defer_find(fsm, fsm->cb_state);
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+#endif
+
+/**
+ * @brief fsm_step
+ *
+ * Função privada que processa o evento pendente e executa o callback do estado
+ */
+static fsm_result_t fsm_step(fsm_handler_t *fsm)
 {
 	//fsm_state_t *state;
-	uint16_t stateID;
+	uint16_t stateID, eventID;
 	fsm_result_t ret = FSM_OK;
+#if FSM_DEFER_QUEUE > 0
+	fsm_result_t parked;
+#endif
 
 	FSM_DBG("fms engine %s ", fsm->fsm_name);
 
@@ -150,44 +494,410 @@ fsm_result_t fsm_engine(fsm_handler_t *fsm)
 		return(FSM_NULL);
 	}
 
+#if FSM_DEFER_QUEUE > 0
+	// Um evento adiado pelo estado atual sai de fsm->eventID e não gera transição
+	parked = fsm_defer_park(fsm);
+#endif
+
+#if FSM_SWAP_ENABLE
+	// Eventos que uma nova versão da tabela compartilhada acrescentou ficam acima do
+	// enum da versão em uso pela instância: migra antes de conferir, pois só valores
+	// abaixo do número de eventos da versão publicada são eventos
+	if( (fsm->reader != NULL) && (fsm->eventID > fsm->number_events) )
+	{
+		if( fsm_swap_enter(fsm) != FSM_OK )
+		{
+			FSM_ERR("ERROR: invalid state\r\n");
+			return(FSM_STATE_ERROR);
+		}
+		fsm_swap_exit(fsm->reader);
+	}
+#endif
+
 	if( fsm->eventID < fsm->number_events )
 	{
-		for( stateID=0; fsm->stateTable[stateID].cb_state != NULL; stateID++ )
+#if FSM_PAYLOAD_ENABLE
+		// O payload acompanha o evento até o fim do callback do novo estado
+		fsm->delivered	= fsm->payload;
+		fsm->payload	= NULL;
+#endif
+#if FSM_TRACE_ENABLE
+		if( fsm->trace != NULL )
 		{
-			//state = fsm->stateTable[stateID];
-			if( (fsm->stateTable[stateID].cb_state == fsm->cb_state ) &&
-				(fsm->stateTable[stateID].eventID  == fsm->eventID  ) )
-			{ 
-				fsm->cb_state = fsm->stateTable[stateID].cb_next;
-				fsm->eventID  = fsm->number_events;
+			fsm_trace_record(fsm->trace, fsm->eventID);
+		}
+#endif
+		FSM_SEQ_BEGIN(fsm);
+#if FSM_TABLE_ENABLE
+		if( fsm->table != NULL )
+		{
+#if FSM_SWAP_ENABLE
+			// Atualiza fsm->table para a versão publicada e protege a leitura dela
+			if( (fsm->reader != NULL) && (fsm_swap_enter(fsm) != FSM_OK) )
+			{
+				ret = FSM_STATE_ERROR;
+			}
+			else
+#endif
+			{
+				stateID = (fsm->eventID < fsm->table->number_events) ?
+						  fsm->table->next[(uint32_t)fsm->stateIdx * fsm->table->number_events + fsm->eventID] : FSM_STATE_INVALID;
+				if( stateID == FSM_STATE_INVALID )
+				{
+					ret = FSM_EVENT_ERROR;
+				}
+				else if( stateID >= fsm->table->number_states )
+				{
+					ret = FSM_STATE_ERROR;
+				}
+				else
+				{
+					fsm->stateIdx = stateID;
+					FSM_STORE(fsm->cb_state, fsm->table->callbacks[stateID]);
+					FSM_STORE(fsm->eventID, fsm->number_events);
+				}
+#if FSM_SWAP_ENABLE
+				if( fsm->reader != NULL )
+				{
+					fsm_swap_exit(fsm->reader);
+				}
+#endif
+			}
+		}
+		else
+#endif
+		{
+			for( stateID=0; fsm->stateTable[stateID].cb_state != NULL; stateID++ )
+			{
+				//state = fsm->stateTable[stateID];
+				if( (fsm->stateTable[stateID].cb_state == fsm->cb_state ) &&
+					(fsm->stateTable[stateID].eventID  == fsm->eventID  ) )
+				{ 
+					FSM_STORE(fsm->cb_state, fsm->stateTable[stateID].cb_next);
+					FSM_STORE(fsm->eventID, fsm->number_events);
 
-				break;
+					break;
+				}
 			}
+
+			if( fsm->stateTable[stateID].cb_state == NULL )
+			{ 
+				ret = FSM_EVENT_ERROR;
+			}
+		}
+#if FSM_SEQLOCK_ENABLE
+		if( ret == FSM_OK )
+		{
+			FSM_STORE(fsm->transitions, fsm->transitions + 1);
+		}
+#endif
+		FSM_SEQ_END(fsm);
+
+#if FSM_DEFER_QUEUE > 0
+		if( (ret == FSM_OK) && (fsm->defer_table != NULL) )
+		{
+			fsm->defer_state = fsm_defer_find(fsm, fsm->cb_state);
+			fsm->defer_flags |= FSM_DEFER_CHANGED;
 		}
+#endif
 
-		if( fsm->stateTable[stateID].cb_state == NULL )
-		{ 
-			ret = FSM_EVENT_ERROR;
+#if FSM_PAYLOAD_ENABLE
+		if( ret != FSM_OK )
+		{
+			fsm_payload_drop(&fsm->delivered);
+		}
+#endif
+		if( ret == FSM_STATE_ERROR )
+		{
+			FSM_ERR("ERROR: invalid state\r\n");
+			return(FSM_STATE_ERROR);
 		}
 	}
 	else
 	{ 
 		ret = FSM_NO_TRANSITION;
 	}
+#if FSM_DEFER_QUEUE > 0
+	if( parked != FSM_NO_TRANSITION )
+	{
+		ret = parked;
+	}
+#endif
 
 	if( fsm->cb_state==NULL )
 	{     
+#if FSM_PAYLOAD_ENABLE
+		fsm_payload_drop(&fsm->delivered);
+#endif
 		FSM_ERR("ERROR: invalid state\r\n");
 		return(FSM_STATE_NULL);
 	}
 
 	uint16_t (*fn_ptr)(fsm_handler_t*) = (uint16_t(*)(fsm_handler_t*)) fsm->cb_state;
-	fsm->eventID = fn_ptr(fsm);
+	eventID = fn_ptr(fsm);
+#if FSM_PAYLOAD_ENABLE
+	// O evento retornado pelo callback não tem payload
+	fsm_payload_drop(&fsm->delivered);
+	fsm_payload_drop(&fsm->payload);
+#endif
+#if FSM_DEFER_QUEUE > 0
+	// Os eventos emitidos e o evento retornado têm precedência sobre os adiados
+	if( (eventID >= fsm->number_events)
+#if FSM_EMIT_QUEUE > 0
+		&& (fsm->emit_count == 0)
+#endif
+	  )
+	{
+		eventID = fsm_defer_recall(fsm);
+	}
+#endif
+
+	FSM_SEQ_BEGIN(fsm);
+	FSM_STORE(fsm->eventID, eventID);
+	FSM_SEQ_END(fsm);
 
 	FSM_DBG("success\r\n");
 	return(ret);
 }
 
+/**
+ * @brief		Executa a máquina de estado até não haver evento pendente
+ * @details		Chama fsm_engine ao menos uma vez e repete enquanto o callback do estado
+ *				retornar um evento, até esgotar o limite de passos ou de ticks. Substitui
+ *				fsm_engine no laço principal quando um evento dispara uma sequência de
+ *				transições, sem atrasar as demais FSMs além do orçamento.
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		budget limites da chamada; recebe os passos e ticks consumidos
+ * @retval		FSM_OK caso a FSM tenha ficado sem evento pendente
+ * @retval		FSM_BUDGET_EXHAUSTED caso o orçamento tenha acabado com evento pendente
+ * @retval		FSM_STATE_ERROR ou FSM_STATE_NULL caso o fsm_engine falhe
+ */
+fsm_result_t fsm_run(fsm_handler_t *fsm, fsm_budget_t *budget)
+{
+	fsm_result_t ret;
+	uint32_t start = 0;
+
+	if( (fsm==NULL) || (budget==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	budget->executed	= 0;
+	budget->elapsed		= 0;
+	if( budget->now != NULL )
+	{
+		start = budget->now();
+	}
+
+	for( ;; )
+	{
+		ret = fsm_engine(fsm);
+		budget->executed++;
+		if( budget->now != NULL )
+		{
+			budget->elapsed = budget->now() - start;
+		}
+
+		if( (ret == FSM_STATE_ERROR) || (ret == FSM_STATE_NULL) )
+		{
+			return(ret);
+		}
+		if( fsm->eventID >= fsm->number_events )
+		{
+			return(FSM_OK);
+		}
+		if( ((budget->steps != 0) && (budget->executed >= budget->steps)) ||
+			((budget->ticks != 0) && (budget->now != NULL) && (budget->elapsed >= budget->ticks)) )
+		{
+			return(FSM_BUDGET_EXHAUSTED);
+		}
+	}
+}
+
+/**
+ * @brief		Envia um evento para a FSM
+ * @details		Equivale a escrever fsm->eventID, mas também é seguro com leitores
+ *				concorrentes (FSM_SEQLOCK_ENABLE). Deve ser chamada pela thread que executa
+ *				o fsm_engine da FSM
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		eventID evento que será processado na próxima chamada do fsm_engine
+ * @retval		FSM_NO_RESOURCES caso o evento pendente tenha saído de defer_queue e não
+ *				caiba mais nela (FSM_DEFER_QUEUE): é descartado, e eventID é enviado
+ */
+fsm_result_t fsm_post(fsm_handler_t *fsm, uint16_t eventID)
+{
+	fsm_result_t ret = FSM_OK;
+
+	if(fsm==NULL)
+	{ 
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+#if FSM_SWAP_ENABLE
+	// O evento pode ser de uma versão mais nova que a da instância, inclusive igual ao
+	// número de eventos da versão em uso, que marca a ausência de evento: migra antes
+	if( (fsm->reader != NULL) && (eventID >= fsm->number_events) )
+	{
+		if( fsm_swap_enter(fsm) != FSM_OK )
+		{
+			FSM_ERR("ERROR: invalid state\r\n");
+			return(FSM_STATE_ERROR);
+		}
+		fsm_swap_exit(fsm->reader);
+	}
+#endif
+#if FSM_DEFER_QUEUE > 0
+	// Um evento retirado de defer_queue e ainda não despachado volta para a fila
+	ret = fsm_defer_unpark(fsm);
+#endif
+#if FSM_PAYLOAD_ENABLE
+	fsm_payload_drop(&fsm->payload);
+#endif
+	FSM_SEQ_BEGIN(fsm);
+	FSM_STORE(fsm->eventID, eventID);
+	FSM_SEQ_END(fsm);
+
+	return(ret);
+}
+
+#if FSM_PAYLOAD_ENABLE
+/**
+ * @brief		Envia um evento com payload para a FSM
+ * @details		A referência do buffer passa para a FSM: o callback do estado alcançado
+ *				o lê com fsm_payload e o fsm_engine o devolve ao pool ao final do
+ *				despacho. O callback que precisar do buffer depois disso chama
+ *				fsm_buffer_retain. Um evento pendente é substituído, como em fsm_post,
+ *				e o seu payload é devolvido.
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		envelope evento e payload (payload pode ser NULL)
+ */
+fsm_result_t fsm_post_envelope(fsm_handler_t *fsm, const fsm_envelope_t *envelope)
+{
+	fsm_result_t ret;
+
+	if( envelope==NULL )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	ret = fsm_post(fsm, envelope->eventID);
+	if( (ret == FSM_OK) || (ret == FSM_NO_RESOURCES) )
+	{
+		fsm->payload = envelope->payload;
+	}
+	return(ret);
+}
+
+/**
+ * @brief		Retorna o payload do evento em despacho
+ * @details		Válido apenas durante o callback do estado
+ * @param		fsm ponteiro para estrutura FSM
+ * @return		Buffer do evento, ou NULL caso o evento não tenha payload
+ */
+struct fsm_buffer* fsm_payload(const fsm_handler_t *fsm)
+{
+	return( (fsm != NULL) ? fsm->delivered : NULL );
+}
+#endif
+
+#if FSM_SEQLOCK_ENABLE
+/**
+ * @brief		Lê o estado de uma FSM executada por outra thread
+ * @details		Não bloqueia a thread que executa o fsm_engine: a leitura é repetida
+ *				enquanto houver uma alteração em andamento
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		status recebe estado, evento pendente e contador de transições consistentes
+ */
+fsm_result_t fsm_read_state(fsm_handler_t *fsm, fsm_status_t *status)
+{
+	uint32_t seq;
+
+	if( (fsm==NULL) || (status==NULL) )
+	{ 
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	do
+	{
+		seq = __atomic_load_n(&fsm->seq, __ATOMIC_ACQUIRE);
+		status->cb_state	= __atomic_load_n(&fsm->cb_state, __ATOMIC_ACQUIRE);
+		status->eventID		= __atomic_load_n(&fsm->eventID, __ATOMIC_ACQUIRE);
+		status->transitions	= __atomic_load_n(&fsm->transitions, __ATOMIC_ACQUIRE);
+	} while( ((seq & 1) != 0) || (seq != __atomic_load_n(&fsm->seq, __ATOMIC_RELAXED)) );
+
+	return(FSM_OK);
+}
+#endif
+
+/**
+ * @brief		Lista os estados de uma tabela de transição
+ * @details		Os estados recebem índices na ordem da primeira ocorrência na tabela,
+ *				lendo cada linha como estado atual e depois próximo estado. Os índices
+ *				dependem apenas da tabela, e não dos endereços dos callbacks, e podem ser
+ *				guardados no lugar dos ponteiros (hibernação, snapshots, tabelas compiladas).
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		states recebe os ponteiros dos estados, indexados pelo índice do estado
+ * @param		max_states quantidade de posições em states
+ * @return		Quantidade de estados, ou FSM_STATE_INVALID caso não caibam em states
+ */
+uint16_t fsm_state_list(fsm_state_t *stateTable, void **states, uint16_t max_states)
+{
+	uint16_t row, number_states = 0;
+	void *state;
+	uint8_t column;
+
+	if( (stateTable==NULL) || (states==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_STATE_INVALID);
+	}
+
+	for( row=0; stateTable[row].cb_state != NULL; row++ )
+	{
+		for( column=0; column<2; column++ )
+		{
+			state = (column == 0) ? stateTable[row].cb_state : stateTable[row].cb_next;
+			if( (state == NULL) || (fsm_state_index(states, number_states, state) != FSM_STATE_INVALID) )
+			{
+				continue;
+			}
+			if( number_states >= max_states )
+			{
+				FSM_ERR("ERROR: without resources\r\n");
+				return(FSM_STATE_INVALID);
+			}
+			states[number_states++] = state;
+		}
+	}
+
+	return(number_states);
+}
+
+/**
+ * @brief		Retorna o índice de um estado
+ * @param		states lista obtida com fsm_state_list
+ * @param		number_states quantidade de estados da lista
+ * @param		cb_state ponteiro para o callback do estado
+ * @return		Índice do estado, ou FSM_STATE_INVALID caso não pertença à lista
+ */
+uint16_t fsm_state_index(void **states, uint16_t number_states, void *cb_state)
+{
+	uint16_t index;
+
+	for( index=0; index<number_states; index++ )
+	{
+		if( states[index] == cb_state )
+		{
+			return(index);
+		}
+	}
+	return(FSM_STATE_INVALID);
+}
+
 /**
  * @brief fsm_checkStateTable
  * 
@@ -232,6 +942,231 @@ fsm_result_t fsm_checkStateTable(fsm_state_t *stateTable, uint16_t number_events
 	return(FSM_OK);
 }
 
+#if FSM_PAYLOAD_ENABLE
+/**
+ * @brief fsm_payload_drop
+ *
+ * Função privada que devolve a referência de um payload e limpa o campo
+ */
+static void fsm_payload_drop(struct fsm_buffer **payload)
+{
+	if( *payload != NULL )
+	{
+		fsm_buffer_release(*payload);
+		*payload = NULL;
+	}
+}
+#endif
+
+#if FSM_DEFER_QUEUE > 0
+/**
+ * @brief fsm_defer_find
+ *
+ * Função privada que retorna a linha da tabela de eventos adiados de um estado
+ */
+static fsm_defer_t* fsm_defer_find(fsm_handler_t *fsm, void *cb_state)
+{
+	fsm_defer_t *entry;
+
+	for( entry=fsm->defer_table; (entry != NULL) && (entry->cb_state != NULL); entry++ )
+	{
+		if( entry->cb_state == cb_state )
+		{
+			return(entry);
+		}
+	}
+	return(NULL);
+}
+
+/**
+ * @brief fsm_defer_accept
+ *
+ * Função privada que retorna a máscara dos eventos com transição a partir de um estado
+ */
+static fsm_mask_t fsm_defer_accept(fsm_handler_t *fsm, void *cb_state)
+{
+	fsm_mask_t accept = 0;
+	uint16_t index;
+#if FSM_TABLE_ENABLE
+	const uint16_t *next;
+	uint16_t state, events;
+
+	if( fsm->table != NULL )
+	{
+		// O estado atual já tem índice; os demais são localizados na tabela
+		state = (cb_state == fsm->cb_state) ? fsm->stateIdx :
+				fsm_state_index((void**)fsm->table->callbacks, fsm->table->number_states, cb_state);
+		if( state == FSM_STATE_INVALID )
+		{
+			return(0);
+		}
+		events	= (fsm->table->number_events < FSM_DEFER_EVENTS) ? fsm->table->number_events : FSM_DEFER_EVENTS;
+		next	= &fsm->table->next[(uint32_t)state * fsm->table->number_events];
+		for( index=0; index<events; index++ )
+		{
+			if( next[index] != FSM_STATE_INVALID )
+			{
+				accept |= FSM_EVENT_BIT(index);
+			}
+		}
+		return(accept);
+	}
+#endif
+
+	for( index=0; fsm->stateTable[index].cb_state != NULL; index++ )
+	{
+		if( (fsm->stateTable[index].cb_state == cb_state) && (fsm->stateTable[index].eventID < FSM_DEFER_EVENTS) )
+		{
+			accept |= FSM_EVENT_BIT(fsm->stateTable[index].eventID);
+		}
+	}
+	return(accept);
+}
+
+/**
+ * @brief fsm_defer_park
+ *
+ * Função privada que guarda em defer_queue o evento pendente adiado pelo estado atual
+ */
+static fsm_result_t fsm_defer_park(fsm_handler_t *fsm)
+{
+	fsm_result_t ret = FSM_OK;
+
+	fsm->defer_flags &= (uint8_t)~FSM_DEFER_RECALLED;
+
+	if( (fsm->defer_state == NULL) || (fsm->eventID >= FSM_DEFER_EVENTS) ||
+		((fsm->defer_state->defer & FSM_EVENT_BIT(fsm->eventID)) == 0) )
+	{
+		return(FSM_NO_TRANSITION);
+	}
+
+	if( fsm->defer_count < FSM_DEFER_QUEUE )
+	{
+		fsm->defer_queue[fsm->defer_count]		= fsm->eventID;
+#if FSM_PAYLOAD_ENABLE
+		fsm->defer_payload[fsm->defer_count]	= fsm->payload;
+		fsm->payload							= NULL;
+#endif
+		fsm->defer_count++;
+		fsm->parked |= FSM_EVENT_BIT(fsm->eventID);
+	}
+	else
+	{
+		// Fila cheia: o evento é descartado
+#if FSM_PAYLOAD_ENABLE
+		fsm_payload_drop(&fsm->payload);
+#endif
+		FSM_ERR("ERROR: without resources\r\n");
+		ret = FSM_NO_RESOURCES;
+	}
+
+	FSM_SEQ_BEGIN(fsm);
+	FSM_STORE(fsm->eventID, fsm->number_events);
+	FSM_SEQ_END(fsm);
+
+	return(ret);
+}
+
+/**
+ * @brief fsm_defer_unpark
+ *
+ * Função privada que devolve ao início de defer_queue o evento pendente retirado dela;
+ * com a fila cheia o evento é descartado e retorna FSM_NO_RESOURCES, como no adiamento
+ */
+static fsm_result_t fsm_defer_unpark(fsm_handler_t *fsm)
+{
+	uint8_t index;
+
+	if( ((fsm->defer_flags & FSM_DEFER_RECALLED) == 0) || (fsm->eventID >= FSM_DEFER_EVENTS) )
+	{
+		return(FSM_OK);
+	}
+	fsm->defer_flags &= (uint8_t)~FSM_DEFER_RECALLED;
+
+	if( fsm->defer_count >= FSM_DEFER_QUEUE )
+	{
+		// Fila cheia: o evento é descartado
+#if FSM_PAYLOAD_ENABLE
+		fsm_payload_drop(&fsm->payload);
+#endif
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	for( index=fsm->defer_count; index>0; index-- )
+	{
+		fsm->defer_queue[index]		= fsm->defer_queue[index-1];
+#if FSM_PAYLOAD_ENABLE
+		fsm->defer_payload[index]	= fsm->defer_payload[index-1];
+#endif
+	}
+	fsm->defer_queue[0]		= fsm->eventID;
+#if FSM_PAYLOAD_ENABLE
+	fsm->defer_payload[0]	= fsm->payload;
+	fsm->payload			= NULL;
+#endif
+	fsm->defer_count++;
+	fsm->parked |= FSM_EVENT_BIT(fsm->eventID);
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_defer_recall
+ *
+ * Função privada que retira de defer_queue o primeiro evento aceito pelo novo estado
+ */
+static uint16_t fsm_defer_recall(fsm_handler_t *fsm)
+{
+	fsm_mask_t accept;
+	uint16_t eventID;
+	uint8_t index;
+
+	if( ((fsm->defer_flags & FSM_DEFER_CHANGED) == 0) || (fsm->parked == 0) )
+	{
+		return(fsm->number_events);
+	}
+	fsm->defer_flags &= (uint8_t)~FSM_DEFER_CHANGED;
+
+	// Eventos que o novo estado também adia continuam guardados
+	accept = (fsm->defer_state != NULL) ? (fsm->defer_state->accept & ~fsm->defer_state->defer) :
+										  fsm_defer_accept(fsm, fsm->cb_state);
+	if( (fsm->parked & accept) == 0 )
+	{
+		return(fsm->number_events);
+	}
+
+	for( index=0; index<fsm->defer_count; index++ )
+	{
+		if( (FSM_EVENT_BIT(fsm->defer_queue[index]) & accept) != 0 )
+		{
+			break;
+		}
+	}
+
+	eventID = fsm->defer_queue[index];
+#if FSM_PAYLOAD_ENABLE
+	fsm->payload = fsm->defer_payload[index];
+#endif
+	fsm->defer_count--;
+	fsm->parked = 0;
+	for( ; index<fsm->defer_count; index++ )
+	{
+		fsm->defer_queue[index]		= fsm->defer_queue[index+1];
+#if FSM_PAYLOAD_ENABLE
+		fsm->defer_payload[index]	= fsm->defer_payload[index+1];
+#endif
+	}
+	for( index=0; index<fsm->defer_count; index++ )
+	{
+		fsm->parked |= FSM_EVENT_BIT(fsm->defer_queue[index]);
+	}
+
+	fsm->defer_flags |= FSM_DEFER_RECALLED;
+	return(eventID);
+}
+#endif
+
 /*
 fsm_state_t* fsm_getStatePtrFromStateIdTable(uint16_t stateID, fsm_state_t *stateTable, uint16_t limit)
 {
@@ -26,10 +26,6 @@
 /**
  * Macros Públicas
  */
-#if FSM_STATIC_ONLY == 0
-#	include <stdlib.h>
-#endif
-
 #if FSM_DEBUG_LEVEL > 0
 #	include <stdio.h>
 #	include <stdarg.h>
@@ -47,6 +43,17 @@
 #	define FSM_ERR(fmt, ...)
 #endif
 
+#define FSM_STATE_INVALID	0xFFFF	/**< Índice de estado inexistente (ver fsm_state_index) */
+
+/**
+ * @brief Escrita de um campo da FSM que pode ser lido por fsm_read_state
+ */
+#if FSM_SEQLOCK_ENABLE
+#	define FSM_STORE(field, value)	__atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+#else
+#	define FSM_STORE(field, value)	((field) = (value))
+#endif
+
 
 
 /**
@@ -66,6 +73,54 @@ typedef struct fsm_state
 	void*		cb_next;
 } fsm_state_t;
 
+#if FSM_TABLE_ENABLE
+/**
+ * @brief FSM Indexed Table
+ * 
+ * Tabela de transição pré-indexada: estados e eventos são índices, e o
+ * próximo estado de cada par é lido diretamente de um vetor denso. Os vetores
+ * podem apontar para um bundle mapeado em memória (fsm_bundle.h)
+ */
+typedef struct fsm_table
+{
+	void* const*	callbacks;		/**< Callback de cada estado, indexado pelo índice do estado */
+	const uint16_t*	next;			/**< next[estado * number_events + evento], FSM_STATE_INVALID sem transição */
+	uint16_t		number_states;	/**< Quantidade de estados */
+	uint16_t		number_events;	/**< Quantidade de eventos */
+	uint16_t		initial;		/**< Índice do estado inicial */
+} fsm_table_t;
+#endif
+
+#if FSM_DEFER_QUEUE > 0
+/**
+ * @brief Conjunto de eventos, um bit por evento (eventos 0 a 31)
+ */
+typedef uint32_t fsm_mask_t;
+
+#define FSM_EVENT_BIT(ev)	((fsm_mask_t)1u << (ev))
+
+/**
+ * @brief FSM Deferral Table
+ * 
+ * Eventos adiados por estado, terminada por cb_state NULL. O campo accept é
+ * preenchido por fsm_defer_attach com os eventos que têm transição a partir
+ * do estado. Estados ausentes da tabela não adiam eventos; listá-los com
+ * defer 0 pré-calcula também a máscara usada para devolver eventos a eles.
+ * @code
+ * static fsm_defer_t deferTable[] = {
+ *     { (void*)st_busy,	FSM_EVENT_BIT(EV_REQUEST),	0 },
+ *     { NULL,				0,							0 }
+ * };
+ * @endcode
+ */
+typedef struct fsm_defer
+{
+	void*		cb_state;	/**< Estado */
+	fsm_mask_t	defer;		/**< Eventos adiados no estado */
+	fsm_mask_t	accept;		/**< Eventos aceitos no estado (preenchido por fsm_defer_attach) */
+} fsm_defer_t;
+#endif
+
 /**
  * @brief FSM Object
  * 
@@ -80,8 +135,87 @@ typedef struct fsm_handler
 	uint16_t		eventID;						/**< Id de evento aguardando para ser processado */
 	uint16_t		number_events;					/**< Quantidade de eventos válidos para a FSM */
 	fsm_state_t*	stateTable;						/**< Ponteiro para a tabela com as regras de transição de estado da FSM */
+#if FSM_TABLE_ENABLE
+	const fsm_table_t*	table;						/**< Tabela indexada (NULL para FSMs criadas com stateTable) */
+	uint16_t		stateIdx;						/**< Índice do estado atual na tabela indexada */
+#endif
+#if FSM_SWAP_ENABLE
+	struct fsm_swap_reader*	reader;				/**< Leitor da tabela compartilhada (NULL para tabela fixa) */
+	uint32_t		generation;						/**< Geração da tabela compartilhada em uso */
+#endif
+#if FSM_SEQLOCK_ENABLE
+	uint32_t		seq;							/**< Contador do seqlock: ímpar durante alterações */
+	uint32_t		transitions;					/**< Transições efetuadas */
+#endif
+#if FSM_TRACE_ENABLE
+	struct fsm_trace*	trace;					/**< Gravador de eventos associado à FSM (NULL quando inativo) */
+#endif
+#if FSM_PAYLOAD_ENABLE
+	struct fsm_buffer*	payload;				/**< Payload do evento pendente (NULL sem payload) */
+	struct fsm_buffer*	delivered;				/**< Payload do evento em despacho, visível ao callback */
+#endif
+#if FSM_EMIT_QUEUE > 0
+	uint16_t		emit_queue[FSM_EMIT_QUEUE];		/**< Eventos emitidos aguardando despacho */
+	uint8_t			emit_head;						/**< Primeiro evento emitido */
+	uint8_t			emit_count;						/**< Eventos emitidos na fila */
+	uint8_t			emit_muted;						/**< Descarta os eventos emitidos (fsm_trace_replay) */
+#endif
+#if FSM_DEFER_QUEUE > 0
+	fsm_defer_t*	defer_table;					/**< Eventos adiados por estado (NULL sem adiamento) */
+	fsm_defer_t*	defer_state;					/**< Linha de defer_table do estado atual (NULL se ausente) */
+	fsm_mask_t		parked;							/**< Eventos presentes em defer_queue */
+	uint16_t		defer_queue[FSM_DEFER_QUEUE];	/**< Eventos adiados, em ordem de chegada */
+#if FSM_PAYLOAD_ENABLE
+	struct fsm_buffer*	defer_payload[FSM_DEFER_QUEUE];	/**< Payloads dos eventos adiados */
+#endif
+	uint8_t			defer_count;					/**< Eventos adiados */
+	uint8_t			defer_flags;					/**< Mudança de estado pendente de verificação e origem do evento pendente */
+#endif
 } fsm_handler_t;
 
+#if FSM_PAYLOAD_ENABLE
+/**
+ * @brief FSM Event Envelope
+ * 
+ * Evento com payload opcional. A referência do buffer passa para a FSM em
+ * fsm_post_envelope.
+ */
+typedef struct fsm_envelope
+{
+	uint16_t			eventID;	/**< Evento */
+	struct fsm_buffer*	payload;	/**< Buffer de um fsm_buffer_pool_t (pode ser NULL) */
+} fsm_envelope_t;
+#endif
+
+#if FSM_SEQLOCK_ENABLE
+/**
+ * @brief FSM Status
+ * 
+ * Leitura consistente do estado de uma FSM, obtida com fsm_read_state
+ */
+typedef struct fsm_status
+{
+	void*		cb_state;		/**< Estado atual */
+	uint16_t	eventID;		/**< Evento pendente */
+	uint32_t	transitions;	/**< Transições efetuadas */
+} fsm_status_t;
+#endif
+
+/**
+ * @brief FSM Run Budget
+ * 
+ * Limites de uma chamada de fsm_run e quanto dela foi consumido. Limites com
+ * valor zero não são aplicados.
+ */
+typedef struct fsm_budget
+{
+	uint32_t	steps;			/**< Máximo de passos do fsm_engine */
+	uint32_t	ticks;			/**< Máximo de ticks de now (ciclos, microssegundos...) */
+	uint32_t	(*now)(void);	/**< Relógio dos ticks, ex. DWT->CYCCNT ou HAL_GetTick (NULL sem limite de tempo) */
+	uint32_t	executed;		/**< Passos executados na última chamada */
+	uint32_t	elapsed;		/**< Ticks consumidos na última chamada */
+} fsm_budget_t;
+
 /**
  * @brief FSM Returns
  * 
@@ -100,6 +234,8 @@ typedef enum fsm_result
 	FSM_EVENT_ERROR,
 	FSM_NO_RESOURCES,
 	FSM_NO_TRANSITION,
+	FSM_FORMAT_ERROR,	/**< Dados serializados inválidos ou de versão incompatível */
+	FSM_BUDGET_EXHAUSTED,	/**< fsm_run interrompido pelo orçamento com evento pendente */
 } fsm_result_t;
 
 /**
@@ -108,6 +244,28 @@ typedef enum fsm_result
 fsm_result_t fsm_create	(fsm_handler_t *fsm, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
 fsm_result_t fsm_destroy(fsm_handler_t *fsm);
 fsm_result_t fsm_engine	(fsm_handler_t *fsm);
+fsm_result_t fsm_run	(fsm_handler_t *fsm, fsm_budget_t *budget);
+fsm_result_t fsm_post	(fsm_handler_t *fsm, uint16_t eventID);
+#if FSM_SEQLOCK_ENABLE
+fsm_result_t fsm_read_state(fsm_handler_t *fsm, fsm_status_t *status);
+#endif
+#if FSM_EMIT_QUEUE > 0
+fsm_result_t fsm_emit	(fsm_handler_t *fsm, const uint16_t *events, uint8_t count);
+#endif
+#if FSM_DEFER_QUEUE > 0
+fsm_result_t fsm_defer_attach(fsm_handler_t *fsm, fsm_defer_t *deferTable);
+#endif
+#if FSM_PAYLOAD_ENABLE
+fsm_result_t		fsm_post_envelope	(fsm_handler_t *fsm, const fsm_envelope_t *envelope);
+struct fsm_buffer*	fsm_payload			(const fsm_handler_t *fsm);
+#endif
+#if FSM_TABLE_ENABLE
+fsm_result_t fsm_create_table	(fsm_handler_t *fsm, const fsm_table_t *table, char* fsm_name);
+fsm_result_t fsm_table_compile	(fsm_table_t *table, fsm_state_t *stateTable, void* initial_state, uint16_t number_events, void **callbacks, uint16_t max_states, uint16_t *next, uint32_t max_next);
+#endif
+
+uint16_t	 fsm_state_list	(fsm_state_t *stateTable, void **states, uint16_t max_states);
+uint16_t	 fsm_state_index(void **states, uint16_t number_states, void *cb_state);
 
 /**
  * @}
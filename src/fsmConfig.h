@@ -26,31 +26,158 @@
  * 1 = Habilita a geração de alertas de Erro
  * 2 = Habilita a geração de todos os alertas
  */
-#define FSM_DEBUG_LEVEL 0
+#ifndef FSM_DEBUG_LEVEL
+#	define FSM_DEBUG_LEVEL 0
+#endif
 
 /**
  * @brief Configuração do modo de alocação de memória
  * 
- * Configura se a estrutura FSM será alocada estática ou dinamicamente
+ * Configura se a estrutura FSM será alocada estática ou dinamicamente. No modo
+ * dinâmico as instâncias vêm de um pool de tamanho fixo (fsm_pool.h), sobre uma
+ * área fornecida pela aplicação ou sobre páginas obtidas com mmap no host, sem
+ * passar pelo heap
  * @code
  * #define FSM_STATIC_ONLY 1
- * FSM fsm;
+ * fsm_handler_t fsm;
  * fsm_create(&fsm, stateTable, (void*)fnInit, "StateMachine", EV_LIMIT);
  * @endcode
  * Or
  * @code
  * #define FSM_STATIC_ONLY 0
- * FSM *fsm;
- * fsm_create(fsm, stateTable, (void*)fnInit, "StateMachine", EV_LIMIT);
+ * static uint8_t arena[FSM_POOL_ARENA_SIZE(8)];
+ * fsm_pool_t pool;
+ * fsm_handler_t *fsm;
+ * fsm_pool_init(&pool, arena, sizeof(arena));
+ * fsm_pool_create(&pool, &fsm, stateTable, (void*)fnInit, "StateMachine", EV_LIMIT);
  * @endcode
  */
-#define FSM_STATIC_ONLY 1
+#ifndef FSM_STATIC_ONLY
+#	define FSM_STATIC_ONLY 1
+#endif
 
 /**
  * @brief Configura o tamanho máximo da string que identifica a FSM
  *
  */
-#define FSM_NAME_MAX_LENGTH 16
+#ifndef FSM_NAME_MAX_LENGTH
+#	define FSM_NAME_MAX_LENGTH 16
+#endif
+
+/**
+ * @brief Configuração do gravador de eventos
+ *
+ * Habilita a captura de todos os eventos entregues à FSM, com o instante em
+ * que foram processados, para reprodução posterior em um host
+ * @see fsm_trace.h
+ *
+ * 0 = Desabilita a gravação de eventos
+ * 1 = Habilita a gravação de eventos
+ */
+#ifndef FSM_TRACE_ENABLE
+#	define FSM_TRACE_ENABLE 0
+#endif
+
+/**
+ * @brief Configuração das tabelas indexadas
+ *
+ * Habilita FSMs criadas a partir de um fsm_table_t (tabelas carregadas de um
+ * bundle binário), em que o fsm_engine encontra a transição com um único
+ * acesso ao índice denso estado x evento, em vez de percorrer a tabela
+ * @see fsm_bundle.h
+ *
+ * 0 = Desabilita as tabelas indexadas
+ * 1 = Habilita as tabelas indexadas
+ */
+#ifndef FSM_TABLE_ENABLE
+#	define FSM_TABLE_ENABLE 0
+#endif
+
+/**
+ * @brief Configuração da troca de tabelas em execução
+ *
+ * Habilita a publicação de novas tabelas indexadas para FSMs em execução,
+ * sem pausar o fsm_engine e sem locks no caminho de despacho. Requer
+ * FSM_TABLE_ENABLE 1
+ * @see fsm_swap.h
+ *
+ * 0 = Desabilita a troca de tabelas
+ * 1 = Habilita a troca de tabelas
+ */
+#ifndef FSM_SWAP_ENABLE
+#	define FSM_SWAP_ENABLE 0
+#endif
+
+#if FSM_SWAP_ENABLE && !FSM_TABLE_ENABLE
+#	error "FSM_SWAP_ENABLE requer FSM_TABLE_ENABLE"
+#endif
+
+/**
+ * @brief Configuração da leitura concorrente do estado
+ *
+ * Protege com um seqlock a parte do fsm_engine que altera o estado, para que
+ * outras threads obtenham com fsm_read_state uma leitura consistente de
+ * estado, evento pendente e contador de transições sem bloquear a thread que
+ * executa a FSM. Nesse modo a thread dona envia eventos com fsm_post
+ *
+ * 0 = Desabilita o seqlock
+ * 1 = Habilita o seqlock
+ */
+#ifndef FSM_SEQLOCK_ENABLE
+#	define FSM_SEQLOCK_ENABLE 0
+#endif
+
+/**
+ * @brief Configuração dos payloads de eventos
+ *
+ * Permite que um evento carregue um buffer de um pool com contagem de
+ * referências (fsm_post_envelope). O callback do estado recebe o buffer sem
+ * cópia, com fsm_payload, e o fsm_engine o devolve depois do despacho
+ * @see fsm_buffer.h
+ *
+ * 0 = Desabilita os payloads
+ * 1 = Habilita os payloads
+ */
+#ifndef FSM_PAYLOAD_ENABLE
+#	define FSM_PAYLOAD_ENABLE 0
+#endif
+
+/**
+ * @brief Configuração da fila de eventos emitidos
+ *
+ * Quantidade de eventos que um callback pode emitir com fsm_emit, além do
+ * evento retornado. O fsm_engine despacha os eventos emitidos em ordem na
+ * mesma chamada, sem estados intermediários
+ *
+ * 0 = Desabilita fsm_emit
+ * 1 a 255 = Posições da fila de cada instância
+ */
+#ifndef FSM_EMIT_QUEUE
+#	define FSM_EMIT_QUEUE 0
+#endif
+
+#if FSM_EMIT_QUEUE > 255
+#	error "FSM_EMIT_QUEUE deve ser no máximo 255"
+#endif
+
+/**
+ * @brief Configuração dos eventos adiados
+ *
+ * Quantidade de eventos que cada instância guarda quando chegam em um estado
+ * que os adia (fsm_defer_attach). Os eventos guardados são devolvidos, em
+ * ordem, quando a FSM muda para um estado que os aceita. Apenas eventos com
+ * identificador menor que 32 podem ser adiados
+ *
+ * 0 = Desabilita o adiamento de eventos
+ * 1 a 255 = Posições da fila de cada instância
+ */
+#ifndef FSM_DEFER_QUEUE
+#	define FSM_DEFER_QUEUE 0
+#endif
+
+#if FSM_DEFER_QUEUE > 255
+#	error "FSM_DEFER_QUEUE deve ser no máximo 255"
+#endif
 
 /**
  * @}
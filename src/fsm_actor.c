@@ -0,0 +1,586 @@
+/**
+ * @file	fsm_actor.c
+ * @brief	Execução de instâncias da Finite State Machine como atores
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * A deque segue Chase-Lev, na formulação de Lê et al. (2013), com operações
+ * sequencialmente consistentes no lugar das barreiras. A caixa de mensagens
+ * é a fila limitada de Vyukov com vários produtores e um consumidor.
+ *
+ * O campo scheduled garante que o ator esteja em no máximo uma fila: quem o
+ * troca de zero para um agenda o ator. Ao final de uma execução o worker
+ * zera o campo e verifica novamente a próxima célula da caixa; a escrita na
+ * caixa e a troca do campo pelo produtor também são sequencialmente
+ * consistentes, então um evento nunca fica na caixa sem que o ator esteja
+ * agendado. Um agendamento a mais apenas executa o ator sem eventos.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_actor.h"
+#include "string.h"
+
+#if FSM_ACTOR_ENABLE
+
+#include <time.h>
+
+/**
+ * @defgroup fsm_actor_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static void*		fsm_actor_worker	(void *arg);
+static void			fsm_actor_run		(fsm_actor_worker_t *worker, fsm_actor_t *actor);
+static uint8_t		fsm_actor_ready		(fsm_actor_t *actor);
+static uint8_t		fsm_actor_receive	(fsm_actor_t *actor, uint16_t *eventID);
+static void			fsm_actor_schedule	(fsm_actor_t *actor);
+static void			fsm_actor_inject	(fsm_actor_runtime_t *runtime, fsm_actor_t *actor);
+static fsm_actor_t*	fsm_actor_injected	(fsm_actor_runtime_t *runtime);
+static uint8_t		fsm_actor_push		(fsm_actor_worker_t *worker, fsm_actor_t *actor);
+static fsm_actor_t*	fsm_actor_pop		(fsm_actor_worker_t *worker);
+static fsm_actor_t*	fsm_actor_steal		(fsm_actor_worker_t *victim);
+
+/**
+ * Variáveis privadas
+ */
+static __thread fsm_actor_worker_t *fsm_actor_current;	/**< Worker da thread atual (NULL fora do runtime) */
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa o runtime de atores
+ * @param		runtime ponteiro para estrutura do runtime
+ * @param		workers vetor com number_workers workers
+ * @param		number_workers quantidade de threads
+ * @param		slots vetor com number_workers * deque_capacity posições para as deques
+ * @param		deque_capacity posições de cada deque (potência de 2); atores que não
+ *				cabem na deque vão para a fila de injeção
+ * @param		budget eventos processados por execução de um ator
+ */
+fsm_result_t fsm_actor_init(fsm_actor_runtime_t *runtime, fsm_actor_worker_t *workers, uint16_t number_workers, fsm_actor_t **slots, uint32_t deque_capacity, uint32_t budget)
+{
+	uint16_t index;
+
+	FSM_DBG("fsm actor init ");
+
+	if( (runtime==NULL) || (workers==NULL) || (slots==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (number_workers == 0) || (budget == 0) || (deque_capacity == 0) || ((deque_capacity & (deque_capacity - 1)) != 0) )
+	{
+		FSM_ERR("ERROR: invalid size\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(runtime, 0, sizeof(fsm_actor_runtime_t));
+	memset(workers, 0, number_workers * sizeof(fsm_actor_worker_t));
+	for( index=0; index<number_workers; index++ )
+	{
+		workers[index].runtime	= runtime;
+		workers[index].slots	= &slots[(size_t)index * deque_capacity];
+		workers[index].mask		= deque_capacity - 1;
+		workers[index].seed		= (uint32_t)index * 2654435761u + 1u;
+	}
+
+	runtime->workers		= workers;
+	runtime->number_workers	= number_workers;
+	runtime->budget			= budget;
+	if( (pthread_mutex_init(&runtime->lock, NULL) != 0) || (pthread_cond_init(&runtime->wake, NULL) != 0) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Inicia as threads dos workers
+ * @details		Eventos enviados antes do início são processados assim que os workers
+ *				começam
+ * @param		runtime ponteiro para estrutura do runtime
+ * @retval		FSM_NO_RESOURCES caso alguma thread não possa ser criada
+ */
+fsm_result_t fsm_actor_start(fsm_actor_runtime_t *runtime)
+{
+	uint16_t index;
+
+	if( runtime==NULL )
+	{
+		FSM_ERR("ERROR: runtime null\r\n");
+		return(FSM_NULL);
+	}
+
+	__atomic_store_n(&runtime->running, 1, __ATOMIC_RELEASE);
+	for( index=0; index<runtime->number_workers; index++ )
+	{
+		if( pthread_create(&runtime->workers[index].thread, NULL, fsm_actor_worker, &runtime->workers[index]) != 0 )
+		{
+			runtime->number_workers = index;
+			fsm_actor_stop(runtime);
+			FSM_ERR("ERROR: without resources\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Encerra as threads dos workers
+ * @details		Cada worker termina a execução em andamento; os atores ainda agendados
+ *				permanecem nas filas e voltam a ser executados em um novo fsm_actor_start
+ * @param		runtime ponteiro para estrutura do runtime
+ */
+fsm_result_t fsm_actor_stop(fsm_actor_runtime_t *runtime)
+{
+	uint16_t index;
+
+	if( runtime==NULL )
+	{
+		FSM_ERR("ERROR: runtime null\r\n");
+		return(FSM_NULL);
+	}
+
+	pthread_mutex_lock(&runtime->lock);
+	__atomic_store_n(&runtime->running, 0, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&runtime->wake);
+	pthread_mutex_unlock(&runtime->lock);
+
+	for( index=0; index<runtime->number_workers; index++ )
+	{
+		pthread_join(runtime->workers[index].thread, NULL);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Cria um ator
+ * @details		O ator não pode ser destruído enquanto o runtime estiver em execução
+ * @param		actor ponteiro para estrutura do ator
+ * @param		runtime runtime que executará o ator
+ * @param		cells caixa de mensagens com capacity posições
+ * @param		capacity eventos aguardando na caixa (potência de 2)
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state ponteiro para a função do estado inicial
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ */
+fsm_result_t fsm_actor_create(fsm_actor_t *actor, fsm_actor_runtime_t *runtime, fsm_actor_cell_t *cells, uint32_t capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events)
+{
+	fsm_result_t ret;
+	uint32_t index;
+
+	if( (actor==NULL) || (runtime==NULL) || (cells==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (capacity < 2) || ((capacity & (capacity - 1)) != 0) )
+	{
+		FSM_ERR("ERROR: invalid size\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	ret = fsm_create(&actor->fsm, stateTable, initial_state, fsm_name, number_events);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	for( index=0; index<capacity; index++ )
+	{
+		cells[index].sequence	= index;
+		cells[index].eventID	= number_events;
+	}
+	actor->runtime		= runtime;
+	actor->next			= NULL;
+	actor->cells		= cells;
+	actor->mask			= capacity - 1;
+	actor->head			= 0;
+	actor->tail			= 0;
+	actor->scheduled	= 0;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Envia um evento para um ator
+ * @details		Pode ser chamada por qualquer thread, inclusive pelos callbacks de
+ *				outros atores. Os eventos de um mesmo produtor são processados na
+ *				ordem de envio.
+ * @param		actor ponteiro para estrutura do ator
+ * @param		eventID evento
+ * @retval		FSM_NO_RESOURCES caso a caixa de mensagens esteja cheia
+ */
+fsm_result_t fsm_actor_send(fsm_actor_t *actor, uint16_t eventID)
+{
+	fsm_actor_cell_t *cell;
+	uint32_t position, sequence;
+
+	if( actor==NULL )
+	{
+		FSM_ERR("ERROR: actor null\r\n");
+		return(FSM_NULL);
+	}
+
+	position = __atomic_load_n(&actor->tail, __ATOMIC_RELAXED);
+	for( ;; )
+	{
+		cell = &actor->cells[position & actor->mask];
+		sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		if( sequence == position )
+		{
+			if( __atomic_compare_exchange_n(&actor->tail, &position, position + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+			{
+				break;
+			}
+		}
+		else if( (int32_t)(sequence - position) < 0 )
+		{
+			return(FSM_NO_RESOURCES);
+		}
+		else
+		{
+			position = __atomic_load_n(&actor->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->eventID = eventID;
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_SEQ_CST);
+
+	if( __atomic_exchange_n(&actor->scheduled, 1, __ATOMIC_SEQ_CST) == 0 )
+	{
+		fsm_actor_schedule(actor);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_actor_worker
+ *
+ * Função privada com o laço de cada worker: deque própria, fila de injeção e roubo
+ */
+static void* fsm_actor_worker(void *arg)
+{
+	fsm_actor_worker_t *worker = (fsm_actor_worker_t*)arg;
+	fsm_actor_runtime_t *runtime = worker->runtime;
+	fsm_actor_t *actor;
+	struct timespec deadline;
+	uint16_t attempt, victim;
+
+	fsm_actor_current = worker;
+
+	while( __atomic_load_n(&runtime->running, __ATOMIC_ACQUIRE) )
+	{
+		actor = NULL;
+
+		// A fila de injeção é consultada periodicamente mesmo com a deque cheia
+		if( ++worker->ticks >= FSM_ACTOR_INJECT_INTERVAL )
+		{
+			worker->ticks = 0;
+			actor = fsm_actor_injected(runtime);
+		}
+		if( actor == NULL )
+		{
+			actor = fsm_actor_pop(worker);
+		}
+		if( actor == NULL )
+		{
+			actor = fsm_actor_injected(runtime);
+		}
+
+		// Rouba de outro worker, a partir de uma vítima aleatória
+		worker->seed ^= worker->seed << 13;
+		worker->seed ^= worker->seed >> 17;
+		worker->seed ^= worker->seed << 5;
+		for( attempt=1; (actor == NULL) && (attempt < runtime->number_workers); attempt++ )
+		{
+			victim = (uint16_t)((worker->seed + attempt) % runtime->number_workers);
+			if( &runtime->workers[victim] != worker )
+			{
+				actor = fsm_actor_steal(&runtime->workers[victim]);
+				if( actor != NULL )
+				{
+					worker->steals++;
+				}
+			}
+		}
+
+		if( actor != NULL )
+		{
+			fsm_actor_run(worker, actor);
+			continue;
+		}
+
+		// Sem trabalho: aguarda a fila de injeção, com limite para observar as deques
+		pthread_mutex_lock(&runtime->lock);
+		if( __atomic_load_n(&runtime->running, __ATOMIC_RELAXED) && (runtime->inject_head == NULL) )
+		{
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += 1000000L;
+			if( deadline.tv_nsec >= 1000000000L )
+			{
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			__atomic_add_fetch(&runtime->sleeping, 1, __ATOMIC_SEQ_CST);
+			pthread_cond_timedwait(&runtime->wake, &runtime->lock, &deadline);
+			__atomic_sub_fetch(&runtime->sleeping, 1, __ATOMIC_SEQ_CST);
+		}
+		pthread_mutex_unlock(&runtime->lock);
+	}
+
+	fsm_actor_current = NULL;
+	return(NULL);
+}
+
+/**
+ * @brief fsm_actor_run
+ *
+ * Função privada que processa até budget eventos do ator e o devolve às filas
+ */
+static void fsm_actor_run(fsm_actor_worker_t *worker, fsm_actor_t *actor)
+{
+	fsm_handler_t *fsm = &actor->fsm;
+	uint32_t steps = 0, head;
+	uint16_t eventID;
+
+	while( steps < worker->runtime->budget )
+	{
+		// Eventos retornados pelos callbacks têm prioridade sobre a caixa de mensagens
+		if( fsm->eventID >= fsm->number_events )
+		{
+			if( !fsm_actor_receive(actor, &eventID) )
+			{
+				break;
+			}
+			fsm_post(fsm, eventID);
+		}
+		fsm_engine(fsm);
+		steps++;
+	}
+	worker->runs++;
+	worker->events += steps;
+
+	// Orçamento esgotado: volta ao final da fila de injeção, atrás dos demais atores
+	if( fsm_actor_ready(actor) )
+	{
+		fsm_actor_inject(worker->runtime, actor);
+		return;
+	}
+
+	// Depois de liberado o ator pode estar com outro worker: só a célula da caixa é consultada
+	head = actor->head;
+	__atomic_store_n(&actor->scheduled, 0, __ATOMIC_SEQ_CST);
+	if( (__atomic_load_n(&actor->cells[head & actor->mask].sequence, __ATOMIC_SEQ_CST) == (head + 1)) &&
+		(__atomic_exchange_n(&actor->scheduled, 1, __ATOMIC_SEQ_CST) == 0) )
+	{
+		fsm_actor_schedule(actor);
+	}
+}
+
+/**
+ * @brief fsm_actor_ready
+ *
+ * Função privada que verifica se o ator tem um evento pendente ou na caixa de mensagens
+ */
+static uint8_t fsm_actor_ready(fsm_actor_t *actor)
+{
+	return( (actor->fsm.eventID < actor->fsm.number_events) ||
+			(__atomic_load_n(&actor->cells[actor->head & actor->mask].sequence, __ATOMIC_SEQ_CST) == (actor->head + 1)) );
+}
+
+/**
+ * @brief fsm_actor_receive
+ *
+ * Função privada que retira o próximo evento da caixa de mensagens (somente quem executa o ator)
+ */
+static uint8_t fsm_actor_receive(fsm_actor_t *actor, uint16_t *eventID)
+{
+	fsm_actor_cell_t *cell = &actor->cells[actor->head & actor->mask];
+
+	if( __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != (actor->head + 1) )
+	{
+		return(0);
+	}
+
+	*eventID = cell->eventID;
+	__atomic_store_n(&cell->sequence, actor->head + actor->mask + 1, __ATOMIC_RELEASE);
+	actor->head++;
+	return(1);
+}
+
+/**
+ * @brief fsm_actor_schedule
+ *
+ * Função privada que coloca o ator na deque do worker atual ou na fila de injeção
+ */
+static void fsm_actor_schedule(fsm_actor_t *actor)
+{
+	fsm_actor_worker_t *worker = fsm_actor_current;
+
+	if( (worker != NULL) && (worker->runtime == actor->runtime) && fsm_actor_push(worker, actor) )
+	{
+		if( __atomic_load_n(&actor->runtime->sleeping, __ATOMIC_SEQ_CST) != 0 )
+		{
+			pthread_cond_signal(&actor->runtime->wake);
+		}
+		return;
+	}
+
+	fsm_actor_inject(actor->runtime, actor);
+}
+
+/**
+ * @brief fsm_actor_inject
+ *
+ * Função privada que coloca o ator no final da fila de injeção
+ */
+static void fsm_actor_inject(fsm_actor_runtime_t *runtime, fsm_actor_t *actor)
+{
+	pthread_mutex_lock(&runtime->lock);
+	actor->next = NULL;
+	if( runtime->inject_tail != NULL )
+	{
+		runtime->inject_tail->next = actor;
+	}
+	else
+	{
+		__atomic_store_n(&runtime->inject_head, actor, __ATOMIC_RELAXED);
+	}
+	runtime->inject_tail = actor;
+	if( runtime->sleeping != 0 )
+	{
+		pthread_cond_signal(&runtime->wake);
+	}
+	pthread_mutex_unlock(&runtime->lock);
+}
+
+/**
+ * @brief fsm_actor_injected
+ *
+ * Função privada que retira o primeiro ator da fila de injeção
+ */
+static fsm_actor_t* fsm_actor_injected(fsm_actor_runtime_t *runtime)
+{
+	fsm_actor_t *actor;
+
+	// Leitura sem a trava apenas para evitar contenção quando a fila está vazia
+	if( __atomic_load_n(&runtime->inject_head, __ATOMIC_RELAXED) == NULL )
+	{
+		return(NULL);
+	}
+
+	pthread_mutex_lock(&runtime->lock);
+	actor = runtime->inject_head;
+	if( actor != NULL )
+	{
+		__atomic_store_n(&runtime->inject_head, actor->next, __ATOMIC_RELAXED);
+		if( actor->next == NULL )
+		{
+			runtime->inject_tail = NULL;
+		}
+	}
+	pthread_mutex_unlock(&runtime->lock);
+
+	return(actor);
+}
+
+/**
+ * @brief fsm_actor_push
+ *
+ * Função privada que coloca um ator na base da deque (somente o dono)
+ */
+static uint8_t fsm_actor_push(fsm_actor_worker_t *worker, fsm_actor_t *actor)
+{
+	int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+	int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+
+	if( (bottom - top) > (int64_t)worker->mask )
+	{
+		return(0);
+	}
+
+	__atomic_store_n(&worker->slots[bottom & worker->mask], actor, __ATOMIC_RELAXED);
+	__atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+	return(1);
+}
+
+/**
+ * @brief fsm_actor_pop
+ *
+ * Função privada que retira um ator da base da deque (somente o dono)
+ */
+static fsm_actor_t* fsm_actor_pop(fsm_actor_worker_t *worker)
+{
+	int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t top;
+	fsm_actor_t *actor = NULL;
+
+	__atomic_store_n(&worker->bottom, bottom, __ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&worker->top, __ATOMIC_SEQ_CST);
+
+	if( top <= bottom )
+	{
+		actor = __atomic_load_n(&worker->slots[bottom & worker->mask], __ATOMIC_RELAXED);
+		if( top == bottom )
+		{
+			// Último ator: disputa com os ladrões
+			if( !__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) )
+			{
+				actor = NULL;
+			}
+			__atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+		}
+	}
+	else
+	{
+		__atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+	}
+
+	return(actor);
+}
+
+/**
+ * @brief fsm_actor_steal
+ *
+ * Função privada que retira um ator do topo da deque de outro worker
+ */
+static fsm_actor_t* fsm_actor_steal(fsm_actor_worker_t *victim)
+{
+	int64_t top = __atomic_load_n(&victim->top, __ATOMIC_SEQ_CST);
+	int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_SEQ_CST);
+	fsm_actor_t *actor;
+
+	if( top >= bottom )
+	{
+		return(NULL);
+	}
+
+	actor = __atomic_load_n(&victim->slots[top & victim->mask], __ATOMIC_RELAXED);
+	if( !__atomic_compare_exchange_n(&victim->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) )
+	{
+		return(NULL);
+	}
+
+	return(actor);
+}
+
+#endif
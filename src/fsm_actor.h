@@ -0,0 +1,143 @@
+/**
+ * @file	fsm_actor.h
+ * @brief	Execução de instâncias da Finite State Machine como atores
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada ator é uma FSM com uma caixa de mensagens de eventos. Qualquer thread
+ * envia eventos com fsm_actor_send; o ator se torna executável quando a caixa
+ * deixa de estar vazia e é colocado na deque Chase-Lev do worker que enviou
+ * o evento ou, fora dos workers, na fila de injeção compartilhada. Workers
+ * sem trabalho roubam atores das deques dos demais.
+ *
+ * Cada execução de um ator processa no máximo budget eventos, contando os
+ * eventos retornados pelos callbacks. Um ator que esgota o orçamento volta
+ * ao final da fila de injeção, que os workers consultam periodicamente, de
+ * modo que um ator ocupado não impede a execução dos demais. Um ator nunca é
+ * executado por duas threads ao mesmo tempo, e o fsm_engine não é alterado.
+ *
+ * Dentro dos callbacks o ator é obtido com fsm_actor_of(this).
+ *
+ * Disponível apenas em sistemas com POSIX threads (FSM_ACTOR_ENABLE).
+ *
+ */
+#ifndef __FSM_ACTOR_H__
+#define __FSM_ACTOR_H__
+
+/**
+ * @defgroup fsm_actor_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_ACTOR_ENABLE	1
+#else
+#	define FSM_ACTOR_ENABLE	0
+#endif
+
+#if FSM_ACTOR_ENABLE
+
+#include <pthread.h>
+
+#ifndef FSM_ACTOR_INJECT_INTERVAL
+#	define FSM_ACTOR_INJECT_INTERVAL	61	/**< Execuções locais entre consultas à fila de injeção */
+#endif
+
+/**
+ * @brief Ator a partir do ponteiro recebido pelos callbacks
+ */
+#define fsm_actor_of(fsm)	((fsm_actor_t*)(fsm))
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Actor Mailbox Cell
+ */
+typedef struct fsm_actor_cell
+{
+	uint32_t	sequence;	/**< Posição que a célula aguarda (fila limitada de Vyukov) */
+	uint16_t	eventID;	/**< Evento */
+} fsm_actor_cell_t;
+
+/**
+ * @brief FSM Actor
+ *
+ * A FSM deve ser o primeiro campo, para que fsm_actor_of possa obter o ator
+ * a partir do ponteiro recebido pelos callbacks.
+ */
+typedef struct fsm_actor
+{
+	fsm_handler_t				fsm;		/**< FSM do ator */
+	struct fsm_actor_runtime*	runtime;	/**< Runtime que executa o ator */
+	struct fsm_actor*			next;		/**< Encadeamento na fila de injeção */
+	fsm_actor_cell_t*			cells;		/**< Caixa de mensagens */
+	uint32_t					mask;		/**< Capacidade da caixa - 1 */
+	uint32_t					head;		/**< Próxima leitura (somente quem executa o ator) */
+	uint32_t					tail;		/**< Próxima escrita (produtores) */
+	uint32_t					scheduled;	/**< Diferente de zero enquanto o ator está em uma fila ou em execução */
+} fsm_actor_t;
+
+/**
+ * @brief FSM Actor Worker
+ *
+ * Thread do runtime com a deque Chase-Lev de atores executáveis
+ */
+typedef struct fsm_actor_worker
+{
+	struct fsm_actor_runtime*	runtime;	/**< Runtime do worker */
+	pthread_t					thread;		/**< Thread do worker */
+	fsm_actor_t**				slots;		/**< Posições da deque */
+	uint32_t					mask;		/**< Capacidade da deque - 1 */
+	int64_t						top;		/**< Extremidade dos roubos */
+	int64_t						bottom;		/**< Extremidade do dono */
+	uint32_t					seed;		/**< Escolha das vítimas de roubo */
+	uint32_t					ticks;		/**< Execuções desde a última consulta à fila de injeção */
+	uint64_t					runs;		/**< Execuções de atores */
+	uint64_t					events;		/**< Eventos processados */
+	uint64_t					steals;		/**< Atores roubados de outros workers */
+} fsm_actor_worker_t;
+
+/**
+ * @brief FSM Actor Runtime
+ */
+typedef struct fsm_actor_runtime
+{
+	fsm_actor_worker_t*	workers;		/**< Workers */
+	uint16_t			number_workers;	/**< Quantidade de workers */
+	uint32_t			budget;			/**< Eventos por execução de um ator */
+	uint32_t			running;		/**< Diferente de zero entre start e stop */
+	uint32_t			sleeping;		/**< Workers aguardando trabalho */
+	pthread_mutex_t		lock;			/**< Protege a fila de injeção */
+	pthread_cond_t		wake;			/**< Acorda workers ociosos */
+	fsm_actor_t*		inject_head;	/**< Fila de injeção */
+	fsm_actor_t*		inject_tail;
+} fsm_actor_runtime_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_actor_init		(fsm_actor_runtime_t *runtime, fsm_actor_worker_t *workers, uint16_t number_workers, fsm_actor_t **slots, uint32_t deque_capacity, uint32_t budget);
+fsm_result_t fsm_actor_start	(fsm_actor_runtime_t *runtime);
+fsm_result_t fsm_actor_stop		(fsm_actor_runtime_t *runtime);
+fsm_result_t fsm_actor_create	(fsm_actor_t *actor, fsm_actor_runtime_t *runtime, fsm_actor_cell_t *cells, uint32_t capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_actor_send		(fsm_actor_t *actor, uint16_t eventID);
+
+#endif
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file	fsm_buffer.c
+ * @brief	Pools de buffers com contagem de referências para payloads de eventos
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_buffer.h"
+#include "string.h"
+
+/**
+ * @defgroup fsm_buffer_c doxygengroup
+ * @{
+ */
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa um pool de buffers sobre uma área da aplicação
+ * @param		pool ponteiro para estrutura do pool
+ * @param		arena área de memória (ver FSM_BUFFER_ARENA_SIZE)
+ * @param		arena_size tamanho da área em bytes
+ * @param		buffer_size bytes de dados por buffer
+ * @retval		FSM_NO_RESOURCES caso a área não comporte nenhum buffer
+ */
+fsm_result_t fsm_buffer_pool_init(fsm_buffer_pool_t *pool, void *arena, size_t arena_size, uint16_t buffer_size)
+{
+	uintptr_t base;
+	size_t pad;
+
+	FSM_DBG("fsm buffer pool init ");
+
+	if( (pool==NULL) || (arena==NULL) || (buffer_size==0) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	base	= (uintptr_t)arena;
+	pad		= (size_t)((8u - (base & 7u)) & 7u);
+	if( arena_size < (pad + FSM_BUFFER_STRIDE(buffer_size)) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(pool, 0, sizeof(fsm_buffer_pool_t));
+	pool->base		= (uint8_t*)(base + pad);
+	pool->stride	= (uint32_t)FSM_BUFFER_STRIDE(buffer_size);
+	pool->capacity	= (uint32_t)((arena_size - pad) / pool->stride);
+	pool->size		= buffer_size;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Obtém um buffer do pool, com uma referência
+ * @param		pool ponteiro para estrutura do pool
+ * @return		Buffer com length zero, ou NULL caso o pool esteja esgotado
+ */
+fsm_buffer_t* fsm_buffer_alloc(fsm_buffer_pool_t *pool)
+{
+	fsm_buffer_t *buffer;
+
+	if( pool==NULL )
+	{
+		FSM_ERR("ERROR: pool null\r\n");
+		return(NULL);
+	}
+
+	if( pool->free_list != NULL )
+	{
+		buffer			= pool->free_list;
+		pool->free_list	= buffer->next;
+	}
+	else if( pool->bump < pool->capacity )
+	{
+		buffer = (fsm_buffer_t*)(pool->base + (size_t)pool->bump * pool->stride);
+		pool->bump++;
+	}
+	else
+	{
+		pool->failures++;
+		return(NULL);
+	}
+
+	buffer->pool	= pool;
+	buffer->next	= NULL;
+	buffer->refs	= 1;
+	buffer->length	= 0;
+	pool->used++;
+
+	return(buffer);
+}
+
+/**
+ * @brief		Acrescenta uma referência ao buffer
+ * @param		buffer ponteiro para o buffer
+ * @retval		FSM_NO_RESOURCES caso o contador esteja no limite
+ */
+fsm_result_t fsm_buffer_retain(fsm_buffer_t *buffer)
+{
+	if( buffer==NULL )
+	{
+		FSM_ERR("ERROR: buffer null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( buffer->refs == 0xFFFF )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	buffer->refs++;
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Remove uma referência do buffer
+ * @details		Na última referência o buffer volta ao pool
+ * @param		buffer ponteiro para o buffer
+ * @retval		FSM_STATE_ERROR caso o buffer já esteja livre
+ */
+fsm_result_t fsm_buffer_release(fsm_buffer_t *buffer)
+{
+	fsm_buffer_pool_t *pool;
+
+	if( buffer==NULL )
+	{
+		FSM_ERR("ERROR: buffer null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( buffer->refs == 0 )
+	{
+		FSM_ERR("ERROR: buffer already free\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	if( --buffer->refs == 0 )
+	{
+		pool			= buffer->pool;
+		buffer->next	= pool->free_list;
+		pool->free_list	= buffer;
+		pool->used--;
+	}
+
+	return(FSM_OK);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file	fsm_buffer.h
+ * @brief	Pools de buffers com contagem de referências para payloads de eventos
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Buffers de tamanho fixo sobre uma área fornecida pela aplicação, com lista
+ * livre intrusiva como em fsm_pool.h: obter e devolver um buffer é O(1) e
+ * não passa pelo malloc. O produtor escreve os dados diretamente em
+ * FSM_BUFFER_DATA e entrega o buffer à FSM com fsm_post_envelope
+ * (FSM_PAYLOAD_ENABLE); o callback do estado o lê com fsm_payload, sem
+ * cópia, e o fsm_engine o devolve depois do despacho:
+ * @code
+ * static uint8_t arena[FSM_BUFFER_ARENA_SIZE(8, 64)];
+ * fsm_buffer_pool_init(&rx_pool, arena, sizeof(arena), 64);
+ *
+ * fsm_envelope_t envelope = { EV_PACKET, fsm_buffer_alloc(&rx_pool) };
+ * envelope.payload->length = uart_read(FSM_BUFFER_DATA(envelope.payload), 64);
+ * fsm_post_envelope(&fsm, &envelope);
+ * @endcode
+ * Um buffer entregue a várias FSMs recebe um fsm_buffer_retain por entrega
+ * adicional. Alocação e liberação devem ocorrer no contexto que executa as
+ * FSMs, como fsm_post.
+ *
+ */
+#ifndef __FSM_BUFFER_H__
+#define __FSM_BUFFER_H__
+
+/**
+ * @defgroup fsm_buffer_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_BUFFER_HEADER				((sizeof(fsm_buffer_t) + 7u) & ~(size_t)7u)
+#define FSM_BUFFER_STRIDE(size)			(FSM_BUFFER_HEADER + (((size_t)(size) + 7u) & ~(size_t)7u))
+#define FSM_BUFFER_ARENA_SIZE(n, size)	((n) * FSM_BUFFER_STRIDE(size) + 8u)	/**< Inclui a margem de alinhamento */
+#define FSM_BUFFER_DATA(buffer)			((uint8_t*)(buffer) + FSM_BUFFER_HEADER)
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Buffer
+ *
+ * Cabeçalho de um buffer; os dados seguem em FSM_BUFFER_DATA
+ */
+typedef struct fsm_buffer
+{
+	struct fsm_buffer_pool*	pool;	/**< Pool de origem */
+	struct fsm_buffer*		next;	/**< Próximo buffer livre */
+	uint16_t				refs;	/**< Referências; o buffer volta ao pool em zero */
+	uint16_t				length;	/**< Bytes válidos, preenchido pelo produtor */
+} fsm_buffer_t;
+
+/**
+ * @brief FSM Buffer Pool
+ *
+ * Como em fsm_pool_t, os buffers nunca usados são entregues em ordem e só
+ * os devolvidos entram na lista livre
+ */
+typedef struct fsm_buffer_pool
+{
+	uint8_t*		base;		/**< Primeiro buffer */
+	fsm_buffer_t*	free_list;	/**< Buffers devolvidos */
+	uint32_t		stride;		/**< Distância entre buffers */
+	uint32_t		capacity;	/**< Quantidade de buffers */
+	uint32_t		bump;		/**< Buffers nunca utilizados a partir deste índice */
+	uint32_t		used;		/**< Buffers em uso */
+	uint32_t		failures;	/**< Alocações recusadas por falta de buffers */
+	uint16_t		size;		/**< Bytes de dados por buffer */
+} fsm_buffer_pool_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t	fsm_buffer_pool_init	(fsm_buffer_pool_t *pool, void *arena, size_t arena_size, uint16_t buffer_size);
+fsm_buffer_t*	fsm_buffer_alloc		(fsm_buffer_pool_t *pool);
+fsm_result_t	fsm_buffer_retain		(fsm_buffer_t *buffer);
+fsm_result_t	fsm_buffer_release		(fsm_buffer_t *buffer);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file	fsm_bundle.c
+ * @brief	Carga de tabelas da Finite State Machine a partir de um bundle binário
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Na carga são verificados apenas o cabeçalho e os limites de cada entrada
+ * do diretório, em O(quantidade de FSMs). Os índices de próximo estado são
+ * verificados pelo fsm_engine no momento do uso.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_bundle.h"
+#include "string.h"
+
+#if FSM_TABLE_ENABLE && FSM_BUNDLE_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @defgroup fsm_bundle_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint8_t	fsm_bundle_fits	(size_t size, uint64_t offset, uint64_t length, uint32_t align);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Mapeia um bundle em memória
+ * @param		bundle ponteiro para estrutura do bundle
+ * @param		path caminho do arquivo do bundle
+ * @retval		FSM_FORMAT_ERROR caso o arquivo não seja um bundle compatível
+ * @retval		FSM_NO_RESOURCES caso o arquivo não possa ser mapeado
+ */
+fsm_result_t fsm_bundle_map(fsm_bundle_t *bundle, const char *path)
+{
+	const fsm_bundle_header_t *header;
+	const fsm_bundle_entry_t *entry;
+	struct stat info;
+	void *mapped;
+	size_t size;
+	uint32_t index;
+	int fd;
+
+	FSM_DBG("fsm bundle map %s ", path);
+
+	if( (bundle==NULL) || (path==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(bundle, 0, sizeof(fsm_bundle_t));
+
+	fd = open(path, O_RDONLY);
+	if( fd < 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	if( (fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(fsm_bundle_header_t)) )
+	{
+		close(fd);
+		FSM_ERR("ERROR: invalid bundle\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	size = (size_t)info.st_size;
+	mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if( mapped == MAP_FAILED )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	bundle->mapped		= mapped;
+	bundle->mapped_size	= size;
+
+	header = (const fsm_bundle_header_t*)mapped;
+	if( (memcmp(header->magic, "FSMB", 4) != 0) ||
+		(header->version != FSM_BUNDLE_VERSION) ||
+		(header->byte_order != FSM_BUNDLE_BYTE_ORDER) ||
+		(header->size != size) ||
+		!fsm_bundle_fits(size, header->entries_offset, (uint64_t)header->count * sizeof(fsm_bundle_entry_t), 8) )
+	{
+		fsm_bundle_unmap(bundle);
+		FSM_ERR("ERROR: invalid bundle\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	entry = (const fsm_bundle_entry_t*)((const uint8_t*)mapped + header->entries_offset);
+	for( index=0; index<header->count; index++, entry++ )
+	{
+		if( (entry->number_states == 0) || (entry->number_states >= FSM_STATE_INVALID) ||
+			(entry->initial >= entry->number_states) ||
+			!fsm_bundle_fits(size, entry->rows_offset, (uint64_t)entry->number_rows * 4 * sizeof(uint16_t), sizeof(uint16_t)) ||
+			!fsm_bundle_fits(size, entry->next_offset, (uint64_t)entry->number_states * entry->number_events * sizeof(uint16_t), sizeof(uint16_t)) )
+		{
+			fsm_bundle_unmap(bundle);
+			FSM_ERR("ERROR: invalid bundle\r\n");
+			return(FSM_FORMAT_ERROR);
+		}
+	}
+
+	bundle->header	= header;
+	bundle->entries	= (const fsm_bundle_entry_t*)((const uint8_t*)mapped + header->entries_offset);
+	bundle->count	= header->count;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Desfaz o mapeamento de um bundle
+ * @details		As tabelas obtidas do bundle deixam de ser válidas
+ * @param		bundle ponteiro para estrutura do bundle
+ */
+fsm_result_t fsm_bundle_unmap(fsm_bundle_t *bundle)
+{
+	if( bundle==NULL )
+	{
+		FSM_ERR("ERROR: bundle null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( bundle->mapped != NULL )
+	{
+		munmap(bundle->mapped, bundle->mapped_size);
+	}
+	memset(bundle, 0, sizeof(fsm_bundle_t));
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Obtém a tabela indexada de uma FSM do bundle
+ * @details		A tabela aponta para o bundle mapeado e para o vetor de callbacks da
+ *				aplicação, que devem permanecer válidos enquanto houver instâncias
+ * @param		bundle ponteiro para estrutura do bundle
+ * @param		name nome da FSM no bundle
+ * @param		callbacks funções dos estados, na ordem dos índices do bundle
+ * @param		number_callbacks quantidade de funções em callbacks
+ * @param		table recebe a tabela indexada
+ * @retval		FSM_STATE_ERROR caso a FSM não exista no bundle
+ * @retval		FSM_FUNCTION_NULL caso number_callbacks não corresponda aos estados da FSM
+ *				ou algum callback seja NULL
+ */
+fsm_result_t fsm_bundle_table(fsm_bundle_t *bundle, const char *name, void* const *callbacks, uint16_t number_callbacks, fsm_table_t *table)
+{
+	const fsm_bundle_entry_t *entry = NULL;
+	uint32_t index;
+	uint16_t state;
+
+	if( (bundle==NULL) || (name==NULL) || (callbacks==NULL) || (table==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	for( index=0; index<bundle->count; index++ )
+	{
+		if( strncmp(bundle->entries[index].name, name, FSM_BUNDLE_NAME_LENGTH) == 0 )
+		{
+			entry = &bundle->entries[index];
+			break;
+		}
+	}
+
+	if( entry == NULL )
+	{
+		FSM_ERR("ERROR: fsm %s not in bundle\r\n", name);
+		return(FSM_STATE_ERROR);
+	}
+
+	if( number_callbacks != entry->number_states )
+	{
+		FSM_ERR("ERROR: callbacks mismatch\r\n");
+		return(FSM_FUNCTION_NULL);
+	}
+
+	for( state=0; state<number_callbacks; state++ )
+	{
+		if( callbacks[state] == NULL )
+		{
+			FSM_ERR("ERROR: callback null\r\n");
+			return(FSM_FUNCTION_NULL);
+		}
+	}
+
+	table->callbacks		= callbacks;
+	table->next				= (const uint16_t*)((const uint8_t*)bundle->mapped + entry->next_offset);
+	table->number_states	= entry->number_states;
+	table->number_events	= entry->number_events;
+	table->initial			= entry->initial;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_bundle_fits
+ *
+ * Função privada que verifica se uma seção alinhada cabe no arquivo
+ */
+static uint8_t fsm_bundle_fits(size_t size, uint64_t offset, uint64_t length, uint32_t align)
+{
+	return( ((offset % align) == 0) && (offset <= size) && (length <= (size - offset)) );
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file	fsm_bundle.h
+ * @brief	Carga de tabelas da Finite State Machine a partir de um bundle binário
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Um bundle reúne várias FSMs descritas apenas por índices de estados,
+ * eventos e callbacks, junto com o índice denso estado x evento já calculado
+ * pelo gerador (generator/script.py --bundle). O arquivo é mapeado em
+ * memória e as tabelas apontam diretamente para ele: não há cópia nem
+ * verificação da tabela (fsm_checkStateTable) na carga. Os índices de
+ * callback são associados a um vetor de funções registrado pela aplicação,
+ * gerado na mesma ordem no cabeçalho <bundle>_bundle.h.
+ *
+ * Formato do arquivo (little endian, seções alinhadas em 8 bytes):
+ * @code
+ * cabeçalho (fsm_bundle_header_t, 32 bytes)
+ * diretório (count * fsm_bundle_entry_t, 48 bytes cada)
+ * para cada FSM:
+ *   linhas   number_rows * 4 x uint16 (estado, evento, próximo estado, 0)
+ *   índice   number_states * number_events x uint16 (FSM_STATE_INVALID sem transição)
+ * @endcode
+ * Os estados são numerados como em fsm_state_list, os eventos como no enum
+ * <fsm>_evHandler do <fsm>_api.h gerado da mesma descrição, e table_hash é o
+ * mesmo de fsm_snapshot_hash sobre a tabela gerada. fsm_snapshot e fsm_wal
+ * ainda exigem instâncias criadas com stateTable: instâncias de um bundle
+ * não podem ser gravadas nem registradas por eles.
+ *
+ * As instâncias são criadas com fsm_create_table. Requer FSM_TABLE_ENABLE 1
+ * e mmap (FSM_BUNDLE_MMAP).
+ *
+ */
+#ifndef __FSM_BUNDLE_H__
+#define __FSM_BUNDLE_H__
+
+/**
+ * @defgroup fsm_bundle_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_BUNDLE_MMAP	1
+#else
+#	define FSM_BUNDLE_MMAP	0
+#endif
+
+#define FSM_BUNDLE_VERSION		1
+#define FSM_BUNDLE_BYTE_ORDER	0x0102
+#define FSM_BUNDLE_NAME_LENGTH	16
+
+#if FSM_TABLE_ENABLE
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Bundle Header
+ */
+typedef struct fsm_bundle_header
+{
+	char		magic[4];		/**< "FSMB" */
+	uint16_t	version;		/**< FSM_BUNDLE_VERSION */
+	uint16_t	byte_order;		/**< FSM_BUNDLE_BYTE_ORDER */
+	uint32_t	count;			/**< Quantidade de FSMs */
+	uint32_t	reserved;
+	uint64_t	entries_offset;	/**< Início do diretório */
+	uint64_t	size;			/**< Tamanho total do arquivo */
+} fsm_bundle_header_t;
+
+/**
+ * @brief FSM Bundle Entry
+ *
+ * Os deslocamentos são relativos ao início do arquivo
+ */
+typedef struct fsm_bundle_entry
+{
+	char		name[FSM_BUNDLE_NAME_LENGTH];	/**< Nome da FSM, completado com zeros */
+	uint16_t	number_states;	/**< Quantidade de estados (e de callbacks) */
+	uint16_t	number_events;	/**< Quantidade de eventos */
+	uint16_t	initial;		/**< Índice do estado inicial */
+	uint16_t	reserved;
+	uint32_t	number_rows;	/**< Linhas da tabela de transição */
+	uint32_t	rows_offset;	/**< Linhas da tabela, para diagramas e validações */
+	uint32_t	next_offset;	/**< Índice denso estado x evento */
+	uint32_t	reserved2;
+	uint64_t	table_hash;		/**< Identidade da tabela (fsm_snapshot_hash) */
+} fsm_bundle_entry_t;
+
+/**
+ * @brief FSM Bundle
+ */
+typedef struct fsm_bundle
+{
+	const fsm_bundle_header_t*	header;		/**< Cabeçalho mapeado */
+	const fsm_bundle_entry_t*	entries;	/**< Diretório mapeado */
+	uint32_t					count;		/**< Quantidade de FSMs */
+	void*						mapped;		/**< Base do mmap */
+	size_t						mapped_size;	/**< Tamanho do mmap */
+} fsm_bundle_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_bundle_map		(fsm_bundle_t *bundle, const char *path);
+fsm_result_t fsm_bundle_unmap	(fsm_bundle_t *bundle);
+fsm_result_t fsm_bundle_table	(fsm_bundle_t *bundle, const char *name, void* const *callbacks, uint16_t number_callbacks, fsm_table_t *table);
+
+#endif
+
+/**
+ * @}
+ */
+
+#endif
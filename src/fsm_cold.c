@@ -0,0 +1,355 @@
+/**
+ * @file	fsm_cold.c
+ * @brief	Hibernação de instâncias ociosas da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O vetor quente é mantido compacto: ao hibernar uma instância, a última
+ * posição ocupada é movida para a posição liberada.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_cold.h"
+#include "string.h"
+
+// Os registros frios guardam apenas estado e evento pendente, e a promoção copia o
+// protótipo sobre a posição quente: eventos emitidos, adiados e payloads seriam
+// perdidos
+#if (FSM_EMIT_QUEUE > 0) || (FSM_DEFER_QUEUE > 0) || FSM_PAYLOAD_ENABLE
+#	error "fsm_cold não suporta FSM_EMIT_QUEUE, FSM_DEFER_QUEUE nem FSM_PAYLOAD_ENABLE"
+#endif
+
+/**
+ * @defgroup fsm_cold_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static fsm_result_t	fsm_cold_evict	(fsm_cold_store_t *store, uint16_t slot);
+static uint16_t		fsm_cold_oldest	(fsm_cold_store_t *store, uint32_t now);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa a hibernação de uma população de instâncias
+ * @details		Todas as instâncias começam frias, no estado inicial e sem evento pendente
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		hot vetor quente, fornecido pela aplicação
+ * @param		hot_capacity posições do vetor quente
+ * @param		cold vetor frio com population registros
+ * @param		population quantidade de instâncias
+ * @param		states recebe os estados da tabela (ver fsm_state_list)
+ * @param		max_states posições em states
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state ponteiro para a função que será executada na primeira iteração da FSM
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @retval		FSM_NO_RESOURCES caso os estados não caibam em states ou hot_capacity seja 0
+ */
+fsm_result_t fsm_cold_init(fsm_cold_store_t *store, fsm_hot_t *hot, uint16_t hot_capacity, fsm_cold_t *cold, uint32_t population, void **states, uint16_t max_states, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events)
+{
+	fsm_result_t ret;
+	uint16_t initial;
+	uint32_t id;
+
+	FSM_DBG("fsm cold init ");
+
+	if( (store==NULL) || (hot==NULL) || (cold==NULL) || (states==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( hot_capacity == 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(store, 0, sizeof(fsm_cold_store_t));
+	ret = fsm_create(&store->proto, stateTable, initial_state, fsm_name, number_events);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	store->number_states = fsm_state_list(stateTable, states, max_states);
+	if( store->number_states == FSM_STATE_INVALID )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+
+	initial = fsm_state_index(states, store->number_states, initial_state);
+	if( initial == FSM_STATE_INVALID )
+	{
+		FSM_ERR("ERROR: initial state not in table\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	for( id=0; id<population; id++ )
+	{
+		cold[id].state		= initial;
+		cold[id].eventID	= number_events;
+	}
+
+	store->hot			= hot;
+	store->cold			= cold;
+	store->states		= states;
+	store->population	= population;
+	store->hot_capacity	= hot_capacity;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Garante que uma instância esteja no vetor quente
+ * @details		Com o vetor quente cheio, a instância há mais tempo sem eventos é
+ *				hibernada para dar lugar à promovida
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		id posição da instância no vetor frio
+ * @param		tick tick atual
+ * @param		fsm recebe o ponteiro para a FSM residente (pode ser NULL); só é válido
+ *				até a próxima promoção ou hibernação
+ * @retval		FSM_STATE_ERROR caso id esteja fora da população
+ */
+fsm_result_t fsm_cold_promote(fsm_cold_store_t *store, uint32_t id, uint32_t tick, fsm_handler_t **fsm)
+{
+	fsm_cold_t *record;
+	fsm_hot_t *slot;
+	fsm_result_t ret;
+
+	if( store==NULL )
+	{
+		FSM_ERR("ERROR: store null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( id >= store->population )
+	{
+		FSM_ERR("ERROR: id out of bounds\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	record = &store->cold[id];
+	if( record->state != FSM_COLD_HOT )
+	{
+		if( store->hot_count >= store->hot_capacity )
+		{
+			ret = fsm_cold_evict(store, fsm_cold_oldest(store, tick));
+			if( ret != FSM_OK )
+			{
+				return(ret);
+			}
+		}
+
+		slot = &store->hot[store->hot_count];
+		slot->fsm			= store->proto;
+		slot->fsm.cb_state	= store->states[record->state];
+		slot->fsm.eventID	= record->eventID;
+		slot->id			= id;
+		slot->tick			= tick;
+
+		record->state	= FSM_COLD_HOT;
+		record->eventID	= store->hot_count++;
+	}
+
+	if( fsm != NULL )
+	{
+		*fsm = &store->hot[record->eventID].fsm;
+	}
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Entrega um evento a uma instância, promovendo-a se estiver fria
+ * @details		Um evento pendente retornado pelo callback da instância é processado
+ *				antes do evento enviado. Os callbacks não devem enviar eventos para a
+ *				mesma camada fria.
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		id posição da instância no vetor frio
+ * @param		eventID evento enviado
+ * @param		tick tick atual
+ * @return		Resultado do fsm_engine para o evento enviado
+ * @retval		FSM_NO_RESOURCES caso a instância ainda tenha um evento pendente após
+ *				processar o anterior (o evento enviado não é entregue)
+ */
+fsm_result_t fsm_cold_post(fsm_cold_store_t *store, uint32_t id, uint16_t eventID, uint32_t tick)
+{
+	fsm_handler_t *fsm;
+	fsm_result_t ret;
+
+	ret = fsm_cold_promote(store, id, tick, &fsm);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	if( fsm->eventID < fsm->number_events )
+	{
+		fsm_engine(fsm);
+		if( fsm->eventID < fsm->number_events )
+		{
+			FSM_ERR("ERROR: event pending\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	fsm->eventID = eventID;
+	store->hot[store->cold[id].eventID].tick = tick;
+	return(fsm_engine(fsm));
+}
+
+/**
+ * @brief		Executa um passo de todas as instâncias residentes
+ * @details		Instâncias frias não são executadas; as que fazem transição têm o tick
+ *				de atividade atualizado
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		tick tick atual
+ */
+fsm_result_t fsm_cold_engine(fsm_cold_store_t *store, uint32_t tick)
+{
+	uint16_t slot;
+
+	if( store==NULL )
+	{
+		FSM_ERR("ERROR: store null\r\n");
+		return(FSM_NULL);
+	}
+
+	for( slot=0; slot<store->hot_count; slot++ )
+	{
+		if( fsm_engine(&store->hot[slot].fsm) == FSM_OK )
+		{
+			store->hot[slot].tick = tick;
+		}
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Move para a camada fria as instâncias ociosas
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		now tick atual
+ * @param		idle_ticks instâncias sem atividade há pelo menos esta quantidade de ticks
+ *				são hibernadas
+ * @return		Quantidade de instâncias hibernadas
+ */
+uint32_t fsm_cold_hibernate(fsm_cold_store_t *store, uint32_t now, uint32_t idle_ticks)
+{
+	uint32_t count = 0;
+	uint16_t slot = 0;
+
+	if( store==NULL )
+	{
+		FSM_ERR("ERROR: store null\r\n");
+		return(0);
+	}
+
+	while( slot < store->hot_count )
+	{
+		// A posição liberada recebe a última instância, que é avaliada em seguida
+		if( ((uint32_t)(now - store->hot[slot].tick) >= idle_ticks) &&
+			(fsm_cold_evict(store, slot) == FSM_OK) )
+		{
+			count++;
+		}
+		else
+		{
+			slot++;
+		}
+	}
+
+	return(count);
+}
+
+/**
+ * @brief		Retorna o estado atual de uma instância
+ * @param		store ponteiro para estrutura da camada fria
+ * @param		id posição da instância no vetor frio
+ * @return		Ponteiro para o callback do estado, ou NULL caso id seja inválido
+ */
+void* fsm_cold_state(fsm_cold_store_t *store, uint32_t id)
+{
+	fsm_cold_t *record;
+
+	if( (store==NULL) || (id >= store->population) )
+	{
+		return(NULL);
+	}
+
+	record = &store->cold[id];
+	if( record->state == FSM_COLD_HOT )
+	{
+		return(store->hot[record->eventID].fsm.cb_state);
+	}
+	return(store->states[record->state]);
+}
+
+/**
+ * @brief		Retorna a posição no vetor frio da instância em execução
+ * @param		fsm ponteiro recebido pelo callback do estado
+ */
+uint32_t fsm_cold_id(fsm_handler_t *fsm)
+{
+	return(((fsm_hot_t*)fsm)->id);
+}
+
+/**
+ * @brief fsm_cold_evict
+ *
+ * Função privada que grava a instância residente no registro frio e compacta o
+ * vetor quente
+ */
+static fsm_result_t fsm_cold_evict(fsm_cold_store_t *store, uint16_t slot)
+{
+	fsm_hot_t *hot = &store->hot[slot];
+	uint16_t state, last;
+
+	state = fsm_state_index(store->states, store->number_states, hot->fsm.cb_state);
+	if( state == FSM_STATE_INVALID )
+	{
+		FSM_ERR("ERROR: state not in table\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	store->cold[hot->id].state		= state;
+	store->cold[hot->id].eventID	= hot->fsm.eventID;
+
+	last = --store->hot_count;
+	if( slot != last )
+	{
+		*hot = store->hot[last];
+		store->cold[hot->id].eventID = slot;
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_cold_oldest
+ *
+ * Função privada que retorna a posição residente há mais tempo sem atividade
+ */
+static uint16_t fsm_cold_oldest(fsm_cold_store_t *store, uint32_t now)
+{
+	uint16_t slot, oldest = 0;
+
+	for( slot=1; slot<store->hot_count; slot++ )
+	{
+		if( (uint32_t)(now - store->hot[slot].tick) > (uint32_t)(now - store->hot[oldest].tick) )
+		{
+			oldest = slot;
+		}
+	}
+	return(oldest);
+}
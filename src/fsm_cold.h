@@ -0,0 +1,99 @@
+/**
+ * @file	fsm_cold.h
+ * @brief	Hibernação de instâncias ociosas da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Divide uma população de instâncias em duas camadas. O vetor quente contém
+ * estruturas fsm_handler_t completas apenas para as instâncias ativas e é
+ * pequeno o bastante para permanecer em cache. Todas as instâncias têm um
+ * registro frio de 4 bytes com o índice do estado (ver fsm_state_list) e o
+ * evento pendente. fsm_cold_hibernate move para a camada fria as instâncias
+ * sem eventos há mais de um limite de ticks, e um evento enviado para uma
+ * instância fria a promove de volta de forma transparente.
+ *
+ * As instâncias são identificadas pela posição no vetor frio; dentro dos
+ * callbacks a posição é obtida com fsm_cold_id(this). O registro frio guarda
+ * apenas estado e evento pendente: não suporta FSM_EMIT_QUEUE,
+ * FSM_DEFER_QUEUE nem FSM_PAYLOAD_ENABLE.
+ *
+ */
+#ifndef __FSM_COLD_H__
+#define __FSM_COLD_H__
+
+/**
+ * @defgroup fsm_cold_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_COLD_HOT		0xFFFF	/**< Registro de uma instância residente: eventID guarda a posição no vetor quente */
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Cold Record
+ *
+ * Estado compacto de uma instância, independente dos endereços dos callbacks
+ */
+typedef struct fsm_cold
+{
+	uint16_t	state;		/**< Índice do estado, ou FSM_COLD_HOT */
+	uint16_t	eventID;	/**< Evento pendente (number_events quando não há) */
+} fsm_cold_t;
+
+/**
+ * @brief FSM Hot Slot
+ *
+ * A FSM deve ser o primeiro campo, para que fsm_cold_id possa obter a
+ * posição a partir do ponteiro recebido pelos callbacks.
+ */
+typedef struct fsm_hot
+{
+	fsm_handler_t	fsm;	/**< Instância residente */
+	uint32_t		id;		/**< Posição da instância no vetor frio */
+	uint32_t		tick;	/**< Tick do último evento ou transição */
+} fsm_hot_t;
+
+/**
+ * @brief FSM Cold Store
+ */
+typedef struct fsm_cold_store
+{
+	fsm_handler_t	proto;			/**< Modelo para as instâncias promovidas */
+	fsm_hot_t*		hot;			/**< Vetor quente, fornecido pela aplicação */
+	fsm_cold_t*		cold;			/**< Vetor frio com um registro por instância */
+	void**			states;			/**< Estados da tabela indexados (fsm_state_list) */
+	uint32_t		population;		/**< Quantidade de instâncias */
+	uint16_t		hot_capacity;	/**< Posições do vetor quente */
+	uint16_t		hot_count;		/**< Instâncias residentes */
+	uint16_t		number_states;	/**< Quantidade de estados em states */
+} fsm_cold_store_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_cold_init		(fsm_cold_store_t *store, fsm_hot_t *hot, uint16_t hot_capacity, fsm_cold_t *cold, uint32_t population, void **states, uint16_t max_states, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_cold_promote	(fsm_cold_store_t *store, uint32_t id, uint32_t tick, fsm_handler_t **fsm);
+fsm_result_t fsm_cold_post		(fsm_cold_store_t *store, uint32_t id, uint16_t eventID, uint32_t tick);
+fsm_result_t fsm_cold_engine	(fsm_cold_store_t *store, uint32_t tick);
+uint32_t	 fsm_cold_hibernate	(fsm_cold_store_t *store, uint32_t now, uint32_t idle_ticks);
+void*		 fsm_cold_state		(fsm_cold_store_t *store, uint32_t id);
+uint32_t	 fsm_cold_id		(fsm_handler_t *fsm);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,395 @@
+/**
+ * @file	fsm_cyclic.c
+ * @brief	Executivo cíclico para FSMs periódicas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * A tabela é montada uma vez, na inicialização. As execuções são alocadas
+ * em ordem de período crescente (taxa monotônica) e, dentro de cada FSM, em
+ * ordem de liberação, no primeiro quadro inteiramente contido entre a
+ * liberação e o prazo com tempo livre suficiente.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_cyclic.h"
+#include "string.h"
+
+#if FSM_CYCLIC_TIMERFD
+#	include <unistd.h>
+#	include <sys/timerfd.h>
+#endif
+
+/**
+ * @defgroup fsm_cyclic_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint32_t		fsm_cyclic_gcd		(uint32_t a, uint32_t b);
+static uint32_t		fsm_cyclic_wcet		(const fsm_cyclic_task_t *task);
+static uint32_t		fsm_cyclic_minor	(const fsm_cyclic_task_t *tasks, uint16_t number_tasks, uint32_t major);
+static fsm_result_t	fsm_cyclic_place	(fsm_cyclic_t *cyclic, uint16_t task, uint32_t *load, uint32_t max_slots);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Monta a tabela do executivo cíclico
+ * @param		cyclic ponteiro para estrutura do executivo
+ * @param		tasks FSMs periódicas
+ * @param		number_tasks quantidade de FSMs
+ * @param		frames vetor com max_frames + 1 posições
+ * @param		max_frames quantidade máxima de quadros menores
+ * @param		slots vetor para as execuções de um quadro maior
+ * @param		max_slots quantidade de posições em slots
+ * @param		now relógio nos mesmos ticks dos períodos, para medir as execuções (pode ser NULL)
+ * @retval		FSM_NO_RESOURCES caso não exista quadro menor viável, a tabela não caiba
+ *				nos vetores ou alguma execução não caiba antes do seu prazo
+ */
+fsm_result_t fsm_cyclic_build(fsm_cyclic_t *cyclic, fsm_cyclic_task_t *tasks, uint16_t number_tasks, uint32_t *frames, uint32_t max_frames,
+							  fsm_cyclic_slot_t *slots, uint32_t max_slots, uint32_t (*now)(void))
+{
+	fsm_cyclic_slot_t slot;
+	uint64_t major = 1;
+	uint32_t last = 0, next, index, position;
+	uint16_t task;
+	fsm_result_t ret;
+
+	FSM_DBG("fsm cyclic build ");
+
+	if( (cyclic==NULL) || (tasks==NULL) || (frames==NULL) || (slots==NULL) || (number_tasks==0) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	for( task=0; task<number_tasks; task++ )
+	{
+		if( (tasks[task].fsm == NULL) || (tasks[task].period == 0) )
+		{
+			FSM_ERR("ERROR: invalid task\r\n");
+			return(FSM_NULL);
+		}
+		major = (major / fsm_cyclic_gcd((uint32_t)major, tasks[task].period)) * tasks[task].period;
+		if( major > 0xFFFFFFFFull )
+		{
+			FSM_ERR("ERROR: major frame too long\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	memset(cyclic, 0, sizeof(fsm_cyclic_t));
+	cyclic->tasks			= tasks;
+	cyclic->number_tasks	= number_tasks;
+	cyclic->slots			= slots;
+	cyclic->frames			= frames;
+	cyclic->major			= (uint32_t)major;
+	cyclic->now				= now;
+
+	cyclic->minor = fsm_cyclic_minor(tasks, number_tasks, cyclic->major);
+	if( cyclic->minor == 0 )
+	{
+		FSM_ERR("ERROR: no feasible minor frame\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	cyclic->number_frames = cyclic->major / cyclic->minor;
+	if( (cyclic->number_frames > max_frames) || (cyclic->number_frames > 0xFFFF) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	// frames acumula a carga de cada quadro durante a alocação
+	memset(frames, 0, (cyclic->number_frames + 1) * sizeof(uint32_t));
+	while( last != 0xFFFFFFFFu )
+	{
+		next = 0xFFFFFFFFu;
+		for( task=0; task<number_tasks; task++ )
+		{
+			if( (tasks[task].period > last) && (tasks[task].period < next) )
+			{
+				next = tasks[task].period;
+			}
+		}
+		for( task=0; (next != 0xFFFFFFFFu) && (task<number_tasks); task++ )
+		{
+			if( tasks[task].period == next )
+			{
+				ret = fsm_cyclic_place(cyclic, task, frames, max_slots);
+				if( ret != FSM_OK )
+				{
+					return(ret);
+				}
+			}
+		}
+		last = next;
+	}
+
+	// Ordena as posições por quadro, preservando a ordem de alocação dentro do quadro
+	for( index=1; index<cyclic->number_slots; index++ )
+	{
+		slot = slots[index];
+		for( position=index; (position > 0) && (slots[position-1].frame > slot.frame); position-- )
+		{
+			slots[position] = slots[position-1];
+		}
+		slots[position] = slot;
+	}
+
+	position = 0;
+	for( index=0; index<=cyclic->number_frames; index++ )
+	{
+		while( (position < cyclic->number_slots) && (slots[position].frame < index) )
+		{
+			position++;
+		}
+		frames[index] = position;
+	}
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Executa o próximo quadro menor
+ * @details		Chamada a cada minor ticks, pela interrupção do timer ou por
+ *				fsm_cyclic_timerfd. Os callbacks dos estados executam no contexto de
+ *				quem chama.
+ * @param		cyclic ponteiro para estrutura do executivo
+ * @retval		FSM_NO_RESOURCES caso o quadro anterior ainda esteja em execução
+ * @retval		FSM_STATE_ERROR ou FSM_STATE_NULL caso o fsm_engine de alguma FSM falhe;
+ *				as demais FSMs do quadro são executadas
+ */
+fsm_result_t fsm_cyclic_tick(fsm_cyclic_t *cyclic)
+{
+	fsm_cyclic_task_t *task;
+	fsm_result_t ret = FSM_OK, engine;
+	uint32_t slot, start = 0, begin = 0, elapsed;
+
+	if( cyclic==NULL )
+	{
+		FSM_ERR("ERROR: cyclic null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( cyclic->busy )
+	{
+		cyclic->overruns++;
+		return(FSM_NO_RESOURCES);
+	}
+	cyclic->busy = 1;
+
+	if( cyclic->now != NULL )
+	{
+		begin = cyclic->now();
+	}
+
+	for( slot=cyclic->frames[cyclic->frame]; slot<cyclic->frames[cyclic->frame + 1]; slot++ )
+	{
+		task = &cyclic->tasks[cyclic->slots[slot].task];
+		if( cyclic->now != NULL )
+		{
+			start = cyclic->now();
+		}
+
+		engine = fsm_engine(task->fsm);
+		if( (engine == FSM_STATE_ERROR) || (engine == FSM_STATE_NULL) )
+		{
+			ret = engine;
+		}
+
+		if( cyclic->now != NULL )
+		{
+			elapsed = cyclic->now() - start;
+			if( elapsed > task->measured )
+			{
+				task->measured = elapsed;
+			}
+		}
+	}
+
+	if( (cyclic->now != NULL) && ((cyclic->now() - begin) > cyclic->minor) )
+	{
+		cyclic->overruns++;
+	}
+
+	cyclic->frame = (cyclic->frame + 1 < cyclic->number_frames) ? (cyclic->frame + 1) : 0;
+	cyclic->busy = 0;
+	return(ret);
+}
+
+#if FSM_CYCLIC_TIMERFD
+/**
+ * @brief		Conduz os quadros com um timerfd periódico (host)
+ * @details		Quadros perdidos por atraso da thread são contados em overruns e
+ *				pulados, para que a tabela continue alinhada ao tempo
+ * @param		cyclic ponteiro para estrutura do executivo
+ * @param		tick_ns duração de um tick em nanossegundos
+ * @param		number_frames quadros a executar (0 sem limite)
+ * @retval		FSM_NO_RESOURCES caso o timerfd não possa ser criado
+ */
+fsm_result_t fsm_cyclic_timerfd(fsm_cyclic_t *cyclic, uint32_t tick_ns, uint32_t number_frames)
+{
+	struct itimerspec period;
+	uint64_t interval, expirations;
+	uint32_t executed = 0;
+	int fd;
+
+	if( cyclic==NULL )
+	{
+		FSM_ERR("ERROR: cyclic null\r\n");
+		return(FSM_NULL);
+	}
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if( fd < 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	interval = (uint64_t)cyclic->minor * tick_ns;
+	period.it_interval.tv_sec	= (time_t)(interval / 1000000000ull);
+	period.it_interval.tv_nsec	= (long)(interval % 1000000000ull);
+	period.it_value				= period.it_interval;
+	if( timerfd_settime(fd, 0, &period, NULL) != 0 )
+	{
+		close(fd);
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	while( (number_frames == 0) || (executed < number_frames) )
+	{
+		if( read(fd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations) )
+		{
+			continue;
+		}
+		if( expirations > 1 )
+		{
+			cyclic->overruns	+= (uint32_t)(expirations - 1);
+			cyclic->frame		= (uint32_t)((cyclic->frame + expirations - 1) % cyclic->number_frames);
+			executed			+= (uint32_t)(expirations - 1);
+		}
+		fsm_cyclic_tick(cyclic);
+		executed++;
+	}
+
+	close(fd);
+	return(FSM_OK);
+}
+#endif
+
+/**
+ * @brief fsm_cyclic_gcd
+ *
+ * Função privada que calcula o máximo divisor comum
+ */
+static uint32_t fsm_cyclic_gcd(uint32_t a, uint32_t b)
+{
+	uint32_t r;
+
+	while( b != 0 )
+	{
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	return(a);
+}
+
+/**
+ * @brief fsm_cyclic_wcet
+ *
+ * Função privada que retorna o maior entre o tempo declarado e o medido
+ */
+static uint32_t fsm_cyclic_wcet(const fsm_cyclic_task_t *task)
+{
+	return( (task->measured > task->wcet) ? task->measured : task->wcet );
+}
+
+/**
+ * @brief fsm_cyclic_minor
+ *
+ * Função privada que escolhe o maior quadro menor viável, ou 0 caso não exista
+ */
+static uint32_t fsm_cyclic_minor(const fsm_cyclic_task_t *tasks, uint16_t number_tasks, uint32_t major)
+{
+	uint32_t frame, shortest = 0xFFFFFFFFu, longest = 0;
+	uint16_t task;
+
+	for( task=0; task<number_tasks; task++ )
+	{
+		if( tasks[task].period < shortest )
+		{
+			shortest = tasks[task].period;
+		}
+		if( fsm_cyclic_wcet(&tasks[task]) > longest )
+		{
+			longest = fsm_cyclic_wcet(&tasks[task]);
+		}
+	}
+
+	for( frame=shortest; (frame > 0) && (frame >= longest); frame-- )
+	{
+		if( (major % frame) != 0 )
+		{
+			continue;
+		}
+		// Entre a liberação e o prazo de cada execução cabe ao menos um quadro inteiro
+		for( task=0; task<number_tasks; task++ )
+		{
+			if( (2ull * frame - fsm_cyclic_gcd(frame, tasks[task].period)) > tasks[task].period )
+			{
+				break;
+			}
+		}
+		if( task == number_tasks )
+		{
+			return(frame);
+		}
+	}
+
+	return(0);
+}
+
+/**
+ * @brief fsm_cyclic_place
+ *
+ * Função privada que aloca as execuções de uma FSM em um quadro maior
+ */
+static fsm_result_t fsm_cyclic_place(fsm_cyclic_t *cyclic, uint16_t task, uint32_t *load, uint32_t max_slots)
+{
+	uint32_t period = cyclic->tasks[task].period;
+	uint32_t wcet = fsm_cyclic_wcet(&cyclic->tasks[task]);
+	uint32_t release, frame, end;
+
+	for( release=0; release<cyclic->major; release+=period )
+	{
+		frame	= (release + cyclic->minor - 1) / cyclic->minor;
+		end		= (release + period) / cyclic->minor;
+		while( (frame < end) && ((load[frame] + wcet) > cyclic->minor) )
+		{
+			frame++;
+		}
+		if( (frame >= end) || (cyclic->number_slots >= max_slots) )
+		{
+			FSM_ERR("ERROR: task %u does not fit\r\n", task);
+			return(FSM_NO_RESOURCES);
+		}
+
+		load[frame] += wcet;
+		cyclic->slots[cyclic->number_slots].frame	= (uint16_t)frame;
+		cyclic->slots[cyclic->number_slots].task	= task;
+		cyclic->number_slots++;
+	}
+
+	return(FSM_OK);
+}
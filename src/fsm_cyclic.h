@@ -0,0 +1,114 @@
+/**
+ * @file	fsm_cyclic.h
+ * @brief	Executivo cíclico para FSMs periódicas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Escalonador dirigido por tempo com tabela estática. fsm_cyclic_build
+ * calcula o quadro maior (mínimo múltiplo comum dos períodos) e o maior
+ * quadro menor que respeita as restrições clássicas (f >= maior tempo de
+ * execução, f divide o quadro maior e 2f - mdc(f, p) <= p para cada período)
+ * e distribui cada execução de cada FSM em um quadro entre a sua liberação e
+ * o seu prazo. Em execução, fsm_cyclic_tick apenas percorre as posições do
+ * quadro atual chamando fsm_engine: não há busca por prioridade a cada tick
+ * e o jitter é determinado pela tabela.
+ *
+ * No alvo, fsm_cyclic_tick é chamada a cada quadro menor pelo SysTick ou
+ * pela interrupção de um timer, por exemplo:
+ * @code
+ * HAL_SYSTICK_Config(SystemCoreClock / (1000000 / cyclic.minor));	// ticks em us
+ * void SysTick_Handler(void) { HAL_IncTick(); fsm_cyclic_tick(&cyclic); }
+ * @endcode
+ * No host, fsm_cyclic_timerfd conduz os quadros com um timerfd periódico.
+ *
+ * Os tempos de execução usados são o maior entre o declarado e o medido:
+ * com um relógio (now) as execuções são medidas, e uma nova chamada de
+ * fsm_cyclic_build considera os valores observados.
+ *
+ */
+#ifndef __FSM_CYCLIC_H__
+#define __FSM_CYCLIC_H__
+
+/**
+ * @defgroup fsm_cyclic_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__linux__)
+#	define FSM_CYCLIC_TIMERFD	1
+#else
+#	define FSM_CYCLIC_TIMERFD	0
+#endif
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Cyclic Task
+ *
+ * FSM periódica. Tempos em ticks da aplicação (por exemplo microssegundos).
+ */
+typedef struct fsm_cyclic_task
+{
+	fsm_handler_t*	fsm;		/**< FSM executada a cada período */
+	uint32_t		period;		/**< Período, igual ao prazo */
+	uint32_t		wcet;		/**< Pior tempo de execução declarado */
+	uint32_t		measured;	/**< Pior tempo de execução observado */
+} fsm_cyclic_task_t;
+
+/**
+ * @brief FSM Cyclic Slot
+ *
+ * Execução de uma FSM em um quadro menor
+ */
+typedef struct fsm_cyclic_slot
+{
+	uint16_t	frame;	/**< Quadro menor */
+	uint16_t	task;	/**< Índice da FSM em tasks */
+} fsm_cyclic_slot_t;
+
+/**
+ * @brief FSM Cyclic Executive
+ */
+typedef struct fsm_cyclic
+{
+	fsm_cyclic_task_t*	tasks;			/**< FSMs periódicas */
+	uint16_t			number_tasks;	/**< Quantidade de FSMs */
+	fsm_cyclic_slot_t*	slots;			/**< Posições, ordenadas por quadro */
+	uint32_t			number_slots;	/**< Execuções por quadro maior */
+	uint32_t*			frames;			/**< Primeira posição de cada quadro (number_frames + 1) */
+	uint32_t			number_frames;	/**< Quadros menores por quadro maior */
+	uint32_t			minor;			/**< Duração do quadro menor */
+	uint32_t			major;			/**< Duração do quadro maior */
+	uint32_t			frame;			/**< Próximo quadro */
+	uint32_t			(*now)(void);	/**< Relógio para medir as execuções (pode ser NULL) */
+	uint32_t			overruns;		/**< Quadros que excederam a duração ou foram perdidos */
+	uint32_t			busy;			/**< Diferente de zero durante um quadro */
+} fsm_cyclic_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_cyclic_build	(fsm_cyclic_t *cyclic, fsm_cyclic_task_t *tasks, uint16_t number_tasks, uint32_t *frames, uint32_t max_frames,
+								 fsm_cyclic_slot_t *slots, uint32_t max_slots, uint32_t (*now)(void));
+fsm_result_t fsm_cyclic_tick	(fsm_cyclic_t *cyclic);
+#if FSM_CYCLIC_TIMERFD
+fsm_result_t fsm_cyclic_timerfd	(fsm_cyclic_t *cyclic, uint32_t tick_ns, uint32_t number_frames);
+#endif
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,375 @@
+/**
+ * @file	fsm_map.c
+ * @brief	Instâncias da Finite State Machine materializadas sob demanda por chave
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Mapa de endereçamento aberto com sondagem linear e remoção por
+ * deslocamento reverso (sem marcadores de remoção), para que a busca nunca
+ * degrade com a rotatividade das entidades.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_map.h"
+#include "string.h"
+
+// As entidades compartilham o handler de trabalho map->fsm, que recebe apenas estado e
+// evento pendente de cada registro: eventos emitidos, adiados e payloads iriam para
+// outra entidade
+#if (FSM_EMIT_QUEUE > 0) || (FSM_DEFER_QUEUE > 0) || FSM_PAYLOAD_ENABLE
+#	error "fsm_map não suporta FSM_EMIT_QUEUE, FSM_DEFER_QUEUE nem FSM_PAYLOAD_ENABLE"
+#endif
+
+/**
+ * @defgroup fsm_map_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint32_t		fsm_map_hash	(uint64_t key);
+static uint8_t		fsm_map_find	(fsm_map_t *map, uint64_t key, uint32_t *pos);
+static void			fsm_map_remove	(fsm_map_t *map, uint32_t pos);
+static uint8_t		fsm_map_accepts	(fsm_map_t *map, void *cb_state, uint16_t eventID);
+static fsm_result_t	fsm_map_insert	(fsm_map_t *map, uint64_t key, uint32_t pos);
+static fsm_result_t	fsm_map_run		(fsm_map_t *map, uint32_t pos);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa um mapa de instâncias
+ * @param		map ponteiro para estrutura do mapa
+ * @param		entries posições do mapa, fornecidas pela aplicação
+ * @param		capacity quantidade de posições (potência de 2, ao menos FSM_MAP_LOAD_DEN);
+ *				no máximo 7/8 são ocupadas
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state estado das entidades que ainda não receberam eventos
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @retval		FSM_NO_RESOURCES caso capacity não seja uma potência de 2 ou seja menor que
+ *				FSM_MAP_LOAD_DEN (o limite de ocupação seria zero)
+ */
+fsm_result_t fsm_map_init(fsm_map_t *map, fsm_map_entry_t *entries, uint32_t capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events)
+{
+	fsm_result_t ret;
+
+	FSM_DBG("fsm map init ");
+
+	if( (map==NULL) || (entries==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (capacity < FSM_MAP_LOAD_DEN) || ((capacity & (capacity - 1)) != 0) )
+	{
+		FSM_ERR("ERROR: invalid capacity\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(map, 0, sizeof(fsm_map_t));
+	ret = fsm_create(&map->fsm, stateTable, initial_state, fsm_name, number_events);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	memset(entries, 0, capacity * sizeof(fsm_map_entry_t));
+	map->initial_state	= initial_state;
+	map->entries		= entries;
+	map->capacity		= capacity;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Entrega um evento a uma entidade
+ * @details		Uma entidade sem registro só é materializada quando o evento causa uma
+ *				transição a partir do estado inicial; caso contrário o evento é recusado
+ *				com FSM_EVENT_ERROR, exatamente como o fsm_engine faria, sem ocupar memória.
+ *				Um evento pendente retornado pelo callback da entidade é processado antes
+ *				do evento enviado. Os callbacks não devem enviar eventos para o mesmo mapa.
+ * @param		map ponteiro para estrutura do mapa
+ * @param		key chave da entidade
+ * @param		eventID evento enviado
+ * @return		Resultado do fsm_engine para o evento enviado
+ * @retval		FSM_NO_RESOURCES caso o mapa esteja cheio, ou a entidade ainda tenha um
+ *				evento pendente após processar o anterior (o evento enviado não é entregue)
+ */
+fsm_result_t fsm_map_post(fsm_map_t *map, uint64_t key, uint16_t eventID)
+{
+	uint32_t pos;
+
+	if( map==NULL )
+	{
+		FSM_ERR("ERROR: map null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( eventID >= map->fsm.number_events )
+	{
+		return(FSM_NO_TRANSITION);
+	}
+
+	if( fsm_map_find(map, key, &pos) && (map->entries[pos].eventID < map->fsm.number_events) )
+	{
+		fsm_map_run(map, pos);
+		if( fsm_map_find(map, key, &pos) && (map->entries[pos].eventID < map->fsm.number_events) )
+		{
+			FSM_ERR("ERROR: event pending\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	if( !fsm_map_find(map, key, &pos) )
+	{
+		if( !fsm_map_accepts(map, map->initial_state, eventID) )
+		{
+			return(FSM_EVENT_ERROR);
+		}
+		if( fsm_map_insert(map, key, pos) != FSM_OK )
+		{
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	map->entries[pos].eventID = eventID;
+	return(fsm_map_run(map, pos));
+}
+
+/**
+ * @brief		Executa um passo da máquina de estado de uma entidade
+ * @details		Equivale a chamar fsm_engine na instância da entidade: processa o evento
+ *				pendente, se houver, e executa o callback do estado atual. Uma entidade
+ *				sem registro executa o estado inicial na FSM de trabalho e só é
+ *				materializada se o callback deixar um evento pendente.
+ * @param		map ponteiro para estrutura do mapa
+ * @param		key chave da entidade
+ * @retval		FSM_NO_RESOURCES caso o mapa esteja cheio e o evento pendente da entidade
+ *				sem registro não possa ser guardado (o evento é descartado)
+ */
+fsm_result_t fsm_map_engine(fsm_map_t *map, uint64_t key)
+{
+	fsm_result_t ret;
+	uint32_t pos;
+
+	if( map==NULL )
+	{
+		FSM_ERR("ERROR: map null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( fsm_map_find(map, key, &pos) )
+	{
+		return(fsm_map_run(map, pos));
+	}
+
+	map->key			= key;
+	map->fsm.cb_state	= map->initial_state;
+	map->fsm.eventID	= map->fsm.number_events;
+
+	ret = fsm_engine(&map->fsm);
+
+	// Sem evento o estado não muda: resta guardar apenas o evento pendente
+	if( map->fsm.eventID < map->fsm.number_events )
+	{
+		if( fsm_map_insert(map, key, pos) != FSM_OK )
+		{
+			return(FSM_NO_RESOURCES);
+		}
+		map->entries[pos].cb_state	= map->fsm.cb_state;
+		map->entries[pos].eventID	= map->fsm.eventID;
+	}
+
+	return(ret);
+}
+
+/**
+ * @brief		Retorna o estado atual de uma entidade
+ * @param		map ponteiro para estrutura do mapa
+ * @param		key chave da entidade
+ * @return		Ponteiro para o callback do estado (o estado inicial quando não há registro)
+ */
+void* fsm_map_state(fsm_map_t *map, uint64_t key)
+{
+	uint32_t pos;
+
+	if( fsm_map_find(map, key, &pos) )
+	{
+		return(map->entries[pos].cb_state);
+	}
+	return(map->initial_state);
+}
+
+/**
+ * @brief		Retorna o evento pendente de uma entidade
+ * @details		Um evento retornado pelo callback fica pendente até o próximo
+ *				fsm_map_engine ou fsm_map_post da entidade
+ * @param		map ponteiro para estrutura do mapa
+ * @param		key chave da entidade
+ * @return		Evento pendente, ou number_events quando não há
+ */
+uint16_t fsm_map_pending(fsm_map_t *map, uint64_t key)
+{
+	uint32_t pos;
+
+	if( fsm_map_find(map, key, &pos) )
+	{
+		return(map->entries[pos].eventID);
+	}
+	return(map->fsm.number_events);
+}
+
+/**
+ * @brief		Retorna a chave da entidade em execução
+ * @param		fsm ponteiro recebido pelo callback do estado
+ */
+uint64_t fsm_map_key(fsm_handler_t *fsm)
+{
+	return(((fsm_map_t*)fsm)->key);
+}
+
+/**
+ * @brief fsm_map_hash
+ *
+ * Função privada que espalha os bits da chave (finalizador do MurmurHash3)
+ */
+static uint32_t fsm_map_hash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDull;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ull;
+	key ^= key >> 33;
+	return((uint32_t)key);
+}
+
+/**
+ * @brief fsm_map_find
+ *
+ * Função privada que procura a chave; retorna 1 e a posição do registro, ou 0 e a
+ * posição livre onde a chave deve ser inserida
+ */
+static uint8_t fsm_map_find(fsm_map_t *map, uint64_t key, uint32_t *pos)
+{
+	uint32_t mask = map->capacity - 1;
+	uint32_t i = fsm_map_hash(key) & mask;
+
+	while( map->entries[i].cb_state != NULL )
+	{
+		if( map->entries[i].key == key )
+		{
+			*pos = i;
+			return(1);
+		}
+		i = (i + 1) & mask;
+	}
+
+	*pos = i;
+	return(0);
+}
+
+/**
+ * @brief fsm_map_insert
+ *
+ * Função privada que cria o registro de uma entidade no estado inicial
+ */
+static fsm_result_t fsm_map_insert(fsm_map_t *map, uint64_t key, uint32_t pos)
+{
+	if( (map->count + 1) > ((map->capacity / FSM_MAP_LOAD_DEN) * FSM_MAP_LOAD_NUM) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	map->entries[pos].key		= key;
+	map->entries[pos].cb_state	= map->initial_state;
+	map->entries[pos].eventID	= map->fsm.number_events;
+	map->count++;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_map_remove
+ *
+ * Função privada que libera um registro e desloca para trás os registros seguintes
+ * do mesmo agrupamento, mantendo as sequências de sondagem contíguas
+ */
+static void fsm_map_remove(fsm_map_t *map, uint32_t pos)
+{
+	uint32_t mask = map->capacity - 1;
+	uint32_t next = (pos + 1) & mask;
+	uint32_t home;
+
+	while( map->entries[next].cb_state != NULL )
+	{
+		home = fsm_map_hash(map->entries[next].key) & mask;
+		// Move o registro se a posição livre está entre a posição ideal dele e a atual
+		if( ((next - home) & mask) >= ((next - pos) & mask) )
+		{
+			map->entries[pos] = map->entries[next];
+			pos = next;
+		}
+		next = (next + 1) & mask;
+	}
+
+	map->entries[pos].cb_state = NULL;
+	map->count--;
+}
+
+/**
+ * @brief fsm_map_accepts
+ *
+ * Função privada que verifica se a tabela possui transição para o par estado/evento
+ */
+static uint8_t fsm_map_accepts(fsm_map_t *map, void *cb_state, uint16_t eventID)
+{
+	fsm_state_t *table = map->fsm.stateTable;
+	uint32_t row;
+
+	for( row=0; table[row].cb_state != NULL; row++ )
+	{
+		if( (table[row].cb_state == cb_state) && (table[row].eventID == eventID) )
+		{
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/**
+ * @brief fsm_map_run
+ *
+ * Função privada que executa o fsm_engine sobre o registro e o libera quando a
+ * entidade volta ao estado inicial sem evento pendente
+ */
+static fsm_result_t fsm_map_run(fsm_map_t *map, uint32_t pos)
+{
+	fsm_map_entry_t *entry = &map->entries[pos];
+	fsm_result_t ret;
+
+	map->key			= entry->key;
+	map->fsm.cb_state	= entry->cb_state;
+	map->fsm.eventID	= entry->eventID;
+
+	ret = fsm_engine(&map->fsm);
+
+	entry->cb_state	= map->fsm.cb_state;
+	entry->eventID	= map->fsm.eventID;
+
+	if( (entry->cb_state == map->initial_state) && (entry->eventID >= map->fsm.number_events) )
+	{
+		fsm_map_remove(map, pos);
+	}
+
+	return(ret);
+}
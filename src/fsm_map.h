@@ -0,0 +1,89 @@
+/**
+ * @file	fsm_map.h
+ * @brief	Instâncias da Finite State Machine materializadas sob demanda por chave
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Mapa de endereçamento aberto (sondagem linear) de uma chave de 64 bits
+ * para um registro compacto de instância. Entidades que estão no estado
+ * inicial, sem evento pendente, não ocupam registro: ele é criado apenas
+ * quando chega o primeiro evento que causa uma transição, ou quando o estado
+ * inicial deixa um evento pendente, e é liberado quando a instância volta
+ * ao estado inicial sem nada pendente. A memória passa a
+ * ser proporcional às entidades ativas, e não ao total de entidades.
+ *
+ * Todas as entidades compartilham a tabela de transição e uma FSM de
+ * trabalho; dentro dos callbacks a chave da entidade em execução é obtida
+ * com fsm_map_key(this). Como a FSM de trabalho só recebe o estado e o
+ * evento pendente de cada registro, não suporta FSM_EMIT_QUEUE,
+ * FSM_DEFER_QUEUE nem FSM_PAYLOAD_ENABLE.
+ *
+ */
+#ifndef __FSM_MAP_H__
+#define __FSM_MAP_H__
+
+/**
+ * @defgroup fsm_map_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_MAP_LOAD_NUM	7	/**< Ocupação máxima do mapa: 7/8 das posições */
+#define FSM_MAP_LOAD_DEN	8
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Map Entry
+ *
+ * Registro de uma entidade ativa. Posições livres têm cb_state NULL.
+ */
+typedef struct fsm_map_entry
+{
+	uint64_t	key;		/**< Chave da entidade */
+	void*		cb_state;	/**< Estado atual da entidade */
+	uint16_t	eventID;	/**< Evento pendente (number_events quando não há) */
+} fsm_map_entry_t;
+
+/**
+ * @brief FSM Map
+ *
+ * A FSM de trabalho deve ser o primeiro campo, para que fsm_map_key possa
+ * obter o mapa a partir do ponteiro recebido pelos callbacks.
+ */
+typedef struct fsm_map
+{
+	fsm_handler_t		fsm;			/**< FSM de trabalho (tabela, nome e eventos compartilhados) */
+	void*				initial_state;	/**< Estado das entidades sem registro */
+	fsm_map_entry_t*	entries;		/**< Posições do mapa, fornecidas pela aplicação */
+	uint32_t			capacity;		/**< Quantidade de posições (potência de 2) */
+	uint32_t			count;			/**< Registros em uso */
+	uint64_t			key;			/**< Chave da entidade em execução */
+} fsm_map_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_map_init	(fsm_map_t *map, fsm_map_entry_t *entries, uint32_t capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_map_post	(fsm_map_t *map, uint64_t key, uint16_t eventID);
+fsm_result_t fsm_map_engine	(fsm_map_t *map, uint64_t key);
+void*		 fsm_map_state	(fsm_map_t *map, uint64_t key);
+uint16_t	 fsm_map_pending	(fsm_map_t *map, uint64_t key);
+uint64_t	 fsm_map_key	(fsm_handler_t *fsm);
+
+/**
+ * @}
+ */
+
+#endif
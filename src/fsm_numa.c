@@ -0,0 +1,341 @@
+/**
+ * @file	fsm_numa.c
+ * @brief	Posicionamento em nós NUMA e páginas grandes da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * A política de nó é aplicada antes do primeiro acesso, então as páginas já
+ * nascem no nó escolhido; em áreas já utilizadas, fsm_numa_bind também migra
+ * as páginas existentes (MPOL_MF_MOVE).
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_numa.h"
+#include "string.h"
+
+#if FSM_NUMA_ENABLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#	include <dirent.h>
+#	include <sys/syscall.h>
+#endif
+
+/**
+ * @defgroup fsm_numa_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_NUMA_MAX_NODES			1024	/**< Nós representáveis na máscara do mbind */
+#define FSM_NUMA_MPOL_PREFERRED		1		/**< Valores de <numaif.h>, sem depender da libnuma */
+#define FSM_NUMA_MPOL_BIND			2
+#define FSM_NUMA_MPOL_MF_MOVE		(1 << 1)
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static size_t	fsm_numa_length	(size_t size, uint8_t flags);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Prepara um alocador fsm_alloc_t para um nó
+ * @param		allocator recebe o gancho de alocação
+ * @param		numa contexto do alocador; deve permanecer válido enquanto o gancho for usado
+ * @param		node nó das alocações, ou FSM_NUMA_ANY
+ * @param		flags FSM_NUMA_HUGE, FSM_NUMA_STRICT
+ */
+void fsm_numa_allocator(fsm_alloc_t *allocator, fsm_numa_t *numa, int node, uint8_t flags)
+{
+	numa->node		= node;
+	numa->flags		= flags;
+	numa->huge		= FSM_NUMA_PAGES_SMALL;
+	numa->bound		= 0;
+
+	allocator->alloc	= fsm_numa_alloc;
+	allocator->release	= fsm_numa_release;
+	allocator->context	= numa;
+}
+
+/**
+ * @brief		Aloca uma área no nó e com as páginas do contexto
+ * @details		A área é zerada e alinhada à página. Com FSM_NUMA_HUGE o tamanho é
+ *				arredondado para múltiplos de FSM_NUMA_HUGE_PAGE.
+ * @param		size tamanho da área
+ * @param		context fsm_numa_t do alocador
+ * @return		Área alocada, ou NULL caso não haja memória ou, com FSM_NUMA_STRICT,
+ *				a área não possa ser ligada ao nó
+ */
+void* fsm_numa_alloc(size_t size, void *context)
+{
+	fsm_numa_t *numa = (fsm_numa_t*)context;
+	size_t length = fsm_numa_length(size, numa->flags);
+	uintptr_t base;
+	uint8_t *raw;
+	void *ptr = MAP_FAILED;
+
+	numa->huge	= FSM_NUMA_PAGES_SMALL;
+	numa->bound	= 0;
+
+	if( size == 0 )
+	{
+		return(NULL);
+	}
+
+	if( numa->flags & FSM_NUMA_HUGE )
+	{
+#ifdef MAP_HUGETLB
+		ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if( ptr != MAP_FAILED )
+		{
+			numa->huge = FSM_NUMA_PAGES_EXPLICIT;
+		}
+#endif
+		if( ptr == MAP_FAILED )
+		{
+			// Sem páginas reservadas: área alinhada em 2 MB para as páginas transparentes
+			raw = (uint8_t*)mmap(NULL, length + FSM_NUMA_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if( raw == (uint8_t*)MAP_FAILED )
+			{
+				FSM_ERR("ERROR: without resources\r\n");
+				return(NULL);
+			}
+			base = ((uintptr_t)raw + FSM_NUMA_HUGE_PAGE - 1) & ~(uintptr_t)(FSM_NUMA_HUGE_PAGE - 1);
+			if( base > (uintptr_t)raw )
+			{
+				munmap(raw, base - (uintptr_t)raw);
+			}
+			if( (uintptr_t)raw + length + FSM_NUMA_HUGE_PAGE > base + length )
+			{
+				munmap((void*)(base + length), (uintptr_t)raw + length + FSM_NUMA_HUGE_PAGE - (base + length));
+			}
+			ptr = (void*)base;
+#ifdef MADV_HUGEPAGE
+			if( madvise(ptr, length, MADV_HUGEPAGE) == 0 )
+			{
+				numa->huge = FSM_NUMA_PAGES_TRANSPARENT;
+			}
+#endif
+		}
+	}
+	else
+	{
+		ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if( ptr == MAP_FAILED )
+		{
+			FSM_ERR("ERROR: without resources\r\n");
+			return(NULL);
+		}
+	}
+
+	if( numa->node != FSM_NUMA_ANY )
+	{
+		if( fsm_numa_bind(ptr, length, numa->node, numa->flags) == FSM_OK )
+		{
+			numa->bound = 1;
+		}
+		else if( numa->flags & FSM_NUMA_STRICT )
+		{
+			munmap(ptr, length);
+			return(NULL);
+		}
+	}
+
+	return(ptr);
+}
+
+/**
+ * @brief		Devolve uma área obtida com fsm_numa_alloc
+ * @param		ptr área
+ * @param		size tamanho passado a fsm_numa_alloc
+ * @param		context fsm_numa_t do alocador (as mesmas flags da alocação)
+ */
+void fsm_numa_release(void *ptr, size_t size, void *context)
+{
+	fsm_numa_t *numa = (fsm_numa_t*)context;
+
+	if( ptr != NULL )
+	{
+		munmap(ptr, fsm_numa_length(size, numa->flags));
+	}
+}
+
+/**
+ * @brief		Liga uma área a um nó NUMA
+ * @details		A área é estendida até os limites de página; páginas já utilizadas
+ *				são migradas para o nó
+ * @param		ptr início da área
+ * @param		size tamanho da área
+ * @param		node nó de destino
+ * @param		flags FSM_NUMA_STRICT usa MPOL_BIND; sem ela, MPOL_PREFERRED
+ * @retval		FSM_NO_RESOURCES caso o nó não exista ou o sistema não suporte mbind
+ */
+fsm_result_t fsm_numa_bind(void *ptr, size_t size, int node, uint8_t flags)
+{
+#ifdef __linux__
+	unsigned long mask[FSM_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start, end;
+
+	if( ptr == NULL )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (node < 0) || (node >= FSM_NUMA_MAX_NODES) )
+	{
+		FSM_ERR("ERROR: invalid node\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+	start	= (uintptr_t)ptr & ~(page - 1);
+	end		= ((uintptr_t)ptr + size + page - 1) & ~(page - 1);
+
+	if( syscall(SYS_mbind, start, end - start, (flags & FSM_NUMA_STRICT) ? FSM_NUMA_MPOL_BIND : FSM_NUMA_MPOL_PREFERRED,
+				mask, (unsigned long)FSM_NUMA_MAX_NODES, FSM_NUMA_MPOL_MF_MOVE) != 0 )
+	{
+		FSM_ERR("ERROR: mbind\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	return(FSM_OK);
+#else
+	(void)ptr;
+	(void)size;
+	(void)node;
+	(void)flags;
+	return(FSM_NO_RESOURCES);
+#endif
+}
+
+/**
+ * @brief		Retorna o nó NUMA de um núcleo
+ * @param		cpu núcleo
+ * @return		Nó do núcleo, ou FSM_NUMA_ANY caso não seja possível determiná-lo
+ */
+int fsm_numa_node_of_cpu(int cpu)
+{
+	int node = FSM_NUMA_ANY;
+#ifdef __linux__
+	char path[64];
+	struct dirent *entry;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if( dir == NULL )
+	{
+		return(FSM_NUMA_ANY);
+	}
+
+	// O diretório do núcleo contém um link nodeN para o seu nó
+	while( (entry = readdir(dir)) != NULL )
+	{
+		if( (strncmp(entry->d_name, "node", 4) == 0) && (entry->d_name[4] >= '0') && (entry->d_name[4] <= '9') )
+		{
+			node = atoi(&entry->d_name[4]);
+			break;
+		}
+	}
+	closedir(dir);
+#else
+	(void)cpu;
+#endif
+	return(node);
+}
+
+#if FSM_TABLE_ENABLE
+/**
+ * @brief		Cria uma réplica de uma tabela indexada em memória do alocador
+ * @details		Callbacks e próximos estados são copiados para uma única área, por
+ *				exemplo no nó do shard que usará a réplica com fsm_create_table
+ * @param		replica recebe a tabela replicada
+ * @param		table tabela original (ver fsm_table_compile e fsm_bundle_table)
+ * @param		allocator alocador da réplica
+ * @retval		FSM_NO_RESOURCES caso o alocador falhe
+ */
+fsm_result_t fsm_numa_table(fsm_table_t *replica, const fsm_table_t *table, const fsm_alloc_t *allocator)
+{
+	size_t callbacks, next;
+	uint8_t *area;
+
+	if( (replica==NULL) || (table==NULL) || (allocator==NULL) || (allocator->alloc==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	callbacks	= (size_t)table->number_states * sizeof(void*);
+	next		= (size_t)table->number_states * table->number_events * sizeof(uint16_t);
+	area = (uint8_t*)allocator->alloc(callbacks + next, allocator->context);
+	if( area == NULL )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memcpy(area, table->callbacks, callbacks);
+	memcpy(area + callbacks, table->next, next);
+
+	replica->callbacks		= (void* const*)area;
+	replica->next			= (const uint16_t*)(area + callbacks);
+	replica->number_states	= table->number_states;
+	replica->number_events	= table->number_events;
+	replica->initial		= table->initial;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Libera uma réplica criada com fsm_numa_table
+ * @details		As FSMs criadas sobre a réplica deixam de ser válidas
+ * @param		replica tabela replicada
+ * @param		allocator o mesmo alocador usado na criação
+ */
+fsm_result_t fsm_numa_table_release(fsm_table_t *replica, const fsm_alloc_t *allocator)
+{
+	if( (replica==NULL) || (allocator==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (replica->callbacks != NULL) && (allocator->release != NULL) )
+	{
+		allocator->release((void*)replica->callbacks, (size_t)replica->number_states * (sizeof(void*) + replica->number_events * sizeof(uint16_t)),
+						   allocator->context);
+	}
+	memset(replica, 0, sizeof(fsm_table_t));
+
+	return(FSM_OK);
+}
+#endif
+
+/**
+ * @brief fsm_numa_length
+ *
+ * Função privada que arredonda o tamanho para páginas comuns ou de 2 MB
+ */
+static size_t fsm_numa_length(size_t size, uint8_t flags)
+{
+	size_t unit = (flags & FSM_NUMA_HUGE) ? FSM_NUMA_HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+
+	return((size + unit - 1) & ~(unit - 1));
+}
+
+#endif
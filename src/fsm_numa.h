@@ -0,0 +1,93 @@
+/**
+ * @file	fsm_numa.h
+ * @brief	Posicionamento em nós NUMA e páginas grandes da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Alocador para os ganchos fsm_alloc_t (fsm_pool_init_alloc, fsm_numa_table)
+ * que liga a memória a um nó NUMA com mbind antes do primeiro acesso e, para
+ * áreas grandes, usa páginas de 2 MB: explícitas (MAP_HUGETLB), quando o
+ * sistema tem páginas reservadas, ou transparentes (madvise MADV_HUGEPAGE)
+ * sobre uma área alinhada em 2 MB. Sem suporte do sistema a alocação
+ * continua com páginas comuns e no nó padrão; os campos huge e bound de
+ * fsm_numa_t informam o que foi obtido na última alocação.
+ *
+ * mbind é chamado diretamente pela chamada de sistema, sem depender da
+ * libnuma. Cada shard (fsm_shard.h) pode receber réplicas da tabela e das
+ * suas áreas no nó do próprio núcleo, obtido com fsm_numa_node_of_cpu.
+ *
+ * Disponível apenas em sistemas com mmap (FSM_NUMA_ENABLE); o nó só é
+ * respeitado no Linux.
+ *
+ */
+#ifndef __FSM_NUMA_H__
+#define __FSM_NUMA_H__
+
+/**
+ * @defgroup fsm_numa_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+#include "fsm_pool.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_NUMA_ENABLE	1
+#else
+#	define FSM_NUMA_ENABLE	0
+#endif
+
+#define FSM_NUMA_HUGE_PAGE		(2u * 1024u * 1024u)	/**< Tamanho das páginas grandes */
+#define FSM_NUMA_ANY			(-1)					/**< Sem preferência de nó */
+
+#define FSM_NUMA_HUGE			0x01	/**< Usa páginas de 2 MB quando possível */
+#define FSM_NUMA_STRICT			0x02	/**< Falha em vez de usar outro nó quando o nó está cheio */
+
+#define FSM_NUMA_PAGES_SMALL		0	/**< Páginas comuns */
+#define FSM_NUMA_PAGES_TRANSPARENT	1	/**< Páginas grandes transparentes solicitadas */
+#define FSM_NUMA_PAGES_EXPLICIT		2	/**< Páginas grandes reservadas (MAP_HUGETLB) */
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM NUMA Allocator Context
+ */
+typedef struct fsm_numa
+{
+	int			node;	/**< Nó das alocações, ou FSM_NUMA_ANY */
+	uint8_t		flags;	/**< FSM_NUMA_HUGE, FSM_NUMA_STRICT */
+	uint8_t		huge;	/**< Páginas obtidas na última alocação (FSM_NUMA_PAGES_*) */
+	uint8_t		bound;	/**< Diferente de zero se a última alocação foi ligada ao nó */
+} fsm_numa_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+#if FSM_NUMA_ENABLE
+void		 fsm_numa_allocator		(fsm_alloc_t *allocator, fsm_numa_t *numa, int node, uint8_t flags);
+void*		 fsm_numa_alloc			(size_t size, void *context);
+void		 fsm_numa_release		(void *ptr, size_t size, void *context);
+fsm_result_t fsm_numa_bind			(void *ptr, size_t size, int node, uint8_t flags);
+int			 fsm_numa_node_of_cpu	(int cpu);
+#if FSM_TABLE_ENABLE
+fsm_result_t fsm_numa_table			(fsm_table_t *replica, const fsm_table_t *table, const fsm_alloc_t *allocator);
+fsm_result_t fsm_numa_table_release	(fsm_table_t *replica, const fsm_alloc_t *allocator);
+#endif
+#endif
+
+/**
+ * @}
+ */
+
+#endif
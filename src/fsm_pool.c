@@ -0,0 +1,260 @@
+/**
+ * @file	fsm_pool.c
+ * @brief	Pool de tamanho fixo para instâncias dinâmicas da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Alocador slab de estruturas fsm_handler_t com lista livre intrusiva.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_pool.h"
+#include "string.h"
+#include <stddef.h>
+
+#if !FSM_STATIC_ONLY
+
+// fsm_pool_destroy reconhece uma posição livre por cb_state NULL: o encadeamento da
+// lista livre não pode alcançá-lo, mesmo com FSM_NAME_MAX_LENGTH menor que um ponteiro
+_Static_assert(offsetof(fsm_handler_t, cb_state) >= sizeof(fsm_slot_t*), "FSM_NAME_MAX_LENGTH sobrepõe cb_state ao encadeamento do pool");
+
+#if FSM_POOL_MMAP
+#	include <sys/mman.h>
+#endif
+
+/**
+ * @brief		Inicializa um pool de instâncias
+ * @details		Com arena NULL (apenas no host) as páginas são obtidas com mmap e
+ *				devolvidas em fsm_pool_deinit. As páginas só são efetivamente alocadas
+ *				pelo sistema quando a posição correspondente é utilizada.
+ * @param		pool ponteiro para estrutura do pool
+ * @param		arena área de memória do pool, ou NULL para mapear size bytes
+ * @param		size tamanho da área em bytes (ver FSM_POOL_ARENA_SIZE)
+ * @retval		FSM_NO_RESOURCES caso a área não comporte nenhuma instância ou o mmap falhe
+ */
+fsm_result_t fsm_pool_init(fsm_pool_t *pool, void *arena, size_t size)
+{
+	uintptr_t start, align;
+	size_t capacity;
+
+	FSM_DBG("fsm pool init ");
+
+	if( pool==NULL )
+	{
+		FSM_ERR("ERROR: pool null\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(pool, 0, sizeof(fsm_pool_t));
+
+	if( arena==NULL )
+	{
+#if FSM_POOL_MMAP
+		arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if( arena == MAP_FAILED )
+		{
+			FSM_ERR("ERROR: without resources\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+		pool->mapped		= arena;
+		pool->mapped_size	= size;
+#else
+		FSM_ERR("ERROR: arena null\r\n");
+		return(FSM_NULL);
+#endif
+	}
+
+	// Alinha o início da área ao tamanho de ponteiro
+	align = sizeof(void*);
+	start = ((uintptr_t)arena + align - 1) & ~(align - 1);
+	if( size < (start - (uintptr_t)arena) + sizeof(fsm_slot_t) )
+	{
+		fsm_pool_deinit(pool);
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	capacity = (size - (start - (uintptr_t)arena)) / sizeof(fsm_slot_t);
+	if( capacity > 0xFFFFFFFFu )
+	{
+		capacity = 0xFFFFFFFFu;
+	}
+
+	pool->slots		= (fsm_slot_t*)start;
+	pool->capacity	= (uint32_t)capacity;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Inicializa um pool de instâncias com um alocador da aplicação
+ * @details		A área é obtida do alocador e devolvida a ele em fsm_pool_deinit, por
+ *				exemplo para posicionar o pool em um nó NUMA ou em páginas grandes
+ * @param		pool ponteiro para estrutura do pool
+ * @param		size tamanho da área em bytes (ver FSM_POOL_ARENA_SIZE)
+ * @param		allocator alocador da área; deve permanecer válido até fsm_pool_deinit
+ * @retval		FSM_NO_RESOURCES caso o alocador falhe ou a área não comporte nenhuma instância
+ */
+fsm_result_t fsm_pool_init_alloc(fsm_pool_t *pool, size_t size, const fsm_alloc_t *allocator)
+{
+	fsm_result_t ret;
+	void *arena;
+
+	if( (pool==NULL) || (allocator==NULL) || (allocator->alloc==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	arena = allocator->alloc(size, allocator->context);
+	if( arena == NULL )
+	{
+		memset(pool, 0, sizeof(fsm_pool_t));
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	ret = fsm_pool_init(pool, arena, size);
+	if( ret != FSM_OK )
+	{
+		if( allocator->release != NULL )
+		{
+			allocator->release(arena, size, allocator->context);
+		}
+		return(ret);
+	}
+
+	pool->mapped		= arena;
+	pool->mapped_size	= size;
+	pool->allocator		= allocator;
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Finaliza um pool de instâncias
+ * @details		Todas as instâncias do pool deixam de ser válidas. Páginas obtidas com
+ *				mmap são devolvidas ao sistema, e áreas obtidas de um alocador, a ele.
+ * @param		pool ponteiro para estrutura do pool
+ */
+fsm_result_t fsm_pool_deinit(fsm_pool_t *pool)
+{
+	if( pool==NULL )
+	{
+		FSM_ERR("ERROR: pool null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (pool->allocator != NULL) && (pool->allocator->release != NULL) )
+	{
+		pool->allocator->release(pool->mapped, pool->mapped_size, pool->allocator->context);
+	}
+#if FSM_POOL_MMAP
+	else if( (pool->allocator == NULL) && (pool->mapped != NULL) )
+	{
+		munmap(pool->mapped, pool->mapped_size);
+	}
+#endif
+
+	memset(pool, 0, sizeof(fsm_pool_t));
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Cria uma FSM em uma posição do pool
+ * @details		Retira uma posição do pool em O(1) e a inicializa com fsm_create
+ * @param		pool ponteiro para estrutura do pool
+ * @param		fsm recebe o ponteiro para a FSM criada
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state ponteiro para a função que será executada na primeira iteração da FSM
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @retval		FSM_NO_RESOURCES caso o pool esteja cheio
+ */
+fsm_result_t fsm_pool_create(fsm_pool_t *pool, fsm_handler_t **fsm, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events)
+{
+	fsm_slot_t *slot;
+	fsm_result_t ret;
+
+	if( (pool==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( pool->free_list != NULL )
+	{
+		slot = pool->free_list;
+		pool->free_list = slot->next;
+	}
+	else if( pool->bump < pool->capacity )
+	{
+		slot = &pool->slots[pool->bump++];
+	}
+	else
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	ret = fsm_create(&slot->fsm, stateTable, initial_state, fsm_name, number_events);
+	if( ret != FSM_OK )
+	{
+		slot->fsm.cb_state = NULL;
+		slot->next = pool->free_list;
+		pool->free_list = slot;
+		return(ret);
+	}
+
+	pool->used++;
+	*fsm = &slot->fsm;
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Destrói uma FSM criada com fsm_pool_create
+ * @details		Devolve a posição à lista livre do pool em O(1). Posições livres têm
+ *				cb_state NULL, o que não ocorre em uma FSM criada
+ * @param		pool pool de onde a FSM foi obtida
+ * @param		fsm ponteiro para estrutura FSM
+ * @retval		FSM_STATE_ERROR caso a FSM não pertença ao pool
+ * @retval		FSM_STATE_NULL caso a FSM já tenha sido destruída
+ */
+fsm_result_t fsm_pool_destroy(fsm_pool_t *pool, fsm_handler_t *fsm)
+{
+	fsm_slot_t *slot = (fsm_slot_t*)fsm;
+
+	if( (pool==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (slot < pool->slots) || (slot >= &pool->slots[pool->bump]) ||
+		((((uintptr_t)slot - (uintptr_t)pool->slots) % sizeof(fsm_slot_t)) != 0) )
+	{
+		FSM_ERR("ERROR: fsm outside pool\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	// O encadeamento da lista livre ocupa apenas o nome, antes de cb_state
+	if( fsm->cb_state == NULL )
+	{
+		FSM_ERR("ERROR: fsm already destroyed\r\n");
+		return(FSM_STATE_NULL);
+	}
+
+	fsm_destroy(fsm);
+
+	slot->next = pool->free_list;
+	pool->free_list = slot;
+	pool->used--;
+
+	return(FSM_OK);
+}
+
+#endif
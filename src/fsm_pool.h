@@ -0,0 +1,105 @@
+/**
+ * @file	fsm_pool.h
+ * @brief	Pool de tamanho fixo para instâncias dinâmicas da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Alocador slab de estruturas fsm_handler_t sobre uma área fornecida pela
+ * aplicação ou, no host, sobre páginas obtidas com mmap. As posições livres
+ * formam uma lista encadeada intrusiva, de modo que criar e destruir uma
+ * instância é O(1), sem fragmentação e sem chamadas ao malloc.
+ *
+ * Disponível apenas com FSM_STATIC_ONLY 0.
+ *
+ */
+#ifndef __FSM_POOL_H__
+#define __FSM_POOL_H__
+
+/**
+ * @defgroup fsm_pool_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_POOL_MMAP	1	/**< fsm_pool_init aceita arena NULL e mapeia as páginas */
+#else
+#	define FSM_POOL_MMAP	0
+#endif
+
+/**
+ * @brief Tamanho da área necessária para n instâncias (inclui a margem de alinhamento)
+ */
+#define FSM_POOL_ARENA_SIZE(n)	((n) * sizeof(fsm_slot_t) + sizeof(void*))
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Allocator
+ *
+ * Gancho de alocação de áreas grandes (pools, réplicas de tabelas), por
+ * exemplo para posicionar a memória em um nó NUMA (ver fsm_numa.h)
+ */
+typedef struct fsm_alloc
+{
+	void*	(*alloc)	(size_t size, void *context);			/**< Retorna a área ou NULL */
+	void	(*release)	(void *ptr, size_t size, void *context);	/**< Devolve uma área obtida com alloc */
+	void*	context;											/**< Contexto do alocador */
+} fsm_alloc_t;
+
+/**
+ * @brief FSM Pool Slot
+ *
+ * Posição do pool: contém uma FSM em uso ou o encadeamento da lista livre
+ */
+typedef union fsm_slot
+{
+	union fsm_slot*	next;	/**< Próxima posição livre */
+	fsm_handler_t	fsm;	/**< Instância em uso */
+} fsm_slot_t;
+
+/**
+ * @brief FSM Pool
+ *
+ * As posições nunca usadas são entregues em ordem (bump), e só as posições
+ * devolvidas entram na lista livre; assim a inicialização é O(1) e páginas
+ * mapeadas só são tocadas quando utilizadas.
+ */
+typedef struct fsm_pool
+{
+	fsm_slot_t*	slots;		/**< Primeira posição do pool */
+	fsm_slot_t*	free_list;	/**< Posições devolvidas */
+	uint32_t	capacity;	/**< Quantidade de posições */
+	uint32_t	bump;		/**< Posições nunca utilizadas a partir deste índice */
+	uint32_t	used;		/**< Instâncias em uso */
+	void*		mapped;		/**< Base do mmap ou do alocador (NULL quando a área é da aplicação) */
+	size_t		mapped_size;	/**< Tamanho do mmap */
+	const fsm_alloc_t*	allocator;	/**< Alocador que forneceu mapped (NULL para mmap) */
+} fsm_pool_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_pool_init		(fsm_pool_t *pool, void *arena, size_t size);
+fsm_result_t fsm_pool_init_alloc	(fsm_pool_t *pool, size_t size, const fsm_alloc_t *allocator);
+fsm_result_t fsm_pool_deinit	(fsm_pool_t *pool);
+fsm_result_t fsm_pool_create	(fsm_pool_t *pool, fsm_handler_t **fsm, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_pool_destroy	(fsm_pool_t *pool, fsm_handler_t *fsm);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,357 @@
+/**
+ * @file	fsm_shard.c
+ * @brief	Runtime particionado por núcleo da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada fila tem um único produtor e um único consumidor: os índices são
+ * publicados com release e lidos com acquire, sem operações de leitura,
+ * modificação e escrita. A rota usa os bits altos do hash de Fibonacci da
+ * chave, independentes dos bits baixos usados pelo fsm_map dentro do shard.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE		/* pthread_attr_setaffinity_np */
+#endif
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_shard.h"
+#include "string.h"
+
+#if FSM_SHARD_ENABLE
+
+#include <sched.h>
+#include <unistd.h>
+
+/**
+ * @defgroup fsm_shard_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static void*	fsm_shard_thread	(void *arg);
+static void		fsm_shard_deliver	(fsm_shard_t *shard, const fsm_shard_msg_t *msg);
+static uint8_t	fsm_shard_push		(fsm_shard_ring_t *ring, uint64_t key, uint16_t eventID);
+static uint8_t	fsm_shard_pop		(fsm_shard_ring_t *ring, fsm_shard_msg_t *msg);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa o runtime particionado
+ * @details		Os vetores são fornecidos pela aplicação; shards e rings devem estar
+ *				alinhados em FSM_SHARD_LINE bytes
+ * @param		runtime ponteiro para estrutura do runtime
+ * @param		shards vetor com number_shards shards
+ * @param		number_shards quantidade de shards (normalmente um por núcleo)
+ * @param		rings vetor com FSM_SHARD_RINGS(number_shards) filas
+ * @param		cells vetor com FSM_SHARD_RINGS(number_shards) * ring_capacity posições
+ * @param		ring_capacity posições de cada fila (potência de 2)
+ * @param		entries vetor com number_shards * map_capacity registros
+ * @param		map_capacity registros do mapa de cada shard (potência de 2, ao menos FSM_MAP_LOAD_DEN)
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		initial_state estado das entidades sem registro
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ * @param		number_events quantidade de eventos no enum da FSM
+ */
+fsm_result_t fsm_shard_init(fsm_shard_runtime_t *runtime, fsm_shard_t *shards, uint16_t number_shards, fsm_shard_ring_t *rings, fsm_shard_msg_t *cells, uint32_t ring_capacity,
+							fsm_map_entry_t *entries, uint32_t map_capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events)
+{
+	fsm_result_t ret;
+	uint32_t index;
+
+	FSM_DBG("fsm shard init ");
+
+	if( (runtime==NULL) || (shards==NULL) || (rings==NULL) || (cells==NULL) || (entries==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (number_shards == 0) || (number_shards == FSM_SHARD_INGRESS) ||
+		(ring_capacity < 2) || ((ring_capacity & (ring_capacity - 1)) != 0) )
+	{
+		FSM_ERR("ERROR: invalid size\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(runtime, 0, sizeof(fsm_shard_runtime_t));
+	memset(shards, 0, number_shards * sizeof(fsm_shard_t));
+	memset(rings, 0, FSM_SHARD_RINGS((size_t)number_shards) * sizeof(fsm_shard_ring_t));
+
+	for( index=0; index<FSM_SHARD_RINGS((uint32_t)number_shards); index++ )
+	{
+		rings[index].cells	= &cells[(size_t)index * ring_capacity];
+		rings[index].mask	= ring_capacity - 1;
+	}
+
+	for( index=0; index<number_shards; index++ )
+	{
+		ret = fsm_map_init(&shards[index].map, &entries[(size_t)index * map_capacity], map_capacity, stateTable, initial_state, fsm_name, number_events);
+		if( ret != FSM_OK )
+		{
+			return(ret);
+		}
+		shards[index].runtime	= runtime;
+		shards[index].index		= (uint16_t)index;
+		shards[index].cpu		= -1;
+	}
+
+	runtime->shards			= shards;
+	runtime->number_shards	= number_shards;
+	runtime->rings			= rings;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Inicia as threads dos shards
+ * @param		runtime ponteiro para estrutura do runtime
+ * @param		cpus núcleo de cada shard (-1 sem fixação); NULL distribui os shards
+ *				pelos núcleos disponíveis em ordem
+ * @retval		FSM_NO_RESOURCES caso alguma thread não possa ser criada
+ */
+fsm_result_t fsm_shard_start(fsm_shard_runtime_t *runtime, const int *cpus)
+{
+	pthread_attr_t attr;
+	long online;
+	uint16_t index;
+	int created;
+#ifdef __linux__
+	cpu_set_t set;
+#endif
+
+	if( runtime==NULL )
+	{
+		FSM_ERR("ERROR: runtime null\r\n");
+		return(FSM_NULL);
+	}
+
+	online = sysconf(_SC_NPROCESSORS_ONLN);
+	if( online < 1 )
+	{
+		online = 1;
+	}
+
+	__atomic_store_n(&runtime->running, 1, __ATOMIC_RELEASE);
+	for( index=0; index<runtime->number_shards; index++ )
+	{
+		runtime->shards[index].cpu = (cpus != NULL) ? cpus[index] : (int)(index % online);
+
+		pthread_attr_init(&attr);
+#ifdef __linux__
+		// Fixada antes de iniciar, para que a pilha já seja alocada no núcleo do shard
+		if( runtime->shards[index].cpu >= 0 )
+		{
+			CPU_ZERO(&set);
+			CPU_SET(runtime->shards[index].cpu, &set);
+			pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+		}
+#else
+		runtime->shards[index].cpu = -1;
+#endif
+		created = pthread_create(&runtime->shards[index].thread, &attr, fsm_shard_thread, &runtime->shards[index]);
+		pthread_attr_destroy(&attr);
+
+		if( created != 0 )
+		{
+			runtime->number_shards = index;
+			fsm_shard_stop(runtime);
+			FSM_ERR("ERROR: without resources\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Encerra as threads dos shards
+ * @details		Eventos ainda nas filas permanecem nelas e são entregues em um novo
+ *				fsm_shard_start
+ * @param		runtime ponteiro para estrutura do runtime
+ */
+fsm_result_t fsm_shard_stop(fsm_shard_runtime_t *runtime)
+{
+	uint16_t index;
+
+	if( runtime==NULL )
+	{
+		FSM_ERR("ERROR: runtime null\r\n");
+		return(FSM_NULL);
+	}
+
+	__atomic_store_n(&runtime->running, 0, __ATOMIC_RELEASE);
+	for( index=0; index<runtime->number_shards; index++ )
+	{
+		pthread_join(runtime->shards[index].thread, NULL);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Retorna o shard que possui uma entidade
+ * @param		runtime ponteiro para estrutura do runtime
+ * @param		key chave da entidade
+ */
+uint16_t fsm_shard_route(fsm_shard_runtime_t *runtime, uint64_t key)
+{
+	uint32_t hash = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+
+	return((uint16_t)(((uint64_t)hash * runtime->number_shards) >> 32));
+}
+
+/**
+ * @brief		Envia um evento para uma entidade
+ * @details		Cada origem deve ser usada por uma única thread: dentro dos callbacks,
+ *				fsm_shard_of(this)->index; fora dos shards, FSM_SHARD_INGRESS
+ * @param		runtime ponteiro para estrutura do runtime
+ * @param		from shard de origem ou FSM_SHARD_INGRESS
+ * @param		key chave da entidade de destino
+ * @param		eventID evento
+ * @retval		FSM_NO_RESOURCES caso a fila entre a origem e o shard de destino esteja cheia
+ */
+fsm_result_t fsm_shard_send(fsm_shard_runtime_t *runtime, uint16_t from, uint64_t key, uint16_t eventID)
+{
+	uint32_t source;
+
+	if( runtime==NULL )
+	{
+		FSM_ERR("ERROR: runtime null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (from >= runtime->number_shards) && (from != FSM_SHARD_INGRESS) )
+	{
+		FSM_ERR("ERROR: invalid shard\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	source = (from == FSM_SHARD_INGRESS) ? runtime->number_shards : from;
+	if( !fsm_shard_push(&runtime->rings[source * runtime->number_shards + fsm_shard_route(runtime, key)], key, eventID) )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_shard_thread
+ *
+ * Função privada com o laço de cada shard: atende as filas de todas as origens
+ */
+static void* fsm_shard_thread(void *arg)
+{
+	fsm_shard_t *shard = (fsm_shard_t*)arg;
+	fsm_shard_runtime_t *runtime = shard->runtime;
+	fsm_shard_ring_t *ring;
+	fsm_shard_msg_t msg;
+	uint32_t source, count, work;
+
+	while( __atomic_load_n(&runtime->running, __ATOMIC_ACQUIRE) )
+	{
+		work = 0;
+		for( source=0; source<=runtime->number_shards; source++ )
+		{
+			ring = &runtime->rings[source * runtime->number_shards + shard->index];
+			for( count=0; (count < FSM_SHARD_BUDGET) && fsm_shard_pop(ring, &msg); count++ )
+			{
+				fsm_shard_deliver(shard, &msg);
+			}
+			work += count;
+		}
+
+		if( work != 0 )
+		{
+			__atomic_store_n(&shard->events, shard->events + work, __ATOMIC_RELAXED);
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	return(NULL);
+}
+
+/**
+ * @brief fsm_shard_deliver
+ *
+ * Função privada que entrega um evento e processa os eventos retornados pelos callbacks
+ */
+static void fsm_shard_deliver(fsm_shard_t *shard, const fsm_shard_msg_t *msg)
+{
+	fsm_map_t *map = &shard->map;
+	uint32_t chain;
+
+	if( fsm_map_post(map, msg->key, msg->eventID) == FSM_NO_RESOURCES )
+	{
+		shard->dropped++;
+	}
+
+	for( chain=0; (chain < FSM_SHARD_CHAIN) && (fsm_map_pending(map, msg->key) < map->fsm.number_events); chain++ )
+	{
+		fsm_map_engine(map, msg->key);
+	}
+}
+
+/**
+ * @brief fsm_shard_push
+ *
+ * Função privada que escreve na fila (somente o produtor)
+ */
+static uint8_t fsm_shard_push(fsm_shard_ring_t *ring, uint64_t key, uint16_t eventID)
+{
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	fsm_shard_msg_t *cell;
+
+	if( (tail - ring->head_cache) > ring->mask )
+	{
+		ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if( (tail - ring->head_cache) > ring->mask )
+		{
+			return(0);
+		}
+	}
+
+	cell = &ring->cells[tail & ring->mask];
+	cell->key		= key;
+	cell->eventID	= eventID;
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return(1);
+}
+
+/**
+ * @brief fsm_shard_pop
+ *
+ * Função privada que lê da fila (somente o consumidor)
+ */
+static uint8_t fsm_shard_pop(fsm_shard_ring_t *ring, fsm_shard_msg_t *msg)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	if( head == ring->tail_cache )
+	{
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if( head == ring->tail_cache )
+		{
+			return(0);
+		}
+	}
+
+	*msg = ring->cells[head & ring->mask];
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return(1);
+}
+
+#endif
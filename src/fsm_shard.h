@@ -0,0 +1,153 @@
+/**
+ * @file	fsm_shard.h
+ * @brief	Runtime particionado por núcleo da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada shard é uma thread fixada em um núcleo que possui, com exclusividade,
+ * um mapa de entidades (fsm_map_t). A chave de cada entidade determina o seu
+ * shard (fsm_shard_route), e nenhum estado de FSM é compartilhado entre
+ * threads: o fsm_engine e o mapa continuam sem operações atômicas.
+ *
+ * Eventos trafegam por filas SPSC dedicadas, uma para cada par (origem,
+ * destino), inclusive de um shard para ele mesmo. Há ainda uma origem
+ * adicional, FSM_SHARD_INGRESS, para uma única thread externa à aplicação
+ * (rede, temporizadores). As únicas escritas compartilhadas são os índices
+ * das filas, cada um em sua própria linha de cache.
+ *
+ * Cada evento entregue é processado até não haver evento pendente na
+ * entidade, e cada fila de origem é atendida por no máximo FSM_SHARD_BUDGET
+ * eventos por passada, para que uma origem ocupada não atrase as demais.
+ * Dentro dos callbacks o shard é obtido com fsm_shard_of(this) e a chave com
+ * fsm_map_key(this); eventos, inclusive para a própria entidade, são enviados
+ * com fsm_shard_send.
+ *
+ * Disponível apenas em sistemas com POSIX threads (FSM_SHARD_ENABLE). A
+ * fixação em núcleos usa pthread_setaffinity_np, disponível no Linux.
+ *
+ */
+#ifndef __FSM_SHARD_H__
+#define __FSM_SHARD_H__
+
+/**
+ * @defgroup fsm_shard_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+#include "fsm_map.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_SHARD_ENABLE	1
+#else
+#	define FSM_SHARD_ENABLE	0
+#endif
+
+#if FSM_SHARD_ENABLE
+
+#include <pthread.h>
+
+#ifndef FSM_SHARD_BUDGET
+#	define FSM_SHARD_BUDGET		64		/**< Eventos por fila de origem em cada passada */
+#endif
+
+#ifndef FSM_SHARD_CHAIN
+#	define FSM_SHARD_CHAIN		64		/**< Eventos retornados pelos callbacks processados por entrega */
+#endif
+
+#define FSM_SHARD_LINE			64		/**< Tamanho da linha de cache */
+#define FSM_SHARD_INGRESS		0xFFFF	/**< Origem dos eventos enviados de fora dos shards */
+
+/**
+ * @brief Quantidade de filas para n shards (n origens internas e a de ingresso)
+ */
+#define FSM_SHARD_RINGS(n)		(((n) + 1) * (n))
+
+/**
+ * @brief Shard a partir do ponteiro recebido pelos callbacks
+ */
+#define fsm_shard_of(fsm)		((fsm_shard_t*)(fsm))
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Shard Message
+ */
+typedef struct fsm_shard_msg
+{
+	uint64_t	key;		/**< Chave da entidade */
+	uint16_t	eventID;	/**< Evento */
+} fsm_shard_msg_t;
+
+/**
+ * @brief FSM Shard Ring
+ *
+ * Fila SPSC. Produtor e consumidor escrevem apenas o próprio índice e
+ * guardam uma cópia do índice do outro lado, relida só quando a fila parece
+ * cheia ou vazia.
+ */
+typedef struct fsm_shard_ring
+{
+	fsm_shard_msg_t*	cells;		/**< Posições da fila */
+	uint32_t			mask;		/**< Capacidade - 1 */
+	uint32_t			tail		__attribute__((aligned(FSM_SHARD_LINE)));	/**< Próxima escrita (produtor) */
+	uint32_t			head_cache;	/**< Cópia de head do produtor */
+	uint32_t			head		__attribute__((aligned(FSM_SHARD_LINE)));	/**< Próxima leitura (consumidor) */
+	uint32_t			tail_cache;	/**< Cópia de tail do consumidor */
+} __attribute__((aligned(FSM_SHARD_LINE))) fsm_shard_ring_t;
+
+/**
+ * @brief FSM Shard
+ *
+ * O mapa deve ser o primeiro campo, para que fsm_shard_of possa obter o
+ * shard a partir do ponteiro recebido pelos callbacks.
+ */
+typedef struct fsm_shard
+{
+	fsm_map_t					map;		/**< Entidades do shard */
+	struct fsm_shard_runtime*	runtime;	/**< Runtime do shard */
+	pthread_t					thread;		/**< Thread do shard */
+	uint16_t					index;		/**< Posição do shard */
+	int							cpu;		/**< Núcleo da thread (-1 sem fixação) */
+	uint64_t					events;		/**< Eventos entregues (lido por outras threads) */
+	uint64_t					dropped;	/**< Eventos não entregues: mapa cheio ou entidade ocupada */
+} __attribute__((aligned(FSM_SHARD_LINE))) fsm_shard_t;
+
+/**
+ * @brief FSM Shard Runtime
+ */
+typedef struct fsm_shard_runtime
+{
+	fsm_shard_t*		shards;			/**< Shards */
+	uint16_t			number_shards;	/**< Quantidade de shards */
+	fsm_shard_ring_t*	rings;			/**< Filas, rings[origem * number_shards + destino] */
+	uint32_t			running;		/**< Diferente de zero entre start e stop */
+} fsm_shard_runtime_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_shard_init		(fsm_shard_runtime_t *runtime, fsm_shard_t *shards, uint16_t number_shards, fsm_shard_ring_t *rings, fsm_shard_msg_t *cells, uint32_t ring_capacity,
+								 fsm_map_entry_t *entries, uint32_t map_capacity, fsm_state_t *stateTable, void* initial_state, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_shard_start	(fsm_shard_runtime_t *runtime, const int *cpus);
+fsm_result_t fsm_shard_stop		(fsm_shard_runtime_t *runtime);
+uint16_t	 fsm_shard_route	(fsm_shard_runtime_t *runtime, uint64_t key);
+fsm_result_t fsm_shard_send		(fsm_shard_runtime_t *runtime, uint16_t from, uint64_t key, uint16_t eventID);
+
+#endif
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @file	fsm_shm.c
+ * @brief	Populações da Finite State Machine em memória compartilhada
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O segmento é dimensionado e preenchido de uma só vez em fsm_shm_create;
+ * depois disso somente as instâncias são alteradas, pelo próprio fsm_engine.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_shm.h"
+#include "string.h"
+
+#if FSM_SHM_ENABLE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @defgroup fsm_shm_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_SHM_ALIGN(x)	(((x) + 63u) & ~(uint64_t)63u)
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static void	fsm_shm_name	(char *dest, const char *src, uint32_t length);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Cria o segmento de memória compartilhada e as instâncias das FSMs
+ * @details		As instâncias de cada FSM são criadas no estado inicial da descrição e
+ *				obtidas com fsm_shm_instances. Um segmento anterior com o mesmo nome é
+ *				substituído.
+ * @param		shm ponteiro para estrutura da memória compartilhada
+ * @param		name nome do segmento, no formato de shm_open ("/nome")
+ * @param		fsms descrição das FSMs
+ * @param		number_fsms quantidade de FSMs
+ * @retval		FSM_STT_ERROR caso alguma tabela tenha mais de FSM_SHM_MAX_STATES estados
+ * @retval		FSM_NO_RESOURCES caso o segmento não possa ser criado
+ */
+fsm_result_t fsm_shm_create(fsm_shm_t *shm, const char *name, const fsm_shm_desc_t *fsms, uint16_t number_fsms)
+{
+	void *states[FSM_SHM_MAX_STATES];
+	fsm_shm_header_t *header;
+	fsm_shm_fsm_t *desc;
+	fsm_handler_t *instances;
+	const fsm_shm_name_t *state_name;
+	uint64_t size, offset, *values;
+	uint32_t index, position;
+	uint16_t fsm, number_states, state;
+	fsm_result_t ret;
+	char *names;
+	void *mapped;
+	int fd;
+
+	FSM_DBG("fsm shm create %s ", name);
+
+	if( (shm==NULL) || (name==NULL) || (fsms==NULL) || (number_fsms==0) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(shm, 0, sizeof(fsm_shm_t));
+
+	// Dimensiona o segmento
+	size = FSM_SHM_ALIGN(sizeof(fsm_shm_header_t) + (uint64_t)number_fsms * sizeof(fsm_shm_fsm_t));
+	for( fsm=0; fsm<number_fsms; fsm++ )
+	{
+		if( fsms[fsm].stateTable == NULL )
+		{
+			FSM_ERR("ERROR: state table null\r\n");
+			return(FSM_STATE_NULL);
+		}
+		number_states = fsm_state_list(fsms[fsm].stateTable, states, FSM_SHM_MAX_STATES);
+		if( (number_states == FSM_STATE_INVALID) || (number_states == 0) )
+		{
+			FSM_ERR("ERROR: too many states\r\n");
+			return(FSM_STT_ERROR);
+		}
+		size += FSM_SHM_ALIGN((uint64_t)number_states * (sizeof(uint64_t) + FSM_SHM_NAME_LENGTH));
+		size += FSM_SHM_ALIGN((uint64_t)fsms[fsm].number_events * FSM_SHM_NAME_LENGTH);
+		size += FSM_SHM_ALIGN((uint64_t)fsms[fsm].population * sizeof(fsm_handler_t));
+	}
+
+	fsm_shm_name(shm->name, name, sizeof(shm->name));
+	shm_unlink(shm->name);
+	fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if( fd < 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	if( ftruncate(fd, (off_t)size) != 0 )
+	{
+		close(fd);
+		shm_unlink(shm->name);
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	mapped = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if( mapped == MAP_FAILED )
+	{
+		shm_unlink(shm->name);
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	shm->header	= (fsm_shm_header_t*)mapped;
+	shm->size	= (size_t)size;
+
+	// Preenche os descritores, os nomes e as instâncias
+	offset = FSM_SHM_ALIGN(sizeof(fsm_shm_header_t) + (uint64_t)number_fsms * sizeof(fsm_shm_fsm_t));
+	desc = (fsm_shm_fsm_t*)((uint8_t*)mapped + sizeof(fsm_shm_header_t));
+	for( fsm=0; fsm<number_fsms; fsm++, desc++ )
+	{
+		number_states = fsm_state_list(fsms[fsm].stateTable, states, FSM_SHM_MAX_STATES);
+		fsm_shm_name(desc->name, fsms[fsm].name, sizeof(desc->name));
+		desc->number_states	= number_states;
+		desc->number_events	= fsms[fsm].number_events;
+		desc->population	= fsms[fsm].population;
+
+		desc->states_offset			= offset;
+		desc->state_names_offset	= offset + (uint64_t)number_states * sizeof(uint64_t);
+		offset += FSM_SHM_ALIGN((uint64_t)number_states * (sizeof(uint64_t) + FSM_SHM_NAME_LENGTH));
+		desc->event_names_offset	= offset;
+		offset += FSM_SHM_ALIGN((uint64_t)fsms[fsm].number_events * FSM_SHM_NAME_LENGTH);
+		desc->instances_offset		= offset;
+		offset += FSM_SHM_ALIGN((uint64_t)fsms[fsm].population * sizeof(fsm_handler_t));
+
+		values	= (uint64_t*)((uint8_t*)mapped + desc->states_offset);
+		names	= (char*)mapped + desc->state_names_offset;
+		for( state=0; state<number_states; state++ )
+		{
+			values[state] = (uint64_t)(uintptr_t)states[state];
+			for( state_name=fsms[fsm].state_names; (state_name != NULL) && (state_name->cb_state != NULL); state_name++ )
+			{
+				if( state_name->cb_state == states[state] )
+				{
+					fsm_shm_name(&names[state * FSM_SHM_NAME_LENGTH], state_name->name, FSM_SHM_NAME_LENGTH);
+					break;
+				}
+			}
+		}
+
+		names = (char*)mapped + desc->event_names_offset;
+		for( position=0; (fsms[fsm].event_names != NULL) && (position < fsms[fsm].number_events); position++ )
+		{
+			fsm_shm_name(&names[position * FSM_SHM_NAME_LENGTH], fsms[fsm].event_names[position], FSM_SHM_NAME_LENGTH);
+		}
+
+		instances = (fsm_handler_t*)((uint8_t*)mapped + desc->instances_offset);
+		for( index=0; index<fsms[fsm].population; index++ )
+		{
+			ret = fsm_create(&instances[index], fsms[fsm].stateTable, fsms[fsm].initial_state,
+							 (char*)((fsms[fsm].name != NULL) ? fsms[fsm].name : ""), fsms[fsm].number_events);
+			if( ret != FSM_OK )
+			{
+				fsm_shm_destroy(shm);
+				return(ret);
+			}
+		}
+	}
+
+	// O cabeçalho é preenchido por último: o inspetor só aceita o segmento completo
+	header = shm->header;
+	header->version				= FSM_SHM_VERSION;
+	header->byte_order			= FSM_SHM_BYTE_ORDER;
+	header->number_fsms			= number_fsms;
+	header->handler_size		= (uint16_t)sizeof(fsm_handler_t);
+	header->pointer_size		= (uint16_t)sizeof(void*);
+	header->offset_state		= (uint16_t)offsetof(fsm_handler_t, cb_state);
+	header->offset_event		= (uint16_t)offsetof(fsm_handler_t, eventID);
+#if FSM_SEQLOCK_ENABLE
+	header->offset_transitions	= (uint16_t)offsetof(fsm_handler_t, transitions);
+#else
+	header->offset_transitions	= FSM_SHM_NO_FIELD;
+#endif
+	header->pid					= (uint32_t)getpid();
+	header->size				= size;
+	header->fsms_offset			= sizeof(fsm_shm_header_t);
+	memcpy(header->magic, "FSMI", 4);
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Desfaz o mapeamento e remove o segmento
+ * @details		Inspetores já conectados mantêm o mapeamento até se desconectarem
+ * @param		shm ponteiro para estrutura da memória compartilhada
+ */
+fsm_result_t fsm_shm_destroy(fsm_shm_t *shm)
+{
+	if( shm==NULL )
+	{
+		FSM_ERR("ERROR: shm null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( shm->header != NULL )
+	{
+		munmap(shm->header, shm->size);
+		shm_unlink(shm->name);
+	}
+	memset(shm, 0, sizeof(fsm_shm_t));
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Obtém as instâncias de uma FSM do segmento
+ * @param		shm ponteiro para estrutura da memória compartilhada
+ * @param		fsm índice da FSM, na ordem passada a fsm_shm_create
+ * @return		Vetor com a população da FSM, ou NULL caso a FSM não exista
+ */
+fsm_handler_t* fsm_shm_instances(fsm_shm_t *shm, uint16_t fsm)
+{
+	const fsm_shm_fsm_t *desc;
+
+	if( (shm==NULL) || (shm->header==NULL) || (fsm >= shm->header->number_fsms) )
+	{
+		FSM_ERR("ERROR: invalid fsm\r\n");
+		return(NULL);
+	}
+
+	desc = (const fsm_shm_fsm_t*)((const uint8_t*)shm->header + shm->header->fsms_offset) + fsm;
+	return((fsm_handler_t*)((uint8_t*)shm->header + desc->instances_offset));
+}
+
+/**
+ * @brief fsm_shm_name
+ *
+ * Função privada que copia um nome completando com zeros (o último byte é sempre zero)
+ */
+static void fsm_shm_name(char *dest, const char *src, uint32_t length)
+{
+	memset(dest, 0, length);
+	if( src != NULL )
+	{
+		strncpy(dest, src, length - 1);
+	}
+}
+
+#endif
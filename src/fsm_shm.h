@@ -0,0 +1,152 @@
+/**
+ * @file	fsm_shm.h
+ * @brief	Populações da Finite State Machine em memória compartilhada
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Coloca as instâncias de uma ou mais FSMs em um segmento POSIX de memória
+ * compartilhada, junto com tabelas de nomes de estados e eventos, para que
+ * ferramentas externas (tools/fsmtop) inspecionem a população em execução
+ * somente com leitura. O fsm_engine não é alterado: as instâncias são
+ * fsm_handler_t comuns que apenas residem no segmento, e não há custo extra
+ * no despacho. Com FSM_SEQLOCK_ENABLE o contador de transições de cada
+ * instância também fica visível, e o inspetor calcula taxas de transição.
+ *
+ * Layout do segmento (ordem de bytes nativa, verificada por byte_order):
+ * @code
+ * fsm_shm_header_t                       (64 bytes, no início)
+ * fsm_shm_fsm_t[number_fsms]             (em fsms_offset, 64 bytes cada)
+ * para cada FSM, nos deslocamentos do descritor:
+ *   uint64_t[number_states]              valor do ponteiro cb_state de cada estado
+ *   char[number_states][FSM_SHM_NAME_LENGTH]   nomes dos estados
+ *   char[number_events][FSM_SHM_NAME_LENGTH]   nomes dos eventos
+ *   instâncias: population estruturas de handler_size bytes
+ * @endcode
+ * O cabeçalho descreve a posição de cb_state, eventID e transitions dentro
+ * do fsm_handler_t, para que o inspetor não dependa da configuração com que
+ * a aplicação foi compilada. Os estados seguem a ordem de fsm_state_list.
+ *
+ * Disponível apenas em sistemas POSIX (FSM_SHM_ENABLE).
+ *
+ */
+#ifndef __FSM_SHM_H__
+#define __FSM_SHM_H__
+
+/**
+ * @defgroup fsm_shm_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_SHM_ENABLE	1
+#else
+#	define FSM_SHM_ENABLE	0
+#endif
+
+#ifndef FSM_SHM_MAX_STATES
+#	define FSM_SHM_MAX_STATES	256		/**< Estados distintos suportados por FSM */
+#endif
+
+#define FSM_SHM_VERSION			1
+#define FSM_SHM_BYTE_ORDER		0x0102
+#define FSM_SHM_NAME_LENGTH		32
+#define FSM_SHM_NO_FIELD		0xFFFF	/**< Campo ausente no fsm_handler_t desta configuração */
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Shared Memory Header
+ */
+typedef struct fsm_shm_header
+{
+	char		magic[4];			/**< "FSMI" */
+	uint16_t	version;			/**< FSM_SHM_VERSION */
+	uint16_t	byte_order;			/**< FSM_SHM_BYTE_ORDER */
+	uint16_t	number_fsms;		/**< Quantidade de FSMs */
+	uint16_t	handler_size;		/**< sizeof(fsm_handler_t) */
+	uint16_t	pointer_size;		/**< sizeof(void*) */
+	uint16_t	offset_state;		/**< Posição de cb_state no fsm_handler_t */
+	uint16_t	offset_event;		/**< Posição de eventID no fsm_handler_t */
+	uint16_t	offset_transitions;	/**< Posição de transitions, ou FSM_SHM_NO_FIELD */
+	uint32_t	pid;				/**< Processo que criou o segmento */
+	uint64_t	size;				/**< Tamanho do segmento */
+	uint64_t	fsms_offset;		/**< Início dos descritores */
+	uint8_t		padding[24];
+} fsm_shm_header_t;
+
+/**
+ * @brief FSM Shared Memory Descriptor
+ *
+ * Os deslocamentos são relativos ao início do segmento
+ */
+typedef struct fsm_shm_fsm
+{
+	char		name[16];				/**< Nome da FSM, completado com zeros */
+	uint16_t	number_states;			/**< Estados da tabela */
+	uint16_t	number_events;			/**< Eventos da FSM */
+	uint32_t	population;				/**< Quantidade de instâncias */
+	uint64_t	states_offset;			/**< Valores dos ponteiros dos estados */
+	uint64_t	state_names_offset;		/**< Nomes dos estados */
+	uint64_t	event_names_offset;		/**< Nomes dos eventos */
+	uint64_t	instances_offset;		/**< Instâncias */
+	uint64_t	reserved;
+} fsm_shm_fsm_t;
+
+/**
+ * @brief Nome de um estado, identificado pelo callback
+ */
+typedef struct fsm_shm_name
+{
+	void*		cb_state;	/**< Callback do estado (NULL encerra a lista) */
+	const char*	name;		/**< Nome exibido pelo inspetor */
+} fsm_shm_name_t;
+
+/**
+ * @brief Descrição de uma FSM a ser colocada no segmento
+ */
+typedef struct fsm_shm_desc
+{
+	const char*				name;			/**< Nome da FSM */
+	fsm_state_t*			stateTable;		/**< Tabela de transição */
+	void*					initial_state;	/**< Estado inicial das instâncias */
+	uint16_t				number_events;	/**< Eventos da FSM */
+	uint32_t				population;		/**< Quantidade de instâncias */
+	const fsm_shm_name_t*	state_names;	/**< Nomes dos estados (NULL usa o índice) */
+	const char* const*		event_names;	/**< Nomes dos eventos, indexados pelo evento (pode ser NULL) */
+} fsm_shm_desc_t;
+
+/**
+ * @brief FSM Shared Memory
+ */
+typedef struct fsm_shm
+{
+	fsm_shm_header_t*	header;		/**< Segmento mapeado */
+	size_t				size;		/**< Tamanho do segmento */
+	char				name[64];	/**< Nome do segmento (shm_open) */
+} fsm_shm_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t	fsm_shm_create		(fsm_shm_t *shm, const char *name, const fsm_shm_desc_t *fsms, uint16_t number_fsms);
+fsm_result_t	fsm_shm_destroy		(fsm_shm_t *shm);
+fsm_handler_t*	fsm_shm_instances	(fsm_shm_t *shm, uint16_t fsm);
+
+/**
+ * @}
+ */
+
+#endif
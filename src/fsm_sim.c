@@ -0,0 +1,356 @@
+/**
+ * @file	fsm_sim.c
+ * @brief	Simulação por eventos discretos de populações de FSMs
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Pairing heap com remoção do mínimo em duas passadas: inserir custa O(1)
+ * e remover o mínimo ou um evento cancelado custa O(log n) amortizado, sem
+ * vetor auxiliar e sem limite de eventos além do vetor da aplicação.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_sim.h"
+#include "string.h"
+
+/**
+ * @defgroup fsm_sim_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint8_t			fsm_sim_before	(const fsm_sim_event_t *a, const fsm_sim_event_t *b);
+static fsm_sim_event_t*	fsm_sim_meld	(fsm_sim_event_t *a, fsm_sim_event_t *b);
+static fsm_sim_event_t*	fsm_sim_combine	(fsm_sim_event_t *first);
+static void				fsm_sim_release	(fsm_sim_t *sim, fsm_sim_event_t *event);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa a simulação no instante zero
+ * @param		sim ponteiro para estrutura da simulação
+ * @param		events vetor para os eventos agendados
+ * @param		capacity quantidade de eventos no vetor
+ */
+fsm_result_t fsm_sim_init(fsm_sim_t *sim, fsm_sim_event_t *events, uint32_t capacity)
+{
+	uint32_t index;
+
+	FSM_DBG("fsm sim init ");
+
+	if( (sim==NULL) || (events==NULL) || (capacity==0) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(sim, 0, sizeof(fsm_sim_t));
+	memset(events, 0, (size_t)capacity * sizeof(fsm_sim_event_t));
+	for( index=0; index<capacity; index++ )
+	{
+		events[index].sibling = (index + 1 < capacity) ? &events[index + 1] : NULL;
+	}
+	sim->free		= events;
+	sim->capacity	= capacity;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Agenda um evento para uma instância
+ * @details		Pode ser chamada pelos callbacks durante fsm_sim_run. Eventos no mesmo
+ *				instante são entregues na ordem de agendamento.
+ * @param		sim ponteiro para estrutura da simulação
+ * @param		fsm instância que recebe o evento
+ * @param		eventID evento enviado com fsm_post
+ * @param		delay intervalo a partir do tempo virtual atual
+ * @param		timer recebe a referência para cancelar o evento (pode ser NULL)
+ * @retval		FSM_NO_RESOURCES caso todos os eventos do vetor estejam agendados
+ */
+fsm_result_t fsm_sim_schedule(fsm_sim_t *sim, fsm_handler_t *fsm, uint16_t eventID, fsm_sim_time_t delay, fsm_sim_timer_t *timer)
+{
+	fsm_sim_event_t *event;
+
+	if( (sim==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	event = sim->free;
+	if( event == NULL )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	sim->free = event->sibling;
+
+	event->time		= sim->now + delay;
+	event->seq		= sim->seq++;
+	event->id		= ++sim->id;
+	event->fsm		= fsm;
+	event->eventID	= eventID;
+	event->queued	= 1;
+	event->child	= NULL;
+	event->sibling	= NULL;
+	event->prev		= NULL;
+
+	sim->root = fsm_sim_meld(sim->root, event);
+	sim->pending++;
+
+	if( timer != NULL )
+	{
+		timer->event	= event;
+		timer->id		= event->id;
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Cancela um evento agendado
+ * @details		Não tem efeito caso o evento já tenha sido entregue ou cancelado
+ * @param		sim ponteiro para estrutura da simulação
+ * @param		timer referência obtida em fsm_sim_schedule
+ */
+fsm_result_t fsm_sim_cancel(fsm_sim_t *sim, fsm_sim_timer_t *timer)
+{
+	fsm_sim_event_t *event, *children;
+
+	if( (sim==NULL) || (timer==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	event = timer->event;
+	timer->event = NULL;
+	if( (event == NULL) || !event->queued || (event->id != timer->id) )
+	{
+		return(FSM_OK);
+	}
+
+	if( event == sim->root )
+	{
+		sim->root = fsm_sim_combine(event->child);
+	}
+	else
+	{
+		// Desliga a subárvore do evento e junta os filhos de volta à raiz
+		if( event->prev->child == event )
+		{
+			event->prev->child = event->sibling;
+		}
+		else
+		{
+			event->prev->sibling = event->sibling;
+		}
+		if( event->sibling != NULL )
+		{
+			event->sibling->prev = event->prev;
+		}
+		children = fsm_sim_combine(event->child);
+		sim->root = fsm_sim_meld(sim->root, children);
+	}
+
+	fsm_sim_release(sim, event);
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Obtém o instante do próximo evento
+ * @param		sim ponteiro para estrutura da simulação
+ * @param		time recebe o instante
+ * @return		1 caso haja evento agendado, 0 caso contrário
+ */
+uint8_t fsm_sim_next(const fsm_sim_t *sim, fsm_sim_time_t *time)
+{
+	if( (sim==NULL) || (time==NULL) || (sim->root == NULL) )
+	{
+		return(0);
+	}
+
+	*time = sim->root->time;
+	return(1);
+}
+
+/**
+ * @brief		Avança a simulação até o instante until
+ * @details		Entrega, em ordem, os eventos agendados até until: o tempo virtual salta
+ *				para o instante do evento, que é enviado com fsm_post, e a instância
+ *				executa fsm_run até ficar sem evento pendente ou completar FSM_SIM_CHAIN
+ *				passos; neste caso o evento pendente é reagendado no mesmo instante, atrás
+ *				dos demais. Ao final o tempo virtual é until.
+ * @param		sim ponteiro para estrutura da simulação
+ * @param		until instante final
+ * @param		max_events eventos a entregar nesta chamada (0 sem limite)
+ * @retval		FSM_BUDGET_EXHAUSTED caso max_events tenha sido atingido antes de until;
+ *				o tempo virtual é o do último evento entregue
+ * @retval		FSM_STATE_ERROR ou FSM_STATE_NULL caso o fsm_engine de uma instância falhe
+ * @retval		FSM_NO_RESOURCES caso não haja evento livre para reagendar uma sequência
+ */
+fsm_result_t fsm_sim_run(fsm_sim_t *sim, fsm_sim_time_t until, uint64_t max_events)
+{
+	fsm_budget_t budget;
+	fsm_sim_event_t *event;
+	fsm_handler_t *fsm;
+	fsm_result_t ret;
+	uint64_t count = 0;
+	uint16_t eventID;
+
+	if( sim==NULL )
+	{
+		FSM_ERR("ERROR: sim null\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(&budget, 0, sizeof(budget));
+	budget.steps = FSM_SIM_CHAIN;
+
+	while( (sim->root != NULL) && (sim->root->time <= until) )
+	{
+		if( (max_events != 0) && (count >= max_events) )
+		{
+			return(FSM_BUDGET_EXHAUSTED);
+		}
+
+		event		= sim->root;
+		sim->root	= fsm_sim_combine(event->child);
+		sim->now	= event->time;
+		fsm			= event->fsm;
+		eventID		= event->eventID;
+		fsm_sim_release(sim, event);
+
+		fsm_post(fsm, eventID);
+		ret = fsm_run(fsm, &budget);
+		sim->steps += budget.executed;
+		sim->dispatched++;
+		count++;
+
+		if( ret == FSM_BUDGET_EXHAUSTED )
+		{
+			ret = fsm_sim_schedule(sim, fsm, fsm->eventID, 0, NULL);
+		}
+		if( ret != FSM_OK )
+		{
+			return(ret);
+		}
+	}
+
+	if( sim->now < until )
+	{
+		sim->now = until;
+	}
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_sim_before
+ *
+ * Função privada que verifica se o evento a precede o evento b
+ */
+static uint8_t fsm_sim_before(const fsm_sim_event_t *a, const fsm_sim_event_t *b)
+{
+	return( (a->time < b->time) || ((a->time == b->time) && ((int32_t)(a->seq - b->seq) < 0)) );
+}
+
+/**
+ * @brief fsm_sim_meld
+ *
+ * Função privada que une duas árvores; o vencedor fica como raiz, sem irmãos
+ */
+static fsm_sim_event_t* fsm_sim_meld(fsm_sim_event_t *a, fsm_sim_event_t *b)
+{
+	fsm_sim_event_t *swap;
+
+	if( a == NULL )
+	{
+		return(b);
+	}
+	if( b == NULL )
+	{
+		return(a);
+	}
+	if( fsm_sim_before(b, a) )
+	{
+		swap	= a;
+		a		= b;
+		b		= swap;
+	}
+
+	b->prev		= a;
+	b->sibling	= a->child;
+	if( a->child != NULL )
+	{
+		a->child->prev = b;
+	}
+	a->child	= b;
+	a->sibling	= NULL;
+	a->prev		= NULL;
+	return(a);
+}
+
+/**
+ * @brief fsm_sim_combine
+ *
+ * Função privada que une uma lista de irmãos em duas passadas
+ */
+static fsm_sim_event_t* fsm_sim_combine(fsm_sim_event_t *first)
+{
+	fsm_sim_event_t *pairs = NULL, *root = NULL, *a, *b, *next;
+
+	// Primeira passada: une os irmãos aos pares, da esquerda para a direita
+	while( first != NULL )
+	{
+		a		= first;
+		b		= a->sibling;
+		next	= (b != NULL) ? b->sibling : NULL;
+
+		a->sibling	= NULL;
+		a->prev		= NULL;
+		if( b != NULL )
+		{
+			b->sibling	= NULL;
+			b->prev		= NULL;
+			a = fsm_sim_meld(a, b);
+		}
+		a->sibling	= pairs;
+		pairs		= a;
+		first		= next;
+	}
+
+	// Segunda passada: une os pares da direita para a esquerda
+	while( pairs != NULL )
+	{
+		next			= pairs->sibling;
+		pairs->sibling	= NULL;
+		root			= fsm_sim_meld(root, pairs);
+		pairs			= next;
+	}
+
+	return(root);
+}
+
+/**
+ * @brief fsm_sim_release
+ *
+ * Função privada que devolve um evento à lista de livres
+ */
+static void fsm_sim_release(fsm_sim_t *sim, fsm_sim_event_t *event)
+{
+	event->queued	= 0;
+	event->child	= NULL;
+	event->prev		= NULL;
+	event->sibling	= sim->free;
+	sim->free		= event;
+	sim->pending--;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file	fsm_sim.h
+ * @brief	Simulação por eventos discretos de populações de FSMs
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O núcleo de simulação mantém os eventos futuros de todas as instâncias
+ * em um pairing heap ordenado pelo instante (e, no mesmo instante, pela
+ * ordem de agendamento). fsm_sim_run avança o tempo virtual diretamente
+ * para o próximo evento e executa fsm_engine apenas na instância afetada,
+ * em vez de percorrer todas as instâncias a cada tick.
+ *
+ * Os callbacks dos estados agendam os próximos eventos da própria
+ * instância (ou de outras) com fsm_sim_schedule, por exemplo um timeout,
+ * e o cancelam com fsm_sim_cancel quando a resposta chega antes:
+ * @code
+ * static uint16_t dev_wait_ack(fsm_handler_t* this)
+ * {
+ *     fsm_sim_schedule(&sim, this, EV_TIMEOUT, 5000, &device_of(this)->timeout);
+ *     return(EV_LIMIT);
+ * }
+ * @endcode
+ * O tempo é um uint64_t na unidade escolhida pela aplicação.
+ *
+ */
+#ifndef __FSM_SIM_H__
+#define __FSM_SIM_H__
+
+/**
+ * @defgroup fsm_sim_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_SIM_CHAIN	64		/**< Transições encadeadas por evento antes de ceder a vez */
+
+/**
+ * Tipos de Dados Públicos
+ */
+typedef uint64_t fsm_sim_time_t;
+
+/**
+ * @brief FSM Simulation Event
+ *
+ * Evento futuro, nó do pairing heap. Os eventos vêm de um vetor fornecido
+ * em fsm_sim_init.
+ */
+typedef struct fsm_sim_event
+{
+	fsm_sim_time_t			time;		/**< Instante do evento */
+	uint32_t				seq;		/**< Ordem de agendamento, desempata o mesmo instante */
+	uint32_t				id;			/**< Identificador do agendamento (ver fsm_sim_timer_t) */
+	fsm_handler_t*			fsm;		/**< Instância que recebe o evento */
+	uint16_t				eventID;	/**< Evento enviado com fsm_post */
+	uint16_t				queued;		/**< Diferente de zero enquanto no heap */
+	struct fsm_sim_event*	child;		/**< Primeiro filho */
+	struct fsm_sim_event*	sibling;	/**< Próximo irmão (próximo livre fora do heap) */
+	struct fsm_sim_event*	prev;		/**< Pai, para o primeiro filho, ou irmão anterior */
+} fsm_sim_event_t;
+
+/**
+ * @brief FSM Simulation Timer
+ *
+ * Referência a um evento agendado, para cancelá-lo. Deixa de ser válida,
+ * sem risco, depois que o evento é entregue.
+ */
+typedef struct fsm_sim_timer
+{
+	fsm_sim_event_t*	event;	/**< Evento agendado */
+	uint32_t			id;		/**< Identificador do agendamento */
+} fsm_sim_timer_t;
+
+/**
+ * @brief FSM Simulation
+ */
+typedef struct fsm_sim
+{
+	fsm_sim_event_t*	root;		/**< Próximo evento */
+	fsm_sim_event_t*	free;		/**< Eventos livres */
+	uint32_t			capacity;	/**< Eventos no vetor */
+	uint32_t			pending;	/**< Eventos agendados */
+	uint32_t			seq;		/**< Próxima ordem de agendamento */
+	uint32_t			id;			/**< Próximo identificador */
+	fsm_sim_time_t		now;		/**< Tempo virtual */
+	uint64_t			dispatched;	/**< Eventos entregues */
+	uint64_t			steps;		/**< Chamadas de fsm_engine */
+} fsm_sim_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t	fsm_sim_init		(fsm_sim_t *sim, fsm_sim_event_t *events, uint32_t capacity);
+fsm_result_t	fsm_sim_schedule	(fsm_sim_t *sim, fsm_handler_t *fsm, uint16_t eventID, fsm_sim_time_t delay, fsm_sim_timer_t *timer);
+fsm_result_t	fsm_sim_cancel		(fsm_sim_t *sim, fsm_sim_timer_t *timer);
+uint8_t			fsm_sim_next		(const fsm_sim_t *sim, fsm_sim_time_t *time);
+fsm_result_t	fsm_sim_run			(fsm_sim_t *sim, fsm_sim_time_t until, uint64_t max_events);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,396 @@
+/**
+ * @file	fsm_snapshot.c
+ * @brief	Checkpoint e restauração de populações da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O arquivo é gravado em <path>.tmp e renomeado somente após o fsync, de modo
+ * que um snapshot anterior nunca é substituído por um arquivo incompleto. O
+ * diretório também recebe fsync após o rename, para que a troca sobreviva a
+ * uma queda de energia antes que a aplicação descarte o que o snapshot cobre.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_snapshot.h"
+#include "string.h"
+
+#if FSM_SNAPSHOT_MMAP
+
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @defgroup fsm_snapshot_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_SNAPSHOT_BATCH	1024	/**< Registros convertidos por escrita */
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Torna durável a entrada de diretório de um arquivo
+ * @details		Abre o diretório que contém path e executa fsync, necessário após criar
+ *				ou renomear o arquivo para que a operação sobreviva a uma queda de energia
+ * @param		path caminho do arquivo
+ * @retval		FSM_NO_RESOURCES caso o diretório não possa ser aberto ou sincronizado
+ */
+fsm_result_t fsm_snapshot_sync_dir(const char *path)
+{
+	char dir[PATH_MAX];
+	const char *slash;
+	size_t length;
+	int fd, ok;
+
+	if( path==NULL )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	slash = strrchr(path, '/');
+	if( slash == NULL )
+	{
+		memcpy(dir, ".", 2);
+	}
+	else
+	{
+		length = (slash == path) ? 1 : (size_t)(slash - path);
+		if( length >= sizeof(dir) )
+		{
+			FSM_ERR("ERROR: path too long\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+		memcpy(dir, path, length);
+		dir[length] = '\0';
+	}
+
+	fd = open(dir, O_RDONLY);
+	if( fd < 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	ok = (fsync(fd) == 0);
+	close(fd);
+	if( !ok )
+	{
+		FSM_ERR("ERROR: sync failed\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Calcula a identidade de uma tabela de transição
+ * @details		FNV-1a de 64 bits sobre number_events e, para cada linha, os índices do
+ *				estado atual e do próximo estado e o evento
+ * @param		stateTable ponteiro para tabela de transição de estados
+ * @param		states lista obtida com fsm_state_list
+ * @param		number_states quantidade de estados da lista
+ * @param		number_events quantidade de eventos no enum da FSM
+ */
+uint64_t fsm_snapshot_hash(fsm_state_t *stateTable, void **states, uint16_t number_states, uint16_t number_events)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	uint16_t row, field[3];
+	uint8_t byte;
+
+	field[0] = number_events;
+	for( byte=0; byte<2; byte++ )
+	{
+		hash = (hash ^ ((field[0] >> (8 * byte)) & 0xFF)) * 0x100000001B3ull;
+	}
+
+	for( row=0; stateTable[row].cb_state != NULL; row++ )
+	{
+		field[0] = fsm_state_index(states, number_states, stateTable[row].cb_state);
+		field[1] = stateTable[row].eventID;
+		field[2] = fsm_state_index(states, number_states, stateTable[row].cb_next);
+		for( byte=0; byte<6; byte++ )
+		{
+			hash = (hash ^ ((field[byte / 2] >> (8 * (byte % 2))) & 0xFF)) * 0x100000001B3ull;
+		}
+	}
+
+	return(hash);
+}
+
+/**
+ * @brief		Grava o estado de uma população de instâncias
+ * @details		Todas as instâncias devem compartilhar a tabela de transição de
+ *				population[0]. O arquivo só substitui path depois de completamente gravado,
+ *				e a troca já é durável quando a função retorna FSM_OK.
+ * @param		path caminho do arquivo de snapshot
+ * @param		population vetor de instâncias
+ * @param		count quantidade de instâncias
+ * @retval		FSM_STATE_ERROR caso alguma instância use outra tabela ou um estado fora dela
+ * @retval		FSM_NO_RESOURCES caso o arquivo não possa ser gravado ou a troca não possa
+ *				ser sincronizada (path pode já conter o novo snapshot)
+ */
+fsm_result_t fsm_snapshot_write(const char *path, fsm_handler_t *population, uint64_t count)
+{
+	fsm_snapshot_header_t header;
+	fsm_cold_t batch[FSM_SNAPSHOT_BATCH];
+	void *states[FSM_SNAPSHOT_MAX_STATES];
+	char tmp[PATH_MAX];
+	fsm_state_t *stateTable;
+	uint16_t number_states, number_events;
+	uint64_t index;
+	uint32_t fill = 0;
+	FILE *file;
+	int ok;
+
+	FSM_DBG("fsm snapshot write %s ", path);
+
+	if( (path==NULL) || (population==NULL) || (count == 0) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	stateTable		= population[0].stateTable;
+	number_events	= population[0].number_events;
+	number_states	= fsm_state_list(stateTable, states, FSM_SNAPSHOT_MAX_STATES);
+	if( number_states == FSM_STATE_INVALID )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+
+	if( snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp) )
+	{
+		FSM_ERR("ERROR: path too long\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "FSMS", 4);
+	header.version			= FSM_SNAPSHOT_VERSION;
+	header.byte_order		= FSM_SNAPSHOT_BYTE_ORDER;
+	header.record_size		= sizeof(fsm_cold_t);
+	header.number_states	= number_states;
+	header.number_events	= number_events;
+	header.table_hash		= fsm_snapshot_hash(stateTable, states, number_states, number_events);
+	header.count			= count;
+	header.records_offset	= FSM_SNAPSHOT_HEADER_SIZE;
+
+	file = fopen(tmp, "wb");
+	if( file == NULL )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+	for( index=0; ok && (index<count); index++ )
+	{
+		if( (population[index].stateTable != stateTable) ||
+			((batch[fill].state = fsm_state_index(states, number_states, population[index].cb_state)) == FSM_STATE_INVALID) )
+		{
+			FSM_ERR("ERROR: invalid state\r\n");
+			fclose(file);
+			remove(tmp);
+			return(FSM_STATE_ERROR);
+		}
+		// Qualquer valor >= number_events significa "sem evento"; a restauração só aceita number_events
+		batch[fill].eventID = (population[index].eventID < number_events) ? population[index].eventID : number_events;
+
+		if( (++fill == FSM_SNAPSHOT_BATCH) || (index + 1 == count) )
+		{
+			ok = (fwrite(batch, sizeof(fsm_cold_t), fill, file) == fill);
+			fill = 0;
+		}
+	}
+
+	ok = ok && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+	ok = (fclose(file) == 0) && ok;
+	if( !ok || (rename(tmp, path) != 0) )
+	{
+		FSM_ERR("ERROR: write failed\r\n");
+		remove(tmp);
+		return(FSM_NO_RESOURCES);
+	}
+
+	// Sem o fsync do diretório o rename pode ser perdido junto com a energia
+	if( fsm_snapshot_sync_dir(path) != FSM_OK )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Mapeia um snapshot em memória
+ * @details		Apenas o cabeçalho é validado; as páginas dos registros são carregadas
+ *				sob demanda quando as instâncias são acessadas
+ * @param		snapshot ponteiro para estrutura do snapshot
+ * @param		path caminho do arquivo de snapshot
+ * @param		stateTable tabela de transição atual da aplicação
+ * @param		fsm_name nome das instâncias restauradas
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @retval		FSM_FORMAT_ERROR caso o arquivo não seja um snapshot compatível
+ * @retval		FSM_STT_ERROR caso o snapshot tenha sido gravado com outra tabela
+ * @retval		FSM_NO_RESOURCES caso o arquivo não possa ser mapeado
+ */
+fsm_result_t fsm_snapshot_map(fsm_snapshot_t *snapshot, const char *path, fsm_state_t *stateTable, char* fsm_name, uint16_t number_events)
+{
+	fsm_snapshot_header_t *header;
+	fsm_result_t ret;
+	struct stat info;
+	void *mapped;
+	int fd;
+
+	FSM_DBG("fsm snapshot map %s ", path);
+
+	if( (snapshot==NULL) || (path==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(snapshot, 0, sizeof(fsm_snapshot_t));
+	ret = fsm_create(&snapshot->proto, stateTable, (stateTable != NULL) ? stateTable[0].cb_state : NULL, fsm_name, number_events);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	snapshot->number_states = fsm_state_list(stateTable, snapshot->states, FSM_SNAPSHOT_MAX_STATES);
+	if( snapshot->number_states == FSM_STATE_INVALID )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+
+	fd = open(path, O_RDONLY);
+	if( fd < 0 )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	if( (fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(fsm_snapshot_header_t)) )
+	{
+		close(fd);
+		FSM_ERR("ERROR: invalid snapshot\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	mapped = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if( mapped == MAP_FAILED )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	snapshot->mapped		= mapped;
+	snapshot->mapped_size	= (size_t)info.st_size;
+
+	header = (fsm_snapshot_header_t*)mapped;
+	if( (memcmp(header->magic, "FSMS", 4) != 0) ||
+		(header->version != FSM_SNAPSHOT_VERSION) ||
+		(header->byte_order != FSM_SNAPSHOT_BYTE_ORDER) ||
+		(header->record_size != sizeof(fsm_cold_t)) ||
+		(header->records_offset < sizeof(fsm_snapshot_header_t)) ||
+		((header->records_offset % sizeof(fsm_cold_t)) != 0) ||
+		(header->records_offset > snapshot->mapped_size) ||
+		(header->count > ((snapshot->mapped_size - header->records_offset) / sizeof(fsm_cold_t))) )
+	{
+		fsm_snapshot_unmap(snapshot);
+		FSM_ERR("ERROR: invalid snapshot\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	if( (header->number_events != number_events) ||
+		(header->number_states != snapshot->number_states) ||
+		(header->table_hash != fsm_snapshot_hash(stateTable, snapshot->states, snapshot->number_states, number_events)) )
+	{
+		fsm_snapshot_unmap(snapshot);
+		FSM_ERR("ERROR: state table mismatch\r\n");
+		return(FSM_STT_ERROR);
+	}
+
+	snapshot->records	= (fsm_cold_t*)((uint8_t*)mapped + header->records_offset);
+	snapshot->count		= header->count;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Desfaz o mapeamento de um snapshot
+ * @param		snapshot ponteiro para estrutura do snapshot
+ */
+fsm_result_t fsm_snapshot_unmap(fsm_snapshot_t *snapshot)
+{
+	if( snapshot==NULL )
+	{
+		FSM_ERR("ERROR: snapshot null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( snapshot->mapped != NULL )
+	{
+		munmap(snapshot->mapped, snapshot->mapped_size);
+	}
+	snapshot->mapped		= NULL;
+	snapshot->mapped_size	= 0;
+	snapshot->records		= NULL;
+	snapshot->count			= 0;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Restaura uma instância do snapshot
+ * @param		snapshot ponteiro para estrutura do snapshot
+ * @param		index posição da instância no snapshot
+ * @param		fsm estrutura que recebe a instância restaurada
+ * @retval		FSM_STATE_ERROR caso index esteja fora do snapshot
+ * @retval		FSM_FORMAT_ERROR caso o registro tenha um estado ou evento pendente inexistente
+ */
+fsm_result_t fsm_snapshot_restore(fsm_snapshot_t *snapshot, uint64_t index, fsm_handler_t *fsm)
+{
+	fsm_cold_t record;
+
+	if( (snapshot==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( index >= snapshot->count )
+	{
+		FSM_ERR("ERROR: index out of bounds\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	record = snapshot->records[index];
+	if( (record.state >= snapshot->number_states) || (record.eventID > snapshot->proto.number_events) )
+	{
+		FSM_ERR("ERROR: invalid record\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	*fsm			= snapshot->proto;
+	fsm->cb_state	= snapshot->states[record.state];
+	fsm->eventID	= record.eventID;
+
+	return(FSM_OK);
+}
+
+#endif
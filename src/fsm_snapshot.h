@@ -0,0 +1,115 @@
+/**
+ * @file	fsm_snapshot.h
+ * @brief	Checkpoint e restauração de populações da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Grava o estado de uma população de instâncias que compartilham a mesma
+ * tabela de transição em um arquivo versionado e independente de endereços:
+ * cada instância é um registro fsm_cold_t com o índice do estado (ver
+ * fsm_state_list) e o evento pendente. A restauração é apenas um mmap do
+ * arquivo, sem interpretar as instâncias; cada registro é convertido para
+ * fsm_handler_t somente quando acessado, e o tempo de restauração passa a
+ * depender das falhas de página, e não da quantidade de instâncias.
+ *
+ * A identidade da tabela é verificada por um hash calculado sobre os índices
+ * dos estados e os eventos de cada linha, e não sobre os endereços, para que
+ * o snapshot continue válido após recompilar a aplicação sem alterar a tabela.
+ *
+ * Formato do arquivo (ordem de bytes nativa, verificada por byte_order):
+ * @code
+ * cabeçalho (FSM_SNAPSHOT_HEADER_SIZE bytes, ver fsm_snapshot_header_t)
+ * registros a partir de records_offset, count * sizeof(fsm_cold_t) bytes
+ * @endcode
+ *
+ * Disponível apenas em sistemas com mmap (FSM_SNAPSHOT_MMAP).
+ *
+ */
+#ifndef __FSM_SNAPSHOT_H__
+#define __FSM_SNAPSHOT_H__
+
+/**
+ * @defgroup fsm_snapshot_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+#include "fsm_cold.h"
+
+/**
+ * Macros Públicas
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_SNAPSHOT_MMAP	1
+#else
+#	define FSM_SNAPSHOT_MMAP	0
+#endif
+
+#ifndef FSM_SNAPSHOT_MAX_STATES
+#	define FSM_SNAPSHOT_MAX_STATES	256	/**< Estados distintos suportados na tabela */
+#endif
+
+#define FSM_SNAPSHOT_VERSION		1
+#define FSM_SNAPSHOT_HEADER_SIZE	64
+#define FSM_SNAPSHOT_BYTE_ORDER		0x0102
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Snapshot Header
+ */
+typedef struct fsm_snapshot_header
+{
+	char		magic[4];		/**< "FSMS" */
+	uint16_t	version;		/**< FSM_SNAPSHOT_VERSION */
+	uint16_t	byte_order;		/**< FSM_SNAPSHOT_BYTE_ORDER gravado na ordem de quem escreveu */
+	uint16_t	record_size;	/**< sizeof(fsm_cold_t) */
+	uint16_t	number_states;	/**< Estados da tabela */
+	uint16_t	number_events;	/**< Eventos da FSM */
+	uint16_t	reserved;
+	uint64_t	table_hash;		/**< fsm_snapshot_hash da tabela */
+	uint64_t	count;			/**< Quantidade de instâncias */
+	uint64_t	records_offset;	/**< Início dos registros no arquivo */
+	uint8_t		padding[FSM_SNAPSHOT_HEADER_SIZE - 40];
+} fsm_snapshot_header_t;
+
+/**
+ * @brief FSM Snapshot
+ *
+ * Snapshot mapeado em memória. O mapeamento é privado: alterações nos
+ * registros não são gravadas de volta no arquivo.
+ */
+typedef struct fsm_snapshot
+{
+	fsm_handler_t	proto;			/**< Modelo para as instâncias restauradas */
+	fsm_cold_t*		records;		/**< Registros mapeados, um por instância */
+	uint64_t		count;			/**< Quantidade de instâncias */
+	uint16_t		number_states;	/**< Estados em states */
+	void*			states[FSM_SNAPSHOT_MAX_STATES];	/**< Estados indexados da tabela */
+	void*			mapped;			/**< Base do mmap */
+	size_t			mapped_size;	/**< Tamanho do mmap */
+} fsm_snapshot_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+uint64_t	 fsm_snapshot_hash		(fsm_state_t *stateTable, void **states, uint16_t number_states, uint16_t number_events);
+fsm_result_t fsm_snapshot_sync_dir	(const char *path);
+fsm_result_t fsm_snapshot_write		(const char *path, fsm_handler_t *population, uint64_t count);
+fsm_result_t fsm_snapshot_map		(fsm_snapshot_t *snapshot, const char *path, fsm_state_t *stateTable, char* fsm_name, uint16_t number_events);
+fsm_result_t fsm_snapshot_unmap		(fsm_snapshot_t *snapshot);
+fsm_result_t fsm_snapshot_restore	(fsm_snapshot_t *snapshot, uint64_t index, fsm_handler_t *fsm);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,365 @@
+/**
+ * @file	fsm_swap.c
+ * @brief	Troca de tabelas da Finite State Machine em execução
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O leitor anuncia a época antes de ler a versão publicada e o escritor
+ * avança a época depois de publicar a nova versão, ambos com ordenação
+ * sequencialmente consistente: um leitor que não aparece na varredura do
+ * escritor só pode enxergar a nova versão.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_swap.h"
+#include "string.h"
+
+#if FSM_SWAP_ENABLE
+
+/**
+ * @defgroup fsm_swap_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static fsm_result_t	fsm_swap_check		(const fsm_table_t *table);
+static uint8_t		fsm_swap_quiescent	(fsm_swap_t *swap, uint32_t epoch);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa uma tabela compartilhada
+ * @param		swap ponteiro para estrutura da tabela compartilhada
+ * @param		version primeira versão (ver fsm_table_compile e fsm_bundle_table)
+ * @param		map resolve estados ausentes em novas versões (pode ser NULL)
+ * @param		release libera versões substituídas (pode ser NULL)
+ * @param		context contexto de map e release
+ * @retval		FSM_STT_ERROR caso a tabela da versão seja inconsistente
+ */
+fsm_result_t fsm_swap_init(fsm_swap_t *swap, fsm_swap_version_t *version, fsm_swap_map_t map, fsm_swap_release_t release, void *context)
+{
+	fsm_result_t ret;
+
+	FSM_DBG("fsm swap init ");
+
+	if( (swap==NULL) || (version==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	ret = fsm_swap_check(&version->table);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	memset(swap, 0, sizeof(fsm_swap_t));
+	version->generation	= 1;
+	version->retired	= 0;
+	swap->current		= version;
+	swap->epoch			= 1;
+	swap->generation	= 1;
+	swap->map			= map;
+	swap->release		= release;
+	swap->context		= context;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Registra o leitor de uma thread que executa fsm_engine
+ * @details		Pode ser chamada por várias threads ao mesmo tempo; leitores não são
+ *				removidos e devem permanecer válidos enquanto a tabela existir
+ * @param		swap ponteiro para estrutura da tabela compartilhada
+ * @param		reader leitor da thread
+ */
+fsm_result_t fsm_swap_register(fsm_swap_t *swap, fsm_swap_reader_t *reader)
+{
+	fsm_swap_reader_t *head;
+
+	if( (swap==NULL) || (reader==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	reader->swap	= swap;
+	reader->epoch	= 0;
+	head = __atomic_load_n(&swap->readers, __ATOMIC_ACQUIRE);
+	do
+	{
+		reader->next = head;
+	} while( !__atomic_compare_exchange_n(&swap->readers, &head, reader, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) );
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Cria uma FSM sobre a versão publicada da tabela compartilhada
+ * @param		fsm ponteiro para estrutura FSM
+ * @param		reader leitor da thread que executará a FSM
+ * @param		fsm_name ponteiro para a string com o nome da FSM
+ */
+fsm_result_t fsm_swap_create(fsm_handler_t *fsm, fsm_swap_reader_t *reader, char* fsm_name)
+{
+	fsm_swap_version_t *version;
+	fsm_result_t ret;
+
+	if( (fsm==NULL) || (reader==NULL) || (reader->swap==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	__atomic_store_n(&reader->epoch, __atomic_load_n(&reader->swap->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	version = __atomic_load_n(&reader->swap->current, __ATOMIC_SEQ_CST);
+
+	ret = fsm_create_table(fsm, &version->table, fsm_name);
+	if( ret == FSM_OK )
+	{
+		fsm->reader		= reader;
+		fsm->generation	= version->generation;
+	}
+
+	fsm_swap_exit(reader);
+	return(ret);
+}
+
+/**
+ * @brief		Publica uma nova versão da tabela
+ * @details		A versão é validada em O(estados x eventos) antes de publicada. A versão
+ *				substituída é liberada quando nenhum leitor puder mais vê-la, nesta ou
+ *				em uma próxima chamada de fsm_swap_reclaim.
+ * @param		swap ponteiro para estrutura da tabela compartilhada
+ * @param		version nova versão; deve permanecer válida até ser liberada
+ * @retval		FSM_STT_ERROR caso a tabela da versão seja inconsistente
+ * @retval		FSM_NO_RESOURCES caso haja FSM_SWAP_RETIRED versões aguardando liberação
+ */
+fsm_result_t fsm_swap_table(fsm_swap_t *swap, fsm_swap_version_t *version)
+{
+	fsm_swap_version_t *previous;
+	fsm_result_t ret;
+	uint32_t epoch;
+
+	FSM_DBG("fsm swap table ");
+
+	if( (swap==NULL) || (version==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	ret = fsm_swap_check(&version->table);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	if( (swap->number_retired >= FSM_SWAP_RETIRED) && (fsm_swap_reclaim(swap) == 0) )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	version->generation	= ++swap->generation;
+	version->retired	= 0;
+	previous = __atomic_exchange_n(&swap->current, version, __ATOMIC_SEQ_CST);
+
+	epoch = swap->epoch + 1;
+	if( epoch == 0 )
+	{
+		epoch = 1;
+	}
+	__atomic_store_n(&swap->epoch, epoch, __ATOMIC_SEQ_CST);
+
+	previous->retired = epoch;
+	swap->retired[swap->number_retired++] = previous;
+	fsm_swap_reclaim(swap);
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Libera as versões substituídas que nenhum leitor pode mais ver
+ * @details		Não bloqueia; deve ser chamada pela thread que publica as versões
+ * @param		swap ponteiro para estrutura da tabela compartilhada
+ * @return		Quantidade de versões liberadas
+ */
+uint32_t fsm_swap_reclaim(fsm_swap_t *swap)
+{
+	uint32_t count = 0;
+	uint16_t index = 0;
+
+	if( swap==NULL )
+	{
+		FSM_ERR("ERROR: swap null\r\n");
+		return(0);
+	}
+
+	while( index < swap->number_retired )
+	{
+		if( fsm_swap_quiescent(swap, swap->retired[index]->retired) )
+		{
+			if( swap->release != NULL )
+			{
+				swap->release(swap->retired[index], swap->context);
+			}
+			swap->retired[index] = swap->retired[--swap->number_retired];
+			count++;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	return(count);
+}
+
+/**
+ * @brief		Aguarda a liberação de todas as versões substituídas
+ * @details		Bloqueia apenas quem publica; os leitores saem da consulta à tabela ao
+ *				final de cada transição
+ * @param		swap ponteiro para estrutura da tabela compartilhada
+ */
+void fsm_swap_synchronize(fsm_swap_t *swap)
+{
+	if( swap==NULL )
+	{
+		FSM_ERR("ERROR: swap null\r\n");
+		return;
+	}
+
+	while( swap->number_retired > 0 )
+	{
+		fsm_swap_reclaim(swap);
+	}
+}
+
+/**
+ * @brief		Inicia a consulta à tabela compartilhada (chamada pelo fsm_engine)
+ * @details		Anuncia a época do leitor, atualiza fsm->table para a versão publicada e,
+ *				na troca de versão, migra o estado da FSM para os índices da nova versão.
+ *				Também chamada pelo fsm_post e pelo fsm_engine com eventos acima do enum
+ *				da versão em uso
+ * @param		fsm ponteiro para estrutura FSM
+ * @retval		FSM_STATE_ERROR caso o estado não exista na nova versão nem seja resolvido
+ *				pela função de mapeamento; a consulta já foi encerrada
+ */
+fsm_result_t fsm_swap_enter(fsm_handler_t *fsm)
+{
+	fsm_swap_reader_t *reader = fsm->reader;
+	fsm_swap_t *swap = reader->swap;
+	fsm_swap_version_t *version;
+	uint16_t state;
+
+	__atomic_store_n(&reader->epoch, __atomic_load_n(&swap->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	version = __atomic_load_n(&swap->current, __ATOMIC_SEQ_CST);
+
+	if( version->generation != fsm->generation )
+	{
+		state = fsm_state_index((void**)version->table.callbacks, version->table.number_states, fsm->cb_state);
+		if( (state == FSM_STATE_INVALID) && (swap->map != NULL) )
+		{
+			state = swap->map(fsm->cb_state, &version->table, swap->context);
+		}
+		if( state >= version->table.number_states )
+		{
+			fsm_swap_exit(reader);
+			return(FSM_STATE_ERROR);
+		}
+
+		// A ausência de evento é marcada pelo número de eventos de cada versão
+		if( fsm->eventID == fsm->number_events )
+		{
+			FSM_STORE(fsm->eventID, version->table.number_events);
+		}
+		fsm->stateIdx		= state;
+		FSM_STORE(fsm->cb_state, version->table.callbacks[state]);
+		fsm->number_events	= version->table.number_events;
+		fsm->generation		= version->generation;
+	}
+
+	fsm->table = &version->table;
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Encerra a consulta à tabela compartilhada (chamada pelo fsm_engine)
+ * @param		reader leitor da thread
+ */
+void fsm_swap_exit(fsm_swap_reader_t *reader)
+{
+	__atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief fsm_swap_check
+ *
+ * Função privada que verifica se os índices da tabela são consistentes
+ */
+static fsm_result_t fsm_swap_check(const fsm_table_t *table)
+{
+	uint32_t position;
+	uint16_t state;
+
+	if( (table->callbacks == NULL) || (table->next == NULL) || (table->initial >= table->number_states) )
+	{
+		FSM_ERR("ERROR: invalid table\r\n");
+		return(FSM_STT_ERROR);
+	}
+
+	for( state=0; state<table->number_states; state++ )
+	{
+		if( table->callbacks[state] == NULL )
+		{
+			FSM_ERR("ERROR: callback null\r\n");
+			return(FSM_STT_ERROR);
+		}
+	}
+
+	for( position=0; position<((uint32_t)table->number_states * table->number_events); position++ )
+	{
+		if( (table->next[position] != FSM_STATE_INVALID) && (table->next[position] >= table->number_states) )
+		{
+			FSM_ERR("ERROR: invalid table\r\n");
+			return(FSM_STT_ERROR);
+		}
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_swap_quiescent
+ *
+ * Função privada que verifica se nenhum leitor está em uma época anterior a epoch
+ */
+static uint8_t fsm_swap_quiescent(fsm_swap_t *swap, uint32_t epoch)
+{
+	fsm_swap_reader_t *reader;
+	uint32_t seen;
+
+	for( reader=__atomic_load_n(&swap->readers, __ATOMIC_ACQUIRE); reader != NULL; reader=reader->next )
+	{
+		seen = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+		if( (seen != 0) && ((int32_t)(seen - epoch) < 0) )
+		{
+			return(0);
+		}
+	}
+	return(1);
+}
+
+#endif
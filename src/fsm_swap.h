@@ -0,0 +1,122 @@
+/**
+ * @file	fsm_swap.h
+ * @brief	Troca de tabelas da Finite State Machine em execução
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Publica novas versões de uma tabela indexada (fsm_table_t) para todas as
+ * FSMs que a compartilham, sem pausar o fsm_engine. A versão atual é lida
+ * com um load atômico e trocada com um store atômico (estilo RCU); o
+ * fsm_engine não usa locks. Cada thread que executa fsm_engine registra um
+ * leitor, que anuncia a época global enquanto consulta a tabela; uma versão
+ * substituída só é liberada depois que todos os leitores saírem das épocas
+ * em que ela ainda podia ser vista.
+ *
+ * Cada FSM migra para a nova versão no primeiro evento após a troca. O
+ * estado é localizado pelo callback; estados que não existem na nova versão
+ * (renomeados ou removidos) são resolvidos pela função de mapeamento.
+ *
+ * Apenas uma thread pode publicar versões de um mesmo fsm_swap_t. As máscaras
+ * de fsm_defer_attach não acompanham a troca, então essas instâncias não
+ * aceitam tabela de eventos adiados. Requer FSM_SWAP_ENABLE 1.
+ *
+ */
+#ifndef __FSM_SWAP_H__
+#define __FSM_SWAP_H__
+
+/**
+ * @defgroup fsm_swap_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#ifndef FSM_SWAP_RETIRED
+#	define FSM_SWAP_RETIRED	8	/**< Versões substituídas aguardando liberação */
+#endif
+
+#if FSM_SWAP_ENABLE
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Swap Version
+ *
+ * Versão publicada de uma tabela. A tabela deve ser o primeiro campo.
+ */
+typedef struct fsm_swap_version
+{
+	fsm_table_t	table;		/**< Tabela indexada desta versão */
+	uint32_t	generation;	/**< Atribuída na publicação */
+	uint32_t	retired;	/**< Época em que foi substituída */
+} fsm_swap_version_t;
+
+/**
+ * @brief Resolve o índice na nova versão de um estado que não existe mais nela
+ * @return Índice do estado, ou FSM_STATE_INVALID
+ */
+typedef uint16_t (*fsm_swap_map_t)(void *cb_state, const fsm_table_t *table, void *context);
+
+/**
+ * @brief Libera uma versão que nenhum leitor pode mais ver
+ */
+typedef void (*fsm_swap_release_t)(fsm_swap_version_t *version, void *context);
+
+/**
+ * @brief FSM Swap Reader
+ *
+ * Registro de uma thread que executa fsm_engine. epoch é 0 fora da consulta
+ * à tabela.
+ */
+typedef struct fsm_swap_reader
+{
+	struct fsm_swap*		swap;	/**< Tabela compartilhada */
+	uint32_t				epoch;	/**< Época anunciada durante a consulta */
+	struct fsm_swap_reader*	next;	/**< Próximo leitor registrado */
+} fsm_swap_reader_t;
+
+/**
+ * @brief FSM Swap
+ */
+typedef struct fsm_swap
+{
+	fsm_swap_version_t*	current;	/**< Versão publicada (acesso atômico) */
+	uint32_t			epoch;		/**< Época global, nunca 0 */
+	uint32_t			generation;	/**< Geração da versão publicada */
+	fsm_swap_reader_t*	readers;	/**< Leitores registrados */
+	fsm_swap_version_t*	retired[FSM_SWAP_RETIRED];	/**< Versões aguardando liberação */
+	uint16_t			number_retired;	/**< Posições ocupadas em retired */
+	fsm_swap_map_t		map;		/**< Mapeamento de estados ausentes (pode ser NULL) */
+	fsm_swap_release_t	release;	/**< Liberação de versões (pode ser NULL) */
+	void*				context;	/**< Contexto de map e release */
+} fsm_swap_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_swap_init			(fsm_swap_t *swap, fsm_swap_version_t *version, fsm_swap_map_t map, fsm_swap_release_t release, void *context);
+fsm_result_t fsm_swap_register		(fsm_swap_t *swap, fsm_swap_reader_t *reader);
+fsm_result_t fsm_swap_create		(fsm_handler_t *fsm, fsm_swap_reader_t *reader, char* fsm_name);
+fsm_result_t fsm_swap_table			(fsm_swap_t *swap, fsm_swap_version_t *version);
+uint32_t	 fsm_swap_reclaim		(fsm_swap_t *swap);
+void		 fsm_swap_synchronize	(fsm_swap_t *swap);
+fsm_result_t fsm_swap_enter			(fsm_handler_t *fsm);
+void		 fsm_swap_exit			(fsm_swap_reader_t *reader);
+
+#endif
+
+/**
+ * @}
+ */
+
+#endif
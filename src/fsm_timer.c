@@ -0,0 +1,366 @@
+/**
+ * @file	fsm_timer.c
+ * @brief	Temporizadores das FSMs e ocioso sem tick periódico
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Heap binário de ponteiros para os temporizadores armados; cada
+ * temporizador guarda a sua posição no heap para ser cancelado ou
+ * rearmado sem busca.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_timer.h"
+#include "string.h"
+
+#if FSM_TIMER_NANOSLEEP
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+/**
+ * @defgroup fsm_timer_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSM_TIMER_BEFORE(a, b)	((int32_t)((a) - (b)) < 0)
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static void	fsm_timer_up	(fsm_timers_t *timers, uint16_t index);
+static void	fsm_timer_down	(fsm_timers_t *timers, uint16_t index);
+static void	fsm_timer_place	(fsm_timers_t *timers, fsm_timer_t *timer, uint16_t index);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicializa um conjunto de temporizadores
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		heap vetor para os temporizadores armados
+ * @param		capacity quantidade de posições em heap
+ */
+fsm_result_t fsm_timers_init(fsm_timers_t *timers, fsm_timer_t **heap, uint16_t capacity)
+{
+	FSM_DBG("fsm timers init ");
+
+	if( (timers==NULL) || (heap==NULL) || (capacity==0) || (capacity>=FSM_TIMER_IDLE) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(timers, 0, sizeof(fsm_timers_t));
+	timers->heap		= heap;
+	timers->capacity	= capacity;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Inicializa um temporizador desarmado
+ * @param		timer ponteiro para estrutura do temporizador
+ * @param		fsm FSM que recebe o evento no vencimento
+ * @param		eventID evento enviado no vencimento
+ */
+fsm_result_t fsm_timer_init(fsm_timer_t *timer, fsm_handler_t *fsm, uint16_t eventID)
+{
+	if( (timer==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	timer->fsm		= fsm;
+	timer->deadline	= 0;
+	timer->eventID	= eventID;
+	timer->index	= FSM_TIMER_IDLE;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Arma ou rearma um temporizador
+ * @details		Pode ser chamada pelo callback do estado que aguarda o tempo
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		timer ponteiro para estrutura do temporizador
+ * @param		now tempo atual, em ticks
+ * @param		timeout ticks até o vencimento (no máximo 2^31 - 1)
+ * @retval		FSM_NO_RESOURCES caso o heap esteja cheio
+ */
+fsm_result_t fsm_timer_start(fsm_timers_t *timers, fsm_timer_t *timer, uint32_t now, uint32_t timeout)
+{
+	uint32_t previous;
+
+	if( (timers==NULL) || (timer==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	previous		= timer->deadline;
+	timer->deadline	= now + timeout;
+
+	if( timer->index != FSM_TIMER_IDLE )
+	{
+		if( FSM_TIMER_BEFORE(timer->deadline, previous) )
+		{
+			fsm_timer_up(timers, timer->index);
+		}
+		else
+		{
+			fsm_timer_down(timers, timer->index);
+		}
+		return(FSM_OK);
+	}
+
+	if( timers->number >= timers->capacity )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	fsm_timer_place(timers, timer, timers->number++);
+	fsm_timer_up(timers, timer->index);
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Cancela um temporizador
+ * @details		Não tem efeito caso o temporizador esteja desarmado
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		timer ponteiro para estrutura do temporizador
+ */
+fsm_result_t fsm_timer_stop(fsm_timers_t *timers, fsm_timer_t *timer)
+{
+	fsm_timer_t *moved;
+	uint16_t index;
+
+	if( (timers==NULL) || (timer==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	index = timer->index;
+	if( index == FSM_TIMER_IDLE )
+	{
+		return(FSM_OK);
+	}
+
+	timer->index = FSM_TIMER_IDLE;
+	if( index != --timers->number )
+	{
+		moved = timers->heap[timers->number];
+		fsm_timer_place(timers, moved, index);
+		fsm_timer_up(timers, index);
+		fsm_timer_down(timers, moved->index);
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Envia os eventos dos temporizadores vencidos
+ * @details		Cada temporizador vencido é desarmado antes do fsm_post. Um temporizador
+ *				cuja FSM ainda tem evento pendente, inclusive o de outro temporizador
+ *				vencido nesta chamada, continua armado e vencido: é entregue em uma
+ *				próxima chamada, depois que o fsm_engine consumir o evento, sem
+ *				substituí-lo
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		now tempo atual, em ticks
+ * @return		Quantidade de temporizadores entregues
+ */
+uint16_t fsm_timers_expire(fsm_timers_t *timers, uint32_t now)
+{
+	fsm_timer_t *timer;
+	uint16_t count = 0, held = 0;
+
+	if( timers==NULL )
+	{
+		FSM_ERR("ERROR: timers null\r\n");
+		return(0);
+	}
+
+	while( (timers->number > 0) && !FSM_TIMER_BEFORE(now, timers->heap[0]->deadline) )
+	{
+		timer = timers->heap[0];
+		fsm_timer_stop(timers, timer);
+		if( timer->fsm->eventID < timer->fsm->number_events )
+		{
+			// Guardado no fim do vetor, fora das posições em uso pelo heap
+			held++;
+			timers->heap[timers->capacity - held] = timer;
+			continue;
+		}
+		fsm_post(timer->fsm, timer->eventID);
+		count++;
+	}
+
+	// Os retidos voltam ao heap com o prazo vencido, a partir da posição mais baixa
+	while( held > 0 )
+	{
+		timer = timers->heap[timers->capacity - held];
+		held--;
+		fsm_timer_place(timers, timer, timers->number++);
+		fsm_timer_up(timers, timer->index);
+	}
+
+	timers->expired += count;
+	return(count);
+}
+
+/**
+ * @brief		Obtém o prazo mais próximo entre todos os temporizadores armados
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		deadline recebe o prazo, em ticks
+ * @return		1 caso haja temporizador armado, 0 caso contrário
+ */
+uint8_t fsm_next_deadline(const fsm_timers_t *timers, uint32_t *deadline)
+{
+	if( (timers==NULL) || (deadline==NULL) || (timers->number == 0) )
+	{
+		return(0);
+	}
+
+	*deadline = timers->heap[0]->deadline;
+	return(1);
+}
+
+/**
+ * @brief		Dorme até o prazo mais próximo
+ * @details		Chamada pelo laço principal quando nenhuma FSM tem evento pendente. Não
+ *				chama o gancho caso algum prazo já tenha vencido.
+ * @param		timers ponteiro para estrutura dos temporizadores
+ * @param		now tempo atual, em ticks
+ * @param		idle gancho que programa o despertar e dorme
+ * @param		context contexto do gancho
+ * @return		Ticks pedidos ao gancho (0 sem chamada, FSM_TIMER_FOREVER sem prazo)
+ */
+uint32_t fsm_timers_idle(fsm_timers_t *timers, uint32_t now, fsm_timer_idle_t idle, void *context)
+{
+	uint32_t deadline, ticks = FSM_TIMER_FOREVER;
+
+	if( (timers==NULL) || (idle==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(0);
+	}
+
+	if( fsm_next_deadline(timers, &deadline) )
+	{
+		if( !FSM_TIMER_BEFORE(now, deadline) )
+		{
+			return(0);
+		}
+		ticks = deadline - now;
+	}
+
+	timers->wakeups++;
+	idle(ticks, context);
+	return(ticks);
+}
+
+#if FSM_TIMER_NANOSLEEP
+/**
+ * @brief		Gancho de ocioso do host
+ * @details		Dorme com clock_nanosleep (CLOCK_MONOTONIC); sem prazo aguarda um sinal
+ * @param		ticks ticks até o despertar
+ * @param		context ponteiro para uint32_t com a duração de um tick em nanossegundos
+ */
+void fsm_timer_nanosleep(uint32_t ticks, void *context)
+{
+	struct timespec delay;
+	uint64_t ns;
+
+	if( ticks == FSM_TIMER_FOREVER )
+	{
+		pause();
+		return;
+	}
+
+	ns = (uint64_t)ticks * ((context != NULL) ? *(const uint32_t*)context : 1000000u);
+	delay.tv_sec	= (time_t)(ns / 1000000000ull);
+	delay.tv_nsec	= (long)(ns % 1000000000ull);
+#if defined(__linux__)
+	clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, NULL);
+#else
+	nanosleep(&delay, NULL);
+#endif
+}
+#endif
+
+/**
+ * @brief fsm_timer_place
+ *
+ * Função privada que coloca um temporizador em uma posição do heap
+ */
+static void fsm_timer_place(fsm_timers_t *timers, fsm_timer_t *timer, uint16_t index)
+{
+	timers->heap[index]	= timer;
+	timer->index		= index;
+}
+
+/**
+ * @brief fsm_timer_up
+ *
+ * Função privada que sobe um temporizador no heap enquanto vence antes do pai
+ */
+static void fsm_timer_up(fsm_timers_t *timers, uint16_t index)
+{
+	fsm_timer_t *timer = timers->heap[index];
+	uint16_t parent;
+
+	while( index > 0 )
+	{
+		parent = (uint16_t)((index - 1) / 2);
+		if( !FSM_TIMER_BEFORE(timer->deadline, timers->heap[parent]->deadline) )
+		{
+			break;
+		}
+		fsm_timer_place(timers, timers->heap[parent], index);
+		index = parent;
+	}
+	fsm_timer_place(timers, timer, index);
+}
+
+/**
+ * @brief fsm_timer_down
+ *
+ * Função privada que desce um temporizador no heap enquanto algum filho vence antes
+ */
+static void fsm_timer_down(fsm_timers_t *timers, uint16_t index)
+{
+	fsm_timer_t *timer = timers->heap[index];
+	uint32_t child;
+
+	for( ;; )
+	{
+		child = 2u * index + 1u;
+		if( child >= timers->number )
+		{
+			break;
+		}
+		if( ((child + 1) < timers->number) && FSM_TIMER_BEFORE(timers->heap[child + 1]->deadline, timers->heap[child]->deadline) )
+		{
+			child++;
+		}
+		if( !FSM_TIMER_BEFORE(timers->heap[child]->deadline, timer->deadline) )
+		{
+			break;
+		}
+		fsm_timer_place(timers, timers->heap[child], index);
+		index = (uint16_t)child;
+	}
+	fsm_timer_place(timers, timer, index);
+}
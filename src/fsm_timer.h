@@ -0,0 +1,117 @@
+/**
+ * @file	fsm_timer.h
+ * @brief	Temporizadores das FSMs e ocioso sem tick periódico
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Cada FSM que aguarda um tempo arma um fsm_timer_t, normalmente no
+ * callback do estado. Os temporizadores armados ficam em um heap mínimo
+ * ordenado pelo prazo, de modo que fsm_next_deadline obtém o prazo mais
+ * próximo de todas as instâncias em O(1) e armar, cancelar ou expirar custa
+ * O(log n). No vencimento o evento do temporizador é enviado com fsm_post;
+ * se a FSM ainda tiver evento pendente, o temporizador continua vencido até
+ * uma próxima chamada de fsm_timers_expire, sem substituir o evento.
+ *
+ * Com isso o laço principal não precisa de um tick a cada 1 ms: depois de
+ * executar as FSMs com evento pendente, fsm_timers_idle programa um único
+ * despertar para o prazo mais próximo, por exemplo:
+ * @code
+ * for( ;; )
+ * {
+ *     fsm_timers_expire(&timers, HAL_GetTick());
+ *     fsm_run(&fsm, &budget);
+ *     fsm_timers_idle(&timers, HAL_GetTick(), app_sleep, NULL);
+ * }
+ * @endcode
+ * O gancho (fsm_timer_idle_t) é da aplicação: no alvo, app_sleep programa um
+ * despertar único (LPTIM ou SysTick com recarga estendida), executa __WFI()
+ * e soma ao contador do HAL_GetTick os ticks dormidos; no host há
+ * fsm_timer_nanosleep. A biblioteca não traz gancho para microcontroladores.
+ * Os prazos são em ticks da aplicação e comparados com aritmética modular:
+ * um temporizador não pode ser armado para mais de 2^31 ticks.
+ *
+ */
+#ifndef __FSM_TIMER_H__
+#define __FSM_TIMER_H__
+
+/**
+ * @defgroup fsm_timer_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_TIMER_IDLE		0xFFFF		/**< Índice de um temporizador desarmado */
+#define FSM_TIMER_FOREVER	0xFFFFFFFF	/**< Espera sem prazo: nenhum temporizador armado */
+
+#if defined(__unix__) || defined(__APPLE__)
+#	define FSM_TIMER_NANOSLEEP	1
+#else
+#	define FSM_TIMER_NANOSLEEP	0
+#endif
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM Timer
+ *
+ * Temporizador de uma FSM. Deve ser iniciado com fsm_timer_init.
+ */
+typedef struct fsm_timer
+{
+	fsm_handler_t*	fsm;		/**< FSM que recebe o evento */
+	uint32_t		deadline;	/**< Prazo, em ticks */
+	uint16_t		eventID;	/**< Evento enviado no vencimento */
+	uint16_t		index;		/**< Posição no heap (FSM_TIMER_IDLE quando desarmado) */
+} fsm_timer_t;
+
+/**
+ * @brief FSM Timers
+ *
+ * Conjunto de temporizadores de um laço de execução
+ */
+typedef struct fsm_timers
+{
+	fsm_timer_t**	heap;		/**< Temporizadores armados, heap mínimo por prazo */
+	uint16_t		number;		/**< Temporizadores armados */
+	uint16_t		capacity;	/**< Posições em heap */
+	uint32_t		wakeups;	/**< Chamadas do gancho de ocioso */
+	uint32_t		expired;	/**< Temporizadores vencidos */
+} fsm_timers_t;
+
+/**
+ * @brief		Gancho de ocioso
+ * @details		Programa um despertar para daqui a ticks (FSM_TIMER_FOREVER sem prazo) e
+ *				dorme até ele ou até uma interrupção que possa gerar eventos
+ */
+typedef void (*fsm_timer_idle_t)(uint32_t ticks, void *context);
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t	fsm_timers_init		(fsm_timers_t *timers, fsm_timer_t **heap, uint16_t capacity);
+fsm_result_t	fsm_timer_init		(fsm_timer_t *timer, fsm_handler_t *fsm, uint16_t eventID);
+fsm_result_t	fsm_timer_start		(fsm_timers_t *timers, fsm_timer_t *timer, uint32_t now, uint32_t timeout);
+fsm_result_t	fsm_timer_stop		(fsm_timers_t *timers, fsm_timer_t *timer);
+uint16_t		fsm_timers_expire	(fsm_timers_t *timers, uint32_t now);
+uint8_t			fsm_next_deadline	(const fsm_timers_t *timers, uint32_t *deadline);
+uint32_t		fsm_timers_idle		(fsm_timers_t *timers, uint32_t now, fsm_timer_idle_t idle, void *context);
+#if FSM_TIMER_NANOSLEEP
+void			fsm_timer_nanosleep	(uint32_t ticks, void *context);
+#endif
+
+/**
+ * @}
+ */
+
+#endif
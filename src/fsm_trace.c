@@ -0,0 +1,320 @@
+/**
+ * @file	fsm_trace.c
+ * @brief	Gravação e reprodução de eventos da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Captura todos os eventos entregues a uma FSM em um log binário compacto e
+ * reproduz logs capturados através do fsm_engine com um relógio virtual.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_trace.h"
+#include "string.h"
+
+/**
+ * @defgroup fsm_trace_c doxygengroup
+ * @{
+ */
+
+/**
+ * Variáveis privadas
+ */
+static uint32_t fsm_trace_virtual_tick = 0;
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static uint32_t fsm_trace_putVarint(uint8_t *buffer, uint32_t value);
+static uint32_t fsm_trace_getVarint(const uint8_t *buffer, uint32_t length, uint32_t *value);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Inicia a gravação dos eventos de uma FSM
+ * @details		Escreve o cabeçalho do log no buffer e associa o gravador à FSM. A partir
+ *				deste ponto cada evento processado pelo fsm_engine é anexado ao log.
+ * @param		trace ponteiro para estrutura do gravador
+ * @param		fsm ponteiro para estrutura FSM já criada com fsm_create
+ * @param		buffer área de memória que receberá o log
+ * @param		size tamanho do buffer em bytes
+ * @param		clock função que retorna o tick atual (ex.: HAL_GetTick)
+ * @return		Resultado da operação
+ * @retval		FSM_NO_RESOURCES caso o buffer não comporte o cabeçalho
+ * @retval		FSM_FUNCTION_NULL caso a gravação esteja desabilitada (FSM_TRACE_ENABLE 0)
+ */
+fsm_result_t fsm_trace_start(fsm_trace_t *trace, fsm_handler_t *fsm, uint8_t *buffer, uint32_t size, fsm_clock_t clock)
+{
+	FSM_DBG("fsm trace start ");
+
+	if( (trace==NULL) || (fsm==NULL) || (buffer==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( clock==NULL )
+	{
+		FSM_ERR("ERROR: clock null\r\n");
+		return(FSM_FUNCTION_NULL);
+	}
+
+#if !FSM_TRACE_ENABLE
+	// Sem FSM_TRACE_ENABLE o fsm_engine não grava eventos
+	FSM_ERR("ERROR: FSM_TRACE_ENABLE disabled\r\n");
+	return(FSM_FUNCTION_NULL);
+#endif
+
+	if( size < FSM_TRACE_HEADER_SIZE )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	memset(trace, 0, sizeof(fsm_trace_t));
+	trace->buffer		= buffer;
+	trace->size			= size;
+	trace->clock		= clock;
+	trace->last_tick	= clock();
+
+	buffer[0] = 'F';
+	buffer[1] = 'S';
+	buffer[2] = 'M';
+	buffer[3] = 'T';
+	buffer[4] = FSM_TRACE_VERSION;
+	buffer[5] = 0;
+	buffer[6] = (uint8_t)(fsm->number_events);
+	buffer[7] = (uint8_t)(fsm->number_events >> 8);
+	buffer[8] = (uint8_t)(trace->last_tick);
+	buffer[9] = (uint8_t)(trace->last_tick >> 8);
+	buffer[10] = (uint8_t)(trace->last_tick >> 16);
+	buffer[11] = (uint8_t)(trace->last_tick >> 24);
+	trace->length = FSM_TRACE_HEADER_SIZE;
+
+#if FSM_TRACE_ENABLE
+	fsm->trace = trace;
+#endif
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Encerra a gravação dos eventos de uma FSM
+ * @details		O conteúdo do log permanece no buffer do gravador, com trace->length bytes
+ * @param		fsm ponteiro para estrutura FSM
+ */
+fsm_result_t fsm_trace_stop(fsm_handler_t *fsm)
+{
+	if( fsm==NULL )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+#if FSM_TRACE_ENABLE
+	fsm->trace = NULL;
+#endif
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Anexa um evento ao log
+ * @details		Chamada pelo fsm_engine para cada evento entregue à FSM. O instante é
+ *				gravado como a diferença em ticks para o evento anterior.
+ * @param		trace ponteiro para estrutura do gravador
+ * @param		eventID evento entregue à FSM
+ * @retval		FSM_NO_RESOURCES caso o buffer esteja cheio (o evento é descartado)
+ */
+fsm_result_t fsm_trace_record(fsm_trace_t *trace, uint16_t eventID)
+{
+	uint32_t tick;
+
+	if( (trace->size - trace->length) < FSM_TRACE_RECORD_MAX )
+	{
+		trace->dropped++;
+		return(FSM_NO_RESOURCES);
+	}
+
+	tick = trace->clock();
+	trace->length += fsm_trace_putVarint(&trace->buffer[trace->length], tick - trace->last_tick);
+	trace->length += fsm_trace_putVarint(&trace->buffer[trace->length], eventID);
+	trace->last_tick = tick;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Reproduz um log através do fsm_engine
+ * @details		Para cada registro o relógio virtual (fsm_trace_clock) é avançado até o
+ *				instante gravado, o evento é entregue à FSM e o fsm_engine é executado,
+ *				sem nenhuma espera. O evento retornado pelo callback do estado é
+ *				substituído pelo próximo evento do log (fsm_post), e os eventos emitidos
+ *				(fsm_emit) são descartados, de modo que a sequência gravada é sempre a
+ *				que conduz a FSM. Callbacks executados no host devem usar
+ *				fsm_trace_clock como fonte de tempo para que a reprodução seja determinística.
+ * @param		fsm ponteiro para estrutura FSM criada com a mesma tabela da gravação
+ * @param		log ponteiro para o log capturado
+ * @param		length tamanho do log em bytes
+ * @param		result estatísticas da reprodução (pode ser NULL)
+ * @retval		FSM_FORMAT_ERROR caso o log seja inválido ou não pertença a esta FSM
+ */
+fsm_result_t fsm_trace_replay(fsm_handler_t *fsm, const uint8_t *log, uint32_t length, fsm_replay_t *result)
+{
+	fsm_replay_t replay;
+	uint32_t pos, delta, eventID, used;
+	fsm_result_t ret;
+#if FSM_TRACE_ENABLE
+	fsm_trace_t *trace;
+#endif
+
+	FSM_DBG("fsm trace replay ");
+
+	if( (fsm==NULL) || (log==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (length < FSM_TRACE_HEADER_SIZE) ||
+		(log[0] != 'F') || (log[1] != 'S') || (log[2] != 'M') || (log[3] != 'T') ||
+		(log[4] != FSM_TRACE_VERSION) ||
+		(((uint16_t)log[6] | ((uint16_t)log[7] << 8)) != fsm->number_events) )
+	{
+		FSM_ERR("ERROR: invalid trace\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	memset(&replay, 0, sizeof(fsm_replay_t));
+	fsm_trace_virtual_tick = (uint32_t)log[8] | ((uint32_t)log[9] << 8) |
+							 ((uint32_t)log[10] << 16) | ((uint32_t)log[11] << 24);
+
+	// A reprodução não deve ser gravada novamente
+#if FSM_TRACE_ENABLE
+	trace = fsm->trace;
+	fsm->trace = NULL;
+#endif
+#if FSM_EMIT_QUEUE > 0
+	// Os eventos emitidos foram gravados quando despachados: só o log conduz a FSM
+	fsm->emit_count = 0;
+	fsm->emit_muted = 1;
+#endif
+
+	ret = FSM_OK;
+	pos = FSM_TRACE_HEADER_SIZE;
+	while( pos < length )
+	{
+		used = fsm_trace_getVarint(&log[pos], length - pos, &delta);
+		if( used == 0 )
+		{
+			ret = FSM_FORMAT_ERROR;
+			break;
+		}
+		pos += used;
+
+		used = fsm_trace_getVarint(&log[pos], length - pos, &eventID);
+		if( (used == 0) || (eventID >= fsm->number_events) )
+		{
+			ret = FSM_FORMAT_ERROR;
+			break;
+		}
+		pos += used;
+
+		fsm_trace_virtual_tick += delta;
+		if( replay.events == 0 )
+		{
+			replay.first_tick = fsm_trace_virtual_tick;
+		}
+
+		fsm_post(fsm, (uint16_t)eventID);
+		if( fsm_engine(fsm) == FSM_OK )
+		{
+			replay.transitions++;
+		}
+		replay.events++;
+	}
+	replay.last_tick = fsm_trace_virtual_tick;
+
+#if FSM_TRACE_ENABLE
+	fsm->trace = trace;
+#endif
+#if FSM_EMIT_QUEUE > 0
+	fsm->emit_muted = 0;
+#endif
+
+	if( result != NULL )
+	{
+		*result = replay;
+	}
+
+	if( ret != FSM_OK )
+	{
+		FSM_ERR("ERROR: truncated trace\r\n");
+		return(ret);
+	}
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Relógio virtual da reprodução
+ * @details		Retorna o tick do evento que está sendo reproduzido. Pode ser utilizado
+ *				como substituto de HAL_GetTick nos builds de host.
+ * @return		Tick virtual atual
+ */
+uint32_t fsm_trace_clock(void)
+{
+	return(fsm_trace_virtual_tick);
+}
+
+/**
+ * @brief fsm_trace_putVarint
+ *
+ * Função privada que codifica um inteiro em varint e retorna a quantidade de bytes escritos
+ */
+static uint32_t fsm_trace_putVarint(uint8_t *buffer, uint32_t value)
+{
+	uint32_t len = 0;
+
+	while( value >= 0x80 )
+	{
+		buffer[len++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[len++] = (uint8_t)value;
+
+	return(len);
+}
+
+/**
+ * @brief fsm_trace_getVarint
+ *
+ * Função privada que decodifica um inteiro varint e retorna a quantidade de bytes lidos
+ * (0 caso o valor esteja truncado ou seja maior que 32 bits)
+ */
+static uint32_t fsm_trace_getVarint(const uint8_t *buffer, uint32_t length, uint32_t *value)
+{
+	uint32_t len = 0;
+	uint32_t shift = 0;
+
+	*value = 0;
+	while( (len < length) && (shift < 35) )
+	{
+		*value |= (uint32_t)(buffer[len] & 0x7F) << shift;
+		if( (buffer[len++] & 0x80) == 0 )
+		{
+			return(len);
+		}
+		shift += 7;
+	}
+
+	return(0);
+}
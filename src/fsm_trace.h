@@ -0,0 +1,102 @@
+/**
+ * @file	fsm_trace.h
+ * @brief	Gravação e reprodução de eventos da Finite State Machine
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Captura todos os eventos entregues a uma FSM, com o instante em que foram
+ * processados, em um log binário compacto. O log pode ser reproduzido em um
+ * host através do fsm_engine com um relógio virtual, sem esperas, para uso
+ * como carga reprodutível em testes de desempenho.
+ *
+ * Formato do log (little endian):
+ * @code
+ * cabeçalho (12 bytes)
+ *   [0..3]   "FSMT"
+ *   [4]      versão (FSM_TRACE_VERSION)
+ *   [5]      reservado (0)
+ *   [6..7]   number_events da FSM gravada
+ *   [8..11]  tick inicial da gravação
+ * registros (2 a 8 bytes cada)
+ *   varint   ticks decorridos desde o registro anterior
+ *   varint   eventID
+ * @endcode
+ * Os inteiros varint usam 7 bits por byte, com o bit mais significativo
+ * indicando que há mais bytes a seguir.
+ *
+ */
+#ifndef __FSM_TRACE_H__
+#define __FSM_TRACE_H__
+
+/**
+ * @defgroup fsm_trace_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stdint.h>
+#include "fsm.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_TRACE_VERSION		1
+#define FSM_TRACE_HEADER_SIZE	12
+#define FSM_TRACE_RECORD_MAX	8
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief Fonte de tempo utilizada para marcar os eventos gravados
+ */
+typedef uint32_t (*fsm_clock_t)(void);
+
+/**
+ * @brief FSM Trace
+ *
+ * Gravador de eventos de uma FSM. O buffer é fornecido pela aplicação e não
+ * há alocação dinâmica; quando o buffer enche, os eventos seguintes são
+ * contados em dropped e descartados.
+ */
+typedef struct fsm_trace
+{
+	uint8_t*		buffer;		/**< Buffer que recebe o log */
+	uint32_t		size;		/**< Tamanho do buffer em bytes */
+	uint32_t		length;		/**< Bytes já utilizados no buffer */
+	uint32_t		last_tick;	/**< Tick do último evento gravado */
+	uint32_t		dropped;	/**< Eventos descartados por falta de espaço */
+	fsm_clock_t		clock;		/**< Fonte de tempo da gravação */
+} fsm_trace_t;
+
+/**
+ * @brief FSM Replay Result
+ *
+ * Resumo da reprodução de um log
+ */
+typedef struct fsm_replay
+{
+	uint32_t	events;			/**< Eventos entregues ao fsm_engine */
+	uint32_t	transitions;	/**< Eventos que resultaram em transição de estado */
+	uint32_t	first_tick;		/**< Tick virtual do primeiro evento */
+	uint32_t	last_tick;		/**< Tick virtual do último evento */
+} fsm_replay_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_trace_start	(fsm_trace_t *trace, fsm_handler_t *fsm, uint8_t *buffer, uint32_t size, fsm_clock_t clock);
+fsm_result_t fsm_trace_stop		(fsm_handler_t *fsm);
+fsm_result_t fsm_trace_record	(fsm_trace_t *trace, uint16_t eventID);
+fsm_result_t fsm_trace_replay	(fsm_handler_t *fsm, const uint8_t *log, uint32_t length, fsm_replay_t *result);
+uint32_t	 fsm_trace_clock	(void);
+
+/**
+ * @}
+ */
+
+#endif
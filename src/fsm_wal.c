@@ -0,0 +1,449 @@
+/**
+ * @file	fsm_wal.c
+ * @brief	Log de transições da Finite State Machine para recuperação após falhas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * O arquivo tem tamanho fixo, reservado na criação, para que acrescentar um
+ * registro seja apenas uma escrita em memória. Os blocos são efetivamente
+ * alocados (posix_fallocate), e não apenas o tamanho ajustado: um arquivo
+ * esparso em um disco cheio geraria SIGBUS na primeira escrita de uma página
+ * mapeada, em vez de um erro na abertura. No commit os registros são
+ * sincronizados antes do cabeçalho, e só então length avança.
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include "fsm_wal.h"
+#include "string.h"
+
+#if FSM_SNAPSHOT_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @defgroup fsm_wal_c doxygengroup
+ * @{
+ */
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static int	fsm_wal_msync	(void *start, size_t length);
+static int	fsm_wal_reserve	(int fd, size_t size);
+
+/**
+ * @}
+ */
+
+/**
+ * @brief		Abre ou cria um log de transições
+ * @details		Um log existente é mapeado com os registros duráveis, prontos para
+ *				fsm_wal_replay, e capacity é ignorado. Um arquivo novo é criado com
+ *				espaço para capacity registros.
+ * @param		wal ponteiro para estrutura do log
+ * @param		path caminho do arquivo de log
+ * @param		capacity registros que cabem no arquivo (limita o tempo de recuperação)
+ * @param		stateTable tabela de transição da população
+ * @param		number_events quantidade de eventos no enum da FSM
+ * @param		sync_interval ticks entre commits (0 para commit a cada transição)
+ * @retval		FSM_FORMAT_ERROR caso o arquivo não seja um log compatível
+ * @retval		FSM_STT_ERROR caso o log tenha sido gravado com outra tabela
+ * @retval		FSM_NO_RESOURCES caso o arquivo não possa ser criado, reservado em disco ou
+ *				mapeado
+ */
+fsm_result_t fsm_wal_open(fsm_wal_t *wal, const char *path, uint64_t capacity, fsm_state_t *stateTable, uint16_t number_events, uint32_t sync_interval)
+{
+	fsm_wal_header_t *header;
+	struct stat info;
+	uint64_t hash;
+	size_t size;
+	void *mapped;
+	int fd, created = 0;
+
+	FSM_DBG("fsm wal open %s ", path);
+
+	if( (wal==NULL) || (path==NULL) || (stateTable==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	memset(wal, 0, sizeof(fsm_wal_t));
+	wal->number_states = fsm_state_list(stateTable, wal->states, FSM_SNAPSHOT_MAX_STATES);
+	if( wal->number_states == FSM_STATE_INVALID )
+	{
+		return(FSM_NO_RESOURCES);
+	}
+	hash = fsm_snapshot_hash(stateTable, wal->states, wal->number_states, number_events);
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if( (fd < 0) || (fstat(fd, &info) != 0) )
+	{
+		if( fd >= 0 )
+		{
+			close(fd);
+		}
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	size = (size_t)info.st_size;
+	if( size == 0 )
+	{
+		size = sizeof(fsm_wal_header_t) + (size_t)capacity * sizeof(fsm_wal_record_t);
+		if( (capacity == 0) || (fsm_wal_reserve(fd, size) != 0) )
+		{
+			// Volta a ficar vazio, para ser criado novamente na próxima abertura
+			if( ftruncate(fd, 0) != 0 )
+			{
+				FSM_ERR("ERROR: truncate failed\r\n");
+			}
+			close(fd);
+			FSM_ERR("ERROR: without resources\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+		created = 1;
+	}
+	else if( size < sizeof(fsm_wal_header_t) )
+	{
+		close(fd);
+		FSM_ERR("ERROR: invalid log\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+
+	mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if( mapped == MAP_FAILED )
+	{
+		FSM_ERR("ERROR: without resources\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	wal->mapped			= mapped;
+	wal->mapped_size	= size;
+
+	header = (fsm_wal_header_t*)mapped;
+	if( created )
+	{
+		memcpy(header->magic, "FSMW", 4);
+		header->version			= FSM_WAL_VERSION;
+		header->byte_order		= FSM_SNAPSHOT_BYTE_ORDER;
+		header->record_size		= sizeof(fsm_wal_record_t);
+		header->number_states	= wal->number_states;
+		header->number_events	= number_events;
+		header->table_hash		= hash;
+		header->capacity		= capacity;
+		header->length			= 0;
+		if( (fsm_wal_msync(header, sizeof(fsm_wal_header_t)) != 0) || (fsm_snapshot_sync_dir(path) != FSM_OK) )
+		{
+			fsm_wal_close(wal);
+			FSM_ERR("ERROR: without resources\r\n");
+			return(FSM_NO_RESOURCES);
+		}
+	}
+	else if( (memcmp(header->magic, "FSMW", 4) != 0) ||
+			 (header->version != FSM_WAL_VERSION) ||
+			 (header->byte_order != FSM_SNAPSHOT_BYTE_ORDER) ||
+			 (header->record_size != sizeof(fsm_wal_record_t)) ||
+			 (header->capacity > ((size - sizeof(fsm_wal_header_t)) / sizeof(fsm_wal_record_t))) ||
+			 (header->length > header->capacity) )
+	{
+		fsm_wal_close(wal);
+		FSM_ERR("ERROR: invalid log\r\n");
+		return(FSM_FORMAT_ERROR);
+	}
+	else if( (header->number_events != number_events) ||
+			 (header->number_states != wal->number_states) ||
+			 (header->table_hash != hash) )
+	{
+		fsm_wal_close(wal);
+		FSM_ERR("ERROR: state table mismatch\r\n");
+		return(FSM_STT_ERROR);
+	}
+
+	wal->header			= header;
+	wal->records		= (fsm_wal_record_t*)((uint8_t*)mapped + sizeof(fsm_wal_header_t));
+	wal->capacity		= header->capacity;
+	wal->length			= header->length;
+	wal->synced			= header->length;
+	wal->sync_interval	= sync_interval;
+	wal->stateTable		= stateTable;
+	wal->number_events	= number_events;
+
+	FSM_DBG("success\r\n");
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Torna duráveis os registros pendentes e fecha o log
+ * @param		wal ponteiro para estrutura do log
+ */
+fsm_result_t fsm_wal_close(fsm_wal_t *wal)
+{
+	if( wal==NULL )
+	{
+		FSM_ERR("ERROR: wal null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( wal->header != NULL )
+	{
+		fsm_wal_flush(wal);
+	}
+	if( wal->mapped != NULL )
+	{
+		munmap(wal->mapped, wal->mapped_size);
+	}
+	memset(wal, 0, sizeof(fsm_wal_t));
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Acrescenta ao log a transição efetivada por uma instância
+ * @details		Deve ser chamada sempre que fsm_engine retornar FSM_OK. O commit só é
+ *				feito quando sync_interval ticks se passaram desde o anterior.
+ * @param		wal ponteiro para estrutura do log
+ * @param		index posição da instância na população
+ * @param		fsm instância após a transição
+ * @param		now tick atual
+ * @retval		FSM_NO_RESOURCES caso o log esteja cheio (ver fsm_wal_compact)
+ * @retval		FSM_STATE_ERROR caso a instância esteja em um estado fora da tabela
+ */
+fsm_result_t fsm_wal_append(fsm_wal_t *wal, uint32_t index, fsm_handler_t *fsm, uint32_t now)
+{
+	fsm_wal_record_t *record;
+	uint16_t state;
+
+	if( (wal==NULL) || (wal->header==NULL) || (fsm==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	if( wal->length >= wal->capacity )
+	{
+		FSM_ERR("ERROR: log full\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+
+	state = fsm_state_index(wal->states, wal->number_states, fsm->cb_state);
+	if( state == FSM_STATE_INVALID )
+	{
+		FSM_ERR("ERROR: invalid state\r\n");
+		return(FSM_STATE_ERROR);
+	}
+
+	record = &wal->records[wal->length++];
+	record->index			= index;
+	record->cold.state		= state;
+	// Qualquer valor >= number_events significa "sem evento"; o replay só aceita number_events
+	record->cold.eventID	= (fsm->eventID < wal->number_events) ? fsm->eventID : wal->number_events;
+
+	return(fsm_wal_sync(wal, now));
+}
+
+/**
+ * @brief		Executa um passo de uma instância e registra a transição no log
+ * @param		wal ponteiro para estrutura do log
+ * @param		population vetor de instâncias
+ * @param		index posição da instância na população
+ * @param		now tick atual
+ * @return		Resultado do fsm_engine, ou o erro do fsm_wal_append caso a transição
+ *				não possa ser registrada
+ */
+fsm_result_t fsm_wal_engine(fsm_wal_t *wal, fsm_handler_t *population, uint32_t index, uint32_t now)
+{
+	fsm_result_t ret, logged;
+
+	ret = fsm_engine(&population[index]);
+	if( ret == FSM_OK )
+	{
+		logged = fsm_wal_append(wal, index, &population[index], now);
+		if( logged != FSM_OK )
+		{
+			return(logged);
+		}
+	}
+
+	return(ret);
+}
+
+/**
+ * @brief		Faz o commit dos registros pendentes se o intervalo expirou
+ * @param		wal ponteiro para estrutura do log
+ * @param		now tick atual
+ */
+fsm_result_t fsm_wal_sync(fsm_wal_t *wal, uint32_t now)
+{
+	if( (wal==NULL) || (wal->header==NULL) )
+	{
+		FSM_ERR("ERROR: wal null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( (wal->length > wal->synced) && ((uint32_t)(now - wal->last_sync) >= wal->sync_interval) )
+	{
+		wal->last_sync = now;
+		return(fsm_wal_flush(wal));
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Faz o commit imediato dos registros pendentes
+ * @param		wal ponteiro para estrutura do log
+ * @retval		FSM_NO_RESOURCES caso o msync falhe
+ */
+fsm_result_t fsm_wal_flush(fsm_wal_t *wal)
+{
+	if( (wal==NULL) || (wal->header==NULL) )
+	{
+		FSM_ERR("ERROR: wal null\r\n");
+		return(FSM_NULL);
+	}
+
+	if( wal->length == wal->synced )
+	{
+		return(FSM_OK);
+	}
+
+	// Registros antes do cabeçalho: length nunca aponta para registros não duráveis
+	if( fsm_wal_msync(&wal->records[wal->synced], (size_t)(wal->length - wal->synced) * sizeof(fsm_wal_record_t)) != 0 )
+	{
+		FSM_ERR("ERROR: msync failed\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	wal->header->length = wal->length;
+	if( fsm_wal_msync(wal->header, sizeof(fsm_wal_header_t)) != 0 )
+	{
+		FSM_ERR("ERROR: msync failed\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	wal->synced = wal->length;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Reaplica o log sobre a população restaurada do último snapshot
+ * @param		wal ponteiro para estrutura do log, recém aberto
+ * @param		population vetor de instâncias, já restaurado
+ * @param		count quantidade de instâncias
+ * @retval		FSM_FORMAT_ERROR caso algum registro seja inválido; os registros
+ *				anteriores já foram aplicados
+ */
+fsm_result_t fsm_wal_replay(fsm_wal_t *wal, fsm_handler_t *population, uint32_t count)
+{
+	fsm_wal_record_t *record;
+	uint64_t position;
+
+	if( (wal==NULL) || (wal->header==NULL) || (population==NULL) )
+	{
+		FSM_ERR("ERROR: null pointer\r\n");
+		return(FSM_NULL);
+	}
+
+	for( position=0; position<wal->length; position++ )
+	{
+		record = &wal->records[position];
+		if( (record->index >= count) || (record->cold.state >= wal->number_states) ||
+			(record->cold.eventID > wal->number_events) )
+		{
+			FSM_ERR("ERROR: invalid record\r\n");
+			return(FSM_FORMAT_ERROR);
+		}
+		population[record->index].cb_state	= wal->states[record->cold.state];
+		population[record->index].eventID	= record->cold.eventID;
+	}
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief		Compacta o log contra um novo snapshot da população
+ * @details		O log é tornado durável antes do snapshot e esvaziado depois dele; uma
+ *				falha entre as duas etapas apenas reaplica registros já contidos no snapshot.
+ *				O log só é esvaziado depois que o rename do snapshot é durável.
+ * @param		wal ponteiro para estrutura do log
+ * @param		snapshot_path caminho do snapshot usado na recuperação
+ * @param		population vetor de instâncias
+ * @param		count quantidade de instâncias
+ */
+fsm_result_t fsm_wal_compact(fsm_wal_t *wal, const char *snapshot_path, fsm_handler_t *population, uint32_t count)
+{
+	fsm_result_t ret;
+
+	ret = fsm_wal_flush(wal);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	// fsm_snapshot_write só retorna FSM_OK após o fsync do diretório: uma queda
+	// depois deste ponto nunca encontra o snapshot anterior com o log já vazio
+	ret = fsm_snapshot_write(snapshot_path, population, count);
+	if( ret != FSM_OK )
+	{
+		return(ret);
+	}
+
+	wal->header->length = 0;
+	if( fsm_wal_msync(wal->header, sizeof(fsm_wal_header_t)) != 0 )
+	{
+		FSM_ERR("ERROR: msync failed\r\n");
+		return(FSM_NO_RESOURCES);
+	}
+	wal->length = 0;
+	wal->synced = 0;
+
+	return(FSM_OK);
+}
+
+/**
+ * @brief fsm_wal_msync
+ *
+ * Função privada que sincroniza as páginas que contêm o intervalo
+ */
+static int fsm_wal_msync(void *start, size_t length)
+{
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t first = (uintptr_t)start & ~(page - 1);
+
+	return(msync((void*)first, ((uintptr_t)start + length) - first, MS_SYNC));
+}
+
+/**
+ * @brief fsm_wal_reserve
+ *
+ * Função privada que aloca os blocos do arquivo; retorna 0 em caso de sucesso
+ */
+static int fsm_wal_reserve(int fd, size_t size)
+{
+#if defined(__APPLE__)
+	// Sem posix_fallocate: os blocos são alocados escrevendo zeros
+	static const uint8_t zero[4096];
+	size_t offset, chunk;
+
+	for( offset=0; offset<size; offset+=chunk )
+	{
+		chunk = ((size - offset) < sizeof(zero)) ? (size - offset) : sizeof(zero);
+		if( pwrite(fd, zero, chunk, (off_t)offset) != (ssize_t)chunk )
+		{
+			return(-1);
+		}
+	}
+	return(0);
+#else
+	return(posix_fallocate(fd, 0, (off_t)size));
+#endif
+}
+
+#endif
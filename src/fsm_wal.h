@@ -0,0 +1,116 @@
+/**
+ * @file	fsm_wal.h
+ * @brief	Log de transições da Finite State Machine para recuperação após falhas
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Camada opcional de durabilidade para uma população de instâncias em um
+ * vetor de fsm_handler_t. Cada transição efetivada (fsm_engine retornando
+ * FSM_OK) é acrescentada a um log mapeado em memória com o índice da
+ * instância, o índice do novo estado e o evento pendente. Os registros são
+ * agrupados e tornados duráveis com um único msync a cada intervalo de
+ * ticks (group commit), e não um fsync por transição.
+ *
+ * O log é compactado contra um snapshot (fsm_snapshot.h): a população é
+ * gravada em um snapshot e o log volta a ficar vazio. A recuperação restaura
+ * o último snapshot e reaplica o log, cujo tamanho máximo limita o tempo de
+ * recuperação. Os registros guardam o estado resultante, e não o evento,
+ * então reaplicar um log já contido no snapshot não altera a população.
+ *
+ * Disponível apenas em sistemas com mmap (FSM_SNAPSHOT_MMAP).
+ *
+ */
+#ifndef __FSM_WAL_H__
+#define __FSM_WAL_H__
+
+/**
+ * @defgroup fsm_wal_h doxygengroup
+ * @{
+ */
+
+/**
+ * Bibliotecas Públicas
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "fsm.h"
+#include "fsm_snapshot.h"
+
+/**
+ * Macros Públicas
+ */
+#define FSM_WAL_VERSION		1
+#define FSM_WAL_HEADER_SIZE	64
+
+/**
+ * Tipos de Dados Públicos
+ */
+
+/**
+ * @brief FSM WAL Header
+ *
+ * Apenas os registros antes de length são considerados na recuperação;
+ * length só avança depois que os registros correspondentes são duráveis.
+ */
+typedef struct fsm_wal_header
+{
+	char		magic[4];		/**< "FSMW" */
+	uint16_t	version;		/**< FSM_WAL_VERSION */
+	uint16_t	byte_order;		/**< FSM_SNAPSHOT_BYTE_ORDER gravado na ordem de quem escreveu */
+	uint16_t	record_size;	/**< sizeof(fsm_wal_record_t) */
+	uint16_t	number_states;	/**< Estados da tabela */
+	uint16_t	number_events;	/**< Eventos da FSM */
+	uint16_t	reserved;
+	uint64_t	table_hash;		/**< fsm_snapshot_hash da tabela */
+	uint64_t	capacity;		/**< Registros que cabem no arquivo */
+	uint64_t	length;			/**< Registros duráveis */
+	uint8_t		padding[FSM_WAL_HEADER_SIZE - 40];
+} fsm_wal_header_t;
+
+/**
+ * @brief FSM WAL Record
+ */
+typedef struct fsm_wal_record
+{
+	uint32_t	index;	/**< Posição da instância na população */
+	fsm_cold_t	cold;	/**< Estado e evento pendente após a transição */
+} fsm_wal_record_t;
+
+/**
+ * @brief FSM WAL
+ */
+typedef struct fsm_wal
+{
+	fsm_wal_header_t*	header;			/**< Cabeçalho mapeado */
+	fsm_wal_record_t*	records;		/**< Registros mapeados */
+	uint64_t			capacity;		/**< Registros que cabem no arquivo */
+	uint64_t			length;			/**< Registros acrescentados */
+	uint64_t			synced;			/**< Registros duráveis */
+	uint32_t			sync_interval;	/**< Ticks entre commits */
+	uint32_t			last_sync;		/**< Tick do último commit */
+	fsm_state_t*		stateTable;		/**< Tabela da população */
+	uint16_t			number_states;	/**< Estados em states */
+	uint16_t			number_events;	/**< Eventos da FSM */
+	void*				states[FSM_SNAPSHOT_MAX_STATES];	/**< Estados indexados da tabela */
+	void*				mapped;			/**< Base do mmap */
+	size_t				mapped_size;	/**< Tamanho do mmap */
+} fsm_wal_t;
+
+/**
+ * Protótipos de Funções Públicas
+ */
+fsm_result_t fsm_wal_open	(fsm_wal_t *wal, const char *path, uint64_t capacity, fsm_state_t *stateTable, uint16_t number_events, uint32_t sync_interval);
+fsm_result_t fsm_wal_close	(fsm_wal_t *wal);
+fsm_result_t fsm_wal_append	(fsm_wal_t *wal, uint32_t index, fsm_handler_t *fsm, uint32_t now);
+fsm_result_t fsm_wal_engine	(fsm_wal_t *wal, fsm_handler_t *population, uint32_t index, uint32_t now);
+fsm_result_t fsm_wal_sync	(fsm_wal_t *wal, uint32_t now);
+fsm_result_t fsm_wal_flush	(fsm_wal_t *wal);
+fsm_result_t fsm_wal_replay	(fsm_wal_t *wal, fsm_handler_t *population, uint32_t count);
+fsm_result_t fsm_wal_compact(fsm_wal_t *wal, const char *snapshot_path, fsm_handler_t *population, uint32_t count);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,440 @@
+/**
+ * @file	fsmtop.c
+ * @brief	Inspetor das populações de FSM em memória compartilhada
+ * @author	Thiago Milioni
+ * @version	0.2
+ * @date	28 Abr 2024
+ *
+ * Conecta-se somente para leitura a um segmento criado com fsm_shm_create e
+ * mostra periodicamente, para cada FSM, a distribuição das instâncias pelos
+ * estados, os eventos pendentes, a taxa de transições e os estados mais
+ * quentes. A aplicação inspecionada não é alterada nem sincronizada: as
+ * leituras são amostras do segmento e podem misturar instâncias de momentos
+ * ligeiramente diferentes.
+ *
+ * A taxa de transições depende do contador de cada instância, presente com
+ * FSM_SEQLOCK_ENABLE; a taxa de entrada em um estado é a soma das transições
+ * do intervalo das instâncias que estão nele. Sem o contador, os estados
+ * quentes são os mais ocupados.
+ *
+ * @code
+ * make -C tools
+ * ./build/fsmtop [-i intervalo_ms] [-n amostras] [-k estados] /segmento
+ * @endcode
+ *
+ */
+
+/**
+ * Bibliotecas Privadas
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fsm_shm.h"
+
+/**
+ * @defgroup fsmtop_c doxygengroup
+ * @{
+ */
+
+/**
+ * Macros Privadas
+ */
+#define FSMTOP_BAR			30
+
+/**
+ * Tipos de Dados Privados
+ */
+typedef struct fsmtop_fsm
+{
+	const fsm_shm_fsm_t*	desc;
+	const uint64_t*			states;
+	const char*				state_names;
+	const char*				event_names;
+	const uint8_t*			instances;
+	uint64_t*				waiting;	/**< Instâncias com cada evento pendente */
+	uint32_t*				last;		/**< Transições de cada instância na amostra anterior */
+	uint64_t				count[FSM_SHM_MAX_STATES + 1];		/**< Instâncias por estado; o último conta estados fora da tabela */
+	uint64_t				entered[FSM_SHM_MAX_STATES + 1];	/**< Transições do intervalo por estado atual */
+	uint64_t				pending;
+	uint64_t				transitions;
+} fsmtop_fsm_t;
+
+/**
+ * Protótipos de Funções Privadas
+ */
+static const fsm_shm_header_t*	fsmtop_attach	(const char *name, size_t *size);
+static void		fsmtop_sample	(const fsm_shm_header_t *header, fsmtop_fsm_t *fsm, uint8_t first);
+static void		fsmtop_print	(const fsm_shm_header_t *header, const fsmtop_fsm_t *fsm, double seconds, uint32_t top);
+static uint16_t	fsmtop_state	(const fsmtop_fsm_t *fsm, uint64_t value);
+static uint64_t	fsmtop_read		(const uint8_t *field, uint16_t size);
+
+/**
+ * @}
+ */
+
+int main(int argc, char *argv[])
+{
+	const fsm_shm_header_t *header;
+	const fsm_shm_fsm_t *desc;
+	fsmtop_fsm_t *fsms;
+	struct timespec delay, before, now;
+	uint32_t interval = 1000, samples = 0, top = 3, sample;
+	uint16_t index;
+	const char *name = NULL;
+	size_t size;
+	double seconds;
+	int a;
+
+	for( a=1; a<argc; a++ )
+	{
+		if( (strcmp(argv[a], "-i") == 0) && (a+1 < argc) )
+		{
+			interval = (uint32_t)strtoul(argv[++a], NULL, 10);
+		}
+		else if( (strcmp(argv[a], "-n") == 0) && (a+1 < argc) )
+		{
+			samples = (uint32_t)strtoul(argv[++a], NULL, 10);
+		}
+		else if( (strcmp(argv[a], "-k") == 0) && (a+1 < argc) )
+		{
+			top = (uint32_t)strtoul(argv[++a], NULL, 10);
+		}
+		else
+		{
+			name = argv[a];
+		}
+	}
+	if( (name == NULL) || (interval == 0) )
+	{
+		fprintf(stderr, "uso: %s [-i intervalo_ms] [-n amostras] [-k estados] /segmento\n", argv[0]);
+		return(2);
+	}
+
+	header = fsmtop_attach(name, &size);
+	if( header == NULL )
+	{
+		return(1);
+	}
+
+	fsms = (fsmtop_fsm_t*)calloc(header->number_fsms, sizeof(fsmtop_fsm_t));
+	if( fsms == NULL )
+	{
+		return(1);
+	}
+	desc = (const fsm_shm_fsm_t*)((const uint8_t*)header + header->fsms_offset);
+	for( index=0; index<header->number_fsms; index++ )
+	{
+		fsms[index].desc		= &desc[index];
+		fsms[index].states		= (const uint64_t*)((const uint8_t*)header + desc[index].states_offset);
+		fsms[index].state_names	= (const char*)header + desc[index].state_names_offset;
+		fsms[index].event_names	= (const char*)header + desc[index].event_names_offset;
+		fsms[index].instances	= (const uint8_t*)header + desc[index].instances_offset;
+		fsms[index].last		= (uint32_t*)calloc(desc[index].population + 1, sizeof(uint32_t));
+		fsms[index].waiting		= (uint64_t*)calloc(desc[index].number_events + 1, sizeof(uint64_t));
+		if( (fsms[index].last == NULL) || (fsms[index].waiting == NULL) )
+		{
+			return(1);
+		}
+		fsmtop_sample(header, &fsms[index], 1);
+	}
+
+	delay.tv_sec	= interval / 1000;
+	delay.tv_nsec	= (long)(interval % 1000) * 1000000L;
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	for( sample=0; (samples == 0) || (sample < samples); sample++ )
+	{
+		nanosleep(&delay, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		seconds = (double)(now.tv_sec - before.tv_sec) + (double)(now.tv_nsec - before.tv_nsec) / 1e9;
+		before = now;
+
+		if( isatty(STDOUT_FILENO) )
+		{
+			printf("\033[H\033[2J");
+		}
+		printf("fsmtop %s  pid %u  %u FSMs  %.0f ms\n", name, header->pid, header->number_fsms, seconds * 1000.0);
+		for( index=0; index<header->number_fsms; index++ )
+		{
+			fsmtop_sample(header, &fsms[index], 0);
+			fsmtop_print(header, &fsms[index], seconds, top);
+		}
+		fflush(stdout);
+	}
+
+	munmap((void*)header, size);
+	return(0);
+}
+
+/**
+ * @brief fsmtop_attach
+ *
+ * Função privada que mapeia o segmento somente para leitura e valida o layout
+ */
+static const fsm_shm_header_t* fsmtop_attach(const char *name, size_t *size)
+{
+	const fsm_shm_header_t *header;
+	const fsm_shm_fsm_t *desc;
+	struct stat info;
+	void *mapped;
+	uint16_t index;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if( fd < 0 )
+	{
+		fprintf(stderr, "fsmtop: segmento %s não encontrado\n", name);
+		return(NULL);
+	}
+	if( (fstat(fd, &info) != 0) || ((size_t)info.st_size < sizeof(fsm_shm_header_t)) )
+	{
+		close(fd);
+		fprintf(stderr, "fsmtop: segmento %s inválido\n", name);
+		return(NULL);
+	}
+	*size = (size_t)info.st_size;
+	mapped = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if( mapped == MAP_FAILED )
+	{
+		fprintf(stderr, "fsmtop: falha ao mapear %s\n", name);
+		return(NULL);
+	}
+
+	header = (const fsm_shm_header_t*)mapped;
+	if( (memcmp(header->magic, "FSMI", 4) != 0) ||
+		(header->version != FSM_SHM_VERSION) ||
+		(header->byte_order != FSM_SHM_BYTE_ORDER) ||
+		(header->size != *size) ||
+		((header->pointer_size != 4) && (header->pointer_size != 8)) ||
+		(header->fsms_offset + (uint64_t)header->number_fsms * sizeof(fsm_shm_fsm_t) > *size) )
+	{
+		munmap(mapped, *size);
+		fprintf(stderr, "fsmtop: %s não é um segmento FSM compatível\n", name);
+		return(NULL);
+	}
+
+	desc = (const fsm_shm_fsm_t*)((const uint8_t*)mapped + header->fsms_offset);
+	for( index=0; index<header->number_fsms; index++ )
+	{
+		if( (desc[index].number_states > FSM_SHM_MAX_STATES) ||
+			(desc[index].state_names_offset + (uint64_t)desc[index].number_states * FSM_SHM_NAME_LENGTH > *size) ||
+			(desc[index].event_names_offset + (uint64_t)desc[index].number_events * FSM_SHM_NAME_LENGTH > *size) ||
+			(desc[index].instances_offset + (uint64_t)desc[index].population * header->handler_size > *size) )
+		{
+			munmap(mapped, *size);
+			fprintf(stderr, "fsmtop: %s não é um segmento FSM compatível\n", name);
+			return(NULL);
+		}
+	}
+
+	return(header);
+}
+
+/**
+ * @brief fsmtop_sample
+ *
+ * Função privada que percorre as instâncias de uma FSM e acumula a amostra
+ */
+static void fsmtop_sample(const fsm_shm_header_t *header, fsmtop_fsm_t *fsm, uint8_t first)
+{
+	const uint8_t *instance = fsm->instances;
+	uint32_t index, transitions;
+	uint16_t state, event;
+
+	memset(fsm->count, 0, sizeof(fsm->count));
+	memset(fsm->entered, 0, sizeof(fsm->entered));
+	memset(fsm->waiting, 0, fsm->desc->number_events * sizeof(uint64_t));
+	fsm->pending		= 0;
+	fsm->transitions	= 0;
+
+	for( index=0; index<fsm->desc->population; index++, instance += header->handler_size )
+	{
+		state = fsmtop_state(fsm, fsmtop_read(instance + header->offset_state, header->pointer_size));
+		fsm->count[state]++;
+		event = (uint16_t)fsmtop_read(instance + header->offset_event, sizeof(uint16_t));
+		if( event < fsm->desc->number_events )
+		{
+			fsm->waiting[event]++;
+			fsm->pending++;
+		}
+		if( header->offset_transitions != FSM_SHM_NO_FIELD )
+		{
+			transitions = (uint32_t)fsmtop_read(instance + header->offset_transitions, sizeof(uint32_t));
+			if( !first )
+			{
+				fsm->transitions		+= (uint32_t)(transitions - fsm->last[index]);
+				fsm->entered[state]		+= (uint32_t)(transitions - fsm->last[index]);
+			}
+			fsm->last[index] = transitions;
+		}
+	}
+}
+
+/**
+ * @brief fsmtop_print
+ *
+ * Função privada que mostra a distribuição e os estados quentes de uma FSM
+ */
+static void fsmtop_print(const fsm_shm_header_t *header, const fsmtop_fsm_t *fsm, double seconds, uint32_t top)
+{
+	uint16_t order[FSM_SHM_MAX_STATES + 1];
+	uint8_t shown[FSM_SHM_MAX_STATES];
+	uint16_t number = fsm->desc->number_states + 1, i, j, swap;
+	uint8_t rates = (header->offset_transitions != FSM_SHM_NO_FIELD);
+	uint64_t population = (fsm->desc->population != 0) ? fsm->desc->population : 1;
+	const uint64_t *key = rates ? fsm->entered : fsm->count;
+	char bar[FSMTOP_BAR + 1];
+	const char *name;
+	uint32_t width;
+
+	printf("\n%.16s  %u instâncias  %llu pendentes", fsm->desc->name, fsm->desc->population, (unsigned long long)fsm->pending);
+	if( rates )
+	{
+		printf("  %.0f transições/s", (double)fsm->transitions / seconds);
+	}
+	printf("\n  %-24s %10s %7s  %-*s %12s\n", "estado", "instâncias", "%", FSMTOP_BAR, "", rates ? "entradas/s" : "");
+
+	// Ordena os estados pela ocupação, do maior para o menor
+	for( i=0; i<number; i++ )
+	{
+		order[i] = i;
+	}
+	for( i=1; i<number; i++ )
+	{
+		for( j=i; (j > 0) && (fsm->count[order[j]] > fsm->count[order[j-1]]); j-- )
+		{
+			swap = order[j]; order[j] = order[j-1]; order[j-1] = swap;
+		}
+	}
+
+	for( i=0; i<number; i++ )
+	{
+		if( (order[i] == fsm->desc->number_states) && (fsm->count[order[i]] == 0) )
+		{
+			continue;
+		}
+		name = (order[i] == fsm->desc->number_states) ? "?" : &fsm->state_names[order[i] * FSM_SHM_NAME_LENGTH];
+		width = (uint32_t)((fsm->count[order[i]] * FSMTOP_BAR + population / 2) / population);
+		memset(bar, '#', width);
+		bar[width] = '\0';
+		if( name[0] == '\0' )
+		{
+			printf("  #%-23u", order[i]);
+		}
+		else
+		{
+			printf("  %-24.*s", FSM_SHM_NAME_LENGTH, name);
+		}
+		printf(" %10llu %6.2f%%  %-*s", (unsigned long long)fsm->count[order[i]],
+			   100.0 * (double)fsm->count[order[i]] / (double)population, FSMTOP_BAR, bar);
+		if( rates )
+		{
+			printf(" %12.0f", (double)fsm->entered[order[i]] / seconds);
+		}
+		printf("\n");
+	}
+
+	// Eventos pendentes, na ordem dos eventos
+	if( fsm->pending > 0 )
+	{
+		printf("  pendentes:");
+		for( j=0; j<fsm->desc->number_events; j++ )
+		{
+			if( fsm->waiting[j] == 0 )
+			{
+				continue;
+			}
+			name = &fsm->event_names[j * FSM_SHM_NAME_LENGTH];
+			if( name[0] == '\0' )
+			{
+				printf(" #%u=%llu", j, (unsigned long long)fsm->waiting[j]);
+			}
+			else
+			{
+				printf(" %.*s=%llu", FSM_SHM_NAME_LENGTH, name, (unsigned long long)fsm->waiting[j]);
+			}
+		}
+		printf("\n");
+	}
+
+	// Estados quentes: mais entradas no intervalo ou, sem contador, mais ocupados
+	printf("  quentes:");
+	memset(shown, 0, sizeof(shown));
+	for( i=0; (i < top) && (i < fsm->desc->number_states); i++ )
+	{
+		swap = FSM_SHM_MAX_STATES;
+		for( j=0; j<fsm->desc->number_states; j++ )
+		{
+			if( !shown[j] && ((swap == FSM_SHM_MAX_STATES) || (key[j] > key[swap])) )
+			{
+				swap = j;
+			}
+		}
+		if( (swap == FSM_SHM_MAX_STATES) || (key[swap] == 0) )
+		{
+			break;
+		}
+		name = &fsm->state_names[swap * FSM_SHM_NAME_LENGTH];
+		if( name[0] == '\0' )
+		{
+			printf(" #%u", swap);
+		}
+		else
+		{
+			printf(" %.*s", FSM_SHM_NAME_LENGTH, name);
+		}
+		shown[swap] = 1;
+	}
+	printf("\n");
+}
+
+/**
+ * @brief fsmtop_state
+ *
+ * Função privada que converte o ponteiro do estado no índice da tabela
+ */
+static uint16_t fsmtop_state(const fsmtop_fsm_t *fsm, uint64_t value)
+{
+	uint16_t state;
+
+	for( state=0; state<fsm->desc->number_states; state++ )
+	{
+		if( fsm->states[state] == value )
+		{
+			return(state);
+		}
+	}
+	return(fsm->desc->number_states);
+}
+
+/**
+ * @brief fsmtop_read
+ *
+ * Função privada que lê um campo de 2, 4 ou 8 bytes de uma instância
+ */
+static uint64_t fsmtop_read(const uint8_t *field, uint16_t size)
+{
+	uint64_t value64;
+	uint32_t value32;
+	uint16_t value16;
+
+	switch( size )
+	{
+		case sizeof(uint16_t):
+			memcpy(&value16, field, sizeof(value16));
+			return(value16);
+		case sizeof(uint32_t):
+			memcpy(&value32, field, sizeof(value32));
+			return(value32);
+		default:
+			memcpy(&value64, field, sizeof(value64));
+			return(value64);
+	}
+}